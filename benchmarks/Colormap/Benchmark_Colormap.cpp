@@ -0,0 +1,51 @@
+#include "RCubeViewer/Colormap.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Measures the throughput of colormapping float arrays to RGB floats and packed RGBA8 colors
+int main()
+{
+    using namespace rcube::viewer;
+    using Clock = std::chrono::high_resolution_clock;
+
+    const size_t sizes[] = {size_t(1) << 10, size_t(1) << 16, size_t(1) << 20, size_t(1) << 24};
+    const int repetitions = 10;
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-0.1f, 1.1f);
+    std::printf("%12s %16s %16s\n", "#values", "RGB32F (M/s)", "RGBA8 (M/s)");
+    for (size_t size : sizes)
+    {
+        std::vector<float> values(size);
+        for (float &v : values)
+        {
+            v = dist(rng);
+        }
+        std::vector<float> rgb(3 * size);
+        std::vector<uint32_t> rgba(size);
+
+        // Warm up (builds the lookup tables, spins up threads)
+        colormap(Colormap::Viridis, values.data(), size, 0.f, 1.f, rgb.data());
+
+        auto start = Clock::now();
+        for (int i = 0; i < repetitions; ++i)
+        {
+            colormap(Colormap::Viridis, values.data(), size, 0.f, 1.f, rgb.data());
+        }
+        const double rgb_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        start = Clock::now();
+        for (int i = 0; i < repetitions; ++i)
+        {
+            colormap(Colormap::Viridis, values.data(), size, 0.f, 1.f, rgba.data());
+        }
+        const double rgba_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        const double total = double(size) * double(repetitions) * 1e-6;
+        std::printf("%12zu %16.1f %16.1f\n", size, total / rgb_seconds, total / rgba_seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include "RCube/Core/Graphics/LightClusters.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Reports the time buildLightClusters() takes for growing numbers of small point lights spread
+// through a 1280x720 perspective view, and the average number of lights per cluster (the
+// number of lights a fragment shades) compared to the total number of lights.
+using namespace rcube;
+
+int main()
+{
+    const glm::mat4 projection =
+        glm::perspective(glm::radians(45.f), 1280.f / 720.f, 0.1f, 100.f);
+    const LightClusterSettings settings;
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> lateral(-20.f, 20.f);
+    std::uniform_real_distribution<float> depth(-60.f, -1.f);
+    std::printf("%10s %12s %16s %10s\n", "#lights", "time (ms)", "lights/cluster", "dropped");
+    const size_t counts[] = {50, 200, 1000, 4000};
+    for (size_t count : counts)
+    {
+        std::vector<glm::vec4> lights(count);
+        for (glm::vec4 &light : lights)
+        {
+            light = glm::vec4(lateral(rng), 0.5f * lateral(rng), depth(rng), 2.f);
+        }
+        using Clock = std::chrono::high_resolution_clock;
+        const int repeats = 20;
+        LightClusters clusters;
+        const auto start = Clock::now();
+        for (int i = 0; i < repeats; ++i)
+        {
+            clusters = buildLightClusters(projection, 0.1f, 100.f, lights, settings);
+        }
+        const double ms =
+            std::chrono::duration<double, std::milli>(Clock::now() - start).count() / repeats;
+        std::printf("%10zu %12.3f %16.2f %10zu\n", count, ms,
+                    double(clusters.indices.size()) / double(clusters.ranges.size()),
+                    clusters.dropped);
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include "RCube/Core/Graphics/MeshGen/MeshSimplifier.h"
+#include "RCube/Core/Graphics/MeshGen/Obj.h"
+#include "RCube/Core/Graphics/MeshGen/Sphere.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Reports the triangle count and error of each level of detail generated by generateLODChain(),
+// and the time it takes. An OBJ file given on the command line is simplified as well.
+using namespace rcube;
+
+static void run(const std::string &name, const TriangleMeshData &mesh)
+{
+    using Clock = std::chrono::high_resolution_clock;
+    const auto start = Clock::now();
+    const std::vector<MeshLOD> chain = generateLODChain(mesh);
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    const size_t num_triangles = mesh.indexed ? mesh.indices.size() : mesh.vertices.size() / 3;
+    std::printf("%-28s %10zu triangles, %zu levels in %.1f ms\n", name.c_str(), num_triangles,
+                chain.size(), ms);
+    for (size_t i = 0; i < chain.size(); ++i)
+    {
+        std::printf("    LOD %zu: %10zu triangles %10zu vertices   error %g\n", i + 1,
+                    chain[i].mesh.indices.size(), chain[i].mesh.vertices.size(), chain[i].error);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned int resolutions[] = {64, 256, 1024};
+    for (unsigned int res : resolutions)
+    {
+        run("uvSphere " + std::to_string(res), uvSphere(1.f, res, 2 * res));
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        run(argv[i], loadOBJ(argv[i]));
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "RCube/Core/Graphics/MeshGen/Meshlets.h"
+#include "RCube/Core/Graphics/MeshGen/Obj.h"
+#include "RCube/Core/Graphics/MeshGen/Sphere.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Reports the number of meshlets built by buildMeshlets() and the time it takes, and how many
+// meshlets cullMeshlets() keeps for a camera looking at the mesh from a few distances, with and
+// without back-facing cone culling. An OBJ file given on the command line is tested as well.
+using namespace rcube;
+
+static void run(const std::string &name, const TriangleMeshData &mesh)
+{
+    using Clock = std::chrono::high_resolution_clock;
+    auto start = Clock::now();
+    const std::vector<Meshlet> meshlets = buildMeshlets(mesh);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    const size_t num_triangles = mesh.indexed ? mesh.indices.size() : mesh.vertices.size() / 3;
+    std::printf("%-28s %10zu triangles, %8zu meshlets built in %.1f ms\n", name.c_str(),
+                num_triangles, meshlets.size(), ms);
+
+    glm::vec3 min, max;
+    mesh.boundingBox(min, max);
+    const glm::vec3 center = 0.5f * (min + max);
+    const float radius = 0.5f * glm::length(max - min);
+    const glm::mat4 projection =
+        glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.01f * radius, 100.f * radius);
+    const float distances[] = {0.5f, 1.5f, 4.f};
+    std::vector<uint32_t> visible;
+    for (float distance : distances)
+    {
+        const glm::vec3 eye = center + glm::vec3(0.f, 0.f, radius * (1.f + distance));
+        MeshletCullingView view;
+        view.object_to_clip = projection * glm::lookAt(eye, center, glm::vec3(0.f, 1.f, 0.f));
+        view.eye = glm::vec4(eye, 1.f);
+        for (bool cone : {false, true})
+        {
+            view.cull_backfacing = cone;
+            start = Clock::now();
+            cullMeshlets(meshlets, view, visible);
+            ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            std::printf("    distance %.1f, %-9s %8zu visible meshlets in %.2f ms\n", distance,
+                        cone ? "cone:" : "no cone:", visible.size(), ms);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned int resolutions[] = {64, 256, 1024};
+    for (unsigned int res : resolutions)
+    {
+        run("uvSphere " + std::to_string(res), uvSphere(1.f, res, 2 * res));
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        run(argv[i], loadOBJ(argv[i]));
+    }
+    return 0;
+}
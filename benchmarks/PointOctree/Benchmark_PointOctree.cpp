@@ -0,0 +1,76 @@
+#include "RCube/Core/Graphics/PointOctree.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+
+// Reports the time buildPointOctree() takes to convert noisy spheres of a few sizes, the shape
+// of the resulting octrees, and how many nodes and points selectNodes() picks for a camera
+// looking at the sphere from a few distances. The number of points of the largest sphere can be
+// given on the command line.
+using namespace rcube;
+
+static void run(size_t num_points)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+    std::vector<glm::vec3> positions(num_points);
+    std::vector<glm::vec3> colors(num_points);
+    for (size_t i = 0; i < num_points; ++i)
+    {
+        glm::vec3 p(uniform(rng), uniform(rng), uniform(rng));
+        while (glm::length(p) < 1e-3f)
+        {
+            p = glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+        }
+        positions[i] = glm::normalize(p) * (1.f + 0.01f * uniform(rng));
+        colors[i] = 0.5f * positions[i] + 0.5f;
+    }
+
+    const std::filesystem::path directory =
+        std::filesystem::temp_directory_path() / "rcube_point_octree_benchmark";
+    using Clock = std::chrono::high_resolution_clock;
+    MemoryPointSource source(positions, colors);
+    auto start = Clock::now();
+    const PointOctreeStats stats = buildPointOctree(source, directory.string());
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::printf("%10zu points: %6zu nodes, %4zu chunks, depth %zu, converted in %.0f ms\n",
+                stats.num_points, stats.num_nodes, stats.num_chunks, stats.depth, ms);
+
+    std::shared_ptr<PointOctree> octree = PointOctree::open(directory.string());
+    const glm::vec2 viewport(1920.f, 1080.f);
+    const glm::mat4 projection =
+        glm::perspective(glm::radians(45.f), viewport.x / viewport.y, 0.01f, 100.f);
+    const float distances[] = {0.5f, 1.5f, 4.f};
+    for (float distance : distances)
+    {
+        PointOctreeView view;
+        view.eye = glm::vec3(0.f, 0.f, 1.f + distance);
+        view.world_to_clip = projection * glm::lookAt(view.eye, glm::vec3(0.f),
+                                                      glm::vec3(0.f, 1.f, 0.f));
+        view.pixels_per_unit = 0.5f * viewport.y * projection[1][1];
+        start = Clock::now();
+        const std::vector<uint32_t> selected = octree->selectNodes(view, 5000000, 150.f);
+        ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        size_t points = 0;
+        for (uint32_t node : selected)
+        {
+            points += octree->nodes()[node].num_points;
+        }
+        std::printf("    distance %.1f: %6zu nodes, %10zu points selected in %.3f ms\n", distance,
+                    selected.size(), points, ms);
+    }
+    std::filesystem::remove_all(directory);
+}
+
+int main(int argc, char **argv)
+{
+    const size_t largest = argc > 1 ? std::stoull(argv[1]) : 20000000;
+    for (size_t num_points = largest / 100; num_points <= largest; num_points *= 10)
+    {
+        run(num_points);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "RCube/Core/Graphics/MeshGen/Sphere.h"
+#include "RCube/Core/Graphics/OpenGL/VertexFormat.h"
+#include "glm/gtc/type_ptr.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Compares the memory, vertex fetch bandwidth, conversion throughput and precision of the
+// compact vertex formats with 32-bit floats on UV spheres of increasing resolution
+using namespace rcube;
+
+struct Attribute
+{
+    const char *name;
+    size_t dim;
+    AttributeFormat format;
+    std::vector<float> data;
+};
+
+// Largest per-component error, or the largest angle in degrees for unit vectors
+static double maxError(const Attribute &attr, const std::vector<float> &decoded)
+{
+    double error = 0.0;
+    const size_t count = attr.data.size() / attr.dim;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (attr.format == AttributeFormat::Oct16)
+        {
+            const glm::vec3 a = glm::make_vec3(&attr.data[3 * i]);
+            const glm::vec3 b = glm::make_vec3(&decoded[3 * i]);
+            const double cos_angle = std::min(1.0, double(glm::dot(a, b)));
+            error = std::max(error, std::acos(cos_angle) * 180.0 / 3.14159265358979);
+            continue;
+        }
+        for (size_t c = 0; c < attr.dim; ++c)
+        {
+            const size_t k = i * attr.dim + c;
+            error = std::max(error, double(std::abs(attr.data[k] - decoded[k])));
+        }
+    }
+    return error;
+}
+
+int main()
+{
+    using Clock = std::chrono::high_resolution_clock;
+    const unsigned int resolutions[] = {64, 180, 512};
+    for (unsigned int res : resolutions)
+    {
+        TriangleMeshData sphere = uvSphere(10.f, res, 2 * res);
+        const size_t num_vertices = sphere.vertices.size();
+        std::vector<Attribute> attributes = {
+            {"positions", 3, AttributeFormat::Snorm16, {}},
+            {"normals", 3, AttributeFormat::Oct16, {}},
+            {"uvs", 2, AttributeFormat::Float16, {}},
+            {"colors", 3, AttributeFormat::Unorm8, {}},
+            {"tangents", 3, AttributeFormat::Oct16, {}},
+        };
+        for (size_t i = 0; i < num_vertices; ++i)
+        {
+            const glm::vec3 &p = sphere.vertices[i];
+            const glm::vec3 &n = sphere.normals[i];
+            const glm::vec3 t = glm::length(glm::vec2(n.x, n.z)) > 1e-6f
+                                    ? glm::normalize(glm::vec3(-n.z, 0.f, n.x))
+                                    : glm::vec3(1.f, 0.f, 0.f);
+            const glm::vec3 color = 0.5f * n + 0.5f;
+            attributes[0].data.insert(attributes[0].data.end(), {p.x + 100.f, p.y, p.z});
+            attributes[1].data.insert(attributes[1].data.end(), {n.x, n.y, n.z});
+            attributes[2].data.insert(attributes[2].data.end(),
+                                      {sphere.texcoords[i].x, sphere.texcoords[i].y});
+            attributes[3].data.insert(attributes[3].data.end(), {color.x, color.y, color.z});
+            attributes[4].data.insert(attributes[4].data.end(), {t.x, t.y, t.z});
+        }
+        const size_t num_indices = sphere.indices.size() * 3;
+        const bool indices16 = num_vertices <= 65536;
+
+        std::printf("UV sphere: %zu vertices, %zu triangles\n", num_vertices,
+                    sphere.indices.size());
+        std::printf("%12s %10s %12s %12s %14s %12s\n", "Attribute", "Format", "Bytes",
+                    "Float bytes", "Pack (MV/s)", "Max error");
+        size_t total = 0, total_float = 0, stride = 0, stride_float = 0;
+        for (const Attribute &attr : attributes)
+        {
+            // Snorm16 data is relative to its bounding box, as in AttributeBuffer
+            glm::vec4 offset(0.f), scale(1.f);
+            if (attr.format == AttributeFormat::Snorm16)
+            {
+                for (size_t c = 0; c < attr.dim; ++c)
+                {
+                    float lo = attr.data[c], hi = attr.data[c];
+                    for (size_t k = c; k < attr.data.size(); k += attr.dim)
+                    {
+                        lo = std::min(lo, attr.data[k]);
+                        hi = std::max(hi, attr.data[k]);
+                    }
+                    offset[c] = 0.5f * (lo + hi);
+                    scale[c] = hi > lo ? 0.5f * (hi - lo) : 1.f;
+                }
+            }
+            const size_t element_bytes = formatStride(attr.format, attr.dim);
+            std::vector<char> packed(num_vertices * element_bytes);
+            const auto start = Clock::now();
+            packElements(attr.format, attr.dim, attr.data.data(), num_vertices, offset, scale,
+                         packed.data());
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            std::vector<float> decoded(attr.data.size());
+            unpackElements(attr.format, attr.dim, packed.data(), num_vertices, offset, scale,
+                           decoded.data());
+
+            const size_t float_bytes = attr.data.size() * sizeof(float);
+            std::printf("%12s %10s %12zu %12zu %14.1f %12.2e\n", attr.name,
+                        formatName(attr.format).c_str(), packed.size(), float_bytes,
+                        double(num_vertices) * 1e-6 / std::max(seconds, 1e-9),
+                        maxError(attr, decoded));
+            total += packed.size();
+            total_float += float_bytes;
+            stride += element_bytes;
+            stride_float += attr.dim * sizeof(float);
+        }
+        const size_t index_bytes = num_indices * (indices16 ? 2 : 4);
+        std::printf("%12s %10s %12zu %12zu\n", "indices", indices16 ? "Uint16" : "Uint32",
+                    index_bytes, num_indices * 4);
+        total += index_bytes;
+        total_float += num_indices * 4;
+        std::printf("Total: %zu vs. %zu bytes (%.1f%%), vertex fetch: %zu vs. %zu bytes per "
+                    "vertex\n\n",
+                    total, total_float, 100.0 * double(total) / double(total_float), stride,
+                    stride_float);
+    }
+    return 0;
+}
@@ -52,9 +52,9 @@ int main()
     s.get<ForwardMaterial>()->shader = std::make_shared<StandardMaterial>();
     ShaderMaterial *generic_mat = s.get<ForwardMaterial>()->shader.get();
     StandardMaterial *mat = dynamic_cast<StandardMaterial *>(generic_mat);
-    mat->albedo = glm::vec3(0.953, 0.788, 0.408);
-    mat->roughness = 0.1f;
-    mat->metallic = 1.f;
+    mat->setAlbedo(glm::vec3(0.953, 0.788, 0.408));
+    mat->setRoughness(0.1f);
+    mat->setMetallic(1.f);
 
     // Set IBL maps to the material from the camera textures
     mat->setIBLFromCamera(viewer.camera().get<Camera>());
@@ -4,6 +4,8 @@
 #include <memory>
 
 #include "RCube/Core/Arch/Component.h"
+#include "RCube/Core/Graphics/MeshGen/MeshSimplifier.h"
+#include "RCube/Core/Graphics/MeshGen/Meshlets.h"
 #include "RCube/Core/Graphics/OpenGL/Mesh.h"
 #include "RCube/Core/Graphics/OpenGL/ShaderProgram.h"
 namespace rcube
@@ -20,9 +22,63 @@ namespace rcube
 class Drawable : public Component<Drawable>
 {
   public:
-    std::shared_ptr<Mesh> mesh; /// OpenGL mesh
-    bool visible = true;        /// Whether visible when rendered
-    bool cast_shadow = true;    /// Whether this object casts a shadow
+    /**
+     * A simplified version of the mesh and its error in object space units
+     */
+    struct LOD
+    {
+        std::shared_ptr<Mesh> mesh;
+        float error = 0.f;
+    };
+
+    std::shared_ptr<Mesh> mesh;       /// OpenGL mesh
+    bool visible = true;              /// Whether visible when rendered
+    bool cast_shadow = true;          /// Whether this object casts a shadow
+    bool dynamic = false;             /// Whether this object moves or deforms often (its shadow
+                                      /// is then kept out of the cached static shadow maps)
+    std::vector<LOD> lods;            /// Coarser versions of mesh, from finest to coarsest
+    float lod_pixel_error = 1.f;      /// Largest error on screen, in pixels, of a selected LOD
+    float lod_hysteresis = 0.25f;     /// Relative margin around lod_pixel_error before switching
+    std::vector<Meshlet> meshlets;    /// Clusters of the triangles of mesh culled one by one
+                                      /// (see buildMeshlets()), or empty to draw mesh whole
+    bool meshlet_cone_culling = true; /// Whether to cull meshlets facing away from the camera;
+                                      /// disable for open surfaces seen from both sides
+    bool static_batch = false;        /// Whether the mesh and transform rarely change, so that
+                                      /// the forward renderer may merge it with other static
+                                      /// drawables sharing its material into one mesh
+
+    /**
+     * Creates and uploads a mesh for each level of a chain made by generateLODChain() from the
+     * data of mesh, replacing the current levels of detail. The levels are used by the forward
+     * renderer unless the mesh is instanced or shows face data or a colormap, which the
+     * simplified meshes lack; shadows are always drawn with the full mesh.
+     *
+     * @param chain Simplified meshes and their errors
+     */
+    void setLODChain(const std::vector<MeshLOD> &chain);
+
+    /**
+     * Selects a level of detail: 0 is the full mesh and i > 0 is lods[i - 1]. The coarsest
+     * level whose error on screen is below lod_pixel_error is chosen. To keep levels from
+     * popping back and forth, a coarser level is only taken when its error is below
+     * (1 - lod_hysteresis) times the threshold, and the current level is only refined when its
+     * error exceeds (1 + lod_hysteresis) times the threshold.
+     *
+     * @param pixels_per_unit Size on screen, in pixels, of one object space unit at the
+     * nearest point of the object's bounding sphere
+     * @param current Level selected in the previous frame
+     * @return Selected level
+     */
+    size_t selectLOD(float pixels_per_unit, size_t current) const;
+
+    /**
+     * Mesh of a level of detail (see selectLOD())
+     */
+    const std::shared_ptr<Mesh> &lodMesh(size_t level) const
+    {
+        return level == 0 || level > lods.size() ? mesh : lods[level - 1].mesh;
+    }
+
     void drawGUI();
 };
 
@@ -3,8 +3,21 @@
 #include "RCube/Core/Arch/Component.h"
 #include "RCube/Core/Graphics/OpenGL/Renderer.h"
 #include "RCube/Core/Graphics/OpenGL/ShaderProgram.h"
+#include "RCube/Core/Graphics/OpenGL/UniformBufferArena.h"
 #include <functional>
 
+/**
+ * Uniform block binding index reserved for material parameters
+ * (0: camera, 1: directional lights, 2: point lights)
+ */
+#define RCUBE_MATERIAL_UNIFORM_BLOCK_BINDING 3
+
+/**
+ * Shader storage binding index of the parameters of the materials drawn by a multi-draw call:
+ * an array of their uniform blocks, indexed by the y component of the per-object IDs
+ */
+#define RCUBE_MULTIDRAW_MATERIAL_BINDING 5
+
 namespace rcube
 {
 
@@ -13,10 +26,68 @@ class ShaderMaterial
   protected:
     const std::string name_;
 
+    /**
+     * Materials that declare their parameters in a std140 uniform block at binding
+     * RCUBE_MATERIAL_UNIFORM_BLOCK_BINDING override this to pack the parameters in the
+     * order of the GLSL block. Returns false if the material does not use a uniform block.
+     *
+     * @param writer Writer to pack the values into
+     */
+    virtual bool writeUniformBlock(Std140Writer &writer);
+
+    /**
+     * Binds the range of the uniform block in the shared UniformBufferArena for drawing,
+     * repacking and uploading it first if markUniformBlockDirty() was called or the opacity
+     * changed since the last upload. Returns false if the material does not use a uniform
+     * block.
+     */
+    bool bindUniformBlock();
+
+    /**
+     * Setters of parameters in the uniform block call this so that the block is repacked
+     */
+    void markUniformBlockDirty();
+
+  private:
+    // Repacks block_data_ if needed; returns false if the material has no uniform block
+    bool updateUniformBlock();
+
+    UniformBufferArena::Block block_;
+    std::vector<char> block_data_;
+    // Whether block_data_ must be repacked, and whether it was uploaded since
+    bool block_dirty_ = true;
+    bool block_uploaded_ = false;
+    // opacity is a public field, so it is compared with the packed value instead
+    float block_opacity_ = 1.f;
+
   public:
     ShaderMaterial(const std::string &name);
-    ~ShaderMaterial() = default;
+    ShaderMaterial(const ShaderMaterial &other);
+    ShaderMaterial &operator=(const ShaderMaterial &other);
+    virtual ~ShaderMaterial();
     virtual void updateUniforms(std::shared_ptr<ShaderProgram> shader);
+    /**
+     * Copies the parameters of the material as laid out in its uniform block, packed again
+     * only if they changed. Returns false if the material does not use a uniform block.
+     *
+     * @param data Bytes of the block
+     */
+    bool packUniformBlock(std::vector<char> &data);
+    /**
+     * Whether the shaders of this material read the model and normal matrices from the
+     * per-object storage buffer, and their parameters from the array of uniform blocks at
+     * RCUBE_MULTIDRAW_MATERIAL_BINDING, when RCUBE_MULTIDRAW is defined. This allows the
+     * ForwardRenderSystem to draw objects with different materials of the same shader in one
+     * multi-draw call. The uniform block must have the same layout in std430 and a size that
+     * is a multiple of 16 bytes.
+     */
+    virtual bool supportsMultiDraw() const;
+    /**
+     * Whether the depth of the material's fragments matches the depth of the rasterized mesh.
+     * Materials that write gl_FragDepth (e.g., ray-cast impostors) return false: they are left
+     * out of the depth prepass and drawn with depth writes in the opaque pass instead.
+     */
+    virtual bool supportsDepthPrepass() const;
     virtual void drawGUI();
     virtual const std::vector<DrawCall::Texture2DInfo> textureSlots();
     virtual const std::vector<DrawCall::TextureCubemapInfo> cubemapSlots();
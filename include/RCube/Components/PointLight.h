@@ -3,14 +3,13 @@
 #include "RCube/Core/Arch/Component.h"
 #include "glm/glm.hpp"
 
-#define RCUBE_MAX_POINT_LIGHTS 50
-
 namespace rcube
 {
 
 /**
  * PointLight represents a light that emits light in all directions.
- * Its intensity diminishes with distance based on the inverse-square law.
+ * Its intensity diminishes with distance based on the inverse-square law and is
+ * faded out to zero at its range.
  * To create a valid point light, add a PointLight component and a
  * Transform component (light's position) to an entity.
  */
@@ -21,6 +20,7 @@ class PointLight : public Component<PointLight>
     glm::vec3 position_ = glm::vec3(0, 0, 0);
     float radius_ = 1.f;
     glm::vec3 color_ = glm::vec3(1, 1, 1);
+    float range_ = 0.f;
 
   public:
     PointLight(float radius = 1.f, glm::vec3 color = glm::vec3(1.f));
@@ -36,6 +36,19 @@ class PointLight : public Component<PointLight>
      */
     void setRadius(float val);
 
+    /**
+     * Get the distance beyond which the light has no effect. Unless set with setRange(), this
+     * is the distance at which the light's inverse-square falloff drops below 1/256.
+     * @return Range
+     */
+    float range() const;
+    /**
+     * Set the distance beyond which the light has no effect; smaller ranges let the forward
+     * renderer shade fewer lights per pixel
+     * @param val Range, or 0 to derive it from the radius, intensity and color
+     */
+    void setRange(float val);
+
     /**
      * Get the color of the light
      * @return Color
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rcube
+{
+
+class WorkerPool;
+
+/**
+ * Settings of the clustered light assignment of the forward renderer. The view frustum is
+ * divided into a grid of clusters: grid.x by grid.y screen tiles and grid.z slices whose depth
+ * grows exponentially from the near to the far plane. Each cluster stores the list of point
+ * lights whose range overlaps it, so that a fragment only shades the lights of its cluster.
+ */
+struct LightClusterSettings
+{
+    // Number of clusters along the width, height and depth of the view frustum
+    glm::uvec3 grid = glm::uvec3(16, 9, 24);
+    // Maximum number of point lights; further lights are ignored
+    size_t max_point_lights = 4096;
+    // Maximum number of light references summed over all clusters; references beyond it are
+    // dropped (see LightClusters::dropped)
+    size_t max_light_indices = 512 * 1024;
+    // Below this many point lights, the lights are assigned on a single thread
+    size_t min_parallel_lights = 64;
+};
+
+/**
+ * Point lights assigned to the clusters of a view frustum
+ */
+struct LightClusters
+{
+    // Number of clusters along the width, height and depth of the view frustum
+    glm::uvec3 grid = glm::uvec3(0);
+    // Depth slice of a view depth d is floor(log(d) * z_scale + z_bias)
+    float z_scale = 0.f;
+    float z_bias = 0.f;
+    // Offset into indices and number of lights of each cluster; x varies fastest, then y
+    std::vector<glm::uvec2> ranges;
+    // Concatenated light lists of the clusters
+    std::vector<uint32_t> indices;
+    // Number of light references dropped to stay within max_light_indices
+    size_t dropped = 0;
+};
+
+/**
+ * Assigns point lights to the clusters of a view frustum. A light is added to every cluster
+ * whose view space bounding box intersects the light's sphere of influence. Depth slices are
+ * processed in parallel on the pool when there are at least settings.min_parallel_lights
+ * lights.
+ *
+ * @param view_to_projection Projection matrix of the camera (perspective or orthographic)
+ * @param znear Near plane distance
+ * @param zfar Far plane distance
+ * @param lights View space position (xyz) and range (w) of each light
+ * @param settings Cluster grid size and budget
+ * @param pool Threads to assign the lights on, or nullptr to assign them on the calling thread
+ * @return Light lists of the clusters
+ */
+LightClusters buildLightClusters(const glm::mat4 &view_to_projection, float znear, float zfar,
+                                 const std::vector<glm::vec4> &lights,
+                                 const LightClusterSettings &settings,
+                                 WorkerPool *pool = nullptr);
+
+} // namespace rcube
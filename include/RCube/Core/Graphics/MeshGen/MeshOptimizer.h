@@ -0,0 +1,108 @@
+#pragma once
+
+#include "RCube/Core/Graphics/OpenGL/Mesh.h"
+#include "glm/glm.hpp"
+#include <string>
+#include <vector>
+
+namespace rcube
+{
+
+/**
+ * Efficiency of an index order for a FIFO post-transform vertex cache of the given size
+ */
+struct VertexCacheStatistics
+{
+    // Average cache miss ratio: vertex shader invocations per triangle (0.5 is optimal for
+    // large regular meshes, 3 is the worst)
+    float acmr = 0.f;
+    // Average transformed vertex ratio: vertex shader invocations per referenced vertex
+    // (1 is optimal)
+    float atvr = 0.f;
+};
+
+struct MeshOptimizerOptions
+{
+    // Number of vertices in the simulated post-transform cache
+    unsigned int cache_size = 32;
+    // Reorder clusters of triangles so that outer triangles are drawn first
+    bool optimize_overdraw = true;
+    // Maximum increase of the ACMR allowed when splitting triangles into clusters for the
+    // overdraw optimization; larger values give smaller clusters and less overdraw
+    float overdraw_threshold = 1.05f;
+    // Reorder vertices in the order the triangles first reference them
+    bool optimize_vertex_fetch = true;
+};
+
+struct MeshOptimizerReport
+{
+    VertexCacheStatistics before;
+    VertexCacheStatistics after;
+
+    std::string toString() const;
+};
+
+/**
+ * Simulates a FIFO vertex cache on the given triangles
+ *
+ * @param indices Triangles
+ * @param num_vertices Number of vertices referenced by the indices
+ * @param cache_size Number of vertices in the cache
+ * @return ACMR and ATVR of the triangles
+ */
+VertexCacheStatistics analyzeVertexCache(const std::vector<glm::uvec3> &indices,
+                                         size_t num_vertices, unsigned int cache_size = 32);
+
+/**
+ * Reorders triangles to reuse recently transformed vertices, using Tom Forsyth's linear-speed
+ * vertex cache optimization: triangles are emitted greedily by the score of their vertices,
+ * which favours vertices in the cache and vertices with few remaining triangles
+ *
+ * @param indices Triangles to reorder in place
+ * @param num_vertices Number of vertices referenced by the indices
+ * @param cache_size Number of vertices in the modelled cache
+ */
+void optimizeVertexCache(std::vector<glm::uvec3> &indices, size_t num_vertices,
+                         unsigned int cache_size = 32);
+
+/**
+ * Reorders clusters of cache-optimized triangles to reduce overdraw, following the cluster
+ * sorting of Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+ * (2007). The triangle order is split into clusters where the vertex cache restarts, as long as
+ * the ACMR within a cluster does not exceed threshold times that of its enclosing run; the
+ * clusters are then sorted so that those facing away from the center of the mesh come first,
+ * since they are likely to occlude the others from most viewpoints.
+ *
+ * @param indices Cache-optimized triangles to reorder in place
+ * @param vertices Vertex positions
+ * @param cache_size Number of vertices in the modelled cache
+ * @param threshold Maximum ratio of a cluster's ACMR to the ACMR of its run
+ */
+void optimizeOverdraw(std::vector<glm::uvec3> &indices, const std::vector<glm::vec3> &vertices,
+                      unsigned int cache_size = 32, float threshold = 1.05f);
+
+/**
+ * Computes a vertex order for fetch locality: vertices are numbered in the order they are
+ * first referenced by the triangles, and unreferenced vertices follow in their original order.
+ * The indices are remapped in place.
+ *
+ * @param indices Triangles whose vertices are renumbered
+ * @param num_vertices Number of vertices
+ * @return For each new vertex index, the old index of the vertex
+ */
+std::vector<unsigned int> optimizeVertexFetch(std::vector<glm::uvec3> &indices,
+                                              size_t num_vertices);
+
+/**
+ * Runs the vertex cache, overdraw and vertex fetch optimizations on an indexed mesh, reordering
+ * all of its per-vertex attributes. Meshes that are not indexed are left unchanged. This is
+ * meant to be run once after loading (e.g., on the result of loadOBJ()) or offline.
+ *
+ * @param mesh Mesh to optimize in place
+ * @param options Which optimizations to run and their parameters
+ * @return Vertex cache statistics before and after the optimization
+ */
+MeshOptimizerReport optimizeMesh(TriangleMeshData &mesh,
+                                 const MeshOptimizerOptions &options = MeshOptimizerOptions());
+
+} // namespace rcube
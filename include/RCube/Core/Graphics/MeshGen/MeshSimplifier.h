@@ -0,0 +1,72 @@
+#pragma once
+
+#include "RCube/Core/Graphics/OpenGL/Mesh.h"
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace rcube
+{
+
+/**
+ * A simplified version of a triangle mesh
+ */
+struct MeshLOD
+{
+    TriangleMeshData mesh;
+    // Estimated distance between the simplified and the original surface, in the units of the
+    // vertex positions: the root mean squared distance of the collapsed vertices to the planes
+    // of the triangles they were merged from
+    float error = 0.f;
+};
+
+struct LODChainOptions
+{
+    // Ratio of the number of triangles of a level to that of the previous level
+    float reduction = 0.5f;
+    // No level with fewer triangles than this is generated
+    size_t min_triangles = 256;
+    // Maximum number of levels, not counting the original mesh
+    size_t max_levels = 8;
+    // Minimum number of triangles per chunk simplified in parallel
+    size_t min_chunk_triangles = 16384;
+};
+
+/**
+ * Simplifies a triangle mesh with quadric error edge collapses (Garland and Heckbert, "Surface
+ * Simplification Using Quadric Error Metrics", 1997). Each collapse merges a vertex into one of
+ * its neighbours, so that the remaining vertices keep their normals, colors and texture
+ * coordinates. Vertices on boundaries and non-manifold edges, and vertices split by a seam
+ * (same position, different attributes, e.g., UV seams or hard edges), are never moved, which
+ * preserves the outline and the texture mapping; collapses that would fold a triangle over
+ * or pinch the surface are skipped.
+ *
+ * Large meshes are split into chunks of triangles sorted along the longest axis of the
+ * bounding box, which are simplified in parallel; vertices shared by chunks are kept.
+ *
+ * @param mesh Mesh to simplify; vertices with identical attributes are welded first, so
+ * non-indexed meshes are accepted
+ * @param target_triangles Number of triangles to reduce the mesh to
+ * @param max_error Collapses whose error exceeds this are not done, even if the target was not
+ * reached
+ * @param min_chunk_triangles Minimum number of triangles per parallel chunk
+ * @return Indexed simplified mesh, holding only the vertices it references, and its error
+ */
+MeshLOD simplifyMesh(const TriangleMeshData &mesh, size_t target_triangles,
+                     float max_error = std::numeric_limits<float>::max(),
+                     size_t min_chunk_triangles = 16384);
+
+/**
+ * Generates a chain of levels of detail by simplifying each level into the next. Generation
+ * stops at options.max_levels, below options.min_triangles or when the simplification stalls
+ * (e.g., on meshes made of seams). The error of a level is accumulated over the chain, so that
+ * it bounds the distance to the original mesh.
+ *
+ * @param mesh Original mesh
+ * @param options Reduction per level and limits
+ * @return Levels after the original mesh, from the finest to the coarsest
+ */
+std::vector<MeshLOD> generateLODChain(const TriangleMeshData &mesh,
+                                      const LODChainOptions &options = LODChainOptions());
+
+} // namespace rcube
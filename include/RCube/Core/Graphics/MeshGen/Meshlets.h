@@ -0,0 +1,86 @@
+#pragma once
+
+#include "RCube/Core/Graphics/OpenGL/Mesh.h"
+#include "glm/glm.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rcube
+{
+
+/**
+ * A cluster of consecutive triangles of a mesh with the bounds needed to cull it as a whole
+ */
+struct Meshlet
+{
+    // Bounding sphere in object space
+    glm::vec3 center = glm::vec3(0.f);
+    float radius = 0.f;
+    // Normal cone: all triangles face away from a viewer at p when
+    // dot(center - p, cone_axis) >= cone_cutoff * length(center - p) + radius. A cutoff of 1
+    // means the triangles face too many directions for the test to succeed.
+    glm::vec3 cone_axis = glm::vec3(0.f, 0.f, 1.f);
+    float cone_cutoff = 1.f;
+    // Triangles first_triangle, ..., first_triangle + num_triangles - 1 of the mesh
+    uint32_t first_triangle = 0;
+    uint32_t num_triangles = 0;
+};
+
+struct MeshletOptions
+{
+    // Maximum number of distinct vertices of a meshlet (at most 255)
+    size_t max_vertices = 64;
+    // Maximum number of triangles of a meshlet
+    size_t max_triangles = 124;
+    // Minimum number of triangles per chunk built in parallel
+    size_t min_chunk_triangles = 65536;
+};
+
+/**
+ * Splits the triangles of a mesh into meshlets: runs of consecutive triangles that reference
+ * at most options.max_vertices vertices. The triangles are not reordered, so the meshlets can
+ * be drawn as ranges of the mesh's own index (or vertex) buffer. Since a meshlet ends as soon
+ * as a triangle would exceed its vertex budget, the triangle order should be local, e.g., as
+ * left by optimizeMesh(). Chunks of triangles are processed in parallel.
+ *
+ * @param mesh Triangle mesh, indexed or not
+ * @param options Size limits of the meshlets
+ * @return Meshlets covering all triangles, in order
+ */
+std::vector<Meshlet> buildMeshlets(const TriangleMeshData &mesh,
+                                   const MeshletOptions &options = MeshletOptions());
+
+/**
+ * A camera that meshlets are culled for, given in the object space of their mesh
+ */
+struct MeshletCullingView
+{
+    // Object to clip space matrix (projection * view * model)
+    glm::mat4 object_to_clip = glm::mat4(1.f);
+    // Camera position (w = 1), or view direction for orthographic cameras (w = 0)
+    glm::vec4 eye = glm::vec4(0.f, 0.f, 0.f, 1.f);
+    // Whether to cull meshlets whose triangles all face away from the camera
+    bool cull_backfacing = true;
+    // Optional depth pyramid level holding the farthest depth of the screen pixels each texel
+    // covers, row by row; pixel (x, y) lies in texel min((x, y) >> depth_shift, depth_size - 1)
+    const float *depth = nullptr;
+    glm::ivec2 depth_size = glm::ivec2(0);
+    int depth_shift = 0;
+    // Size of the viewport in pixels
+    glm::ivec2 viewport = glm::ivec2(1);
+};
+
+/**
+ * Finds the meshlets that may be visible: those whose bounding sphere intersects the view
+ * frustum, that do not face away from the camera (if view.cull_backfacing) and that are not
+ * behind the depth pyramid (if view.depth is given). Meshlets are tested in parallel.
+ *
+ * @param meshlets Meshlets of a mesh
+ * @param view Camera in the object space of the mesh
+ * @param visible Filled with the indices of the visible meshlets, in increasing order
+ */
+void cullMeshlets(const std::vector<Meshlet> &meshlets, const MeshletCullingView &view,
+                  std::vector<uint32_t> &visible);
+
+} // namespace rcube
@@ -1,7 +1,13 @@
 #pragma once
 
 #include "RCube/Core/Graphics/OpenGL/Buffer.h"
+#include "RCube/Core/Graphics/OpenGL/StreamingBuffer.h"
+#include "RCube/Core/Graphics/OpenGL/VertexFormat.h"
 #include "glm/glm.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <stdexcept>
 #include <string>
@@ -17,16 +23,192 @@ enum AttributeLocation
     UV,
     COLOR,
     TANGENT,
-    WIREFRAME
+    WIREFRAME,
+    // Per-instance index into per-object data; set up by the renderer for multi-draw submission
+    DRAW_ID,
+    // Per-instance glyph placement: xyz is the translation and w the scale
+    INSTANCE_OFFSET,
+    // Per-instance glyph orientation: xyz is the direction of the glyph's +Y axis and w the
+    // magnitude of the vector it represents
+    INSTANCE_DIRECTION,
+    // Scalar value mapped to a color in the vertex shader (see rcube::ColormapParameters)
+    SCALAR,
+    // ID of the object a vertex of a static batch belongs to (see buildStaticBatch())
+    OBJECT_ID
 };
 
+/**
+ * Sorted set of ranges [begin, end) of a buffer's CPU data that were modified since the last
+ * upload. Overlapping and adjacent ranges are merged; beyond MAX_RANGES ranges they collapse
+ * into a single range spanning all of them to bound the number of upload calls.
+ */
+class DirtyRanges
+{
+    std::vector<std::pair<size_t, size_t>> ranges_;
+
+  public:
+    static constexpr size_t MAX_RANGES = 32;
+
+    void add(size_t begin, size_t end)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+        auto it = std::lower_bound(ranges_.begin(), ranges_.end(), std::make_pair(begin, end));
+        if (it != ranges_.begin() && std::prev(it)->second >= begin)
+        {
+            --it;
+            it->second = std::max(it->second, end);
+        }
+        else
+        {
+            it = ranges_.insert(it, {begin, end});
+        }
+        // Absorb the following ranges that overlap or touch the merged one
+        auto next = std::next(it);
+        while (next != ranges_.end() && next->first <= it->second)
+        {
+            it->second = std::max(it->second, next->second);
+            next = ranges_.erase(next);
+        }
+        if (ranges_.size() > MAX_RANGES)
+        {
+            ranges_ = {{ranges_.front().first, ranges_.back().second}};
+        }
+    }
+
+    void clear()
+    {
+        ranges_.clear();
+    }
+
+    bool empty() const
+    {
+        return ranges_.empty();
+    }
+
+    const std::vector<std::pair<size_t, size_t>> &ranges() const
+    {
+        return ranges_;
+    }
+};
+
+/**
+ * CPU data of a vertex attribute and the OpenGL buffer it is uploaded to. Modified ranges of the
+ * data are tracked so that update() only uploads what changed: setData() marks everything,
+ * setElements() and markDirty() mark a range, and the non-const accessors conservatively mark
+ * everything since the caller may write anywhere through them.
+ * Attributes that change every frame can be switched to a StreamingBuffer with setStreaming().
+ * The data can be stored in a compact AttributeFormat on the GPU with setFormat(); the CPU data
+ * stays float and is converted when uploading.
+ */
 class AttributeBuffer
 {
     std::string name_;
     GLuint location_ = 0;
     size_t dim_ = 1;
-    std::vector<float> data_;
+    GLuint divisor_ = 0;
+    // Mutable since the const accessors read the data back from the GPU after
+    // releaseCPUData(); size() is released_size_ while the data is not resident
+    mutable std::vector<float> data_;
+    mutable bool resident_ = true;
+    size_t released_size_ = 0;
+    // Reads released data back from where the caller uploaded it instead of from buffer_
+    std::function<void(float *, size_t)> read_back_;
     std::shared_ptr<ArrayBuffer> buffer_;
+    // Ranges of data_ (in floats) to upload
+    DirtyRanges dirty_;
+    // Incremented whenever the data may have been modified
+    size_t version_ = 0;
+    // Used instead of buffer_ when the attribute is streamed
+    std::shared_ptr<StreamingBuffer> streaming_;
+    AttributeFormat format_ = AttributeFormat::Float32;
+    // Range of the data mapped to [-1, 1] by the Snorm16 format, as center and half extent
+    glm::vec4 decode_offset_ = glm::vec4(0.f);
+    glm::vec4 decode_scale_ = glm::vec4(1.f);
+
+    void markAllDirty()
+    {
+        dirty_.add(0, data_.size());
+        ++version_;
+    }
+
+    // Sets the Snorm16 decoding range to the bounding box of the given data
+    void computeDecodeRange(const float *data, size_t size)
+    {
+        glm::vec4 min(0.f), max(0.f);
+        for (size_t c = 0; c < dim_; ++c)
+        {
+            min[c] = max[c] = size == 0 ? 0.f : data[c];
+        }
+        for (size_t i = 0; i < size; ++i)
+        {
+            const size_t c = i % dim_;
+            min[c] = std::min(min[c], data[i]);
+            max[c] = std::max(max[c], data[i]);
+        }
+        decode_offset_ = 0.5f * (min + max);
+        decode_scale_ = 0.5f * (max - min);
+        for (size_t c = 0; c < 4; ++c)
+        {
+            // Constant components decode to the offset with any scale
+            decode_scale_[c] = decode_scale_[c] > 0.f ? decode_scale_[c] : 1.f;
+        }
+    }
+
+    // Reads the data back from the GPU if it was released
+    void restore() const
+    {
+        if (resident_)
+        {
+            return;
+        }
+        data_.resize(released_size_);
+        if (!data_.empty())
+        {
+            if (read_back_)
+            {
+                read_back_(data_.data(), data_.size());
+            }
+            else if (format_ == AttributeFormat::Float32)
+            {
+                buffer_->getData(data_.data(), data_.size() * sizeof(float), 0);
+            }
+            else
+            {
+                std::vector<char> packed(count() * stride());
+                buffer_->getData(packed.data(), packed.size(), 0);
+                unpackElements(format_, dim_, packed.data(), count(), decode_offset_,
+                               decode_scale_, data_.data());
+            }
+        }
+        resident_ = true;
+    }
+
+    // Whether the floats in [begin, end) lie in the Snorm16 decoding range
+    bool inDecodeRange(size_t begin, size_t end) const
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const size_t c = i % dim_;
+            if (std::abs(data_[i] - decode_offset_[c]) > decode_scale_[c])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Converts and uploads the elements containing the floats in [begin, end)
+    void uploadPacked(size_t begin, size_t end)
+    {
+        const size_t first = begin / dim_;
+        const size_t last = (end + dim_ - 1) / dim_;
+        std::vector<char> packed((last - first) * stride());
+        packInto(first, last - first, packed.data(), stride());
+        buffer_->setData(packed.data(), packed.size(), first * stride());
+    }
 
   public:
     AttributeBuffer() = default;
@@ -35,12 +217,23 @@ class AttributeBuffer
 
     AttributeBuffer &operator=(const AttributeBuffer &other) = delete;
 
-    static std::shared_ptr<AttributeBuffer> create(std::string name, GLuint location, size_t dim)
+    /**
+     * Creates an attribute buffer
+     *
+     * @param name Name of the attribute
+     * @param location Layout location of the attribute in the vertex shader
+     * @param dim Number of components per element (1-4)
+     * @param divisor 0 for per-vertex data, 1 for per-instance data
+     * @return Shared pointer to the attribute buffer
+     */
+    static std::shared_ptr<AttributeBuffer> create(std::string name, GLuint location, size_t dim,
+                                                   GLuint divisor = 0)
     {
         auto attr_buf = std::make_shared<AttributeBuffer>();
         attr_buf->name_ = name;
         attr_buf->dim_ = dim;
         attr_buf->location_ = location;
+        attr_buf->divisor_ = divisor;
         attr_buf->buffer_ = ArrayBuffer::create(1);
         return attr_buf;
     }
@@ -52,14 +245,40 @@ class AttributeBuffer
 
     const float *ptr() const
     {
+        restore();
         return data_.data();
     }
 
     float *ptr()
     {
+        restore();
+        markAllDirty();
         return data_.data();
     }
 
+    const glm::vec4 *ptrVec4() const
+    {
+        if (dim_ != 4)
+        {
+            throw std::runtime_error("Attempting to interpret " + std::to_string(dim_) +
+                                     "D data as 4D");
+        }
+        restore();
+        return reinterpret_cast<const glm::vec4 *>(data_.data());
+    }
+
+    glm::vec4 *ptrVec4()
+    {
+        if (dim_ != 4)
+        {
+            throw std::runtime_error("Attempting to interpret " + std::to_string(dim_) +
+                                     "D data as 4D");
+        }
+        restore();
+        markAllDirty();
+        return reinterpret_cast<glm::vec4 *>(data_.data());
+    }
+
     const glm::vec3 *ptrVec3() const
     {
         if (dim_ != 3)
@@ -67,6 +286,7 @@ class AttributeBuffer
             throw std::runtime_error("Attempting to interpret " + std::to_string(dim_) +
                                      "D data as 3D");
         }
+        restore();
         return reinterpret_cast<const glm::vec3 *>(data_.data());
     }
 
@@ -77,6 +297,8 @@ class AttributeBuffer
             throw std::runtime_error("Attempting to interpret " + std::to_string(dim_) +
                                      "D data as 3D");
         }
+        restore();
+        markAllDirty();
         return reinterpret_cast<glm::vec3 *>(data_.data());
     }
 
@@ -87,6 +309,7 @@ class AttributeBuffer
             throw std::runtime_error("Attempting to interpret " + std::to_string(dim_) +
                                      "D data as 2D");
         }
+        restore();
         return reinterpret_cast<const glm::vec2 *>(data_.data());
     }
 
@@ -97,12 +320,14 @@ class AttributeBuffer
             throw std::runtime_error("Attempting to interpret " + std::to_string(dim_) +
                                      "D data as 2D");
         }
+        restore();
+        markAllDirty();
         return reinterpret_cast<glm::vec2 *>(data_.data());
     }
 
     size_t size() const
     {
-        return data_.size();
+        return resident_ ? data_.size() : released_size_;
     }
 
     size_t dim() const
@@ -112,7 +337,7 @@ class AttributeBuffer
 
     size_t count() const
     {
-        return data_.size() / dim();
+        return size() / dim();
     }
 
     std::shared_ptr<ArrayBuffer> buffer() const
@@ -125,13 +350,24 @@ class AttributeBuffer
         return location_;
     }
 
+    /**
+     * Number of instances that share an element of this attribute; 0 for per-vertex data
+     */
+    GLuint divisor() const
+    {
+        return divisor_;
+    }
+
     const std::vector<float> &data() const
     {
+        restore();
         return data_;
     }
 
     std::vector<float> &data()
     {
+        restore();
+        markAllDirty();
         return data_;
     }
 
@@ -151,6 +387,152 @@ class AttributeBuffer
         {
             data_ = data;
         }
+        resident_ = true;
+        markAllDirty();
+    }
+
+    /**
+     * Takes over the given data without copying it
+     */
+    void setData(std::vector<float> &&data)
+    {
+        if (data.size() % dim_ != 0)
+        {
+            throw std::runtime_error("Attempting to set data of size " +
+                                     std::to_string(data.size()) + "which is not divisible by " +
+                                     std::to_string(dim_) + " (dim)");
+        }
+        data_ = std::move(data);
+        resident_ = true;
+        markAllDirty();
+    }
+
+    /**
+     * Copies size floats from memory owned by the caller, e.g., a memory-mapped file, without
+     * an intermediate container
+     */
+    void setData(const float *data, size_t size)
+    {
+        if (size % dim_ != 0)
+        {
+            throw std::runtime_error("Attempting to set data of size " + std::to_string(size) +
+                                     "which is not divisible by " + std::to_string(dim_) +
+                                     " (dim)");
+        }
+        data_.assign(data, data + size);
+        resident_ = true;
+        markAllDirty();
+    }
+
+    /**
+     * Uploads size floats straight into the GPU buffer (converting them to format()) without
+     * keeping a CPU copy, as if releaseCPUData() was called afterwards. Streamed attributes
+     * need a CPU copy.
+     *
+     * @param data Pointer to size floats
+     * @param size Number of floats
+     */
+    void uploadWithoutCPUCopy(const float *data, size_t size)
+    {
+        if (size % dim_ != 0)
+        {
+            throw std::runtime_error("Attempting to set data of size " + std::to_string(size) +
+                                     "which is not divisible by " + std::to_string(dim_) +
+                                     " (dim)");
+        }
+        if (streaming_ != nullptr)
+        {
+            throw std::runtime_error("Streamed attribute " + name_ + " needs a CPU copy");
+        }
+        data_.clear();
+        data_.shrink_to_fit();
+        dirty_.clear();
+        ++version_;
+        resident_ = false;
+        released_size_ = size;
+        read_back_ = nullptr;
+        if (format_ == AttributeFormat::Snorm16)
+        {
+            computeDecodeRange(data, size);
+        }
+        buffer_->reserve(count() * stride());
+        // Convert in chunks to bound the temporary memory
+        const size_t chunk = 65536;
+        std::vector<char> packed;
+        for (size_t first = 0; first < count(); first += chunk)
+        {
+            const size_t n = std::min(chunk, count() - first);
+            if (format_ == AttributeFormat::Float32)
+            {
+                buffer_->setData(data + first * dim_, n * dim_, first * stride());
+                continue;
+            }
+            packed.resize(n * stride());
+            packElements(format_, dim_, data + first * dim_, n, decode_offset_, decode_scale_,
+                         packed.data());
+            buffer_->setData(packed.data(), packed.size(), first * stride());
+        }
+    }
+
+    /**
+     * Uploads pending modifications and frees the CPU copy of the data; the GPU buffer keeps
+     * it. The const and non-const accessors read it back from the GPU on demand (converted
+     * from format(), so Snorm16, Oct16, Float16 and Unorm8 data comes back quantized).
+     * Streamed attributes keep their CPU copy.
+     */
+    void releaseCPUData()
+    {
+        if (!resident_ || streaming_ != nullptr)
+        {
+            return;
+        }
+        if (dirty())
+        {
+            update();
+        }
+        released_size_ = data_.size();
+        data_.clear();
+        data_.shrink_to_fit();
+        resident_ = false;
+        read_back_ = nullptr;
+    }
+
+    /**
+     * Frees the CPU copy of data that the caller uploaded elsewhere (e.g., into a
+     * GeometryArena) instead of into buffer(); the accessors read it back on demand with the
+     * given function, which receives the destination and the number of floats. Pending
+     * modifications must have been uploaded. Streamed attributes keep their CPU copy.
+     *
+     * @param read_back Function that reads the data back
+     */
+    void releaseCPUData(std::function<void(float *, size_t)> read_back)
+    {
+        if (!resident_ || streaming_ != nullptr)
+        {
+            return;
+        }
+        released_size_ = data_.size();
+        data_.clear();
+        data_.shrink_to_fit();
+        resident_ = false;
+        read_back_ = std::move(read_back);
+    }
+
+    /**
+     * Whether the data is held on the CPU, i.e., it was not released or it was read back
+     */
+    bool resident() const
+    {
+        return resident_;
+    }
+
+    /**
+     * Counter that changes whenever the data may have been modified (through setData(),
+     * setElements(), markDirty() or a non-const accessor), for caching values derived from it
+     */
+    size_t version() const
+    {
+        return version_;
     }
 
     void setData(const std::vector<glm::vec2> &data)
@@ -168,6 +550,8 @@ class AttributeBuffer
         {
             data_.assign(glm::value_ptr(data[0]), glm::value_ptr(data[0]) + data.size() * 2);
         }
+        resident_ = true;
+        markAllDirty();
     }
 
     void setData(const std::vector<glm::vec3> &data)
@@ -185,15 +569,351 @@ class AttributeBuffer
         {
             data_.assign(glm::value_ptr(data[0]), glm::value_ptr(data[0]) + data.size() * 3);
         }
+        resident_ = true;
+        markAllDirty();
+    }
+
+    void setData(const std::vector<glm::vec4> &data)
+    {
+        if (dim_ != 4)
+        {
+            throw std::runtime_error("Attempting to set 4D data, expected " + std::to_string(dim_) +
+                                     "D data");
+        }
+        if (data.empty())
+        {
+            data_.clear();
+        }
+        else
+        {
+            data_.assign(glm::value_ptr(data[0]), glm::value_ptr(data[0]) + data.size() * 4);
+        }
+        resident_ = true;
+        markAllDirty();
+    }
+
+    /**
+     * Overwrites count elements starting at element first and marks only them for upload
+     *
+     * @param first Index of the first element
+     * @param values count * dim() floats
+     * @param count Number of elements
+     */
+    void setElements(size_t first, const float *values, size_t count)
+    {
+        restore();
+        if ((first + count) * dim_ > data_.size())
+        {
+            throw std::runtime_error("Attempting to set elements beyond the end of attribute " +
+                                     name_);
+        }
+        std::copy(values, values + count * dim_, data_.begin() + first * dim_);
+        markDirty(first, count);
+    }
+
+    /**
+     * Overwrites count elements starting at element first. Resident data is modified like with
+     * setElements() and uploaded by update(); released data is converted and written straight
+     * into the GPU buffer without reading the rest of it back. Returns false without writing
+     * if released Snorm16 data would fall outside of the decoding range.
+     *
+     * @param first Index of the first element
+     * @param values count * dim() floats
+     * @param count Number of elements
+     * @return Whether the elements were written
+     */
+    bool writeElements(size_t first, const float *values, size_t count)
+    {
+        if (resident_ || streaming_ != nullptr)
+        {
+            setElements(first, values, count);
+            return true;
+        }
+        if (first + count > this->count())
+        {
+            throw std::runtime_error("Attempting to set elements beyond the end of attribute " +
+                                     name_);
+        }
+        if (format_ == AttributeFormat::Snorm16)
+        {
+            for (size_t i = 0; i < count * dim_; ++i)
+            {
+                const size_t c = i % dim_;
+                if (std::abs(values[i] - decode_offset_[c]) > decode_scale_[c])
+                {
+                    return false;
+                }
+            }
+        }
+        std::vector<char> packed(count * stride());
+        packElements(format_, dim_, values, count, decode_offset_, decode_scale_, packed.data());
+        buffer_->setData(packed.data(), packed.size(), first * stride());
+        ++version_;
+        return true;
+    }
+
+    /**
+     * Marks count elements starting at element first for upload, e.g., after modifying them
+     * through a pointer obtained before the last update()
+     *
+     * @param first Index of the first element
+     * @param count Number of elements
+     */
+    void markDirty(size_t first, size_t count)
+    {
+        restore();
+        dirty_.add(std::min(first * dim_, data_.size()),
+                   std::min((first + count) * dim_, data_.size()));
+        ++version_;
+    }
+
+    /**
+     * Ranges of the data (in floats) modified since the last upload
+     */
+    const DirtyRanges &dirtyRanges() const
+    {
+        return dirty_;
+    }
+
+    /**
+     * Marks the data as uploaded, for callers that upload it elsewhere (e.g., into a
+     * GeometryArena)
+     */
+    void clearDirty()
+    {
+        dirty_.clear();
+    }
+
+    /**
+     * Returns whether update() has anything to upload
+     */
+    bool dirty() const
+    {
+        if (streaming_ != nullptr)
+        {
+            return !dirty_.empty();
+        }
+        return !dirty_.empty() || buffer_->size() != count() * stride();
+    }
+
+    /**
+     * Sets the format of the data on the GPU. The vertex array must be pointed at the buffer
+     * with the new format; Mesh::setAttributeFormat() takes care of it. Streamed attributes
+     * must be Float32.
+     *
+     * @param format Format of the data on the GPU
+     */
+    void setFormat(AttributeFormat format)
+    {
+        if (format != AttributeFormat::Float32 && streaming_ != nullptr)
+        {
+            throw std::runtime_error("Streamed attribute " + name_ + " must be Float32");
+        }
+        if (format != AttributeFormat::Float32 && dim_ > 4)
+        {
+            throw std::runtime_error("Attribute " + name_ + " has more than 4 components");
+        }
+        if (format == AttributeFormat::Oct16 && dim_ != 3)
+        {
+            throw std::runtime_error("Oct16 format requires 3D data, attribute " + name_ +
+                                     " is " + std::to_string(dim_) + "D");
+        }
+        if (format == format_)
+        {
+            return;
+        }
+        // The data is read back in the old format
+        restore();
+        format_ = format;
+        decode_offset_ = glm::vec4(0.f);
+        decode_scale_ = glm::vec4(1.f);
+        // Force a full upload into a reallocated buffer
+        buffer_->reserve(0);
+        markAllDirty();
+    }
+
+    AttributeFormat format() const
+    {
+        return format_;
+    }
+
+    /**
+     * Size of an element in bytes on the GPU
+     */
+    size_t stride() const
+    {
+        return formatStride(format_, dim_);
+    }
+
+    /**
+     * Recomputes the Snorm16 decoding range from all of the data if full is set or if modified
+     * data fell outside of it. update() calls this; callers that upload the data elsewhere
+     * with packInto() must call it before.
+     *
+     * @param full Whether all of the data is about to be uploaded
+     * @return Whether the range changed, in which case all of the data must be uploaded
+     */
+    bool updateDecodeRange(bool full)
+    {
+        if (format_ != AttributeFormat::Snorm16)
+        {
+            return false;
+        }
+        if (!full && std::all_of(dirty_.ranges().begin(), dirty_.ranges().end(),
+                                 [this](const std::pair<size_t, size_t> &range) {
+                                     return inDecodeRange(range.first, range.second);
+                                 }))
+        {
+            return false;
+        }
+        computeDecodeRange(data_.data(), data_.size());
+        return true;
+    }
+
+    /**
+     * Converts elements to the GPU format and writes them to memory with the given stride,
+     * e.g., into the records of an interleaved vertex buffer
+     *
+     * @param first Index of the first element
+     * @param count Number of elements
+     * @param dst Destination of the first element
+     * @param dst_stride Distance in bytes between consecutive elements in dst
+     */
+    void packInto(size_t first, size_t count, char *dst, size_t dst_stride) const
+    {
+        const size_t element_size = stride();
+        if (dst_stride == element_size)
+        {
+            packElements(format_, dim_, data_.data() + first * dim_, count, decode_offset_,
+                         decode_scale_, dst);
+            return;
+        }
+        std::vector<char> packed(count * element_size);
+        packElements(format_, dim_, data_.data() + first * dim_, count, decode_offset_,
+                     decode_scale_, packed.data());
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::copy(packed.begin() + i * element_size, packed.begin() + (i + 1) * element_size,
+                      dst + i * dst_stride);
+        }
+    }
+
+    /**
+     * Center of the data range decoded from the Snorm16 format; 0 for other formats
+     */
+    const glm::vec4 &decodeOffset() const
+    {
+        return decode_offset_;
+    }
+
+    /**
+     * Half extent of the data range decoded from the Snorm16 format; 1 for other formats
+     */
+    const glm::vec4 &decodeScale() const
+    {
+        return decode_scale_;
+    }
+
+    /**
+     * Switches between uploading into buffer() and into a persistently mapped
+     * streamingBuffer(), which avoids stalls for data that is rewritten every frame (e.g.,
+     * deforming meshes or live point streams). The vertex array must be pointed at the buffer
+     * in use after each update(); Mesh::setStreaming() and Mesh::uploadToGPU() take care of it.
+     *
+     * @param streaming Whether to stream the attribute
+     */
+    void setStreaming(bool streaming)
+    {
+        if (streaming == (streaming_ != nullptr))
+        {
+            return;
+        }
+        if (streaming && format_ != AttributeFormat::Float32)
+        {
+            throw std::runtime_error("Streamed attribute " + name_ + " must be Float32");
+        }
+        restore();
+        streaming_ = streaming ? StreamingBuffer::create(data_.size() * sizeof(float)) : nullptr;
+        markAllDirty();
     }
 
+    bool streaming() const
+    {
+        return streaming_ != nullptr;
+    }
+
+    std::shared_ptr<StreamingBuffer> streamingBuffer() const
+    {
+        return streaming_;
+    }
+
+    /**
+     * Uploads the modified ranges of the data; if the size of the data changed, the buffer is
+     * reallocated and all of it is uploaded. Streamed attributes write all of the data into
+     * the next region of the streaming buffer. Data in a format other than Float32 is converted
+     * first; Snorm16 data is fully uploaded with a new decoding range when modified values fall
+     * outside of the current one.
+     */
     void update()
     {
+        // Released data is always uploaded already
+        if (!resident_)
+        {
+            return;
+        }
+        if (streaming_ != nullptr)
+        {
+            const size_t bytes = data_.size() * sizeof(float);
+            if (bytes > streaming_->regionSize())
+            {
+                streaming_ = StreamingBuffer::create(bytes + bytes / 2);
+            }
+            if (!data_.empty())
+            {
+                streaming_->write(data_.data(), bytes);
+            }
+            dirty_.clear();
+            return;
+        }
+        if (format_ != AttributeFormat::Float32)
+        {
+            bool full = buffer_->size() != count() * stride();
+            full = updateDecodeRange(full) || full;
+            if (full)
+            {
+                buffer_->reserve(count() * stride());
+                if (!data_.empty())
+                {
+                    uploadPacked(0, data_.size());
+                }
+            }
+            else
+            {
+                for (const std::pair<size_t, size_t> &range : dirty_.ranges())
+                {
+                    uploadPacked(range.first, range.second);
+                }
+            }
+            dirty_.clear();
+            return;
+        }
         if (buffer_->size() != data_.size() * sizeof(float))
         {
             buffer_->reserve(data_.size() * sizeof(float));
+            if (!data_.empty())
+            {
+                buffer_->setData(data_);
+            }
+        }
+        else
+        {
+            for (const std::pair<size_t, size_t> &range : dirty_.ranges())
+            {
+                buffer_->setData(data_.data() + range.first, range.second - range.first,
+                                 range.first * sizeof(float));
+            }
         }
-        buffer_->setData(data_);
+        dirty_.clear();
     }
 
     void release()
@@ -202,16 +922,90 @@ class AttributeBuffer
         {
             buffer_->release();
         }
+        streaming_ = nullptr;
         data_.clear();
         data_.shrink_to_fit();
+        resident_ = true;
+        released_size_ = 0;
+        read_back_ = nullptr;
+        dirty_.clear();
     }
 };
 
+/**
+ * CPU indices of a mesh and the OpenGL buffer they are uploaded to. Modified ranges are tracked
+ * like in AttributeBuffer. Indices are uploaded as 16-bit integers whenever all of them are
+ * below 65536, which halves the size of the buffer and the index fetch bandwidth; indexType()
+ * gives the type to draw with.
+ */
 class AttributeIndexBuffer
 {
-    std::vector<unsigned int> data_;
+    // CPU copy of the indices, read back from buffer_ on demand after releaseCPUData()
+    mutable std::vector<unsigned int> data_;
+    mutable bool resident_ = true;
+    size_t released_size_ = 0;
+    // Reads released indices back from where the caller uploaded them instead of from buffer_
+    std::function<void(unsigned int *, size_t)> read_back_;
     std::shared_ptr<ElementArrayBuffer> buffer_;
     size_t dim_ = 3;
+    // Ranges of data_ (in indices) to upload
+    DirtyRanges dirty_;
+    // Incremented whenever the indices may have been modified
+    size_t version_ = 0;
+    // Type of the indices in buffer_
+    GLenum type_ = GL_UNSIGNED_INT;
+
+    void markAllDirty()
+    {
+        dirty_.add(0, data_.size());
+        ++version_;
+    }
+
+    // Reads the indices back from the GPU if they were released
+    void restore() const
+    {
+        if (resident_)
+        {
+            return;
+        }
+        data_.resize(released_size_);
+        if (read_back_)
+        {
+            read_back_(data_.data(), data_.size());
+        }
+        else if (type_ == GL_UNSIGNED_INT)
+        {
+            buffer_->getData(data_.data(), data_.size() * sizeof(unsigned int), 0);
+        }
+        else
+        {
+            std::vector<uint16_t> packed(data_.size());
+            buffer_->getData(packed.data(), packed.size() * sizeof(uint16_t), 0);
+            std::copy(packed.begin(), packed.end(), data_.begin());
+        }
+        resident_ = true;
+    }
+
+    // Whether the indices in [begin, end) fit in 16 bits
+    bool fits16Bit(size_t begin, size_t end) const
+    {
+        return std::all_of(data_.begin() + begin, data_.begin() + end,
+                           [](unsigned int i) { return i <= 0xffffu; });
+    }
+
+    // Uploads the indices in [begin, end) with the current type
+    void uploadRange(size_t begin, size_t end)
+    {
+        if (type_ == GL_UNSIGNED_INT)
+        {
+            buffer_->setData(data_.data() + begin, (end - begin) * sizeof(unsigned int),
+                             begin * sizeof(unsigned int));
+            return;
+        }
+        std::vector<uint16_t> packed(data_.begin() + begin, data_.begin() + end);
+        buffer_->setData(packed.data(), packed.size() * sizeof(uint16_t),
+                         begin * sizeof(uint16_t));
+    }
 
   public:
     static std::shared_ptr<AttributeIndexBuffer> create(size_t dim)
@@ -224,6 +1018,7 @@ class AttributeIndexBuffer
 
     const unsigned int *ptr() const
     {
+        restore();
         return data_.data();
     }
 
@@ -234,6 +1029,7 @@ class AttributeIndexBuffer
             throw std::runtime_error("Attempting to interpret " + std::to_string(dim_) +
                                      "D data as 3D");
         }
+        restore();
         return reinterpret_cast<const glm::uvec3 *>(data_.data());
     }
 
@@ -244,6 +1040,8 @@ class AttributeIndexBuffer
             throw std::runtime_error("Attempting to interpret " + std::to_string(dim_) +
                                      "D data as 3D");
         }
+        restore();
+        markAllDirty();
         return reinterpret_cast<glm::uvec3 *>(data_.data());
     }
 
@@ -254,6 +1052,7 @@ class AttributeIndexBuffer
             throw std::runtime_error("Attempting to interpret " + std::to_string(dim_) +
                                      "D data as 2D");
         }
+        restore();
         return reinterpret_cast<const glm::uvec2 *>(data_.data());
     }
 
@@ -264,17 +1063,19 @@ class AttributeIndexBuffer
             throw std::runtime_error("Attempting to interpret " + std::to_string(dim_) +
                                      "D data as 2D");
         }
+        restore();
+        markAllDirty();
         return reinterpret_cast<glm::uvec2 *>(data_.data());
     }
 
     size_t size() const
     {
-        return data_.size();
+        return resident_ ? data_.size() : released_size_;
     }
 
     size_t count() const
     {
-        return data_.size() / dim();
+        return size() / dim();
     }
 
     size_t dim() const
@@ -289,17 +1090,136 @@ class AttributeIndexBuffer
 
     const std::vector<unsigned int> &data() const
     {
+        restore();
         return data_;
     }
 
     std::vector<unsigned int> &data()
     {
+        restore();
+        markAllDirty();
         return data_;
     }
 
     void setData(const std::vector<unsigned int> &data)
     {
         data_ = data;
+        resident_ = true;
+        markAllDirty();
+    }
+
+    /**
+     * Takes over the given indices without copying them
+     */
+    void setData(std::vector<unsigned int> &&data)
+    {
+        data_ = std::move(data);
+        resident_ = true;
+        markAllDirty();
+    }
+
+    /**
+     * Copies size indices from memory owned by the caller without an intermediate container
+     */
+    void setData(const unsigned int *data, size_t size)
+    {
+        data_.assign(data, data + size);
+        resident_ = true;
+        markAllDirty();
+    }
+
+    /**
+     * Uploads size indices straight into the GPU buffer (as 16-bit integers if they all fit)
+     * without keeping a CPU copy, as if releaseCPUData() was called afterwards
+     *
+     * @param data Pointer to size indices
+     * @param size Number of indices
+     */
+    void uploadWithoutCPUCopy(const unsigned int *data, size_t size)
+    {
+        data_.clear();
+        data_.shrink_to_fit();
+        dirty_.clear();
+        ++version_;
+        resident_ = false;
+        released_size_ = size;
+        read_back_ = nullptr;
+        type_ = std::all_of(data, data + size, [](unsigned int i) { return i <= 0xffffu; })
+                    ? GL_UNSIGNED_SHORT
+                    : GL_UNSIGNED_INT;
+        buffer_->reserve(size * indexSize());
+        if (type_ == GL_UNSIGNED_INT)
+        {
+            buffer_->setData(data, size * sizeof(unsigned int), 0);
+            return;
+        }
+        // Convert in chunks to bound the temporary memory
+        const size_t chunk = 65536 * 3;
+        std::vector<uint16_t> packed;
+        for (size_t first = 0; first < size; first += chunk)
+        {
+            const size_t n = std::min(chunk, size - first);
+            packed.assign(data + first, data + first + n);
+            buffer_->setData(packed.data(), n * sizeof(uint16_t), first * sizeof(uint16_t));
+        }
+    }
+
+    /**
+     * Uploads pending modifications and frees the CPU copy of the indices; they are read back
+     * from the GPU on demand
+     */
+    void releaseCPUData()
+    {
+        if (!resident_)
+        {
+            return;
+        }
+        if (dirty())
+        {
+            update();
+        }
+        released_size_ = data_.size();
+        data_.clear();
+        data_.shrink_to_fit();
+        resident_ = false;
+        read_back_ = nullptr;
+    }
+
+    /**
+     * Frees the CPU copy of indices that the caller uploaded elsewhere (e.g., into a
+     * GeometryArena) instead of into buffer(); they are read back on demand with the given
+     * function, which receives the destination and the number of indices. Pending
+     * modifications must have been uploaded.
+     *
+     * @param read_back Function that reads the indices back
+     */
+    void releaseCPUData(std::function<void(unsigned int *, size_t)> read_back)
+    {
+        if (!resident_)
+        {
+            return;
+        }
+        released_size_ = data_.size();
+        data_.clear();
+        data_.shrink_to_fit();
+        resident_ = false;
+        read_back_ = std::move(read_back);
+    }
+
+    /**
+     * Whether the indices are held on the CPU, i.e., they were not released or were read back
+     */
+    bool resident() const
+    {
+        return resident_;
+    }
+
+    /**
+     * Counter that changes whenever the indices may have been modified
+     */
+    size_t version() const
+    {
+        return version_;
     }
 
     void setData(const std::vector<glm::uvec2> &data)
@@ -317,6 +1237,8 @@ class AttributeIndexBuffer
         {
             data_.assign(glm::value_ptr(data[0]), glm::value_ptr(data[0]) + data.size() * 2);
         }
+        resident_ = true;
+        markAllDirty();
     }
 
     void setData(const std::vector<glm::uvec3> &data)
@@ -334,15 +1256,119 @@ class AttributeIndexBuffer
         {
             data_.assign(glm::value_ptr(data[0]), glm::value_ptr(data[0]) + data.size() * 3);
         }
+        resident_ = true;
+        markAllDirty();
+    }
+
+    /**
+     * Overwrites count primitives starting at primitive first and marks only them for upload
+     *
+     * @param first Index of the first primitive
+     * @param values count * dim() indices
+     * @param count Number of primitives
+     */
+    void setElements(size_t first, const unsigned int *values, size_t count)
+    {
+        restore();
+        if ((first + count) * dim_ > data_.size())
+        {
+            throw std::runtime_error("Attempting to set indices beyond the end of the buffer");
+        }
+        std::copy(values, values + count * dim_, data_.begin() + first * dim_);
+        markDirty(first, count);
+    }
+
+    /**
+     * Marks count primitives starting at primitive first for upload
+     *
+     * @param first Index of the first primitive
+     * @param count Number of primitives
+     */
+    void markDirty(size_t first, size_t count)
+    {
+        restore();
+        dirty_.add(std::min(first * dim_, data_.size()),
+                   std::min((first + count) * dim_, data_.size()));
+        ++version_;
+    }
+
+    /**
+     * Ranges of the indices modified since the last upload
+     */
+    const DirtyRanges &dirtyRanges() const
+    {
+        return dirty_;
+    }
+
+    /**
+     * Marks the indices as uploaded, for callers that upload them elsewhere
+     */
+    void clearDirty()
+    {
+        dirty_.clear();
+    }
+
+    /**
+     * Returns whether update() has anything to upload
+     */
+    bool dirty() const
+    {
+        return !dirty_.empty() || buffer_->size() != size() * indexSize();
     }
 
+    /**
+     * Type of the uploaded indices: GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+     */
+    GLenum indexType() const
+    {
+        return type_;
+    }
+
+    /**
+     * Size of an uploaded index in bytes
+     */
+    size_t indexSize() const
+    {
+        return type_ == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    }
+
+    /**
+     * Uploads the modified ranges of the indices; if their number changed or a modified index
+     * no longer fits in the current type, the buffer is reallocated and all of them are
+     * uploaded with the smallest type that fits
+     */
     void update()
     {
-        if (buffer_->size() != data_.size() * sizeof(unsigned int))
+        // Released indices are always uploaded already
+        if (!resident_)
+        {
+            return;
+        }
+        bool full = buffer_->size() != data_.size() * indexSize();
+        if (!full && type_ == GL_UNSIGNED_SHORT)
+        {
+            full = !std::all_of(dirty_.ranges().begin(), dirty_.ranges().end(),
+                                [this](const std::pair<size_t, size_t> &range) {
+                                    return fits16Bit(range.first, range.second);
+                                });
+        }
+        if (full)
         {
-            buffer_->reserve(data_.size() * sizeof(unsigned int));
+            type_ = fits16Bit(0, data_.size()) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            buffer_->reserve(data_.size() * indexSize());
+            if (!data_.empty())
+            {
+                uploadRange(0, data_.size());
+            }
         }
-        buffer_->setData(data_);
+        else
+        {
+            for (const std::pair<size_t, size_t> &range : dirty_.ranges())
+            {
+                uploadRange(range.first, range.second);
+            }
+        }
+        dirty_.clear();
     }
 
     void release()
@@ -352,6 +1378,11 @@ class AttributeIndexBuffer
             buffer_->release();
         }
         data_.clear();
+        data_.shrink_to_fit();
+        resident_ = true;
+        released_size_ = 0;
+        read_back_ = nullptr;
+        dirty_.clear();
     }
 };
 
@@ -16,6 +16,9 @@ enum class BufferType
     ElementArray = GL_ELEMENT_ARRAY_BUFFER,
     Uniform = GL_UNIFORM_BUFFER,
     PixelPack = GL_PIXEL_PACK_BUFFER,
+    ShaderStorage = GL_SHADER_STORAGE_BUFFER,
+    DrawIndirect = GL_DRAW_INDIRECT_BUFFER,
+    AtomicCounter = GL_ATOMIC_COUNTER_BUFFER,
 };
 
 template <BufferType Type> class Buffer
@@ -131,16 +134,44 @@ template <BufferType Type> class Buffer
     {
         glBindBuffer(GLenum(Type), 0);
     }
-    template <BufferType T = Type, typename = typename std::enable_if<T == BufferType::Uniform>::type>
+    template <BufferType T = Type,
+              typename = typename std::enable_if<T == BufferType::Uniform ||
+                                                 T == BufferType::ShaderStorage ||
+                                                 T == BufferType::AtomicCounter>::type>
     void bindBase(int index) const
     {
         glBindBufferBase(GLenum(Type), index, id_);
     }
+    template <BufferType T = Type,
+              typename = typename std::enable_if<T == BufferType::Uniform ||
+                                                 T == BufferType::ShaderStorage>::type>
+    void bindRange(int index, size_t offset, size_t bytes) const
+    {
+        assert(offset + bytes <= size_);
+        glBindBufferRange(GLenum(Type), index, id_, offset, bytes);
+    }
+    template <BufferType T = Type, typename = typename std::enable_if<T != BufferType::PixelPack>::type>
+    void setData(const void *buf, size_t bytes, size_t offset)
+    {
+        assert(offset + bytes <= size_);
+        glNamedBufferSubData(id_, offset, bytes, buf);
+    }
+    /**
+     * Reads data back from the buffer; this waits for pending writes to the buffer
+     */
+    void getData(void *buf, size_t bytes, size_t offset) const
+    {
+        assert(offset + bytes <= size_);
+        glGetNamedBufferSubData(id_, offset, bytes, buf);
+    }
 };
 
 using ArrayBuffer = Buffer<BufferType::Array>;
 using ElementArrayBuffer = Buffer<BufferType::ElementArray>;
 using UniformBuffer = Buffer<BufferType::Uniform>;
 using PixelPackBuffer = Buffer<BufferType::PixelPack>;
+using ShaderStorageBuffer = Buffer<BufferType::ShaderStorage>;
+using DrawIndirectBuffer = Buffer<BufferType::DrawIndirect>;
+using AtomicCounterBuffer = Buffer<BufferType::AtomicCounter>;
 
 } // namespace rcube
\ No newline at end of file
@@ -84,12 +84,184 @@ void main() {
 )";
 
 
+/**
+ * Compressed vertex formats: vertex shader chunk
+ * Declares the uniforms describing the rcube::AttributeFormat of the positions, normals and
+ * tangents, and defines decodePosition(), decodeNormal() and decodeTangent() to turn them back
+ * into object space vectors. The defaults leave Float32 data unchanged. It is part of
+ * INSTANCING_VERTEX_SHADER_CHUNK, whose instancePosition() decodes the position.
+ */
+const static std::string VERTEX_FORMAT_SHADER_CHUNK = R"(
+// Snorm16 positions in [-1, 1] are mapped to the bounding box of the mesh
+uniform vec3 position_decode_offset = vec3(0.0);
+uniform vec3 position_decode_scale = vec3(1.0);
+// bit 0: normals are Oct16, bit 1: tangents are Oct16
+uniform int vertex_format_flags = 0;
+
+vec3 decodePosition(vec3 p)
+{
+    return position_decode_offset + position_decode_scale * p;
+}
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.xy += mix(vec2(t), vec2(-t), greaterThanEqual(v.xy, vec2(0.0)));
+    return normalize(v);
+}
+
+// Oct16 attributes have 2 components, so only xy of the vec3 input is set
+vec3 decodeNormal(vec3 n)
+{
+    return (vertex_format_flags & 1) != 0 ? octDecode(n.xy) : n;
+}
+
+vec3 decodeTangent(vec3 t)
+{
+    return (vertex_format_flags & 2) != 0 ? octDecode(t.xy) : t;
+}
+)";
+
+/**
+ * Instanced glyphs: vertex shader chunk
+ * Declares the per-instance attributes and the glyph_params uniform (see rcube::GlyphParameters)
+ * and defines instancePosition() and instanceVector() to place the vertices and rotate the
+ * normals of an instanced glyph. The chunk is added to all vertex shaders of the
+ * ForwardRenderSystemShaderManager. For meshes that are not instanced, the generic values of the
+ * disabled attributes, (0, 0, 0, 1), and the default glyph_params leave the inputs unchanged.
+ * It includes VERTEX_FORMAT_SHADER_CHUNK; instancePosition() expects the undecoded position,
+ * whereas normals and tangents must be decoded before calling instanceVector().
+ */
+const static std::string INSTANCING_VERTEX_SHADER_CHUNK = VERTEX_FORMAT_SHADER_CHUNK + R"(
+layout (location = 7) in vec4 instance_offset;
+layout (location = 8) in vec4 instance_direction;
+
+// x: scale by magnitude (0 or 1), y: max. length, z: 1 / max. magnitude, w: size
+uniform vec4 glyph_params = vec4(0.0, 1.0, 1.0, 1.0);
+
+mat3 instanceRotation()
+{
+    float len = length(instance_direction.xyz);
+    if (len < 1e-8)
+    {
+        return mat3(1.0);
+    }
+    // Orthonormal basis whose Y axis is the direction of the instance
+    vec3 y = instance_direction.xyz / len;
+    vec3 a = abs(y.x) < 0.9 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 0.0, 1.0);
+    vec3 x = normalize(cross(y, a));
+    vec3 z = cross(x, y);
+    return mat3(x, y, z);
+}
+
+float instanceScale()
+{
+    float scale = glyph_params.w;
+    if (dot(instance_direction.xyz, instance_direction.xyz) > 0.0)
+    {
+        scale = glyph_params.y * mix(1.0, instance_direction.w * glyph_params.z, glyph_params.x);
+    }
+    return instance_offset.w * scale;
+}
+
+vec3 instancePosition(vec3 p)
+{
+    return instanceRotation() * (instanceScale() * decodePosition(p)) + instance_offset.xyz;
+}
+
+vec3 instanceVector(vec3 v)
+{
+    return instanceRotation() * v;
+}
+)";
+
+/**
+ * Colormapping: shared shader chunk
+ * Declares the colormap lookup table and the colormap_params uniform
+ * (see rcube::ColormapParameters), and defines colormapLookup() which maps a scalar to a color.
+ * It is part of COLORMAP_VERTEX_SHADER_CHUNK and FACE_DATA_GEOMETRY_SHADER_CHUNK; the
+ * declarations are identical so that both stages share the uniform and the texture unit.
+ */
+const static std::string COLORMAP_SHADER_CHUNK = R"(
+// x: enabled (0 or 1), y: min. value, z: 1 / (max. value - min. value)
+uniform vec4 colormap_params = vec4(0.0, 0.0, 1.0, 0.0);
+layout (binding = 15) uniform sampler2D colormap_lut;
+
+vec3 colormapLookup(float value)
+{
+    float t = clamp((value - colormap_params.y) * colormap_params.z, 0.0, 1.0);
+    // Sample at texel centers so that t = 0 and t = 1 map to the first and last entries
+    float lut_size = float(textureSize(colormap_lut, 0).x);
+    float u = (t * (lut_size - 1.0) + 0.5) / lut_size;
+    return textureLod(colormap_lut, vec2(u, 0.5), 0.0).rgb;
+}
+)";
+
+/**
+ * Colormapping: vertex shader chunk
+ * Declares the scalar attribute and defines vertexColor() which maps the scalar to a color
+ * if the mesh has a colormap, and returns the given color otherwise.
+ * The chunk is added to all vertex shaders of the ForwardRenderSystemShaderManager.
+ */
+const static std::string COLORMAP_VERTEX_SHADER_CHUNK = COLORMAP_SHADER_CHUNK + R"(
+layout (location = 9) in float scalar;
+
+vec3 vertexColor(vec3 color)
+{
+    if (colormap_params.x == 0.0)
+    {
+        return color;
+    }
+    return colormapLookup(scalar);
+}
+)";
+
+/**
+ * Per-face data: geometry shader chunk
+ * Declares the per-face data buffer and the face_data_flags uniform
+ * (see rcube::FaceDataParameters), and defines faceColor() and faceWire() which return the
+ * data of the current triangle (gl_PrimitiveIDIn) if the mesh has it, and the given per-vertex
+ * values otherwise. Face colors are raised to the given gamma to match the per-vertex colors of
+ * the material. The chunk is added to all geometry shaders of the
+ * ForwardRenderSystemShaderManager.
+ */
+const static std::string FACE_DATA_GEOMETRY_SHADER_CHUNK = COLORMAP_SHADER_CHUNK + R"(
+// face_data[2 * i]: color (rgb) and scalar (a) of triangle i,
+// face_data[2 * i + 1].x: wireframe flag of triangle i
+layout (std430, binding = 1) readonly buffer FaceData {
+    vec4 face_data[];
+};
+// Bit 0: colors, bit 1: scalars, bit 2: wireframe flags
+uniform int face_data_flags = 0;
+
+vec3 faceColor(vec3 vertex_color, float gamma)
+{
+    if ((face_data_flags & 2) != 0 && colormap_params.x != 0.0)
+    {
+        return pow(colormapLookup(face_data[2 * gl_PrimitiveIDIn].a), vec3(gamma));
+    }
+    if ((face_data_flags & 1) != 0)
+    {
+        return pow(face_data[2 * gl_PrimitiveIDIn].rgb, vec3(gamma));
+    }
+    return vertex_color;
+}
+
+float faceWire(float vertex_wire)
+{
+    if ((face_data_flags & 4) != 0)
+    {
+        return face_data[2 * gl_PrimitiveIDIn + 1].x;
+    }
+    return vertex_wire;
+}
+)";
+
 /**
  * Shadowmap vertex shader
  */
 const static std::string SHADOWMAP_VERTEX_SHADER = R"(
-#version 450
-
 layout (location = 0) in vec3 position;
 
 uniform mat4 light_matrix;
@@ -98,7 +270,7 @@ invariant gl_Position;
 
 void main()
 {
-    gl_Position = light_matrix * model_matrix * vec4(position, 1.0);
+    gl_Position = light_matrix * model_matrix * vec4(instancePosition(position), 1.0);
 }
 )";
 
@@ -121,10 +293,16 @@ const static std::string UNIQUECOLOR_FRAGMENT_SHADER = R"(
 #version 450
 
 uniform int id;
+// Whether the mesh is instanced: the instance is reported instead of the primitive
+uniform bool instanced = false;
+// Whether the mesh is a static batch: the object ID of the vertices is reported instead of id
+uniform bool batched = false;
+flat in int vert_instance;
+flat in int vert_object_id;
 layout (location = 0) out ivec3 frag_out;
 
 void main() {
-    frag_out = ivec3(id, gl_PrimitiveID, 0);
+    frag_out = ivec3(batched ? vert_object_id : id, instanced ? vert_instance : gl_PrimitiveID, 0);
 }
 )";
 
@@ -132,9 +310,8 @@ void main() {
  * Unique color for entity: vertex shader
  */
 const static std::string UNIQUECOLOR_VERTEX_SHADER = R"(
-#version 450
-
 layout (location = 0) in vec3 position;
+layout (location = 10) in float object_id;
 
 layout (std140, binding=0) uniform Camera {
     mat4 view_matrix;
@@ -145,10 +322,15 @@ layout (std140, binding=0) uniform Camera {
 
 uniform mat4 model_matrix;
 invariant gl_Position;
+flat out int vert_instance;
+flat out int vert_object_id;
 
 void main()
 {
-    gl_Position = projection_matrix * view_matrix * model_matrix * vec4(position, 1.0);
+    vert_instance = gl_InstanceID;
+    vert_object_id = int(object_id);
+    vec4 world_position = model_matrix * vec4(instancePosition(position), 1.0);
+    gl_Position = projection_matrix * view_matrix * world_position;
 }
 )";
 
@@ -169,8 +351,6 @@ void main()
  * Depth pass: vertex shader
  */
 const static std::string DEPTH_VERTEX_SHADER = R"(
-#version 450
-
 layout (location = 0) in vec3 position;
 
 layout (std140, binding=0) uniform Camera {
@@ -185,7 +365,7 @@ invariant gl_Position;
 
 void main()
 {
-    vec4 world_position = model_matrix * vec4(position, 1.0);
+    vec4 world_position = model_matrix * vec4(instancePosition(position), 1.0);
     gl_Position = projection_matrix * view_matrix * world_position;
 }
 )";
@@ -206,6 +386,7 @@ std::shared_ptr<ShaderProgram> skyboxShader();
 
 /**
  * Create a shader for rendering a shadow map into a depth buffer
+ * The shadow, unique color and depth shaders include INSTANCING_VERTEX_SHADER_CHUNK.
  */
 std::shared_ptr<ShaderProgram> shadowMapShader();
 
@@ -78,6 +78,12 @@ class Framebuffer
      */
     std::shared_ptr<Texture2D> colorAttachment(size_t i = 0);
 
+    /**
+     * Returns the depth or depth-stencil attachment
+     * @return Pointer to Texture2D, or nullptr if there is none
+     */
+    std::shared_ptr<Texture2D> depthStencilAttachment();
+
     /**
      * Returns the number of color attachments in this framebuffer
      * @return Number of color attachments
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "RCube/Core/Graphics/OpenGL/Buffer.h"
+#include "glad/glad.h"
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace rcube
+{
+
+/**
+ * RangeAllocator hands out ranges of [0, capacity) from a free list with first fit, merging
+ * neighbouring free ranges when a range is freed. Units are up to the user (e.g., vertices).
+ */
+class RangeAllocator
+{
+  public:
+    static constexpr size_t INVALID = size_t(-1);
+
+    /**
+     * Allocates a range of the given size
+     *
+     * @param size Size of the range
+     * @return Offset of the range, or INVALID if no free range is large enough
+     */
+    size_t allocate(size_t size);
+
+    /**
+     * Returns a range to the free list
+     *
+     * @param offset Offset returned by allocate()
+     * @param size Size passed to allocate()
+     */
+    void free(size_t offset, size_t size);
+
+    /**
+     * Extends the allocator to the given capacity; the added range is free
+     */
+    void grow(size_t capacity);
+
+    /**
+     * Resets the allocator to a single used range [0, used) followed by free space
+     */
+    void reset(size_t capacity, size_t used);
+
+    size_t capacity() const;
+
+    size_t used() const;
+
+    size_t largestFreeRange() const;
+
+    size_t numFreeRanges() const;
+
+  private:
+    // Free ranges indexed by offset
+    std::map<size_t, size_t> free_ranges_;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+};
+
+/**
+ * GeometryArena stores the vertices and indices of many meshes in a few large buffers that
+ * share a vertex layout: one buffer per attribute of the layout and one index buffer, all
+ * referenced by a single vertex array object. Meshes are sub-allocated ranges of vertices and
+ * indices and are drawn with a base vertex and first index, so drawing meshes from the same
+ * arena needs no vertex array switches and can be batched into a single multi-draw call.
+ *
+ * There is one arena per layout, created on demand by forLayout(). Indices stay relative to the
+ * first vertex of their mesh. Arenas must only be used after an OpenGL context has been
+ * created.
+ */
+class GeometryArena : public std::enable_shared_from_this<GeometryArena>
+{
+  public:
+    /**
+     * A float vertex attribute of the layout
+     */
+    struct Attribute
+    {
+        GLuint location = 0;
+        size_t dim = 1;
+        bool operator<(const Attribute &other) const
+        {
+            return location < other.location ||
+                   (location == other.location && dim < other.dim);
+        }
+        bool operator==(const Attribute &other) const
+        {
+            return location == other.location && dim == other.dim;
+        }
+    };
+
+    // Attributes sorted by location
+    using Layout = std::vector<Attribute>;
+
+    /**
+     * Range of vertices and indices owned by a mesh. The offsets may change when the arena is
+     * defragmented, so they should be read when drawing rather than cached.
+     */
+    struct Allocation
+    {
+        size_t first_vertex = 0;
+        size_t num_vertices = 0;
+        size_t first_index = 0;
+        size_t num_indices = 0;
+    };
+
+    /**
+     * Occupancy of an arena; counts are in vertices and indices
+     */
+    struct Stats
+    {
+        size_t vertex_capacity = 0;
+        size_t vertices_used = 0;
+        size_t index_capacity = 0;
+        size_t indices_used = 0;
+        size_t num_allocations = 0;
+        // 1 - (largest free range / total free space); 0 when the free space is contiguous
+        float vertex_fragmentation = 0.f;
+        float index_fragmentation = 0.f;
+        // Size of all buffers of the arena
+        size_t bytes = 0;
+    };
+
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+    ~GeometryArena();
+
+    /**
+     * Returns the arena for the given layout, creating it if needed
+     *
+     * @param layout Vertex attributes sorted by location
+     * @return Arena for the layout
+     */
+    static GeometryArena &forLayout(const Layout &layout);
+
+    /**
+     * Returns all arenas created so far
+     */
+    static std::vector<GeometryArena *> arenas();
+
+    /**
+     * Destroys all arenas and their buffers. Must be called before the OpenGL context is
+     * destroyed, since the arenas otherwise live until the program exits. Allocations that
+     * are still held are left dangling: they can be destroyed safely but not drawn or read.
+     */
+    static void releaseAll();
+
+    /**
+     * Allocates vertices and indices; the buffers grow if needed. The range is returned to the
+     * arena when the last copy of the returned pointer is destroyed, unless the arena was
+     * destroyed first.
+     *
+     * @param num_vertices Number of vertices
+     * @param num_indices Number of indices (0 for non-indexed meshes)
+     * @return Shared pointer to the allocation
+     */
+    std::shared_ptr<Allocation> allocate(size_t num_vertices, size_t num_indices);
+
+    /**
+     * Copies floats into the buffer of the attribute at the given location
+     *
+     * @param allocation Destination allocation
+     * @param location Location of the attribute; must be part of the layout
+     * @param data Pointer to data
+     * @param offset Offset in floats from the first vertex of the allocation
+     * @param count Number of floats
+     */
+    void writeVertices(const Allocation &allocation, GLuint location, const float *data,
+                       size_t offset, size_t count);
+
+    /**
+     * Copies indices into the index buffer
+     *
+     * @param allocation Destination allocation
+     * @param data Pointer to indices relative to the first vertex of the allocation
+     * @param offset Offset in indices from the first index of the allocation
+     * @param count Number of indices
+     */
+    void writeIndices(const Allocation &allocation, const unsigned int *data, size_t offset,
+                      size_t count);
+
+    /**
+     * Reads floats back from the buffer of the attribute at the given location; waits for the
+     * GPU like glGetNamedBufferSubData
+     *
+     * @param allocation Source allocation
+     * @param location Location of the attribute; must be part of the layout
+     * @param data Destination of count floats
+     * @param offset Offset in floats from the first vertex of the allocation
+     * @param count Number of floats
+     */
+    void readVertices(const Allocation &allocation, GLuint location, float *data, size_t offset,
+                      size_t count) const;
+
+    /**
+     * Reads indices back from the index buffer; waits for the GPU like glGetNamedBufferSubData
+     *
+     * @param allocation Source allocation
+     * @param data Destination of count indices
+     * @param offset Offset in indices from the first index of the allocation
+     * @param count Number of indices
+     */
+    void readIndices(const Allocation &allocation, unsigned int *data, size_t offset,
+                     size_t count) const;
+
+    /**
+     * Moves all allocations to the front of the buffers so that the free space is contiguous.
+     * The offsets of the allocations are updated in place.
+     */
+    void defragment();
+
+    Stats stats() const;
+
+    const Layout &layout() const;
+
+    GLuint vao() const;
+
+  private:
+    explicit GeometryArena(const Layout &layout);
+
+    void free(Allocation *allocation);
+    void growVertices(size_t min_capacity);
+    void growIndices(size_t min_capacity);
+    // Points the vertex array at the current buffers
+    void bindBuffers();
+    // Index of the attribute at the given location in the layout
+    size_t attributeIndex(GLuint location) const;
+
+    Layout layout_;
+    GLuint vao_ = 0;
+    // One buffer per attribute of the layout, in the same order
+    std::vector<std::shared_ptr<ArrayBuffer>> vertex_buffers_;
+    std::shared_ptr<ElementArrayBuffer> index_buffer_;
+    RangeAllocator vertex_ranges_;
+    RangeAllocator index_ranges_;
+    std::set<Allocation *> allocations_;
+};
+
+} // namespace rcube
@@ -4,8 +4,11 @@
 #include "RCube/Core/Graphics/OpenGL/AttributeBuffer.h"
 #include "RCube/Core/Graphics/OpenGL/Buffer.h"
 #include "RCube/Core/Graphics/OpenGL/GLDataType.h"
+#include "RCube/Core/Graphics/OpenGL/GeometryArena.h"
+#include "RCube/Core/Graphics/OpenGL/Texture.h"
 #include "glad/glad.h"
 #include "glm/glm.hpp"
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <string>
@@ -57,6 +60,133 @@ struct TriangleMeshData
     void boundingBox(glm::vec3 &min, glm::vec3 &max) const;
 };
 
+/**
+ * Parameters used by the vertex shaders to place the glyph of an instanced mesh, whose
+ * per-instance data is given by the attributes at AttributeLocation::INSTANCE_OFFSET and
+ * AttributeLocation::INSTANCE_DIRECTION. They are uniforms, so changing them does not
+ * touch any per-instance buffer.
+ */
+struct GlyphParameters
+{
+    // Size of instances without a direction (e.g., points)
+    float size = 1.f;
+    // Length of the longest directed instance (e.g., arrows)
+    float max_length = 1.f;
+    // Magnitude that is drawn with max_length when scaling by magnitude
+    float max_magnitude = 1.f;
+    // Whether directed instances are scaled by their magnitude or all drawn with max_length
+    bool scale_by_magnitude = true;
+};
+
+/**
+ * Parameters used by the vertex shaders to map the attribute at AttributeLocation::SCALAR
+ * to a color: the scalar is normalized with the data range [vmin, vmax] and looked up
+ * in the lookup table texture (a row of RGB texels). When lut is nullptr, the color attribute
+ * is used as is. Changing the range or the lookup table does not touch any vertex buffer.
+ */
+struct ColormapParameters
+{
+    std::shared_ptr<Texture2D> lut;
+    float vmin = 0.f;
+    float vmax = 1.f;
+};
+
+/**
+ * Per-face data of an indexed triangle mesh, read by the geometry shaders of the built-in
+ * materials with gl_PrimitiveIDIn so that face colors, scalars and wireframe flags can be shown
+ * without duplicating the vertices of each face. The buffer holds two vec4s per triangle:
+ * (r, g, b, scalar) and (wireframe flag, 0, 0, 0). The flags select which of them replace the
+ * per-vertex data; face scalars are mapped with the mesh's ColormapParameters.
+ */
+struct FaceDataParameters
+{
+    std::shared_ptr<ShaderStorageBuffer> buffer;
+    bool colors = false;
+    bool scalars = false;
+    bool wires = false;
+};
+
+/**
+ * Describes how the per-vertex attributes of a Mesh are laid out on the GPU. By default each
+ * attribute has a buffer of its own. The attributes listed in interleaved (or all per-vertex
+ * attributes if interleave_all is set) are instead packed into a single buffer holding one
+ * record per vertex, so that the vertex fetch reads one contiguous record from a single buffer
+ * binding. The CPU data of each attribute remains a separate array accessible with
+ * Mesh::attribute(); the records are assembled from the modified vertices when uploading.
+ */
+struct VertexLayout
+{
+    // Binding index of the interleaved buffer in the vertex array; bindings 0-10 are used by
+    // the separate attribute buffers and 15 by the multi-draw IDs
+    static constexpr GLuint INTERLEAVED_BINDING = 14;
+
+    // Names of the interleaved attributes, in the order of their fields in a record
+    std::vector<std::string> interleaved;
+    bool interleave_all = false;
+
+    /**
+     * Layout that interleaves all per-vertex attributes
+     */
+    static VertexLayout interleavedAll()
+    {
+        VertexLayout layout;
+        layout.interleave_all = true;
+        return layout;
+    }
+
+    bool interleaves(const std::string &name) const
+    {
+        return interleave_all ||
+               std::find(interleaved.begin(), interleaved.end(), name) != interleaved.end();
+    }
+};
+
+/**
+ * What a Mesh does with the CPU copies of its attributes and indices after uploading them.
+ * Released data is read back from the GPU on demand when it is accessed (e.g., to build a BVH
+ * or to modify it), which stalls the pipeline, so releasing suits static meshes that are only
+ * drawn. Streamed and interleaved attributes keep their copies; meshes in a geometry arena read
+ * theirs back from the arena.
+ */
+enum class CPUDataPolicy
+{
+    Keep,
+    ReleaseAfterUpload
+};
+
+/**
+ * GPU memory used by the vertex attributes and indices of a mesh in their AttributeFormat and
+ * index type, compared to storing them as 32-bit floats and integers. Every drawn vertex
+ * fetches each enabled attribute once, so the bytes per vertex also compare the vertex fetch
+ * bandwidth.
+ */
+struct MeshMemoryReport
+{
+    struct Attribute
+    {
+        std::string name;
+        AttributeFormat format = AttributeFormat::Float32;
+        bool enabled = false;
+        size_t bytes = 0;
+        size_t float_bytes = 0;
+    };
+    std::vector<Attribute> attributes;
+    size_t index_bytes = 0;
+    size_t index_uint32_bytes = 0;
+    // Sum of the strides of the enabled per-vertex attributes
+    size_t bytes_per_vertex = 0;
+    size_t float_bytes_per_vertex = 0;
+    // CPU memory held by the copies of the attributes and indices
+    size_t cpu_bytes = 0;
+
+    size_t totalBytes() const;
+
+    size_t totalFloatBytes() const;
+
+    // Human-readable table of the report
+    std::string toString() const;
+};
+
 // Represents a 3D triangle/line Mesh with vertex positions, normals,
 // texcoords, colors using OpenGL buffers
 class Mesh
@@ -67,11 +197,33 @@ class Mesh
     std::map<std::string, std::shared_ptr<AttributeBuffer>> attributes_;
     std::shared_ptr<AttributeIndexBuffer> indices_;
     std::map<std::string, bool> attributes_enabled_;
+    std::vector<std::shared_ptr<Mesh>> children_;
+    GlyphParameters glyph_params_;
+    ColormapParameters colormap_params_;
+    FaceDataParameters face_data_;
+    // Arena holding the vertices and indices when use_arena_ is set; empty before the first
+    // upload and after GeometryArena::releaseAll()
+    bool use_arena_ = false;
+    std::weak_ptr<GeometryArena> arena_;
+    std::shared_ptr<GeometryArena::Allocation> arena_allocation_;
+    // Interleaved attributes in record order, the byte offset of each in a record and the
+    // buffer holding the records; empty and nullptr if no attribute is interleaved
+    std::vector<std::shared_ptr<AttributeBuffer>> interleaved_;
+    std::vector<size_t> interleaved_offsets_;
+    size_t interleaved_stride_ = 0;
+    std::shared_ptr<ArrayBuffer> interleaved_buffer_;
+    // Forces the next upload to rewrite all records, e.g., after the record layout changed
+    bool interleaved_full_upload_ = true;
+    CPUDataPolicy cpu_data_policy_ = CPUDataPolicy::Keep;
+    // Bounding box of the positions, valid while their version is bounds_version_ or while they
+    // are released from the CPU
+    AABB bounds_;
+    size_t bounds_version_ = size_t(-1);
     bool init_ = false;
     // BVHNodePtr bvh_; // Bounding Volume Hierarchy for intersection queries
 
     Mesh(std::vector<std::shared_ptr<AttributeBuffer>> attributes, MeshPrimitive prim,
-         bool indexed = false);
+         bool indexed = false, const VertexLayout &layout = VertexLayout());
 
   public:
     Mesh() = default;
@@ -86,18 +238,48 @@ class Mesh
      * Initialize actually creates the vertex attribute object and buffers on the OpenGL side
      */
 
-    static std::shared_ptr<Mesh> createPointMesh();
+    static std::shared_ptr<Mesh> createPointMesh(const VertexLayout &layout = VertexLayout());
+
+    static std::shared_ptr<Mesh> createLineMesh(bool indexed,
+                                                const VertexLayout &layout = VertexLayout());
 
-    static std::shared_ptr<Mesh> createLineMesh(bool indexed);
+    static std::shared_ptr<Mesh> createTriangleMesh(bool indexed, bool strip = false,
+                                                    const VertexLayout &layout = VertexLayout());
 
-    static std::shared_ptr<Mesh> createTriangleMesh(bool indexed, bool strip = false);
+    static std::shared_ptr<Mesh> create(const LineMeshData &linemesh,
+                                        const VertexLayout &layout = VertexLayout());
 
-    static std::shared_ptr<Mesh> create(const LineMeshData &linemesh);
+    static std::shared_ptr<Mesh> create(const TriangleMeshData &trimesh,
+                                        const VertexLayout &layout = VertexLayout());
 
-    static std::shared_ptr<Mesh> create(const TriangleMeshData &trimesh);
+    /**
+     * Creates a mesh from data that is no longer needed: each array of trimesh is freed as
+     * soon as it was handed over, so that at most one attribute is held twice. With
+     * CPUDataPolicy::ReleaseAfterUpload the arrays are uploaded straight into GPU buffers
+     * (converted to their format on the way) without any CPU copy being made.
+     *
+     * @param trimesh Mesh data, cleared by the call
+     * @param layout Attributes to interleave in a single vertex buffer
+     * @param policy Whether to keep the CPU copies after the upload
+     * @return Shared pointer to the mesh
+     */
+    static std::shared_ptr<Mesh> create(TriangleMeshData &&trimesh,
+                                        const VertexLayout &layout = VertexLayout(),
+                                        CPUDataPolicy policy = CPUDataPolicy::Keep);
 
+    /**
+     * Creates a mesh with copies of the given (empty) attributes
+     *
+     * @param attributes Name, location, dimension and divisor of the attributes
+     * @param prim Primitive type
+     * @param indexed Whether the mesh has an index buffer
+     * @param layout Attributes to interleave in a single vertex buffer; per-instance attributes
+     * cannot be interleaved
+     * @return Shared pointer to the mesh
+     */
     static std::shared_ptr<Mesh> create(std::vector<std::shared_ptr<AttributeBuffer>> attributes,
-                                        MeshPrimitive prim, bool indexed = false);
+                                        MeshPrimitive prim, bool indexed = false,
+                                        const VertexLayout &layout = VertexLayout());
 
     void release();
 
@@ -115,10 +297,123 @@ class Mesh
 
     std::shared_ptr<AttributeIndexBuffer> indices();
 
+    // Uploads the modified ranges of all attributes and the indices; clean ones are skipped
     void uploadToGPU();
 
     void uploadToGPU(const std::string &attribute);
 
+    /**
+     * Makes the given attribute upload into a persistently mapped, triple-buffered
+     * StreamingBuffer instead of a regular buffer, for data that changes every frame such as
+     * deforming meshes or live point streams
+     *
+     * @param attribute Name of the attribute
+     * @param streaming Whether to stream the attribute
+     */
+    void setStreaming(const std::string &attribute, bool streaming);
+
+    /**
+     * Sets whether the CPU copies of the attributes and indices are freed after each upload
+     * (see CPUDataPolicy); releasing takes effect at the next uploadToGPU()
+     */
+    void setCPUDataPolicy(CPUDataPolicy policy);
+
+    CPUDataPolicy cpuDataPolicy() const
+    {
+        return cpu_data_policy_;
+    }
+
+    /**
+     * Whether the attribute is stored in the interleaved vertex buffer
+     */
+    bool interleaved(const std::string &attribute) const;
+
+    /**
+     * Size in bytes of a record of the interleaved vertex buffer; 0 if no attribute is
+     * interleaved
+     */
+    size_t interleavedStride() const
+    {
+        return interleaved_stride_;
+    }
+
+    /**
+     * Sets the format in which an attribute is stored on the GPU (see AttributeFormat); the
+     * vertex shaders of the built-in materials decode it transparently. Streamed attributes
+     * and meshes in a geometry arena must use Float32.
+     *
+     * @param attribute Name of the attribute
+     * @param format Format on the GPU
+     */
+    void setAttributeFormat(const std::string &attribute, AttributeFormat format);
+
+    /**
+     * Switches the standard attributes between Float32 and compact formats: Snorm16
+     * positions relative to the bounding box, Oct16 normals and tangents, Float16 texture
+     * coordinates and Unorm8 colors. This shrinks a vertex with all of them from 60 to 28
+     * bytes. Indices use 16 bits whenever possible regardless of this setting.
+     *
+     * @param compress Whether to use the compact formats
+     */
+    void setCompressedVertexFormats(bool compress);
+
+    /**
+     * Type of the indices on the GPU: GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+     */
+    GLenum indexType() const;
+
+    /**
+     * Center and half extent of the bounding box that Snorm16 positions are relative to;
+     * (0, 0, 0) and (1, 1, 1) for other formats
+     */
+    glm::vec3 positionDecodeOffset() const;
+
+    glm::vec3 positionDecodeScale() const;
+
+    /**
+     * Value of the "vertex_format_flags" shader uniform: bit 0 is set when the normals are
+     * Oct16 and bit 1 when the tangents are
+     */
+    int vertexFormatFlags() const;
+
+    /**
+     * Reports the GPU memory used by the attributes and indices
+     */
+    MeshMemoryReport memoryReport() const;
+
+    /**
+     * Stores the vertices and indices in the GeometryArena matching the enabled attributes
+     * instead of in buffers of the mesh's own, so that meshes with the same attributes share a
+     * vertex array and can be drawn together with multi-draw. The mesh's own buffers and vertex
+     * array are freed while it is in the arena and filled again when it leaves. Instanced
+     * meshes, interleaved and streamed attributes and attributes in a format other than
+     * Float32 cannot be stored in an arena.
+     *
+     * @param use Whether to use a geometry arena
+     */
+    void setUseGeometryArena(bool use);
+
+    bool usesGeometryArena() const;
+
+    /**
+     * Whether the mesh can be moved into a geometry arena without changing how it was set up:
+     * it is not instanced and its attributes are neither streamed, interleaved nor stored in a
+     * format other than Float32
+     */
+    bool geometryArenaCompatible() const;
+
+    /**
+     * Index of the first vertex of the mesh in the buffers of its vertex array (non-zero only
+     * for meshes in a geometry arena)
+     */
+    size_t baseVertex() const;
+
+    /**
+     * Index of the first index of the mesh in the index buffer of its vertex array (non-zero
+     * only for meshes in a geometry arena)
+     */
+    size_t firstIndex() const;
+
     MeshPrimitive primitive() const
     {
         return primitive_;
@@ -144,6 +439,68 @@ class Mesh
 
     size_t numIndexData() const;
 
+    /**
+     * Whether the mesh has per-instance attributes (divisor > 0), i.e., the vertex data
+     * describes a single glyph that is drawn once per instance
+     */
+    bool instanced() const;
+
+    /**
+     * Number of instances drawn, given by the largest per-instance attribute;
+     * 0 if the mesh is not instanced
+     */
+    size_t numInstances() const;
+
+    GlyphParameters &glyphParameters()
+    {
+        return glyph_params_;
+    }
+
+    const GlyphParameters &glyphParameters() const
+    {
+        return glyph_params_;
+    }
+
+    ColormapParameters &colormapParameters()
+    {
+        return colormap_params_;
+    }
+
+    const ColormapParameters &colormapParameters() const
+    {
+        return colormap_params_;
+    }
+
+    FaceDataParameters &faceData()
+    {
+        return face_data_;
+    }
+
+    const FaceDataParameters &faceData() const
+    {
+        return face_data_;
+    }
+
+    /**
+     * Adds a mesh that is drawn along with this mesh using the same transform and material
+     * (e.g., glyphs visualizing a vector field on a surface)
+     *
+     * @param child Mesh to draw with this mesh
+     */
+    void addChild(std::shared_ptr<Mesh> child);
+
+    /**
+     * Removes a mesh previously added with addChild()
+     *
+     * @param child Mesh to remove
+     */
+    void removeChild(std::shared_ptr<Mesh> child);
+
+    const std::vector<std::shared_ptr<Mesh>> &children() const
+    {
+        return children_;
+    }
+
     // virtual void updateBVH();
 
     // void updateBVH(const std::vector<PrimitivePtr> &prims);
@@ -156,14 +513,58 @@ class Mesh
 
     virtual void drawGUI();
 
+    /**
+     * Bounding box of the positions. It is cached until the positions are modified; for released
+     * positions, the box computed before they were released is returned without reading them
+     * back.
+     */
     AABB boundingBox();
 
+    /**
+     * Counter that changes whenever the shape of the mesh may have changed, i.e., its positions,
+     * indices or per-instance offsets and directions were modified; for caching results that
+     * only depend on the shape, such as shadow maps
+     */
+    size_t shapeVersion() const;
+
+    /**
+     * Counter that changes whenever any attribute or the indices may have changed; for caching
+     * copies of the mesh data, such as static batches
+     */
+    size_t dataVersion() const;
+
   private:
+    void setDefaultValue(GLuint id, const glm::vec4 &val);
+
     void setDefaultValue(GLuint id, const glm::vec3 &val);
 
     void setDefaultValue(GLuint id, const glm::vec2 &val);
 
     void setDefaultValue(GLuint id, float val);
+
+    void setDefaultValue(const AttributeBuffer &attr);
+
+    // Points the vertex array at the buffer (region) the attribute was last uploaded to
+    void bindAttributeBuffer(const AttributeBuffer &attr);
+
+    // Frees the CPU copies that may be released under CPUDataPolicy::ReleaseAfterUpload
+    void releaseCPUCopies();
+
+    // Writes the enabled attributes and the indices into the arena matching their layout
+    void uploadToArena();
+
+    // Creates the mesh's own vertex array and points it at the buffers of the attributes
+    void createVertexArray();
+
+    // Moves the attributes selected by the layout from their buffers into the interleaved one
+    void setupVertexLayout(const VertexLayout &layout);
+
+    // Computes the record layout from the formats of the interleaved attributes and points the
+    // vertex array at it
+    void configureInterleaved();
+
+    // Writes the records of the vertices whose interleaved attributes were modified
+    void uploadInterleaved();
 };
 
 } // namespace rcube
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "glad/glad.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+
+namespace rcube
+{
+
+/**
+ * ReadbackBuffer reads results of GPU work (e.g., compute shader output) back to the CPU
+ * without stalling. Its storage is allocated once with glNamedBufferStorage and stays
+ * persistently and coherently mapped, and it is split into NUM_REGIONS regions. copy() queues a
+ * copy of a buffer into the next region followed by a fence; poll() returns the latest region
+ * whose fence has signaled, whose data can then be read with data(). Results thus arrive one
+ * or more frames after they were computed, unlike glGetNamedBufferSubData, which waits for the
+ * GPU to finish all pending work.
+ *
+ * The buffer must only be used after an OpenGL context has been created.
+ */
+class ReadbackBuffer
+{
+  public:
+    static constexpr size_t NUM_REGIONS = 3;
+    static constexpr size_t NO_REGION = size_t(-1);
+
+    ReadbackBuffer(const ReadbackBuffer &) = delete;
+    ReadbackBuffer &operator=(const ReadbackBuffer &) = delete;
+
+    ~ReadbackBuffer();
+
+    /**
+     * Creates a readback buffer
+     *
+     * @param region_size Capacity of each region in bytes
+     * @return Shared pointer to the readback buffer
+     */
+    static std::shared_ptr<ReadbackBuffer> create(size_t region_size);
+
+    /**
+     * Queues a copy of the first bytes of a buffer into the next region. Writes to the source
+     * by shaders must be made visible with glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT) first.
+     * Returns NO_REGION without copying if the GPU has not finished the copy previously queued
+     * into that region.
+     *
+     * @param buffer Source buffer
+     * @param bytes Number of bytes to copy; must not exceed regionSize()
+     * @return Region the data is copied to, or NO_REGION
+     */
+    size_t copy(GLuint buffer, size_t bytes);
+
+    /**
+     * Returns the region of the latest copy that has completed since the last call, or
+     * NO_REGION if there is none; never waits for the GPU. Regions of older copies are
+     * skipped.
+     */
+    size_t poll();
+
+    /**
+     * Data of a region returned by poll(); valid until the region is copied into again
+     */
+    const void *data(size_t region) const;
+
+    /**
+     * Capacity of each region in bytes
+     */
+    size_t regionSize() const;
+
+  private:
+    ReadbackBuffer() = default;
+
+    struct Region
+    {
+        GLsync fence = nullptr;
+        uint64_t sequence = 0;
+        // Whether the copy has completed and was not returned by poll() yet
+        bool ready = false;
+    };
+
+    // Checks the fence of a region without waiting and marks it ready once signaled
+    void checkFence(Region &region);
+
+    GLuint id_ = 0;
+    size_t region_size_ = 0;
+    char *mapped_ = nullptr;
+    std::array<Region, NUM_REGIONS> regions_;
+    // Region last copied into
+    size_t current_ = NUM_REGIONS - 1;
+    uint64_t sequence_ = 0;
+};
+
+} // namespace rcube
@@ -53,6 +53,55 @@ struct DrawCall
         GLenum primitive;
         bool indexed = false;
         GLsizei num_data;
+        // First vertex and first index in the buffers of the vertex array, which are non-zero
+        // for meshes sub-allocated from a GeometryArena
+        GLint base_vertex = 0;
+        GLuint first_index = 0;
+        // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        GLenum index_type = GL_UNSIGNED_INT;
+        // Instanced meshes are drawn num_instances times with glDraw{Arrays|Elements}Instanced
+        bool instanced = false;
+        GLsizei num_instances = 0;
+        // Value of the "glyph_params" uniform (x: scale by magnitude, y: max. length,
+        // z: 1 / max. magnitude, w: size) if the shader declares it; identity by default
+        glm::vec4 glyph_params = glm::vec4(0.f, 1.f, 1.f, 1.f);
+        // Colormap lookup table bound to COLORMAP_TEXTURE_UNIT and value of the
+        // "colormap_params" uniform (x: enabled, y: min. value, z: 1 / (max. - min. value));
+        // disabled by default
+        GLuint colormap_lut = 0;
+        glm::vec4 colormap_params = glm::vec4(0.f, 0.f, 1.f, 0.f);
+        // Per-face data buffer bound to FACE_DATA_BINDING and value of the "face_data_flags"
+        // uniform (bit 0: colors, bit 1: scalars, bit 2: wireframe flags); disabled by default
+        GLuint face_data = 0;
+        int face_data_flags = 0;
+        // Values of the "position_decode_offset", "position_decode_scale" and
+        // "vertex_format_flags" uniforms (see common::VERTEX_FORMAT_SHADER_CHUNK); identity by
+        // default
+        glm::vec3 position_decode_offset = glm::vec3(0.f);
+        glm::vec3 position_decode_scale = glm::vec3(1.f);
+        int vertex_format_flags = 0;
+        // Meshes drawn right after this one with the same shader and uniforms
+        std::vector<MeshInfo> children;
+    };
+
+    // Texture unit of the colormap lookup table; matches the binding in
+    // common::COLORMAP_VERTEX_SHADER_CHUNK
+    static constexpr int COLORMAP_TEXTURE_UNIT = 15;
+
+    // Shader storage binding of the per-face data; matches the binding in
+    // common::FACE_DATA_GEOMETRY_SHADER_CHUNK
+    static constexpr int FACE_DATA_BINDING = 1;
+
+    /**
+     * When draw_count > 0, the draw call is submitted with a single
+     * glMultiDraw{Arrays|Elements}Indirect call reading draw_count commands
+     * from indirect_buffer starting at the byte offset
+     */
+    struct MultiDrawInfo
+    {
+        GLuint indirect_buffer = 0;
+        size_t offset = 0;
+        GLsizei draw_count = 0;
     };
 
     std::shared_ptr<ShaderProgram> shader;
@@ -61,6 +110,7 @@ struct DrawCall
     std::vector<Texture2DInfo> textures;
     std::vector<TextureCubemapInfo> cubemaps;
     MeshInfo mesh;
+    MultiDrawInfo multi_draw;
     [[deprecated]] RenderSettings settings;
     bool ignore_settings = false;
 };
@@ -124,6 +174,17 @@ class GLRenderer
   private:
     void updateSettings(const RenderSettings &settings);
 
+    // Issues the draw command(s) for the given draw call's mesh
+    void submit(const DrawCall &dc);
+
+    // Per-mesh uniforms that the shader of a draw call may declare
+    // Sets the per-mesh uniforms and textures declared by the shader
+    void setMeshUniforms(const DrawCall::MeshInfo &mesh,
+                         const ShaderProgram::MeshUniforms &uniforms);
+
+    // Draws the mesh and its children, setting their per-mesh uniforms
+    void drawMesh(const DrawCall::MeshInfo &mesh, const ShaderProgram::MeshUniforms &uniforms);
+
     // Skybox
     std::shared_ptr<Mesh> skybox_mesh_;
     std::shared_ptr<ShaderProgram> skybox_shader_;
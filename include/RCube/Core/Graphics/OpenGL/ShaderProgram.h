@@ -218,12 +218,29 @@ struct RenderSettings
 
 class ShaderProgram
 {
+  public:
+    /**
+     * Per-mesh uniforms that the GLRenderer sets for every draw call, looked up once after
+     * linking; nullptr if the program does not declare the uniform
+     */
+    struct MeshUniforms
+    {
+        Uniform *glyph_params = nullptr;
+        Uniform *colormap_params = nullptr;
+        Uniform *face_data_flags = nullptr;
+        Uniform *position_decode_offset = nullptr;
+        Uniform *position_decode_scale = nullptr;
+        Uniform *vertex_format_flags = nullptr;
+    };
+
   private:
     GLuint location_;
     std::vector<GLint> shaders_;
     bool warn_ = true;
     std::unordered_map<std::string, ShaderAttributeDesc> attributes_;
     std::unordered_map<std::string, Uniform> uniforms_;
+    // Points into uniforms_, whose elements keep their addresses
+    MeshUniforms mesh_uniforms_;
 
   public:
     ShaderProgram();
@@ -244,10 +261,19 @@ class ShaderProgram
                                                  const std::vector<std::string> &geometry_shader,
                                                  const std::vector<std::string> &fragment_shader,
                                                  bool debug = false);
+    /**
+     * Creates a compute shader program (OpenGL 4.3)
+     * @param compute_shader Source strings of the compute shader, concatenated in order
+     * @param debug Whether to print compilation and linking errors
+     * @return Shader program
+     */
+    static std::shared_ptr<ShaderProgram>
+    createCompute(const std::vector<std::string> &compute_shader, bool debug = false);
     const std::unordered_map<std::string, ShaderAttributeDesc> &attributes() const;
     const Uniform &uniform(std::string name) const;
     Uniform &uniform(std::string name);
     bool hasUniform(std::string name, Uniform &uni);
+    const MeshUniforms &meshUniforms() const;
     bool link(bool debug = false);
     GLuint id() const;
     void use() const;
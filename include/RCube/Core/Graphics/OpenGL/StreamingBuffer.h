@@ -0,0 +1,75 @@
+#pragma once
+
+#include "glad/glad.h"
+#include <array>
+#include <memory>
+
+namespace rcube
+{
+
+/**
+ * StreamingBuffer is a buffer for data that is rewritten every frame (e.g., deforming meshes or
+ * live point streams). Its storage is allocated once with glNamedBufferStorage and stays
+ * persistently and coherently mapped, and it is split into NUM_REGIONS regions that are written
+ * in turn. A region is only overwritten once the fence placed after the GPU commands reading it
+ * has signaled, so writing never stalls on the frame the GPU is still drawing, unlike
+ * glNamedBufferSubData on a buffer that is in use.
+ *
+ * After write(), the data is in the region starting at offset(); draws reading it must be issued
+ * before the next write(), which places the fence for that region.
+ *
+ * The buffer must only be used after an OpenGL context has been created.
+ */
+class StreamingBuffer
+{
+  public:
+    static constexpr size_t NUM_REGIONS = 3;
+
+    StreamingBuffer(const StreamingBuffer &) = delete;
+    StreamingBuffer &operator=(const StreamingBuffer &) = delete;
+
+    ~StreamingBuffer();
+
+    /**
+     * Creates a streaming buffer
+     *
+     * @param region_size Capacity of each region in bytes
+     * @return Shared pointer to the streaming buffer
+     */
+    static std::shared_ptr<StreamingBuffer> create(size_t region_size);
+
+    /**
+     * Copies data into the next region, waiting for the GPU to finish reading it if needed
+     *
+     * @param data Pointer to data
+     * @param bytes Number of bytes to copy; must not exceed regionSize()
+     */
+    void write(const void *data, size_t bytes);
+
+    /**
+     * Byte offset of the region last written
+     */
+    size_t offset() const;
+
+    /**
+     * Capacity of each region in bytes
+     */
+    size_t regionSize() const;
+
+    GLuint id() const;
+
+  private:
+    StreamingBuffer() = default;
+
+    // Waits until the fence of the given region has signaled and deletes it
+    void waitForRegion(size_t region);
+
+    GLuint id_ = 0;
+    size_t region_size_ = 0;
+    char *mapped_ = nullptr;
+    // Region last written; NUM_REGIONS before the first write
+    size_t current_ = NUM_REGIONS;
+    std::array<GLsync, NUM_REGIONS> fences_ = {};
+};
+
+} // namespace rcube
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "RCube/Core/Graphics/OpenGL/Buffer.h"
+#include "glm/glm.hpp"
+#include <cstring>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace rcube
+{
+
+/**
+ * Std140Writer packs values into a byte array following the std140 layout rules
+ * so that they can be copied directly into a uniform block.
+ * Values must be added in the same order as the members of the GLSL block.
+ */
+class Std140Writer
+{
+    std::vector<char> &bytes_;
+    size_t offset_ = 0;
+
+    template <typename T> void write(const T *values, size_t count, size_t alignment)
+    {
+        offset_ = (offset_ + alignment - 1) / alignment * alignment;
+        if (bytes_.size() < offset_ + count * sizeof(T))
+        {
+            bytes_.resize(offset_ + count * sizeof(T), 0);
+        }
+        std::memcpy(bytes_.data() + offset_, values, count * sizeof(T));
+        offset_ += count * sizeof(T);
+    }
+
+  public:
+    Std140Writer(std::vector<char> &bytes) : bytes_(bytes)
+    {
+        bytes_.clear();
+    }
+    void add(float value)
+    {
+        write(&value, 1, 4);
+    }
+    void add(int value)
+    {
+        write(&value, 1, 4);
+    }
+    void add(bool value)
+    {
+        // bool occupies 4 bytes in a std140 block
+        int v = value ? 1 : 0;
+        write(&v, 1, 4);
+    }
+    void add(const glm::vec2 &value)
+    {
+        write(&value[0], 2, 8);
+    }
+    void add(const glm::vec3 &value)
+    {
+        write(&value[0], 3, 16);
+    }
+    void add(const glm::vec4 &value)
+    {
+        write(&value[0], 4, 16);
+    }
+    void add(const glm::mat4 &value)
+    {
+        write(&value[0][0], 16, 16);
+    }
+    /**
+     * Size of the block written so far, rounded up to the size of a vec4
+     * as required for std140 blocks
+     */
+    size_t size() const
+    {
+        return (offset_ + 15) / 16 * 16;
+    }
+};
+
+/**
+ * UniformBufferArena is a single large uniform buffer that is shared by many small uniform
+ * blocks (e.g., the parameters of all materials in the scene). Each block is sub-allocated at an
+ * offset satisfying GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT and bound for drawing with
+ * glBindBufferRange, which avoids a separate buffer object per block.
+ *
+ * The arena must only be used after an OpenGL context has been created.
+ */
+class UniformBufferArena
+{
+  public:
+    /**
+     * Handle to a sub-allocated range in the arena
+     */
+    struct Block
+    {
+        size_t offset = 0;
+        size_t size = 0;
+        // Number of release() calls of the arena before the block was allocated, plus one
+        size_t generation = 0;
+        bool valid() const
+        {
+            return size > 0;
+        }
+    };
+
+    UniformBufferArena(const UniformBufferArena &) = delete;
+    UniformBufferArena &operator=(const UniformBufferArena &) = delete;
+
+    static UniformBufferArena &instance();
+
+    /**
+     * Allocates a block of the given size in bytes. The arena grows if needed; existing blocks
+     * retain their offsets and contents.
+     *
+     * @param bytes Size of the block in bytes
+     * @return Handle to the allocated block
+     */
+    Block allocate(size_t bytes);
+
+    /**
+     * Returns a block to the arena so that its range can be reused; blocks allocated before
+     * the last release() are only reset
+     *
+     * @param block Block previously returned by allocate()
+     */
+    void free(Block &block);
+
+    /**
+     * Whether the block was allocated since the last release()
+     */
+    bool owns(const Block &block) const;
+
+    /**
+     * Deletes the uniform buffer and forgets all blocks. Must be called before the OpenGL
+     * context is destroyed, since the arena itself lives until the program exits. The arena
+     * can be used again afterwards; blocks allocated before must be allocated again.
+     */
+    void release();
+
+    /**
+     * Copies data into the given block
+     *
+     * @param block Destination block
+     * @param data Pointer to data
+     * @param bytes Number of bytes to copy; must not exceed block.size
+     */
+    void write(const Block &block, const void *data, size_t bytes);
+
+    /**
+     * Binds the range of the given block to a uniform block binding point
+     *
+     * @param block Block to bind
+     * @param index Uniform block binding index
+     */
+    void bind(const Block &block, int index);
+
+    /**
+     * Size of the underlying uniform buffer in bytes
+     */
+    size_t capacity() const;
+
+    /**
+     * Number of bytes currently allocated to blocks
+     */
+    size_t used() const;
+
+  private:
+    UniformBufferArena() = default;
+    ~UniformBufferArena() = default;
+
+    void grow(size_t min_capacity);
+    size_t align(size_t bytes) const;
+
+    std::shared_ptr<UniformBuffer> ubo_;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+    size_t alignment_ = 0;
+    size_t generation_ = 1;
+    // Free ranges indexed by offset, merged with neighbours on free()
+    std::map<size_t, size_t> free_ranges_;
+};
+
+} // namespace rcube
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include <cstdint>
+#include <string>
+
+namespace rcube
+{
+
+/**
+ * Format in which an AttributeBuffer stores its elements on the GPU. The CPU data is always
+ * float; it is converted when uploading, and the vertex shaders read the converted data as
+ * floats again (see common::VERTEX_FORMAT_SHADER_CHUNK for the formats that need decoding).
+ */
+enum class AttributeFormat
+{
+    // 32-bit floats
+    Float32,
+    // 16-bit floats (e.g., texture coordinates)
+    Float16,
+    // Normalized 16-bit integers relative to the bounding box of the data, which is mapped to
+    // [-1, 1] per component (e.g., positions); decoded with an offset and scale
+    Snorm16,
+    // Unit vectors (e.g., normals, tangents) as 2 normalized 16-bit integers using the
+    // octahedral mapping; requires 3D data
+    Oct16,
+    // Normalized 8-bit unsigned integers of data in [0, 1] (e.g., colors)
+    Unorm8
+};
+
+/**
+ * Number of components of an element in the given format as declared to OpenGL; 16-bit
+ * formats are padded to an even number of components and 8-bit formats to 4 components so that
+ * every element is 4-byte aligned
+ *
+ * @param format Format of the attribute
+ * @param dim Number of components of the float data
+ * @return Number of components on the GPU
+ */
+GLint formatComponents(AttributeFormat format, size_t dim);
+
+/**
+ * OpenGL type of the components in the given format
+ */
+GLenum formatType(AttributeFormat format);
+
+/**
+ * Whether OpenGL normalizes the integer components of the given format to [-1, 1] or [0, 1]
+ */
+GLboolean formatNormalized(AttributeFormat format);
+
+/**
+ * Size of an element in bytes on the GPU
+ *
+ * @param format Format of the attribute
+ * @param dim Number of components of the float data
+ * @return Size in bytes
+ */
+size_t formatStride(AttributeFormat format, size_t dim);
+
+std::string formatName(AttributeFormat format);
+
+/**
+ * Converts a float to a 16-bit float, rounding to nearest even
+ */
+uint16_t packHalf(float value);
+
+float unpackHalf(uint16_t value);
+
+/**
+ * Maps a unit vector onto the octahedron unfolded into [-1, 1]^2
+ */
+glm::vec2 octEncode(const glm::vec3 &n);
+
+/**
+ * Inverse of octEncode(); the result is normalized
+ */
+glm::vec3 octDecode(const glm::vec2 &e);
+
+/**
+ * Converts count elements of float data into the given format
+ *
+ * @param format Destination format
+ * @param dim Number of components per element
+ * @param src count * dim floats
+ * @param count Number of elements
+ * @param offset Center of the data range (Snorm16 only)
+ * @param scale Half the extent of the data range per component (Snorm16 only); must be > 0
+ * @param dst Destination of count * formatStride(format, dim) bytes
+ */
+void packElements(AttributeFormat format, size_t dim, const float *src, size_t count,
+                  const glm::vec4 &offset, const glm::vec4 &scale, void *dst);
+
+/**
+ * Converts count elements from the given format back to float data, as the vertex shaders
+ * would decode them
+ *
+ * @param format Source format
+ * @param dim Number of components per element
+ * @param src count * formatStride(format, dim) bytes
+ * @param count Number of elements
+ * @param offset Offset used when packing (Snorm16 only)
+ * @param scale Scale used when packing (Snorm16 only)
+ * @param dst Destination of count * dim floats
+ */
+void unpackElements(AttributeFormat format, size_t dim, const void *src, size_t count,
+                    const glm::vec4 &offset, const glm::vec4 &scale, float *dst);
+
+} // namespace rcube
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "RCube/Core/Accel/AABB.h"
+#include "glm/glm.hpp"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rcube
+{
+
+/**
+ * Sequential reader of the points converted by buildPointOctree(), so that point sets larger
+ * than the memory can be converted from files
+ */
+class PointSource
+{
+  public:
+    virtual ~PointSource() = default;
+
+    /**
+     * Bounding box of all points, needed before the first point is read (e.g., from the header
+     * of a file)
+     */
+    virtual AABB bounds() = 0;
+
+    /**
+     * Reads the next points
+     *
+     * @param max_points Maximum number of points to read
+     * @param positions Filled with the positions of the points read
+     * @param colors Filled with their colors in [0, 1], or left empty for white points
+     * @return Number of points read; 0 once all points have been read
+     */
+    virtual size_t read(size_t max_points, std::vector<glm::vec3> &positions,
+                        std::vector<glm::vec3> &colors) = 0;
+};
+
+/**
+ * PointSource reading points held in memory; the vectors must outlive the source
+ */
+class MemoryPointSource : public PointSource
+{
+  public:
+    /**
+     * @param positions Positions of the points
+     */
+    explicit MemoryPointSource(const std::vector<glm::vec3> &positions);
+    /**
+     * @param positions Positions of the points
+     * @param colors Colors of the points in [0, 1]
+     */
+    MemoryPointSource(const std::vector<glm::vec3> &positions,
+                      const std::vector<glm::vec3> &colors);
+    AABB bounds() override;
+    size_t read(size_t max_points, std::vector<glm::vec3> &positions,
+                std::vector<glm::vec3> &colors) override;
+
+  private:
+    const std::vector<glm::vec3> *positions_;
+    const std::vector<glm::vec3> *colors_;
+    size_t next_ = 0;
+};
+
+struct PointOctreeOptions
+{
+    // Number of cells along each side of the sampling grid of a node; a node keeps at most one
+    // point per cell, so its points are about (node size / grid_size) apart
+    size_t grid_size = 128;
+    // Nodes with at most this many points keep all of them and have no children
+    size_t max_leaf_points = 20000;
+    // Level of the octree whose nodes (8^chunk_depth of them) the points are first sorted into
+    // on disk; each of these chunks is then indexed in memory
+    size_t chunk_depth = 3;
+    // Largest chunk indexed in memory; larger chunks are split into their octants on disk
+    size_t max_chunk_points = size_t(1) << 22;
+    // Number of points read from the source and written to the chunks at a time
+    size_t batch_points = size_t(1) << 20;
+    // Nodes at this level are leaves, however many points they have (e.g., duplicates)
+    size_t max_depth = 20;
+};
+
+/**
+ * Summary of a conversion by buildPointOctree()
+ */
+struct PointOctreeStats
+{
+    size_t num_points = 0;
+    size_t num_nodes = 0;
+    size_t num_chunks = 0;
+    size_t depth = 0;
+};
+
+/**
+ * Converts a point set into a level of detail octree on disk, in the spirit of Potree (Schuetz,
+ * "Potree: Rendering Large Point Clouds in Web Browsers", 2016). Each point is stored in exactly
+ * one node: a node keeps a subsample of the points in its cube with one point per cell of its
+ * sampling grid, the one closest to the center of the cell, and passes the others on to its
+ * children. The points of the nodes down to any level thus form an evenly spaced subsample of
+ * the whole set whose density doubles with each level (nested subsampling).
+ *
+ * The conversion works out of core: the points are streamed from the source in batches into
+ * chunk files (the nodes at options.chunk_depth), which are then indexed in memory in parallel,
+ * each chunk also providing its share of the nodes above it, which is appended to a file per
+ * node. Memory use is bounded by options.max_chunk_points per thread and options.batch_points
+ * rather than by the number of points.
+ *
+ * The directory receives hierarchy.bin, holding the nodes, and octree.bin, holding the points
+ * of each node as 16-byte records (position relative to the minimum of the octree's cube as
+ * three floats and an RGBA8 color). Existing files are overwritten. Throws std::runtime_error
+ * if the files cannot be written.
+ *
+ * @param source Points to convert
+ * @param directory Output directory; created if needed
+ * @param options Sampling and memory settings
+ * @return Number of points, nodes, chunks and levels written
+ */
+PointOctreeStats buildPointOctree(PointSource &source, const std::string &directory,
+                                  const PointOctreeOptions &options = PointOctreeOptions());
+
+/**
+ * Camera for which octree nodes are selected
+ */
+struct PointOctreeView
+{
+    // World to clip space matrix (projection * view) and the object to world matrix
+    glm::mat4 world_to_clip = glm::mat4(1.f);
+    glm::mat4 model = glm::mat4(1.f);
+    // Camera position in world space
+    glm::vec3 eye = glm::vec3(0.f);
+    bool orthographic = false;
+    // Pixels per world unit at unit distance (perspective) or anywhere (orthographic):
+    // 0.5 * viewport height * projection[1][1]
+    float pixels_per_unit = 1.f;
+};
+
+/**
+ * A level of detail octree of points written by buildPointOctree(). Only the hierarchy is held
+ * in memory; the points of a node are read from disk on request.
+ */
+class PointOctree
+{
+  public:
+    static constexpr uint32_t NO_NODE = 0xFFFFFFFFu;
+
+    struct Node
+    {
+        // Cube of the node, in the coordinates of the original points
+        AABB bounds;
+        // Distance between the cells of the node's sampling grid
+        float spacing = 0.f;
+        uint32_t level = 0;
+        uint32_t parent = NO_NODE;
+        std::array<uint32_t, 8> children;
+        uint32_t num_points = 0;
+        // Index of the node's first point in octree.bin
+        uint64_t first_point = 0;
+    };
+
+    /**
+     * Reads the hierarchy of an octree written by buildPointOctree(). Throws std::runtime_error
+     * if the files are missing or invalid.
+     *
+     * @param directory Directory passed to buildPointOctree()
+     * @return Shared pointer to the octree
+     */
+    static std::shared_ptr<PointOctree> open(const std::string &directory);
+
+    /**
+     * Nodes of the octree; the root is nodes()[0] and parents come before their children
+     */
+    const std::vector<Node> &nodes() const
+    {
+        return nodes_;
+    }
+
+    size_t numPoints() const
+    {
+        return num_points_;
+    }
+
+    /**
+     * Cube of the root node
+     */
+    const AABB &bounds() const
+    {
+        return nodes_[0].bounds;
+    }
+
+    /**
+     * Reads the points of a node from disk. Safe to call from several threads.
+     *
+     * @param node Index of the node
+     * @param positions Filled with the positions of the node's points
+     * @param colors Filled with their colors
+     */
+    void readNode(uint32_t node, std::vector<glm::vec3> &positions,
+                  std::vector<glm::vec3> &colors) const;
+
+    /**
+     * Selects the nodes to draw for a camera, largest on screen first: starting from the root,
+     * nodes whose bounding sphere is in the view frustum are visited in decreasing order of its
+     * projected diameter. A node is selected if its diameter is at least min_node_pixels and
+     * its points fit in the budget along with those selected before; selection stops at the
+     * first node that does not fit. Children are visited after their parent is selected, so
+     * the selected nodes form a subtree.
+     *
+     * @param view Camera and object transform
+     * @param point_budget Maximum number of points of the selected nodes; the root is always
+     * selected if visible
+     * @param min_node_pixels Smallest diameter on screen, in pixels, of a selected node
+     * @return Indices of the selected nodes, in the order they were selected
+     */
+    std::vector<uint32_t> selectNodes(const PointOctreeView &view, size_t point_budget,
+                                      float min_node_pixels) const;
+
+  private:
+    PointOctree() = default;
+
+    std::string points_path_;
+    std::vector<Node> nodes_;
+    size_t num_points_ = 0;
+    // Minimum corner of the root cube, which the stored positions are relative to
+    glm::vec3 root_min_ = glm::vec3(0.f);
+};
+
+} // namespace rcube
@@ -15,10 +15,18 @@ enum class ForwardRenderPass
 {
     Opaque,
     Transparent,
+    // Opaque pass where per-object data is read from a shader storage buffer
+    // indexed by the per-instance draw ID (RCUBE_MULTIDRAW is defined)
+    OpaqueMultiDraw,
 };
 
 /**
  * ShaderManager is a class to create and manage shaders for the ForwardRenderSystem
+ * Vertex shaders are compiled with common::INSTANCING_VERTEX_SHADER_CHUNK so that they
+ * can place instanced glyphs with instancePosition() and instanceVector(), and with
+ * common::COLORMAP_VERTEX_SHADER_CHUNK so that they can colormap scalars with vertexColor().
+ * Geometry shaders are compiled with common::FACE_DATA_GEOMETRY_SHADER_CHUNK so that they can
+ * show per-face data with faceColor() and faceWire().
  */
 class ForwardRenderSystemShaderManager
 {
@@ -34,8 +42,9 @@ class ForwardRenderSystemShaderManager
     };
     std::unordered_map<ShaderNameAndPass, std::shared_ptr<ShaderProgram>, ShaderNameAndPassHash>
         res_;
-    std::array<std::string, 2> defines_ = {"#define RCUBE_RENDERPASS 0\n",
-                                           "#define RCUBE_RENDERPASS 1\n"};
+    std::array<std::string, 3> defines_ = {"#define RCUBE_RENDERPASS 0\n",
+                                           "#define RCUBE_RENDERPASS 1\n",
+                                           "#define RCUBE_RENDERPASS 0\n#define RCUBE_MULTIDRAW\n"};
 
     ForwardRenderSystemShaderManager() = default;
     ~ForwardRenderSystemShaderManager() = default;
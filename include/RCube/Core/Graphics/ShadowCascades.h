@@ -0,0 +1,123 @@
+#pragma once
+
+#include "RCube/Core/Accel/AABB.h"
+#include "glm/glm.hpp"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#define RCUBE_MAX_SHADOW_CASCADES 4
+
+namespace rcube
+{
+
+/**
+ * Settings of the cascaded shadow maps of directional lights. The camera frustum (up to
+ * max_distance) is split into cascades along the view direction; each shadow-casting light
+ * renders one tile of the shadow atlas per cascade, fitted to that slice of the frustum. The
+ * atlas holds a row of cascades per shadow-casting light and takes
+ * lights * cascades * resolution^2 * 4 bytes (twice that with split_dynamic_casters); the
+ * resolution is halved until it fits in memory_budget.
+ */
+struct ShadowSettings
+{
+    // Size in texels of the square atlas tile of a cascade
+    unsigned int resolution = 2048;
+    // Number of cascades, at most RCUBE_MAX_SHADOW_CASCADES
+    unsigned int cascades = 4;
+    // Blend between uniform (0) and logarithmic (1) split distances
+    float split_lambda = 0.75f;
+    // Distance from the camera up to which shadows are drawn; 0 uses the far plane. The range
+    // is also clipped to the bounds of the shadow casters.
+    float max_distance = 0.f;
+    // Maximum size of the shadow atlas in bytes
+    size_t memory_budget = 128 * 1024 * 1024;
+    // Offset of the shadow lookups along the surface normal, in texels of the cascade
+    float normal_offset = 1.5f;
+    // Constant depth bias of the shadow lookups, in [0, 1] depth units
+    float depth_bias = 0.0005f;
+    // Fit a single cascade to the bounds of the shadow casters instead of the camera frustum.
+    // The shadow maps then do not depend on the camera and stay cached while it moves, which
+    // suits inspecting a bounded scene.
+    bool fit_to_casters = false;
+    // Redraw a cascade only when a light, the transform or shape of a caster, or the cascade's
+    // projection changed
+    bool cache = true;
+    // Keep the shadows of static casters in a second, cached atlas and draw the casters whose
+    // Drawable::dynamic is set on top of a copy of it every frame. This doubles the atlas
+    // memory but keeps moving objects from invalidating the cache.
+    bool split_dynamic_casters = false;
+};
+
+/**
+ * A cascade fitted to a slice of the camera frustum
+ */
+struct ShadowCascade
+{
+    // Light's view projection matrix mapping the slice into [-1, 1]^3
+    glm::mat4 view_projection = glm::mat4(1.f);
+    // Size of a shadow map texel in world units
+    float texel_size = 0.f;
+};
+
+/**
+ * Computes the far distance of each cascade, using the practical split scheme: a blend of
+ * logarithmic splits (which keep the texel density on screen constant) and uniform splits
+ *
+ * @param znear Near distance of the first cascade
+ * @param zfar Far distance of the last cascade
+ * @param count Number of cascades
+ * @param lambda Blend factor: 0 gives uniform and 1 logarithmic splits
+ * @return Far distance of each cascade
+ */
+std::vector<float> cascadeSplits(float znear, float zfar, unsigned int count, float lambda);
+
+/**
+ * Corners of the part of a camera frustum between two view distances
+ *
+ * @param inverse_view_projection Inverse of the camera's projection * view matrix
+ * @param znear Near plane distance of the camera
+ * @param zfar Far plane distance of the camera
+ * @param slice_near Near distance of the slice
+ * @param slice_far Far distance of the slice
+ * @return World space corners: 4 on the near side of the slice and 4 on the far side
+ */
+std::array<glm::vec3, 8> frustumSlice(const glm::mat4 &inverse_view_projection, float znear,
+                                      float zfar, float slice_near, float slice_far);
+
+/**
+ * Fits an orthographic shadow projection to a slice of the camera frustum. The projection
+ * covers the bounding sphere of the slice, so that its size does not change when the camera
+ * rotates, and is moved in whole texels, so that shadow edges do not shimmer when the camera
+ * moves. The depth range is extended towards the light to include all shadow casters.
+ *
+ * @param light_direction Direction of the light
+ * @param slice Corners of the frustum slice
+ * @param casters World space bounds of the shadow casters
+ * @param resolution Size in texels of the shadow map tile
+ * @return View projection matrix and texel size of the cascade
+ */
+ShadowCascade fitShadowCascade(const glm::vec3 &light_direction,
+                               const std::array<glm::vec3, 8> &slice, const AABB &casters,
+                               unsigned int resolution);
+
+/**
+ * Whether a world space box can cast a shadow into a cascade, i.e., it overlaps the cascade's
+ * projection laterally and is not beyond its far plane
+ *
+ * @param view_projection Light's view projection matrix of the cascade
+ * @param box World space box
+ */
+bool boxInShadowCascade(const glm::mat4 &view_projection, const AABB &box);
+
+/**
+ * Largest tile resolution, obtained by halving settings.resolution, such that the given number
+ * of tiles fits in settings.memory_budget (but not below 256 texels)
+ *
+ * @param settings Shadow settings
+ * @param num_tiles Number of atlas tiles (lights times cascades)
+ * @return Tile resolution
+ */
+unsigned int shadowTileResolution(const ShadowSettings &settings, size_t num_tiles);
+
+} // namespace rcube
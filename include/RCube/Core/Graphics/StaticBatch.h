@@ -0,0 +1,84 @@
+#pragma once
+
+#include "RCube/Core/Accel/AABB.h"
+#include "RCube/Core/Graphics/OpenGL/Mesh.h"
+#include "glm/glm.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rcube
+{
+
+// Number of vertices at which a static batch stops taking new members; small batches keep the
+// rebuild after a change of one member cheap
+constexpr size_t MAX_STATIC_BATCH_VERTICES = 65536;
+
+// Largest number of vertices of a mesh merged into static batches; larger meshes gain nothing
+// from batching and are drawn on their own
+constexpr size_t MAX_STATIC_BATCH_MEMBER_VERTICES = MAX_STATIC_BATCH_VERTICES / 4;
+
+/**
+ * A mesh merged into a static batch with the transform it is merged with
+ */
+struct StaticBatchMember
+{
+    // Stored per vertex in the batch's "object_ids" attribute (e.g., the ID of the entity
+    // drawing the mesh, for picking); must be below 2^24 to be exact as a float
+    unsigned int id = 0;
+    std::shared_ptr<Mesh> mesh;
+    glm::mat4 transform = glm::mat4(1.f);
+    // Set by buildStaticBatch(): the member's triangles are the indices
+    // [first_index, first_index + num_indices) of the batch, its vertices the vertices
+    // [first_vertex, first_vertex + num_vertices), and its world space bounding box
+    size_t first_index = 0;
+    size_t num_indices = 0;
+    size_t first_vertex = 0;
+    size_t num_vertices = 0;
+    AABB bounds;
+};
+
+/**
+ * Whether a mesh can be merged into a static batch: a triangle mesh (indexed or not) that is
+ * neither instanced nor has children, face data or a colormap, with at most
+ * MAX_STATIC_BATCH_MEMBER_VERTICES vertices
+ */
+bool staticBatchable(const Mesh &mesh);
+
+/**
+ * Key of the meshes that can be merged into the same batch: the names, locations, dimensions
+ * and formats of their enabled attributes
+ */
+std::string staticBatchSignature(const Mesh &mesh);
+
+/**
+ * Merges meshes with the same staticBatchSignature() into a single indexed triangle mesh whose
+ * vertices are transformed to world space: positions by the member's transform, normals by its
+ * normal matrix and tangents by its linear part. The triangles of mirrored members are flipped
+ * to keep their front faces. Each vertex also gets the member's id in an "object_ids"
+ * attribute (AttributeLocation::OBJECT_ID). Members are merged in order, so each one is a
+ * contiguous range of the batch's indices that can be drawn or skipped on its own. The CPU
+ * copies of the batch are released after the upload.
+ *
+ * @param members Meshes to merge and their transforms; their index ranges and bounds are set
+ * @return Batch mesh, uploaded to the GPU
+ */
+std::shared_ptr<Mesh> buildStaticBatch(std::vector<StaticBatchMember> &members);
+
+/**
+ * Moves a member of a batch built by buildStaticBatch() to a new transform when nothing else
+ * about it changed: its positions, normals and tangents are transformed again from its mesh
+ * and written over its range of the batch's vertices, without touching the other members.
+ * Fails if the batch must be rebuilt instead, i.e., if the member's triangles would have to be
+ * flipped or its positions leave the Snorm16 decoding range of the batch; the member's range
+ * may then be partially updated.
+ *
+ * @param batch Batch mesh
+ * @param member Member of the batch; its transform and bounds are updated
+ * @param transform New transform of the member
+ * @return Whether the member was updated
+ */
+bool retransformStaticBatchMember(Mesh &batch, StaticBatchMember &member,
+                                  const glm::mat4 &transform);
+
+} // namespace rcube
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace rcube
+{
+
+/**
+ * Returns the number of chunks parallelChunks() splits a range into: at most one per hardware
+ * thread, with at least min_chunk_size elements each
+ *
+ * @param size Number of elements
+ * @param min_chunk_size Minimum number of elements per chunk
+ * @return Number of chunks (at least 1)
+ */
+inline size_t numParallelChunks(size_t size, size_t min_chunk_size)
+{
+    const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    return std::max(size_t(1), std::min(max_threads, size / std::max(min_chunk_size, size_t(1))));
+}
+
+/**
+ * Splits [0, size) into numParallelChunks(size, min_chunk_size) contiguous chunks and calls
+ * kernel(chunk_index, begin, end) on each, in parallel when there is more than one chunk.
+ * The first chunk runs on the calling thread. Per-chunk results can be written to an array
+ * indexed by chunk_index and reduced afterwards.
+ *
+ * @param size Number of elements
+ * @param min_chunk_size Minimum number of elements per chunk; below this, the cost of
+ * spawning a thread outweighs the work
+ * @param kernel Callable as kernel(size_t chunk_index, size_t begin, size_t end)
+ */
+template <typename Kernel> void parallelChunks(size_t size, size_t min_chunk_size, Kernel kernel)
+{
+    const size_t num_chunks = numParallelChunks(size, min_chunk_size);
+    if (num_chunks == 1)
+    {
+        kernel(size_t(0), size_t(0), size);
+        return;
+    }
+    const size_t chunk = (size + num_chunks - 1) / num_chunks;
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_chunks - 1);
+    for (size_t i = 1; i < num_chunks; ++i)
+    {
+        const size_t begin = std::min(i * chunk, size);
+        const size_t end = std::min(begin + chunk, size);
+        futures.push_back(std::async(std::launch::async, kernel, i, begin, end));
+    }
+    kernel(size_t(0), size_t(0), std::min(chunk, size));
+    for (std::future<void> &f : futures)
+    {
+        f.get();
+    }
+}
+
+} // namespace rcube
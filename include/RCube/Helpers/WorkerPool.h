@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rcube
+{
+
+/**
+ * Threads that are started once and then run work split like parallelChunks(), for work done
+ * every frame where spawning threads on each call would cost more than the work saves. The
+ * calling thread takes part in the work. A pool runs one call at a time; concurrent calls wait
+ * for each other.
+ */
+class WorkerPool
+{
+  public:
+    using Kernel = std::function<void(size_t, size_t, size_t)>;
+
+    /**
+     * Starts the worker threads
+     *
+     * @param num_threads Number of threads including the calling one; 0 uses one per hardware
+     * thread
+     */
+    explicit WorkerPool(size_t num_threads = 0);
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    /**
+     * Stops and joins the worker threads
+     */
+    ~WorkerPool();
+
+    /**
+     * Number of threads work is split across, including the calling one
+     */
+    size_t numThreads() const
+    {
+        return workers_.size() + 1;
+    }
+
+    /**
+     * Splits [0, size) into at most numThreads() contiguous chunks with at least
+     * min_chunk_size elements each and calls kernel(chunk_index, begin, end) on each, like
+     * parallelChunks(). Returns once all chunks are done; an exception thrown by the kernel is
+     * rethrown.
+     *
+     * @param size Number of elements
+     * @param min_chunk_size Minimum number of elements per chunk
+     * @param kernel Callable as kernel(size_t chunk_index, size_t begin, size_t end)
+     */
+    void parallelChunks(size_t size, size_t min_chunk_size, const Kernel &kernel);
+
+  private:
+    // Waits for chunks and runs them until the pool is destroyed
+    void work();
+    // Runs the next chunk of the current call; the lock is released while the kernel runs
+    void runChunk(std::unique_lock<std::mutex> &lock);
+
+    std::vector<std::thread> workers_;
+    // Held for the whole of a parallelChunks() call
+    std::mutex call_mutex_;
+    // Guards the state of the current call below
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const Kernel *kernel_ = nullptr;
+    size_t size_ = 0;
+    size_t chunk_size_ = 0;
+    size_t num_chunks_ = 0;
+    size_t next_chunk_ = 0;
+    // Chunks of the current call not finished yet
+    size_t pending_ = 0;
+    std::exception_ptr error_;
+    bool stop_ = false;
+};
+
+} // namespace rcube
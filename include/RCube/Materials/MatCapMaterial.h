@@ -16,6 +16,14 @@ class MatCapRGBMaterial : public ShaderMaterial
     std::shared_ptr<Texture2D> blue_;
     std::shared_ptr<Texture2D> black_;
 
+  protected:
+    /**
+     * Loads the RGB material capture textures for a derived material with its own shader
+     *
+     * @param name Name of the derived material's shader
+     */
+    MatCapRGBMaterial(const std::string &name);
+
   public:
     glm::vec3 color = glm::vec3(1, 1, 1);
     glm::vec3 emissive_color = glm::vec3(0, 0, 0);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "RCube/Components/ForwardMaterial.h"
+
+namespace rcube
+{
+
+/**
+ * PointSplatMaterial renders each vertex of a mesh with the Points primitive as a splat of
+ * constant screen-space size (e.g., the nodes of a viewer::OctreePointcloud), colored by the
+ * per-vertex colors. The size is given in pixels, or in world units so that splats shrink with
+ * distance like geometry. Round splats discard the fragments outside the inscribed circle.
+ *
+ * The depth prepass, picking and shadows do not write gl_PointSize, so the material writes its
+ * own depth in the opaque pass and point meshes should not cast shadows.
+ */
+class PointSplatMaterial : public ShaderMaterial
+{
+  public:
+    // Diameter of a splat in pixels, or in world units if size_in_world_units
+    float point_size = 2.f;
+    bool size_in_world_units = false;
+    // Largest diameter of a splat in pixels
+    float max_point_size = 64.f;
+    bool round = true;
+
+    PointSplatMaterial();
+    void updateUniforms(std::shared_ptr<ShaderProgram> shader) override;
+    bool supportsDepthPrepass() const override;
+    void drawGUI() override;
+};
+
+} // namespace rcube
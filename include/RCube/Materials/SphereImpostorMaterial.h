@@ -0,0 +1,28 @@
+#pragma once
+
+#include "RCube/Materials/MatCapMaterial.h"
+
+namespace rcube
+{
+
+/**
+ * SphereImpostorMaterial renders each instance of an instanced quad mesh as a sphere
+ * (e.g., the points of a viewer::Pointcloud with the SphereImpostor glyph).
+ * The quad is turned towards the camera in the vertex shader and the sphere is ray-cast per
+ * fragment, writing the exact depth and normal, so a sphere costs two triangles regardless of
+ * its size on screen. Shading uses the RGB material captures of MatCapRGBMaterial.
+ *
+ * The sphere of an instance is centered at its offset and its diameter is the instance scale
+ * (see INSTANCING_VERTEX_SHADER_CHUNK). The model matrix must scale uniformly. The depth
+ * prepass, picking and shadows use the quads, so picks and shadows are approximate.
+ */
+class SphereImpostorMaterial : public MatCapRGBMaterial
+{
+  public:
+    SphereImpostorMaterial();
+    void updateUniforms(std::shared_ptr<ShaderProgram> shader) override;
+    bool supportsDepthPrepass() const override;
+    void drawGUI() override;
+};
+
+} // namespace rcube
@@ -8,34 +8,100 @@
 namespace rcube
 {
 
+/**
+ * StandardMaterial shades objects with a physically-based metallic-roughness model. Its
+ * parameters live in a uniform block that is repacked and uploaded only when a setter changes
+ * them (or when the opacity changes).
+ */
 class StandardMaterial : public ShaderMaterial
 {
     std::vector<DrawCall::Texture2DInfo> textures_;
     std::vector<DrawCall::TextureCubemapInfo> cubemaps_;
+    glm::vec3 albedo_ = glm::vec3(1.f);
+    float roughness_ = 0.5f;
+    float metallic_ = 0.5f;
+    std::shared_ptr<Texture2D> albedo_texture_ = nullptr;
+    std::shared_ptr<Texture2D> roughness_texture_ = nullptr;
+    std::shared_ptr<Texture2D> metallic_texture_ = nullptr;
+    std::shared_ptr<Texture2D> normal_texture_ = nullptr;
+    std::shared_ptr<Texture2D> ibl_brdfLUT_ = nullptr;
+    std::shared_ptr<TextureCubemap> ibl_irradiance_ = nullptr;
+    std::shared_ptr<TextureCubemap> ibl_prefilter_ = nullptr;
+    bool image_based_lighting_ = true;
+    bool wireframe_ = false;
+    float wireframe_thickness_ = 1.f;
+    glm::vec3 wireframe_color_ = glm::vec3(0.f, 0.f, 0.f);
 
-  public:
-    glm::vec3 albedo = glm::vec3(1.f);
-    float roughness = 0.5f;
-    float metallic = 0.5f;
-    std::shared_ptr<Texture2D> albedo_texture = nullptr;
-    std::shared_ptr<Texture2D> roughness_texture = nullptr;
-    std::shared_ptr<Texture2D> metallic_texture = nullptr;
-    std::shared_ptr<Texture2D> normal_texture = nullptr;
-    std::shared_ptr<Texture2D> ibl_brdfLUT = nullptr;
-    std::shared_ptr<TextureCubemap> ibl_irradiance = nullptr;
-    std::shared_ptr<TextureCubemap> ibl_prefilter = nullptr;
-    bool image_based_lighting = true;
-
-    bool wireframe = false;
-    float wireframe_thickness = 1.f;
-    glm::vec3 wireframe_color = glm::vec3(0.f, 0.f, 0.f);
+    // Whether all maps needed for image-based lighting are set and it is enabled
+    bool useIBL() const;
+
+  protected:
+    bool writeUniformBlock(Std140Writer &writer) override;
 
+  public:
     StandardMaterial();
     void updateUniforms(std::shared_ptr<ShaderProgram> shader) override;
+    bool supportsMultiDraw() const override;
     const std::vector<DrawCall::Texture2DInfo> textureSlots() override;
     const std::vector<DrawCall::TextureCubemapInfo> cubemapSlots() override;
-    void setIBLFromCamera(Camera *cam);
     void drawGUI() override;
+
+    /**
+     * Base color in sRGB
+     */
+    void setAlbedo(const glm::vec3 &albedo);
+    const glm::vec3 &albedo() const;
+
+    void setRoughness(float roughness);
+    float roughness() const;
+
+    void setMetallic(float metallic);
+    float metallic() const;
+
+    /**
+     * Textures that replace the albedo and modulate the roughness and metallic values; the
+     * normal texture perturbs the normals in tangent space. nullptr disables a texture.
+     */
+    void setAlbedoTexture(std::shared_ptr<Texture2D> texture);
+    const std::shared_ptr<Texture2D> &albedoTexture() const;
+
+    void setRoughnessTexture(std::shared_ptr<Texture2D> texture);
+    const std::shared_ptr<Texture2D> &roughnessTexture() const;
+
+    void setMetallicTexture(std::shared_ptr<Texture2D> texture);
+    const std::shared_ptr<Texture2D> &metallicTexture() const;
+
+    void setNormalTexture(std::shared_ptr<Texture2D> texture);
+    const std::shared_ptr<Texture2D> &normalTexture() const;
+
+    /**
+     * Sets the maps used for image-based lighting, e.g., those precomputed by a Camera
+     *
+     * @param irradiance Diffuse irradiance cubemap
+     * @param prefilter Prefiltered specular cubemap
+     * @param brdfLUT Lookup table of the split-sum BRDF approximation
+     */
+    void setIBLMaps(std::shared_ptr<TextureCubemap> irradiance,
+                    std::shared_ptr<TextureCubemap> prefilter, std::shared_ptr<Texture2D> brdfLUT);
+    void setIBLFromCamera(Camera *cam);
+
+    /**
+     * Whether image-based lighting is used when its maps are set
+     */
+    void setImageBasedLighting(bool flag);
+    bool imageBasedLighting() const;
+
+    void setWireframe(bool flag);
+    bool wireframe() const;
+
+    void setWireframeThickness(float thickness);
+    float wireframeThickness() const;
+
+    /**
+     * Color of the wireframe in sRGB
+     */
+    void setWireframeColor(const glm::vec3 &color);
+    const glm::vec3 &wireframeColor() const;
 };
 
 } // namespace rcube
\ No newline at end of file
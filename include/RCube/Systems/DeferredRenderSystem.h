@@ -6,9 +6,30 @@
 #include "RCube/Core/Graphics/OpenGL/Renderer.h"
 #include "RCube/Components/Camera.h"
 
+#define RCUBE_MAX_LIGHTS_PER_TILE 256
+
 namespace rcube
 {
 
+/**
+ * Settings of the tiled light culling of the deferred lighting pass. A compute pass splits the
+ * screen into 16x16 pixel tiles, finds the depth range of the G-buffer in each tile and culls the
+ * point lights against the tile's frustum; each pixel then only shades the lights of its tile
+ * (at most RCUBE_MAX_LIGHTS_PER_TILE).
+ */
+struct TiledLightingSettings
+{
+    // Whether to cull lights per tile; otherwise every pixel shades every point light
+    bool enabled = true;
+    // Maximum number of point lights; further lights are ignored
+    size_t max_point_lights = 4096;
+    // Overlay a heatmap of the number of lights in each tile; tiles with more lights than
+    // RCUBE_MAX_LIGHTS_PER_TILE are drawn in white
+    bool show_heatmap = false;
+    // Number of lights drawn in the hottest color of the heatmap
+    unsigned int heatmap_max_lights = 64;
+};
+
 class DeferredRenderSystem : public System
 {
   public:
@@ -23,11 +44,35 @@ class DeferredRenderSystem : public System
         return "DeferredRenderSystem";
     }
 
+    /**
+     * Settings of the tiled light culling; changes take effect in the next frame
+     */
+    TiledLightingSettings &tiledLightingSettings()
+    {
+        return tiled_settings_;
+    }
+    const TiledLightingSettings &tiledLightingSettings() const
+    {
+        return tiled_settings_;
+    }
+    /**
+     * Number of 16x16 pixel tiles along x and y
+     */
+    glm::ivec2 numTiles() const;
+    /**
+     * Reads back the number of point lights overlapping each tile in the last frame (row by
+     * row from the bottom left tile); this waits for the GPU
+     * @return Light count per tile, or an empty vector if tiled culling is disabled
+     */
+    std::vector<uint32_t> tileLightCounts() const;
+
   protected:
     void setCameraUBO(const glm::vec3 &eye_pos, const glm::mat4 &world_to_view,
                       const glm::mat4 &view_to_projection, const glm::mat4 &projection_to_viewport);
     void setDirectionalLightsUBO();
-    void setPointLightsUBO();
+    void setPointLightsSSBO();
+    // Builds the light list of each screen tile from the G-buffer depth
+    void lightCullingPass(Camera *cam);
     void initializePostprocess();
     void geometryPass();
     void lightingPass(Camera *cam);
@@ -41,6 +86,7 @@ class DeferredRenderSystem : public System
     std::shared_ptr<Framebuffer> framebuffer_shadow_;
     std::shared_ptr<ShaderProgram> gbuffer_shader_;
     std::shared_ptr<ShaderProgram> lighting_shader_;
+    std::shared_ptr<ShaderProgram> culling_shader_;
     std::shared_ptr<ShaderProgram> shadow_shader_;
     std::shared_ptr<Framebuffer> framebuffer_brightness_;
     std::shared_ptr<Framebuffer> framebuffer_blur_[2];
@@ -52,7 +98,12 @@ class DeferredRenderSystem : public System
     // Uniform buffer objects for camera and lights
     std::shared_ptr<Buffer<BufferType::Uniform>> ubo_camera_;
     std::shared_ptr<Buffer<BufferType::Uniform>> ubo_dirlights_;
-    std::shared_ptr<Buffer<BufferType::Uniform>> ubo_pointlights_;
+    // Point lights, and the light count and light list of each tile
+    std::shared_ptr<ShaderStorageBuffer> ssbo_pointlights_;
+    std::shared_ptr<ShaderStorageBuffer> ssbo_tile_counts_;
+    std::shared_ptr<ShaderStorageBuffer> ssbo_tile_indices_;
+    TiledLightingSettings tiled_settings_;
+    int num_pointlights_ = 0;
     unsigned int msaa_;
     // Buffers
     std::vector<float> dirlight_data_;
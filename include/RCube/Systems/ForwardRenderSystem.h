@@ -4,11 +4,27 @@
 #include "RCube/Core/Arch/System.h"
 #include "RCube/Core/Graphics/OpenGL/CheckGLError.h"
 #include "RCube/Core/Graphics/OpenGL/Framebuffer.h"
+#include "RCube/Core/Graphics/OpenGL/ReadbackBuffer.h"
 #include "RCube/Core/Graphics/OpenGL/Renderer.h"
+#include "RCube/Core/Graphics/LightClusters.h"
+#include "RCube/Core/Graphics/ShadowCascades.h"
+#include "RCube/Core/Graphics/StaticBatch.h"
+#include "RCube/Helpers/WorkerPool.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace rcube
 {
 
+class Drawable;
+struct Meshlet;
+class ShaderMaterial;
+class Transform;
+
 class WeightedBlendedOITManager
 {
     std::shared_ptr<Framebuffer> fbo_;
@@ -16,10 +32,20 @@ class WeightedBlendedOITManager
     std::shared_ptr<Texture2D> revealage_tex_;
     std::shared_ptr<ShaderProgram> composite_shader_;
     glm::ivec2 resolution_ = glm::ivec2(1280, 720);
+    TextureInternalFormat accum_format_ = TextureInternalFormat::RGBA32F;
 
   public:
     WeightedBlendedOITManager() = default;
     void initialize(glm::ivec2 resolution, std::shared_ptr<Texture2D> opaque_depth);
+    /**
+     * Sets the format of the accumulation target, reallocating it if already initialized
+     * @param format RGBA32F (default) or RGBA16F
+     */
+    void setAccumFormat(TextureInternalFormat format);
+    TextureInternalFormat accumFormat() const
+    {
+        return accum_format_;
+    }
     std::shared_ptr<Framebuffer> getFramebuffer();
     std::shared_ptr<Texture2D> getAccumTexture();
     std::shared_ptr<Texture2D> getRevealageTexture();
@@ -60,15 +86,295 @@ class ForwardRenderSystem : public System
         return framebuffer_pp_->getImage();
     }
 
+    /**
+     * Enables or disables multi-draw submission of opaque objects. When enabled, the world and
+     * normal matrices of objects are stored in a shader storage buffer, the parameters of their
+     * materials in another, and all objects whose materials share a shader and textures and
+     * whose meshes share a vertex layout are drawn with a single glMultiDrawElementsIndirect
+     * (or glMultiDrawArraysIndirect) call. Only meshes whose vertex buffers are shared, i.e.,
+     * that were moved into the GeometryArena of their layout with Mesh::setUseGeometryArena,
+     * are drawn this way. Other meshes, materials that do not support it, and contexts older
+     * than OpenGL 4.3 use the regular per-object draw path.
+     *
+     * @param flag Whether to enable multi-draw
+     */
+    void setMultiDrawEnabled(bool flag)
+    {
+        multidraw_ = flag;
+    }
+    bool multiDrawEnabled() const
+    {
+        return multidraw_;
+    }
+
+    /**
+     * Enables or disables hierarchical-Z occlusion culling of opaque objects. The depth prepass
+     * draws the objects that were visible in their previous test for the camera; a depth
+     * pyramid built from it tests the bounding boxes of all opaque objects, and the depth of
+     * the objects that became visible is added in the same frame. The opaque pass then draws
+     * the visible objects only. The decisions stay on the GPU, which writes the indirect draw
+     * commands of the tested objects, so nothing is read back. Instanced meshes, meshes with
+     * children and objects drawn by meshlets (which are culled one by one) are never culled,
+     * and neither are shadow casters in the shadow pass or objects in the pick pass. Requires
+     * OpenGL 4.3.
+     *
+     * @param flag Whether to enable occlusion culling
+     */
+    void setOcclusionCullingEnabled(bool flag)
+    {
+        occlusion_culling_ = flag;
+        occlusion_states_.clear();
+        occlusion_ = nullptr;
+    }
+    bool occlusionCullingEnabled() const
+    {
+        return occlusion_culling_;
+    }
+    /**
+     * Number of opaque objects culled by the occlusion test of the last rendered camera. The
+     * count is read back without waiting for the GPU, so it lags one or two frames behind.
+     */
+    size_t numOccluded() const
+    {
+        return occlusion_ != nullptr ? occlusion_->num_occluded : 0;
+    }
+
+    /**
+     * Number of triangles drawn by the opaque and transparent passes of all cameras in the last
+     * frame, after the selection of levels of detail (see Drawable::lods). Triangles of meshlets
+     * are counted on the GPU and lag behind like numMeshletsDrawn(); objects hidden by occlusion
+     * culling are counted.
+     */
+    size_t numTrianglesDrawn() const
+    {
+        return triangles_drawn_;
+    }
+    /**
+     * Number of triangles the opaque and transparent passes of the last frame would have drawn
+     * with the full meshes
+     */
+    size_t numTrianglesFullDetail() const
+    {
+        return triangles_full_detail_;
+    }
+
+    /**
+     * Number of meshlets (see Drawable::meshlets) drawn by the opaque passes of all cameras,
+     * after frustum, back-facing and, with occlusion culling, depth pyramid culling. Meshlets
+     * are culled on the GPU and the count is read back without waiting, so it lags one or two
+     * frames behind.
+     */
+    size_t numMeshletsDrawn() const
+    {
+        return meshlets_drawn_;
+    }
+    /**
+     * Number of meshlets of the opaque objects tested for the opaque passes of all cameras in
+     * the last frame
+     */
+    size_t numMeshletsTested() const
+    {
+        return meshlets_tested_;
+    }
+
+    /**
+     * Number of static batches (see Drawable::static_batch), of the drawables merged into them
+     * and of the batches rebuilt in the last frame because their members changed. Members
+     * whose transform alone changed are moved within their batch without a rebuild.
+     */
+    size_t numStaticBatches() const
+    {
+        return static_batches_.size();
+    }
+    size_t numStaticBatchMembers() const
+    {
+        return static_batch_members_.size();
+    }
+    size_t numStaticBatchesRebuilt() const
+    {
+        return static_batches_rebuilt_;
+    }
+
+    /**
+     * Sets the format of the accumulation target of the weighted blended order-independent
+     * transparency. RGBA16F halves its memory and bandwidth compared to RGBA32F (the default),
+     * at the cost of precision when many transparent layers overlap.
+     *
+     * @param format RGBA32F or RGBA16F
+     */
+    void setTransparencyAccumFormat(TextureInternalFormat format)
+    {
+        wboit_.setAccumFormat(format);
+    }
+    TextureInternalFormat transparencyAccumFormat() const
+    {
+        return wboit_.accumFormat();
+    }
+
+    /**
+     * Settings of the cascaded shadow maps of directional lights that cast shadows; changes
+     * take effect in the next frame
+     */
+    ShadowSettings &shadowSettings()
+    {
+        return shadow_settings_;
+    }
+    const ShadowSettings &shadowSettings() const
+    {
+        return shadow_settings_;
+    }
+
+    /**
+     * Settings of the clustered assignment of point lights; changes take effect in the next
+     * frame
+     */
+    LightClusterSettings &lightClusterSettings()
+    {
+        return light_cluster_settings_;
+    }
+    const LightClusterSettings &lightClusterSettings() const
+    {
+        return light_cluster_settings_;
+    }
+    /**
+     * Point lights assigned to the clusters of the last rendered camera
+     */
+    const LightClusters &lightClusters() const
+    {
+        return light_clusters_;
+    }
+
+    /**
+     * Size of the shadow atlases in bytes
+     */
+    size_t shadowAtlasBytes() const
+    {
+        const size_t atlases = shadow_static_atlas_ != nullptr ? 2 : 1;
+        return shadow_atlas_ != nullptr
+                   ? atlases * shadow_atlas_->width() * shadow_atlas_->height() * sizeof(float)
+                   : 0;
+    }
+
   protected:
     void setCameraUBO(const glm::vec3 &eye_pos, const glm::mat4 &world_to_view,
                       const glm::mat4 &view_to_projection, const glm::mat4 &projection_to_viewport);
     void setDirectionalLightsUBO();
-    void setPointLightsUBO();
+    // Uploads the point lights and their world space position and range for clustering
+    void setPointLightsSSBO();
+    // Assigns the point lights to the clusters of the camera's view frustum
+    void setLightClustersSSBO(Camera *cam);
     void initializePostprocess();
-    void shadowMapPass();
+    struct ShadowCaster
+    {
+        Entity entity;
+        AABB bounds;
+    };
+    // What the shadow of a caster depends on; cached cascades are redrawn when it changes
+    struct ShadowCasterState
+    {
+        unsigned int entity;
+        const Mesh *mesh;
+        size_t shape_version;
+        glm::mat4 transform;
+        glm::vec4 glyph_params;
+        bool operator==(const ShadowCasterState &other) const;
+    };
+    // Renders the cascades of all shadow-casting directional lights for the camera and fills the
+    // shadow UBO; cascades whose casters and projection did not change are kept
+    void shadowMapPass(Camera *cam);
+    // Draws the casters overlapping a cascade into the tile given by the render target
+    void drawShadowCasters(const RenderTarget &rt, const glm::mat4 &light_matrix,
+                           const std::vector<ShadowCaster> &casters);
+    // Reallocates the shadow atlases if their size or the static/dynamic split changed
+    void resizeShadowAtlas(int width, int height, bool split);
+    // Sorts the visible drawables with a material into opaque and transparent ones; done once
+    // per frame for all cameras and passes
+    void classifyDrawables();
+    // Selects the level of detail of the visible drawables for a camera, starting from the
+    // levels selected for it in the previous frame
+    void selectLODs(Entity camera_entity, const std::unordered_map<uint64_t, size_t> &previous);
+    // Mesh drawn for a drawable with the current camera
+    const std::shared_ptr<Mesh> &drawnMesh(Entity entity, Drawable *dr) const;
+    // Draw commands written for the objects tested for occlusion: those visible in their
+    // previous test (depth prepass), those that became visible (added to the depth prepass)
+    // and those visible now (opaque pass)
+    enum class OcclusionPhase
+    {
+        Prepass = 0,
+        Reveal = 1,
+        Visible = 2,
+    };
+    // Draws the depth of the opaque objects; with occlusion culling, the tested objects are
+    // drawn by the commands of the first phase
     void depthPrepass(Camera *cam);
+    // Draws the depth of the given opaque objects into the depth prepass target, clearing it
+    // first if clear; tested objects are drawn by the commands of the given phase
+    void drawDepth(const std::vector<Entity> &entities, bool clear, OcclusionPhase phase);
+    // Finds the opaque objects the occlusion test covers for the camera, uploads their bounds
+    // and draw parameters, and writes the commands of the first phase
+    void prepareOcclusionCulling();
+    // Builds the depth pyramid from the depth prepass, tests the objects against it, writes the
+    // commands of the other phases, and adds the depth of the objects that became visible
+    void occlusionCullingPass(Camera *cam);
+    // Sets the draw command of an object tested for occlusion in the command buffer of a phase;
+    // returns false if the object is not tested
+    bool occlusionDraw(Entity entity, OcclusionPhase phase, DrawCall::MultiDrawInfo &info) const;
+    // Uploads the meshlets of the opaque objects drawn by meshlets when they have changed
+    void updateMeshletData();
+    // Culls the meshlets of the opaque objects for the camera in a compute shader that writes
+    // one draw command per meshlet, drawing nothing for culled meshlets; the depth pyramid of
+    // the occlusion culling pass is also tested if use_depth. Both culls of a camera write
+    // their own command buffer, so the second one leaves the commands of the depth prepass
+    // alone.
+    void cullMeshletDraws(Camera *cam, bool use_depth);
+    // Draw commands of an object's visible meshlets, or nullptr to draw its mesh whole
+    const DrawCall::MultiDrawInfo *meshletDraws(Entity entity) const
+    {
+        const auto it = meshlet_draws_.find(entity.id());
+        return it != meshlet_draws_.end() ? &it->second : nullptr;
+    }
+    // Opaque static drawables sharing a material and vertex layout, merged into one mesh
+    struct StaticBatch
+    {
+        std::shared_ptr<ShaderMaterial> material;
+        std::string signature;
+        // Merged meshes in the order of their index ranges, with the entity, mesh data version
+        // and frame each was last seen in; removed members have no mesh until the rebuild
+        std::vector<StaticBatchMember> members;
+        std::vector<Entity> entities;
+        std::vector<size_t> data_versions;
+        std::vector<uint64_t> last_seen;
+        size_t num_vertices = 0;
+        std::shared_ptr<Mesh> mesh;
+        bool dirty = true;
+        // Draw commands of the visible members for the current camera: runs of consecutive
+        // members merged for the color passes, one per member for the pick pass so that
+        // gl_PrimitiveID counts from the member's first triangle
+        DrawCall::MultiDrawInfo draws;
+        DrawCall::MultiDrawInfo pick_draws;
+        size_t triangles = 0;
+    };
+    // Adds, moves and removes the members of the static batches, transforms members whose
+    // transform alone changed again in place and rebuilds the batches whose members changed
+    // otherwise; done once per frame
+    void updateStaticBatches(const std::vector<Entity> &entities);
+    // Culls the members of the static batches for the camera and uploads the draw commands of
+    // the remaining ones
+    void cullStaticBatches(Camera *cam);
     void opaqueGeometryPass(Camera *cam);
+    struct MultiDrawItem
+    {
+        ShaderMaterial *material;
+        std::shared_ptr<Mesh> mesh;
+        Transform *transform;
+        unsigned int id;
+        // History slot plus one of an object tested for occlusion, or 0
+        uint32_t occlusion_slot = 0;
+    };
+    // Whether objects with the material can be drawn with multi-draw; a material that claims
+    // support without a uniform block is reported once and drawn per object
+    bool multiDrawSupported(ShaderMaterial *material);
+    void addMultiDrawCalls(std::vector<MultiDrawItem> &items, std::vector<DrawCall> &drawcalls);
     void transparentGeometryPass(Camera *cam);
     void pickFBOPass(Camera *cam);
     void postprocessPass(Camera *cam);
@@ -82,12 +388,15 @@ class ForwardRenderSystem : public System
     std::shared_ptr<Framebuffer> framebuffer_blur_[2];
     std::shared_ptr<Framebuffer> framebuffer_pp_;
     std::shared_ptr<Framebuffer> framebuffer_shadow_;
+    std::shared_ptr<Framebuffer> framebuffer_shadow_static_;
     std::shared_ptr<Framebuffer> framebuffer_pick_;
     std::shared_ptr<Framebuffer> framebuffer_depth_;
     std::shared_ptr<Texture2D> depth_;
     std::shared_ptr<Framebuffer> framebuffer_depth_ms_;
     std::shared_ptr<Texture2D> depth_ms_;
     std::shared_ptr<Texture2D> shadow_atlas_;
+    // Cached shadows of static casters when ShadowSettings::split_dynamic_casters is set
+    std::shared_ptr<Texture2D> shadow_static_atlas_;
     std::shared_ptr<ShaderProgram> shader_brightness_;
     std::shared_ptr<ShaderProgram> shader_blur_;
     std::shared_ptr<ShaderProgram> shader_shadow_;
@@ -97,15 +406,106 @@ class ForwardRenderSystem : public System
     // Uniform buffer objects for camera and lights
     std::shared_ptr<Buffer<BufferType::Uniform>> ubo_camera_;
     std::shared_ptr<Buffer<BufferType::Uniform>> ubo_dirlights_;
-    std::shared_ptr<Buffer<BufferType::Uniform>> ubo_pointlights_;
+    std::shared_ptr<Buffer<BufferType::Uniform>> ubo_shadows_;
     unsigned int msaa_;
     // Buffers
     std::vector<float> dirlight_data_;
     std::vector<float> pointlight_data_;
+    // Clustered point lights: light data, the cluster grid with the light range of each
+    // cluster, and the light lists of the clusters
+    LightClusterSettings light_cluster_settings_;
+    LightClusters light_clusters_;
+    // Threads assigning the lights to the clusters, started on the first frame with many lights
+    std::unique_ptr<WorkerPool> light_workers_;
+    std::vector<glm::vec4> pointlight_bounds_;
+    std::shared_ptr<ShaderStorageBuffer> ssbo_pointlights_;
+    std::shared_ptr<ShaderStorageBuffer> ssbo_light_clusters_;
+    std::shared_ptr<ShaderStorageBuffer> ssbo_light_indices_;
+    // Shadows: atlas matrices and tiles of each light and cascade, followed by the split
+    // distances (see the ShadowCascades block of the StandardMaterial shader)
+    ShadowSettings shadow_settings_;
+    std::vector<float> shadow_data_;
+    // Shadow cache: the atlas matrix each tile was last drawn with, the static casters it was
+    // drawn with and whether dynamic casters were drawn over the static tiles
+    std::vector<glm::mat4> shadow_tile_matrices_;
+    std::vector<ShadowCasterState> shadow_static_casters_;
+    bool shadow_had_dynamic_ = false;
     // Pick pass
     bool pick_pass_ = true;
+    // Visible drawables of the current frame
+    std::vector<Entity> opaque_entities_;
+    std::vector<Entity> transparent_entities_;
+    // Levels of detail: the level of each camera (high 32 bits of the key) and drawable (low 32
+    // bits), the meshes of the current camera's drawables not drawn at full detail, and the
+    // triangle counts of the last frame
+    std::unordered_map<uint64_t, size_t> lod_levels_;
+    std::unordered_map<unsigned int, std::shared_ptr<Mesh>> lod_meshes_;
+    size_t triangles_drawn_ = 0;
+    size_t triangles_full_detail_ = 0;
+    // Occlusion culling: depth pyramid holding the farthest depth of each texel's footprint,
+    // the bounds and draw parameters of the tested objects with the index of each, their draw
+    // commands for each phase, and the state of each camera (by entity id) with the state of
+    // the camera being rendered
+    bool occlusion_culling_ = false;
+    bool occlusion_culling_supported_ = false;
+    std::shared_ptr<Texture2D> hiz_;
+    std::shared_ptr<ShaderProgram> shader_hiz_downsample_;
+    std::shared_ptr<ShaderProgram> shader_occlusion_history_;
+    std::shared_ptr<ShaderProgram> shader_occlusion_test_;
+    std::shared_ptr<ShaderProgram> shader_occlusion_multidraw_;
+    std::shared_ptr<ShaderStorageBuffer> ssbo_occlusion_objects_;
+    std::vector<Entity> occlusion_tested_;
+    std::unordered_map<unsigned int, uint32_t> occlusion_indices_;
+    std::array<std::shared_ptr<DrawIndirectBuffer>, 3> occlusion_commands_;
+    std::shared_ptr<AtomicCounterBuffer> occlusion_counter_;
+    struct OcclusionState
+    {
+        // Slot of each tested object in the visibility history and the unused slots
+        std::unordered_map<unsigned int, uint32_t> slots;
+        std::vector<uint32_t> free_slots;
+        // Whether the object in each slot was visible in its latest test; written on the GPU
+        std::shared_ptr<ShaderStorageBuffer> history;
+        // Number of hidden objects, read back without waiting
+        std::shared_ptr<ReadbackBuffer> readback;
+        size_t num_occluded = 0;
+    };
+    std::unordered_map<unsigned int, OcclusionState> occlusion_states_;
+    OcclusionState *occlusion_ = nullptr;
+    // Meshlet culling: the meshlets of all objects drawn by meshlets, the drawables they were
+    // uploaded from and the first meshlet of each, the objects culled for a camera, the draw
+    // commands written before the depth prepass and after the occlusion pass, the draw
+    // commands of each object, and the meshlet counters with their readback
+    std::shared_ptr<ShaderProgram> shader_meshlet_cull_;
+    std::shared_ptr<ShaderStorageBuffer> ssbo_meshlets_;
+    std::vector<std::tuple<unsigned int, const Meshlet *, size_t>> meshlet_sources_;
+    std::unordered_map<unsigned int, uint32_t> meshlet_offsets_;
+    std::shared_ptr<ShaderStorageBuffer> ssbo_meshlet_objects_;
+    std::array<std::shared_ptr<DrawIndirectBuffer>, 2> meshlet_commands_;
+    std::unordered_map<unsigned int, DrawCall::MultiDrawInfo> meshlet_draws_;
+    std::shared_ptr<ShaderStorageBuffer> ssbo_meshlet_stats_;
+    std::shared_ptr<ReadbackBuffer> meshlet_stats_readback_;
+    size_t meshlets_drawn_ = 0;
+    size_t meshlet_triangles_drawn_ = 0;
+    size_t meshlets_tested_ = 0;
+    // Static batching: the batches, the batch and member index of each merged drawable, the
+    // draw commands of the visible members and the number of batches rebuilt in the last frame
+    std::vector<std::unique_ptr<StaticBatch>> static_batches_;
+    std::unordered_map<unsigned int, std::pair<StaticBatch *, size_t>> static_batch_members_;
+    std::shared_ptr<DrawIndirectBuffer> static_batch_commands_;
+    uint64_t static_batch_frame_ = 0;
+    size_t static_batches_rebuilt_ = 0;
     // Transparency
     WeightedBlendedOITManager wboit_;
+    // Multi-draw submission
+    bool multidraw_ = false;
+    bool multidraw_supported_ = false;
+    // Whether materials that support multi-draw pack a uniform block, by material name
+    std::unordered_map<std::string, bool> multidraw_blocks_;
+    std::shared_ptr<ShaderStorageBuffer> ssbo_objects_;
+    std::shared_ptr<ShaderStorageBuffer> ssbo_materials_;
+    size_t ssbo_offset_alignment_ = 256;
+    std::shared_ptr<DrawIndirectBuffer> indirect_buffer_;
+    std::shared_ptr<ArrayBuffer> draw_id_buffer_;
 };
 
 } // namespace rcube
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "RCube/Core/Graphics/OpenGL/Texture.h"
 #include "glm/glm.hpp"
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace rcube
@@ -15,16 +18,61 @@ enum class Colormap
     Magma,
 };
 
+/**
+ * Maps a value in [vmin, vmax] to a color; values outside the range are clamped.
+ * Colormap::None maps every value to white.
+ */
 void colormap(Colormap cm, float value, float vmin, float vmax, glm::vec3 &rgb);
 
+/**
+ * Maps an array of values to colors in bulk using SIMD (AVX2 when compiled with it, SSE2
+ * otherwise) and multiple threads for large arrays
+ *
+ * @param cm Colormap enum
+ * @param values Array of values
+ * @param size Number of values
+ * @param vmin Value mapped to the first color of the colormap
+ * @param vmax Value mapped to the last color of the colormap
+ * @param rgb Output array of 3 * size floats
+ */
+void colormap(Colormap cm, const float *values, size_t size, float vmin, float vmax, float *rgb);
+
+/**
+ * Maps an array of values to colors packed as RGBA8 (red in the lowest byte, alpha is 255),
+ * e.g., for uploading as GL_RGBA/GL_UNSIGNED_BYTE data
+ *
+ * @param rgba Output array of size packed colors
+ */
+void colormap(Colormap cm, const float *values, size_t size, float vmin, float vmax,
+              uint32_t *rgba);
+
 void colormap(Colormap cm, const float *value, size_t size, float vmin, float vmax,
               std::vector<glm::vec3> &rgb);
 
-void colormap(Colormap cm, const std::vector<float> values, float vmin, float vmax,
+void colormap(Colormap cm, const std::vector<float> &values, float vmin, float vmax,
               std::vector<float> &colors);
 
 void colormap(Colormap cm, const std::vector<float> &value, float vmin, float vmax,
               std::vector<glm::vec3> &colors);
 
+/**
+ * Returns the lookup table of the colormap as a texture with a single row of RGB texels, for
+ * colormapping in shaders (see rcube::ColormapParameters). The texture is created on first use
+ * and shared afterwards, so this requires a current OpenGL context. The textures are released
+ * by releaseColormapTextures().
+ *
+ * @param cm Colormap enum
+ * @return Lookup table texture, nullptr for Colormap::None
+ */
+std::shared_ptr<Texture2D> colormapTexture(Colormap cm);
+
+/**
+ * Releases the lookup table textures created by colormapTexture(); they are created again in
+ * the current context on the next call. Must be called while the context they were created in
+ * is current, e.g., before the window is destroyed.
+ * Note: called by RCubeViewer before terminating
+ */
+void releaseColormapTextures();
+
 } // namespace viewer
 } // namespace rcube
\ No newline at end of file
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "RCube/Core/Graphics/OpenGL/Mesh.h"
+#include "RCube/Core/Graphics/PointOctree.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace rcube
+{
+namespace viewer
+{
+
+/**
+ * OctreePointcloud is a Mesh that streams a point cloud of any size from a PointOctree on disk
+ * (see buildPointOctree()). The mesh itself holds the points of the root node; every frame,
+ * update() selects the octree nodes to draw for the camera and attaches the GPU meshes of
+ * those that are loaded as children of the mesh. Missing nodes are read on a background thread
+ * in order of their size on screen and uploaded a few at a time, so the coarse levels show up
+ * at once and detail fills in as the camera settles. Nodes that are no longer drawn stay on the
+ * GPU until the point budget is exceeded, then the least recently drawn ones are freed.
+ *
+ * The mesh uses the Points primitive and should be drawn with a PointSplatMaterial.
+ */
+class OctreePointcloud : public Mesh
+{
+    struct ResidentNode
+    {
+        std::shared_ptr<Mesh> mesh;
+        uint64_t last_drawn = 0;
+    };
+    struct LoadedNode
+    {
+        uint32_t node;
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> colors;
+    };
+
+    std::shared_ptr<PointOctree> octree_;
+    // GPU meshes of the nodes other than the root
+    std::unordered_map<uint32_t, ResidentNode> resident_;
+    size_t resident_points_ = 0;
+    size_t point_budget_ = 5000000;
+    float min_node_pixels_ = 150.f;
+    size_t max_upload_points_ = 1000000;
+    size_t points_drawn_ = 0;
+    uint64_t frame_ = 0;
+
+    // Shared with the loader thread: nodes to read in priority order, the node being read, the
+    // nodes read but not uploaded yet and the nodes that could not be read
+    std::thread loader_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<uint32_t> requests_;
+    uint32_t loading_ = PointOctree::NO_NODE;
+    std::deque<LoadedNode> loaded_;
+    std::unordered_set<uint32_t> failed_;
+    bool stop_ = false;
+
+    explicit OctreePointcloud(std::shared_ptr<PointOctree> octree);
+
+    void loadNodes();
+    void uploadLoadedNodes();
+    void evictNodes();
+
+  public:
+    /**
+     * Opens a point octree written by buildPointOctree() and loads its root node. Throws
+     * std::runtime_error if the octree cannot be read.
+     *
+     * @param directory Directory of the octree
+     * @return Shared pointer to rcube::viewer::OctreePointcloud (derived from rcube::Mesh)
+     */
+    static std::shared_ptr<OctreePointcloud> create(const std::string &directory);
+
+    ~OctreePointcloud() override;
+
+    /**
+     * Selects the nodes to draw for a camera, attaches those that are loaded, queues the
+     * missing ones for loading and uploads nodes loaded since the last call.
+     * Note: called by RCubeViewer every frame
+     *
+     * @param model Object to world matrix of the mesh
+     * @param world_to_view View matrix of the camera
+     * @param view_to_projection Projection matrix of the camera
+     * @param orthographic Whether the projection is orthographic
+     * @param viewport_size Size of the viewport in pixels
+     */
+    void update(const glm::mat4 &model, const glm::mat4 &world_to_view,
+                const glm::mat4 &view_to_projection, bool orthographic,
+                const glm::ivec2 &viewport_size);
+
+    const PointOctree &octree() const
+    {
+        return *octree_;
+    }
+
+    /**
+     * Returns the maximum number of points drawn and kept on the GPU
+     *
+     * @return Point budget
+     */
+    size_t pointBudget() const;
+
+    /**
+     * Sets the maximum number of points drawn and kept on the GPU
+     *
+     * @param budget Point budget
+     */
+    void setPointBudget(size_t budget);
+
+    /**
+     * Returns the smallest size on screen, in pixels, of a drawn node
+     *
+     * @return Minimum node size in pixels
+     */
+    float minNodePixels() const;
+
+    /**
+     * Sets the smallest size on screen, in pixels, of a drawn node; smaller values draw finer
+     * levels
+     *
+     * @param pixels Minimum node size in pixels
+     */
+    void setMinNodePixels(float pixels);
+
+    /**
+     * Returns the number of points drawn in the last frame
+     *
+     * @return Number of points drawn
+     */
+    size_t numPointsDrawn() const;
+
+    /**
+     * Returns the number of nodes on the GPU, including the root
+     *
+     * @return Number of resident nodes
+     */
+    size_t numResidentNodes() const;
+
+    /**
+     * Draws the GUI for this pointcloud
+     * Note: called by RCubeViewer internally
+     */
+    virtual void drawGUI() override;
+};
+
+} // namespace viewer
+} // namespace rcube
@@ -17,8 +17,11 @@ namespace viewer
  * 
  * Pointcloud is a class that derives from Mesh and provides an API
  * to automatically create a mesh from a pointcloud (list of points).
- * It generates a mesh based on per-point glyphs (spheres or boxes)
- * and allows setting scalar and vector valued per-point attributes.
+ * The mesh is instanced: it holds a single glyph (sphere, box or quad) that is drawn once
+ * per point using per-point offsets, scales and colors, so its memory grows with the number
+ * of points and not with the complexity of the glyph. The point size is a glyph parameter
+ * (uniform) and changing it does not upload any data.
+ * It allows setting scalar and vector valued per-point attributes.
  */
 class Pointcloud : public Mesh
 {
@@ -31,18 +34,20 @@ class Pointcloud : public Mesh
     enum class PointcloudGlyph
     {
         Sphere,
-        Box
+        Box,
+        // Camera-facing quad that must be drawn with a SphereImpostorMaterial, which ray-casts
+        // a sphere per point
+        SphereImpostor
     };
 
   private:
-    size_t num_vertices_per_point_ = 0;
-    size_t num_triangles_per_point_ = 0;
     std::vector<glm::vec3> points_;
+    std::vector<float> scales_;
     float point_size_ = 0.01f;
     glm::vec3 color_ = glm::vec3(1.f, 1.f, 1.f);
     PointcloudGlyph glyph_;
-    size_t num_vector_field_vertices_ = 0;
-    size_t num_vector_field_faces_ = 0;
+    // Arrow mesh of the visible vector field, drawn as a child of the pointcloud
+    std::shared_ptr<Mesh> arrows_;
     std::unordered_map<std::string, ScalarField> scalar_fields_;
     std::string visible_scalar_field_ = "(None)";
     std::unordered_map<std::string, VectorField> vector_fields_;
@@ -52,8 +57,9 @@ class Pointcloud : public Mesh
 
     void setPointcloudColorAttribute(const std::vector<glm::vec3> &perPointColors);
     void setPointcloudColorAttribute(const glm::vec3 &perPointColor);
-    void setPointcloudArrowAttributes(const TriangleMeshData &mesh);
-    void createMesh();
+    void attachArrows();
+    void createGlyph();
+    void updateInstances();
 
   public:
     /**
@@ -69,19 +75,34 @@ class Pointcloud : public Mesh
                                               PointcloudGlyph glyph = PointcloudGlyph::Box);
 
     /**
-     * Returns the number of vertices used by the mesh to represent each point
+     * Returns the number of vertices of the glyph mesh that is instanced for each point
      *
      * @return Number of vertices in the per-point mesh
      */
     size_t verticesPerPoint() const;
 
     /**
-     * Returns the number of triangles used by the mesh to represent each point
+     * Returns the number of triangles of the glyph mesh that is instanced for each point
      *
      * @return Number of triangles in the per-point mesh
      */
     size_t trianglesPerPoint() const;
 
+    /**
+     * Returns the glyph used to render each point
+     *
+     * @return Glyph enum
+     */
+    PointcloudGlyph glyph() const;
+
+    /**
+     * Sets the glyph used to render each point.
+     * PointcloudGlyph::SphereImpostor requires a SphereImpostorMaterial.
+     *
+     * @param glyph Glyph enum
+     */
+    void setGlyph(PointcloudGlyph glyph);
+
     /**
      * Add a scalar field (list of per-point scalars) for the pointcloud
      *
@@ -197,6 +218,27 @@ class Pointcloud : public Mesh
      */
     float pointSize() const;
 
+    /**
+     * Sets the size of each rendered point in the point cloud
+     *
+     * @param point_size Size of each point
+     */
+    void setPointSize(float point_size);
+
+    /**
+     * Returns the per-point scale factors applied to the point size
+     *
+     * @return Per-point scales (empty if all points have the same size)
+     */
+    const std::vector<float> &pointScales() const;
+
+    /**
+     * Sets per-point scale factors that are applied to the point size
+     *
+     * @param scales Per-point scales, or an empty vector to draw all points with the same size
+     */
+    void setPointScales(const std::vector<float> &scales);
+
     /**
      * Returns the color of the pointcloud
      *
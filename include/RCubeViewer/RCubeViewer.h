@@ -59,6 +59,9 @@ struct RCubeViewerProps
     std::string title = "RCubeViewer";             // Title of the viewer window
     glm::ivec2 resolution = glm::ivec2(1280, 720); // Resolution of internal framebuffer and window
     int MSAA = 2; // Number of samples for multisampling (for RenderSystemType::Forward)
+    // Whether to accumulate transparent objects in RGBA16F instead of RGBA32F, halving the memory
+    // and bandwidth of the transparency pass (for RenderSystemType::Forward)
+    bool half_float_transparency = false;
     glm::vec3 background_color_top =
         glm::vec3(82.f / 255.f, 87.f / 255.f, 110.f / 255.f); // Background top color
     glm::vec3 background_color_bottom =
@@ -100,6 +103,10 @@ class RCubeViewer : public rcube::Window
 
     EntityHandle addMeshEntity(const std::string &name);
 
+    // Adds an entity drawing the point octree in directory (see buildPointOctree()) as a
+    // streamed OctreePointcloud with point splats
+    EntityHandle addOctreePointcloud(const std::string &name, const std::string &directory);
+
     EntityHandle addPointLight(const std::string name, glm::vec3 position, float radius,
                                glm::vec3 color);
 
@@ -135,6 +142,9 @@ class RCubeViewer : public rcube::Window
 
     virtual void drawGUI();
 
+    // Selects and streams the nodes of the OctreePointclouds for the camera
+    void updateOctreePointclouds();
+
     virtual void drawMainMenuBarGUI();
 
     virtual void drawEntityInspectorGUI();
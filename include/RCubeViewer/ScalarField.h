@@ -10,9 +10,27 @@ namespace rcube
 namespace viewer
 {
 
+/**
+ * Summary statistics of the finite values of a scalar field
+ */
+struct ScalarFieldStatistics
+{
+    float min = 0.f;
+    float max = 0.f;
+    double mean = 0.0;
+    double variance = 0.0;
+    // Number of finite values
+    size_t count = 0;
+};
+
 /**
  * ScalarField is a class to store a field of scalar values that can be displayed on
  * a pointcloud, surface mesh, etc.
+ * By default, the scalars are uploaded once and colormapped in the vertex shader, so that
+ * changing the data range or the colormap only updates uniforms. Colormapping on the CPU
+ * is available as a fallback with setGPUColormapping(false).
+ * Statistics and the histogram are computed in parallel in O(n) and updated incrementally
+ * when a sub-range of the data is set with setData(offset, values).
  */
 class ScalarField
 {
@@ -21,11 +39,23 @@ class ScalarField
     std::vector<glm::vec3> colors_;
     std::vector<float> data_;
     std::vector<float> histogram_;
+    std::vector<size_t> bin_counts_;
+    size_t bins_ = 10;
+    ScalarFieldStatistics stats_;
+    // Sums of the finite values and their squares, for incremental updates of the statistics
+    double sum_ = 0.0;
+    double sum_sq_ = 0.0;
+    bool stats_dirty_ = true;
     Colormap cmap_ = Colormap::Viridis;
     float vmin_ = 0.f;
     float vmax_ = 1.f;
+    bool gpu_colormap_ = true;
     bool dirty_ = true;
 
+    size_t bin(float value) const;
+    void computeHistogram();
+    void finalizeStatistics();
+
   public:
     /**
      * Returns the scalar field data
@@ -45,6 +75,14 @@ class ScalarField
      */
     void setData(const std::vector<float> &data);
 
+    /**
+     * Replaces a sub-range of the scalar field data, updating the statistics and histogram
+     * incrementally unless the data range changes
+     * @param offset Index of the first value to replace
+     * @param values New values; offset + values.size() must not exceed the size of the data
+     */
+    void setData(size_t offset, const std::vector<float> &values);
+
     /**
      * Returns the minimum data range of scalar field data
      * @return Minimum range of data
@@ -74,6 +112,46 @@ class ScalarField
      */
     void fitDataRange();
 
+    /**
+     * Sets the data range to percentiles of the scalar field data, which ignores outliers
+     * (e.g., 1 and 99)
+     * @param lower_percentile Percentile in [0, 100] for the minimum data range
+     * @param upper_percentile Percentile in [0, 100] for the maximum data range
+     */
+    void fitDataRange(float lower_percentile, float upper_percentile);
+
+    /**
+     * Returns the percentile of the finite scalar field data in O(n)
+     * @param percentile Percentile in [0, 100]
+     * @return Value below which the given percentage of the data falls
+     */
+    float percentile(float percentile) const;
+
+    /**
+     * Returns the min./max./mean/variance of the scalar field data
+     * @return Statistics of the data
+     */
+    const ScalarFieldStatistics &statistics();
+
+    /**
+     * Returns the histogram of the data over [min, max] with histogramBins() bins,
+     * normalized to sum to 1
+     * @return Histogram
+     */
+    const std::vector<float> &histogram();
+
+    /**
+     * Returns the number of bins of the histogram (default: 10)
+     * @return Number of bins
+     */
+    size_t histogramBins() const;
+
+    /**
+     * Sets the number of bins of the histogram
+     * @param Number of bins (at least 1)
+     */
+    void setHistogramBins(size_t bins);
+
     /**
      * Returns the current colormap
      * @return Colormap enum
@@ -87,18 +165,40 @@ class ScalarField
     void setCmap(Colormap cmap);
 
     /**
-     * Updates the colors of the scalar field if necessary
+     * Returns whether the scalars are colormapped in the vertex shader (default: true)
+     * @return Whether colormapping is done on the GPU
+     */
+    bool gpuColormapping() const;
+
+    /**
+     * Sets whether the scalars are colormapped in the vertex shader or on the CPU
+     * @param Whether colormapping is done on the GPU
+     */
+    void setGPUColormapping(bool flag);
+
+    /**
+     * Returns the parameters to colormap the scalars in the vertex shader; the lookup table
+     * is nullptr when colormapping on the CPU
+     * Note: called by RCubeViewer internally
+     *
+     * @return Colormap parameters for the mesh displaying the scalar field
+     */
+    ColormapParameters colormapParameters() const;
+
+    /**
+     * Updates the colors of the scalar field if necessary. With GPU colormapping, no colors are
+     * computed and only changes to the data need to be uploaded.
      * Note: called by RCubeViewer internally
      *
-     * @return Whether colors were actually updated
+     * @return Whether the data (GPU colormapping) or colors (CPU colormapping) need uploading
      */
     bool updateColors();
 
     /**
-     * Update the histogram based on the current scalar field data
+     * Recomputes the statistics and histogram from the current scalar field data
      * Note: called by RCubeViewer internally
      */
-    void updateHistogram();
+    void updateStatistics();
 };
 
 } // namespace viewer
@@ -31,10 +31,11 @@ class SurfaceMesh : public Mesh
     std::string visible_face_vector_field_ = "(None)";
     std::vector<glm::vec3> vertices_;
     std::vector<glm::uvec3> faces_;
-    std::vector<glm::vec3> vertices_display_;
     std::vector<glm::vec3> face_centers_;
-    size_t num_vertex_vector_field_vertices_ = 0;
-    size_t num_face_vector_field_vertices_ = 0;
+    // Per-face data read by the geometry shaders (see rcube::FaceDataParameters):
+    // face_values_[2 * i] holds the color and scalar of face i, face_values_[2 * i + 1].x its
+    // wireframe flag (1: normal, 2: highlighted, 3: selected)
+    std::vector<glm::vec4> face_values_;
     std::unordered_set<size_t> selected_faces_;
     size_t highlighted_primitive_;
     size_t highlighted_ = false;
@@ -48,9 +49,10 @@ class SurfaceMesh : public Mesh
     void setVertexColorAttribute(const std::vector<glm::vec3> &vertex_colors);
     void setFaceColorAttribute(const glm::vec3 &face_color);
     void setFaceColorAttribute(const std::vector<glm::vec3> &face_colors);
-    void setVertexArrowMesh(const TriangleMeshData &mesh);
-    void setFaceArrowMesh(const TriangleMeshData &mesh);
-    size_t numVerticesDisplay() const;
+    void setVertexScalarAttribute(const std::vector<float> &vertex_scalars);
+    void setFaceScalarAttribute(const std::vector<float> &face_scalars);
+    void setFaceWireFlag(size_t index, float flag);
+    void uploadFaceData();
 
   public:
     static std::shared_ptr<SurfaceMesh> create(const TriangleMeshData &data);
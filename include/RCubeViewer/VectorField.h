@@ -13,12 +13,16 @@ namespace viewer
 /**
  * VectorField is a class to store a field of vector values that can be displayed on
  * a pointcloud, surface mesh, etc.
+ * The vectors are drawn as an instanced mesh of a single arrow glyph whose per-instance data
+ * is the origin, direction, magnitude and color of each vector. The arrows are oriented and
+ * scaled in the vertex shader, so the maximum length and scaling by magnitude are glyph
+ * parameters that do not require uploading any data.
  */
 class VectorField
 {
     friend class Pointcloud;
     friend class SurfaceMesh;
-    TriangleMeshData mesh_;
+    std::shared_ptr<Mesh> mesh_;
     TriangleMeshData glyph_;
     std::vector<glm::vec3> vectors_;
     std::vector<glm::vec3> points_;
@@ -26,10 +30,18 @@ class VectorField
     bool scale_by_magnitude_ = true;
     Colormap cmap_ = Colormap::None;
     bool dirty_ = true;
+    bool dirty_glyph_ = true;
 
   public:
     VectorField();
 
+    /**
+     * Copies the vector data; the copy creates its own mesh when it is displayed
+     */
+    VectorField(const VectorField &other);
+
+    VectorField &operator=(const VectorField &other);
+
     /**
      * Returns the vector field
      * @return const-ref to the vector field
@@ -82,6 +94,21 @@ class VectorField
      */
     void setMaxLength(float val);
 
+    /**
+     * Returns whether the arrows are scaled by the magnitude of the vectors
+     * (the longest is maxLength() long) or all drawn with maxLength()
+     *
+     * @return Whether the arrows are scaled by magnitude
+     */
+    bool scaleByMagnitude() const;
+
+    /**
+     * Sets whether the arrows are scaled by the magnitude of the vectors
+     *
+     * @param Whether the arrows are scaled by magnitude
+     */
+    void setScaleByMagnitude(bool flag);
+
     /**
      * Returns the current colormap
      * @return Colormap enum
@@ -95,7 +122,9 @@ class VectorField
     void setCmap(Colormap cmap);
 
     /**
-     * Updates the arrows of the vector field if necessary
+     * Updates the per-instance data of the arrows if necessary
+     *
+     * @return Whether the arrows were updated
      */
     bool updateArrows();
 
@@ -108,11 +137,11 @@ class VectorField
     void setGlyph(const TriangleMeshData &glyph);
 
     /**
-     * Get the mesh data associated to the vector field
+     * Get the instanced arrow mesh of the vector field; nullptr until updateArrows() is called
      *
-     * @return Vector field mesh data
+     * @return Vector field mesh
      */
-    const TriangleMeshData &mesh() const;
+    std::shared_ptr<Mesh> mesh() const;
 };
 
 } // namespace viewer
@@ -1,16 +1,66 @@
 #include "RCube/Components/Drawable.h"
 #include "imgui.h"
+#include <algorithm>
 
 namespace rcube
 {
 
+void Drawable::setLODChain(const std::vector<MeshLOD> &chain)
+{
+    lods.clear();
+    lods.reserve(chain.size());
+    for (const MeshLOD &level : chain)
+    {
+        LOD lod;
+        lod.mesh = Mesh::create(level.mesh);
+        lod.mesh->uploadToGPU();
+        lod.error = level.error;
+        lods.push_back(lod);
+    }
+}
+
+size_t Drawable::selectLOD(float pixels_per_unit, size_t current) const
+{
+    const float coarsen = lod_pixel_error * (1.f - lod_hysteresis);
+    const float refine = lod_pixel_error * (1.f + lod_hysteresis);
+    auto pixels = [&](size_t level) {
+        return level == 0 ? 0.f : lods[level - 1].error * pixels_per_unit;
+    };
+    size_t level = std::min(current, lods.size());
+    while (level < lods.size() && pixels(level + 1) <= coarsen)
+    {
+        ++level;
+    }
+    while (level > 0 && pixels(level) > refine)
+    {
+        --level;
+    }
+    return level;
+}
+
 void Drawable::drawGUI()
 {
     // Visibility
     ImGui::Checkbox("Visible", &visible);
+    ImGui::Checkbox("Cast shadow", &cast_shadow);
+    ImGui::Checkbox("Static batching", &static_batch);
+
+    // Levels of detail
+    if (!lods.empty())
+    {
+        ImGui::LabelText("#LODs", "%zu", lods.size());
+        ImGui::InputFloat("LOD pixel error", &lod_pixel_error);
+    }
+
+    // Meshlets
+    if (!meshlets.empty())
+    {
+        ImGui::LabelText("#Meshlets", "%zu", meshlets.size());
+        ImGui::Checkbox("Cull back-facing meshlets", &meshlet_cone_culling);
+    }
 
     // Mesh
     mesh->drawGUI();
 }
 
-} // namespace rcube
\ No newline at end of file
+} // namespace rcube
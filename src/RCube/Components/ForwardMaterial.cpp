@@ -19,14 +19,102 @@ const std::vector<DrawCall::TextureCubemapInfo> ShaderMaterial::cubemapSlots()
 ShaderMaterial::ShaderMaterial(const std::string &name) : name_(name)
 {
 }
+ShaderMaterial::ShaderMaterial(const ShaderMaterial &other)
+    : name_(other.name_), opacity(other.opacity), next_pass(other.next_pass)
+{
+    // The copy gets its own uniform block on first use
+}
+ShaderMaterial &ShaderMaterial::operator=(const ShaderMaterial &other)
+{
+    opacity = other.opacity;
+    next_pass = other.next_pass;
+    // Force a re-upload since the parameters may have changed
+    block_dirty_ = true;
+    return *this;
+}
+ShaderMaterial::~ShaderMaterial()
+{
+    UniformBufferArena::instance().free(block_);
+}
+bool ShaderMaterial::writeUniformBlock(Std140Writer &)
+{
+    return false;
+}
+void ShaderMaterial::markUniformBlockDirty()
+{
+    block_dirty_ = true;
+}
+bool ShaderMaterial::updateUniformBlock()
+{
+    if (!block_dirty_ && opacity == block_opacity_)
+    {
+        return true;
+    }
+    Std140Writer writer(block_data_);
+    if (!writeUniformBlock(writer))
+    {
+        return false;
+    }
+    block_data_.resize(writer.size(), 0);
+    block_dirty_ = false;
+    block_uploaded_ = false;
+    block_opacity_ = opacity;
+    return true;
+}
+bool ShaderMaterial::packUniformBlock(std::vector<char> &data)
+{
+    if (!updateUniformBlock())
+    {
+        return false;
+    }
+    data = block_data_;
+    return true;
+}
+bool ShaderMaterial::bindUniformBlock()
+{
+    if (!updateUniformBlock())
+    {
+        return false;
+    }
+    UniformBufferArena &arena = UniformBufferArena::instance();
+    // Blocks of a released arena are gone
+    if (!arena.owns(block_))
+    {
+        block_ = UniformBufferArena::Block();
+    }
+    if (block_.valid() && block_.size < block_data_.size())
+    {
+        arena.free(block_);
+    }
+    if (!block_.valid())
+    {
+        block_ = arena.allocate(block_data_.size());
+        block_uploaded_ = false;
+    }
+    if (!block_uploaded_)
+    {
+        arena.write(block_, block_data_.data(), block_data_.size());
+        block_uploaded_ = true;
+    }
+    arena.bind(block_, RCUBE_MATERIAL_UNIFORM_BLOCK_BINDING);
+    return true;
+}
 void ShaderMaterial::updateUniforms(std::shared_ptr<ShaderProgram> shader)
 {
-    if (shader == nullptr)
+    if (shader == nullptr || bindUniformBlock())
     {
         return;
     }
     shader->uniform("opacity").set(std::min(1.f, std::max(opacity, 0.f)));
 }
+bool ShaderMaterial::supportsMultiDraw() const
+{
+    return false;
+}
+bool ShaderMaterial::supportsDepthPrepass() const
+{
+    return true;
+}
 void ShaderMaterial::drawGUI()
 {
     ImGui::SliderFloat("Opacity", &opacity, 0.f, 1.f);
@@ -2,6 +2,8 @@
 #include "RCube/Components/DirectionalLight.h"
 #include "glm/gtc/type_ptr.hpp"
 #include "imgui.h"
+#include <algorithm>
+#include <cmath>
 
 namespace rcube
 {
@@ -22,6 +24,22 @@ void PointLight::setRadius(float val)
     radius_ = val;
 }
 
+float PointLight::range() const
+{
+    if (range_ > 0.f)
+    {
+        return range_;
+    }
+    // intensity * color * radius^2 / range^2 = 1 / 256
+    const float brightness = intensity_ * std::max(color_.r, std::max(color_.g, color_.b));
+    return radius_ * std::sqrt(256.f * std::max(brightness, 0.f));
+}
+
+void PointLight::setRange(float val)
+{
+    range_ = val;
+}
+
 const glm::vec3 &PointLight::color() const
 {
     return color_;
@@ -56,6 +74,7 @@ void PointLight::drawGUI()
 {
     ImGui::ColorEdit3("Color", glm::value_ptr(color_));
     ImGui::InputFloat("Radius", &radius_);
+    ImGui::InputFloat("Range", &range_);
     ImGui::InputFloat("Intensity", &intensity_);
     ImGui::Checkbox("Cast shadow", &cast_shadow_);
 }
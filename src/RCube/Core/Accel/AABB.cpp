@@ -125,11 +125,16 @@ glm::vec3 AABB::extents() const
 
 AABB operator*(const glm::mat4 &mat, const AABB &box)
 {
-    glm::vec3 mn(mat * glm::vec4(box.min(), 1.0));
-    glm::vec3 mx(mat * glm::vec4(box.max(), 1.0));
     AABB transformed_box;
-    transformed_box.expandBy(mn);
-    transformed_box.expandBy(mx);
+    if (box.isNull())
+    {
+        return transformed_box;
+    }
+    // All corners are needed for rotations
+    for (const glm::vec3 &p : box.corners())
+    {
+        transformed_box.expandBy(glm::vec3(mat * glm::vec4(p, 1.0)));
+    }
     return transformed_box;
 }
 
@@ -0,0 +1,143 @@
+#include "RCube/Core/Graphics/LightClusters.h"
+#include "RCube/Helpers/WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace rcube
+{
+
+// Squared distance from a point to a box
+static float squaredDistance(const glm::vec3 &p, const glm::vec3 &min, const glm::vec3 &max)
+{
+    const glm::vec3 d = glm::max(glm::max(min - p, p - max), glm::vec3(0.f));
+    return glm::dot(d, d);
+}
+
+LightClusters buildLightClusters(const glm::mat4 &view_to_projection, float znear, float zfar,
+                                 const std::vector<glm::vec4> &lights,
+                                 const LightClusterSettings &settings, WorkerPool *pool)
+{
+    LightClusters clusters;
+    const glm::uvec3 grid = glm::max(settings.grid, glm::uvec3(1));
+    const size_t num_clusters = size_t(grid.x) * grid.y * grid.z;
+    znear = std::max(znear, 1e-6f);
+    zfar = std::max(zfar, znear * (1.f + 1e-6f));
+    const float log_ratio = std::log(zfar / znear);
+    clusters.grid = grid;
+    clusters.z_scale = float(grid.z) / log_ratio;
+    clusters.z_bias = -float(grid.z) * std::log(znear) / log_ratio;
+    clusters.ranges.assign(num_clusters, glm::uvec2(0));
+    if (lights.empty())
+    {
+        return clusters;
+    }
+
+    // Depth of the slice boundaries
+    std::vector<float> depths(grid.z + 1);
+    for (unsigned int k = 0; k <= grid.z; ++k)
+    {
+        depths[k] = znear * std::exp(log_ratio * float(k) / float(grid.z));
+    }
+    // Rays through the corners of the screen tiles, as points on the near and far planes
+    const glm::mat4 inverse_projection = glm::inverse(view_to_projection);
+    const size_t num_corners = size_t(grid.x + 1) * (grid.y + 1);
+    std::vector<glm::vec3> ray_near(num_corners);
+    std::vector<glm::vec3> ray_far(num_corners);
+    for (unsigned int j = 0; j <= grid.y; ++j)
+    {
+        for (unsigned int i = 0; i <= grid.x; ++i)
+        {
+            const glm::vec2 ndc(-1.f + 2.f * float(i) / float(grid.x),
+                                -1.f + 2.f * float(j) / float(grid.y));
+            const glm::vec4 n = inverse_projection * glm::vec4(ndc, -1.f, 1.f);
+            const glm::vec4 f = inverse_projection * glm::vec4(ndc, 1.f, 1.f);
+            ray_near[j * (grid.x + 1) + i] = glm::vec3(n) / n.w;
+            ray_far[j * (grid.x + 1) + i] = glm::vec3(f) / f.w;
+        }
+    }
+    // Point of a ray at a view depth (-z); the depth is linear along the ray
+    auto at_depth = [&](size_t corner, float depth) {
+        const glm::vec3 &pn = ray_near[corner];
+        const glm::vec3 &pf = ray_far[corner];
+        const float t = (depth + pn.z) / (pn.z - pf.z);
+        return pn + t * (pf - pn);
+    };
+
+    std::vector<std::vector<uint32_t>> lists(num_clusters);
+    auto assign = [&](size_t, size_t begin, size_t end) {
+        std::vector<uint32_t> slice_lights;
+        for (size_t z = begin; z < end; ++z)
+        {
+            // Lights overlapping the depth range of the slice
+            slice_lights.clear();
+            for (size_t l = 0; l < lights.size(); ++l)
+            {
+                const float depth = -lights[l].z;
+                if (depth + lights[l].w >= depths[z] && depth - lights[l].w <= depths[z + 1])
+                {
+                    slice_lights.push_back(uint32_t(l));
+                }
+            }
+            if (slice_lights.empty())
+            {
+                continue;
+            }
+            for (unsigned int y = 0; y < grid.y; ++y)
+            {
+                for (unsigned int x = 0; x < grid.x; ++x)
+                {
+                    glm::vec3 min(std::numeric_limits<float>::max());
+                    glm::vec3 max(-std::numeric_limits<float>::max());
+                    for (unsigned int c = 0; c < 4; ++c)
+                    {
+                        const size_t corner = (y + c / 2) * (grid.x + 1) + x + c % 2;
+                        for (size_t d = z; d <= z + 1; ++d)
+                        {
+                            const glm::vec3 p = at_depth(corner, depths[d]);
+                            min = glm::min(min, p);
+                            max = glm::max(max, p);
+                        }
+                    }
+                    std::vector<uint32_t> &list = lists[(z * grid.y + y) * grid.x + x];
+                    for (uint32_t l : slice_lights)
+                    {
+                        const float r = lights[l].w;
+                        if (squaredDistance(glm::vec3(lights[l]), min, max) <= r * r)
+                        {
+                            list.push_back(l);
+                        }
+                    }
+                }
+            }
+        }
+    };
+    if (pool != nullptr && lights.size() >= settings.min_parallel_lights)
+    {
+        pool->parallelChunks(grid.z, 1, assign);
+    }
+    else
+    {
+        assign(0, 0, grid.z);
+    }
+
+    // Concatenate the lists within the budget
+    size_t total = 0;
+    for (const std::vector<uint32_t> &list : lists)
+    {
+        total += list.size();
+    }
+    clusters.indices.reserve(std::min(total, settings.max_light_indices));
+    for (size_t c = 0; c < num_clusters; ++c)
+    {
+        const size_t room = settings.max_light_indices - clusters.indices.size();
+        const size_t count = std::min(lists[c].size(), room);
+        clusters.ranges[c] = glm::uvec2(clusters.indices.size(), count);
+        clusters.indices.insert(clusters.indices.end(), lists[c].begin(),
+                                lists[c].begin() + count);
+        clusters.dropped += lists[c].size() - count;
+    }
+    return clusters;
+}
+
+} // namespace rcube
@@ -0,0 +1,435 @@
+#include "RCube/Core/Graphics/MeshGen/MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+namespace rcube
+{
+
+// Parameters of the vertex score from Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+const static float CACHE_DECAY_POWER = 1.5f;
+const static float LAST_TRIANGLE_SCORE = 0.75f;
+const static float VALENCE_BOOST_SCALE = 2.f;
+const static float VALENCE_BOOST_POWER = 0.5f;
+
+// Simulates a FIFO cache; a vertex is a hit if it was inserted less than cache_size misses ago
+class FIFOCacheSimulator
+{
+  public:
+    FIFOCacheSimulator(size_t num_vertices, unsigned int cache_size)
+        : insert_time_(num_vertices, 0), cache_size_(cache_size), time_(cache_size + 1)
+    {
+    }
+
+    // Returns whether the vertex missed the cache
+    bool access(unsigned int v)
+    {
+        if (time_ - insert_time_[v] > cache_size_)
+        {
+            insert_time_[v] = time_++;
+            return true;
+        }
+        return false;
+    }
+
+    // Empties the cache
+    void reset()
+    {
+        time_ += cache_size_ + 1;
+    }
+
+  private:
+    std::vector<size_t> insert_time_;
+    size_t cache_size_;
+    size_t time_;
+};
+
+VertexCacheStatistics analyzeVertexCache(const std::vector<glm::uvec3> &indices,
+                                         size_t num_vertices, unsigned int cache_size)
+{
+    VertexCacheStatistics stats;
+    if (indices.empty())
+    {
+        return stats;
+    }
+    FIFOCacheSimulator cache(num_vertices, cache_size);
+    std::vector<bool> referenced(num_vertices, false);
+    size_t misses = 0;
+    size_t num_referenced = 0;
+    for (const glm::uvec3 &tri : indices)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            misses += cache.access(tri[k]) ? 1 : 0;
+            if (!referenced[tri[k]])
+            {
+                referenced[tri[k]] = true;
+                ++num_referenced;
+            }
+        }
+    }
+    stats.acmr = float(misses) / float(indices.size());
+    stats.atvr = float(misses) / float(num_referenced);
+    return stats;
+}
+
+static float vertexScore(int cache_position, unsigned int remaining, unsigned int cache_size)
+{
+    if (remaining == 0)
+    {
+        return -1.f;
+    }
+    float score = 0.f;
+    if (cache_position >= 0)
+    {
+        if (cache_position < 3)
+        {
+            // The vertices of the last triangle get a fixed score so that the next triangle
+            // does not simply reuse its most recent edge and creates long strips
+            score = LAST_TRIANGLE_SCORE;
+        }
+        else
+        {
+            const float s = 1.f - float(cache_position - 3) / float(cache_size - 3);
+            score = std::pow(s, CACHE_DECAY_POWER);
+        }
+    }
+    // Vertices with few remaining triangles are boosted to finish them off
+    score += VALENCE_BOOST_SCALE * std::pow(float(remaining), -VALENCE_BOOST_POWER);
+    return score;
+}
+
+void optimizeVertexCache(std::vector<glm::uvec3> &indices, size_t num_vertices,
+                         unsigned int cache_size)
+{
+    const size_t num_triangles = indices.size();
+    if (num_triangles == 0)
+    {
+        return;
+    }
+    cache_size = std::max(cache_size, 4u);
+
+    // Triangles adjacent to each vertex; live_[v] of them are not emitted yet and they are kept
+    // at the front of the vertex's range
+    std::vector<unsigned int> live(num_vertices, 0);
+    for (const glm::uvec3 &tri : indices)
+    {
+        ++live[tri.x];
+        ++live[tri.y];
+        ++live[tri.z];
+    }
+    std::vector<size_t> offsets(num_vertices + 1, 0);
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    std::vector<unsigned int> adjacency(offsets.back());
+    {
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < num_triangles; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                adjacency[fill[indices[t][k]]++] = unsigned(t);
+            }
+        }
+    }
+
+    std::vector<int> cache_position(num_vertices, -1);
+    std::vector<float> vertex_score(num_vertices);
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        vertex_score[v] = vertexScore(-1, live[v], cache_size);
+    }
+    std::vector<float> triangle_score(num_triangles);
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        const glm::uvec3 &tri = indices[t];
+        triangle_score[t] = vertex_score[tri.x] + vertex_score[tri.y] + vertex_score[tri.z];
+    }
+    std::vector<bool> emitted(num_triangles, false);
+
+    std::vector<glm::uvec3> result;
+    result.reserve(num_triangles);
+    std::vector<unsigned int> cache, new_cache;
+    cache.reserve(cache_size + 3);
+    new_cache.reserve(cache_size + 3);
+
+    size_t best = size_t(std::max_element(triangle_score.begin(), triangle_score.end()) -
+                         triangle_score.begin());
+    // Input order cursor used when no triangle in the cache is left (dead end)
+    size_t cursor = 0;
+    while (result.size() < num_triangles)
+    {
+        if (best == num_triangles)
+        {
+            while (emitted[cursor])
+            {
+                ++cursor;
+            }
+            best = cursor;
+        }
+        const glm::uvec3 tri = indices[best];
+        result.push_back(tri);
+        emitted[best] = true;
+
+        // Remove the triangle from the live triangles of its vertices
+        for (int k = 0; k < 3; ++k)
+        {
+            const unsigned int v = tri[k];
+            unsigned int *begin = adjacency.data() + offsets[v];
+            unsigned int *end = begin + live[v];
+            unsigned int *it = std::find(begin, end, unsigned(best));
+            std::swap(*it, *(end - 1));
+            --live[v];
+        }
+
+        // The triangle's vertices move to the front of the cache
+        new_cache.assign({tri.x, tri.y, tri.z});
+        for (unsigned int v : cache)
+        {
+            if (v != tri.x && v != tri.y && v != tri.z)
+            {
+                new_cache.push_back(v);
+            }
+        }
+        for (size_t i = cache_size; i < new_cache.size(); ++i)
+        {
+            cache_position[new_cache[i]] = -1;
+            vertex_score[new_cache[i]] = vertexScore(-1, live[new_cache[i]], cache_size);
+        }
+        if (new_cache.size() > cache_size)
+        {
+            new_cache.resize(cache_size);
+        }
+        for (size_t i = 0; i < new_cache.size(); ++i)
+        {
+            cache_position[new_cache[i]] = int(i);
+            vertex_score[new_cache[i]] = vertexScore(int(i), live[new_cache[i]], cache_size);
+        }
+        std::swap(cache, new_cache);
+
+        // Rescore the triangles of the cached vertices and pick the best of them
+        best = num_triangles;
+        float best_score = -1.f;
+        for (unsigned int v : cache)
+        {
+            for (size_t i = offsets[v]; i < offsets[v] + live[v]; ++i)
+            {
+                const unsigned int t = adjacency[i];
+                const glm::uvec3 &adj = indices[t];
+                triangle_score[t] =
+                    vertex_score[adj.x] + vertex_score[adj.y] + vertex_score[adj.z];
+                if (triangle_score[t] > best_score)
+                {
+                    best_score = triangle_score[t];
+                    best = t;
+                }
+            }
+        }
+    }
+    indices = std::move(result);
+}
+
+void optimizeOverdraw(std::vector<glm::uvec3> &indices, const std::vector<glm::vec3> &vertices,
+                      unsigned int cache_size, float threshold)
+{
+    const size_t num_triangles = indices.size();
+    if (num_triangles == 0)
+    {
+        return;
+    }
+
+    // Hard boundaries: triangles whose three vertices all miss the cache, i.e., where the
+    // cache-optimized order restarts anyway
+    std::vector<size_t> runs;
+    std::vector<unsigned int> triangle_misses(num_triangles);
+    {
+        FIFOCacheSimulator cache(vertices.size(), cache_size);
+        for (size_t t = 0; t < num_triangles; ++t)
+        {
+            unsigned int misses = 0;
+            for (int k = 0; k < 3; ++k)
+            {
+                misses += cache.access(indices[t][k]) ? 1 : 0;
+            }
+            triangle_misses[t] = misses;
+            if (misses == 3)
+            {
+                runs.push_back(t);
+            }
+        }
+    }
+    runs.push_back(num_triangles);
+
+    // Soft boundaries: split a run where the ACMR of the cluster so far, starting from an empty
+    // cache, is within threshold of the ACMR of the whole run
+    std::vector<size_t> clusters;
+    FIFOCacheSimulator cache(vertices.size(), cache_size);
+    for (size_t r = 0; r + 1 < runs.size(); ++r)
+    {
+        const size_t begin = runs[r];
+        const size_t end = runs[r + 1];
+        size_t run_misses = 0;
+        for (size_t t = begin; t < end; ++t)
+        {
+            run_misses += triangle_misses[t];
+        }
+        const float run_acmr = float(run_misses) / float(end - begin);
+        cache.reset();
+        clusters.push_back(begin);
+        size_t cluster_start = begin;
+        size_t cluster_misses = 0;
+        for (size_t t = begin; t < end; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                cluster_misses += cache.access(indices[t][k]) ? 1 : 0;
+            }
+            const float acmr = float(cluster_misses) / float(t + 1 - cluster_start);
+            if (t + 1 < end && acmr <= threshold * run_acmr)
+            {
+                clusters.push_back(t + 1);
+                cluster_start = t + 1;
+                cluster_misses = 0;
+                cache.reset();
+            }
+        }
+    }
+    clusters.push_back(num_triangles);
+
+    // Area-weighted centroid and normal of each cluster and of the mesh
+    const size_t num_clusters = clusters.size() - 1;
+    std::vector<glm::vec3> centroids(num_clusters, glm::vec3(0.f));
+    std::vector<glm::vec3> normals(num_clusters, glm::vec3(0.f));
+    glm::vec3 mesh_centroid(0.f);
+    float mesh_area = 0.f;
+    for (size_t c = 0; c < num_clusters; ++c)
+    {
+        float area = 0.f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            const glm::vec3 &a = vertices[indices[t].x];
+            const glm::vec3 &b = vertices[indices[t].y];
+            const glm::vec3 &d = vertices[indices[t].z];
+            const glm::vec3 n = glm::cross(b - a, d - a);
+            const float triangle_area = 0.5f * glm::length(n);
+            centroids[c] += triangle_area * (a + b + d) / 3.f;
+            normals[c] += n;
+            area += triangle_area;
+        }
+        mesh_centroid += centroids[c];
+        mesh_area += area;
+        centroids[c] = area > 0.f ? centroids[c] / area : vertices[indices[clusters[c]].x];
+    }
+    mesh_centroid = mesh_area > 0.f ? mesh_centroid / mesh_area : glm::vec3(0.f);
+
+    // Clusters facing away from the center are drawn first
+    std::vector<float> sort_key(num_clusters);
+    for (size_t c = 0; c < num_clusters; ++c)
+    {
+        const float length = glm::length(normals[c]);
+        sort_key[c] =
+            length > 0.f ? glm::dot(centroids[c] - mesh_centroid, normals[c] / length) : 0.f;
+    }
+    std::vector<size_t> order(num_clusters);
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(),
+                     [&sort_key](size_t a, size_t b) { return sort_key[a] > sort_key[b]; });
+    std::vector<glm::uvec3> result;
+    result.reserve(num_triangles);
+    for (size_t c : order)
+    {
+        result.insert(result.end(), indices.begin() + clusters[c],
+                      indices.begin() + clusters[c + 1]);
+    }
+    indices = std::move(result);
+}
+
+std::vector<unsigned int> optimizeVertexFetch(std::vector<glm::uvec3> &indices,
+                                              size_t num_vertices)
+{
+    const unsigned int UNASSIGNED = unsigned(-1);
+    std::vector<unsigned int> new_index(num_vertices, UNASSIGNED);
+    std::vector<unsigned int> old_index;
+    old_index.reserve(num_vertices);
+    for (glm::uvec3 &tri : indices)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            if (new_index[tri[k]] == UNASSIGNED)
+            {
+                new_index[tri[k]] = unsigned(old_index.size());
+                old_index.push_back(tri[k]);
+            }
+            tri[k] = new_index[tri[k]];
+        }
+    }
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        if (new_index[v] == UNASSIGNED)
+        {
+            old_index.push_back(unsigned(v));
+        }
+    }
+    return old_index;
+}
+
+// Reorders per-vertex data; data of other sizes (e.g., missing attributes) is left alone
+template <typename T>
+static void remapVertices(std::vector<T> &data, const std::vector<unsigned int> &old_index)
+{
+    if (data.size() != old_index.size())
+    {
+        return;
+    }
+    std::vector<T> result(data.size());
+    for (size_t i = 0; i < old_index.size(); ++i)
+    {
+        result[i] = data[old_index[i]];
+    }
+    data = std::move(result);
+}
+
+MeshOptimizerReport optimizeMesh(TriangleMeshData &mesh, const MeshOptimizerOptions &options)
+{
+    MeshOptimizerReport report;
+    const size_t num_vertices = mesh.vertices.size();
+    if (!mesh.indexed)
+    {
+        // Every triangle has vertices of its own
+        report.before.acmr = report.after.acmr = mesh.vertices.empty() ? 0.f : 3.f;
+        report.before.atvr = report.after.atvr = mesh.vertices.empty() ? 0.f : 1.f;
+        return report;
+    }
+    report.before = analyzeVertexCache(mesh.indices, num_vertices, options.cache_size);
+    optimizeVertexCache(mesh.indices, num_vertices, options.cache_size);
+    if (options.optimize_overdraw)
+    {
+        optimizeOverdraw(mesh.indices, mesh.vertices, options.cache_size,
+                         options.overdraw_threshold);
+    }
+    if (options.optimize_vertex_fetch)
+    {
+        const std::vector<unsigned int> old_index =
+            optimizeVertexFetch(mesh.indices, num_vertices);
+        remapVertices(mesh.vertices, old_index);
+        remapVertices(mesh.normals, old_index);
+        remapVertices(mesh.colors, old_index);
+        remapVertices(mesh.tangents, old_index);
+        remapVertices(mesh.texcoords, old_index);
+    }
+    report.after = analyzeVertexCache(mesh.indices, num_vertices, options.cache_size);
+    return report;
+}
+
+std::string MeshOptimizerReport::toString() const
+{
+    char buffer[128];
+    std::snprintf(buffer, sizeof(buffer), "ACMR: %.3f -> %.3f, ATVR: %.3f -> %.3f", before.acmr,
+                  after.acmr, before.atvr, after.atvr);
+    return buffer;
+}
+
+} // namespace rcube
@@ -0,0 +1,657 @@
+#include "RCube/Core/Graphics/MeshGen/MeshSimplifier.h"
+#include "RCube/Helpers/ParallelChunks.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace rcube
+{
+
+const static unsigned int NO_VERTEX = std::numeric_limits<unsigned int>::max();
+
+// Sum of the squared distances to a set of planes, each weighted by the area of the triangle it
+// was taken from. Stores the upper triangle of the symmetric 4x4 matrix sum(w * p p^T) of the
+// planes p = (n, d).
+struct Quadric
+{
+    double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+    double weight = 0;
+
+    void addPlane(const glm::dvec3 &n, double d, double w)
+    {
+        xx += w * n.x * n.x;
+        xy += w * n.x * n.y;
+        xz += w * n.x * n.z;
+        xw += w * n.x * d;
+        yy += w * n.y * n.y;
+        yz += w * n.y * n.z;
+        yw += w * n.y * d;
+        zz += w * n.z * n.z;
+        zw += w * n.z * d;
+        ww += w * d * d;
+        weight += w;
+    }
+
+    Quadric &operator+=(const Quadric &q)
+    {
+        xx += q.xx;
+        xy += q.xy;
+        xz += q.xz;
+        xw += q.xw;
+        yy += q.yy;
+        yz += q.yz;
+        yw += q.yw;
+        zz += q.zz;
+        zw += q.zw;
+        ww += q.ww;
+        weight += q.weight;
+        return *this;
+    }
+
+    // Mean squared distance of a point to the planes
+    double error(const glm::vec3 &p) const
+    {
+        if (weight <= 0)
+        {
+            return 0;
+        }
+        const double x = p.x, y = p.y, z = p.z;
+        const double e = xx * x * x + yy * y * y + zz * z * z +
+                         2 * (xy * x * y + xz * x * z + yz * y * z + xw * x + yw * y + zw * z) +
+                         ww;
+        return std::max(e, 0.0) / weight;
+    }
+};
+
+// Sum of two quadrics evaluated at a point
+static double collapseError(const Quadric &a, const Quadric &b, const glm::vec3 &p)
+{
+    Quadric q = a;
+    q += b;
+    return q.error(p);
+}
+
+struct PositionKey
+{
+    uint32_t x, y, z;
+    bool operator==(const PositionKey &other) const
+    {
+        return x == other.x && y == other.y && z == other.z;
+    }
+};
+
+struct PositionHash
+{
+    size_t operator()(const PositionKey &k) const
+    {
+        return (size_t(k.x) * 73856093) ^ (size_t(k.y) * 19349663) ^ (size_t(k.z) * 83492791);
+    }
+};
+
+static PositionKey positionKey(const glm::vec3 &p)
+{
+    PositionKey key;
+    // Adding zero turns -0 into +0
+    const glm::vec3 q = p + glm::vec3(0.f);
+    std::memcpy(&key.x, &q.x, sizeof(float));
+    std::memcpy(&key.y, &q.y, sizeof(float));
+    std::memcpy(&key.z, &q.z, sizeof(float));
+    return key;
+}
+
+// Whether two vertices have the same per-vertex attributes besides their position
+static bool sameAttributes(const TriangleMeshData &mesh, unsigned int a, unsigned int b)
+{
+    const size_t n = mesh.vertices.size();
+    auto same = [n, a, b](const auto &data) { return data.size() != n || data[a] == data[b]; };
+    return same(mesh.normals) && same(mesh.colors) && same(mesh.tangents) &&
+           same(mesh.texcoords);
+}
+
+// Vertices of a mesh grouped by position
+struct Welding
+{
+    // First vertex with the same position and attributes as each vertex
+    std::vector<unsigned int> vertex;
+    // Index of the distinct position of each vertex
+    std::vector<unsigned int> position;
+    // Whether each position has vertices with different attributes
+    std::vector<char> seam;
+};
+
+static Welding weldVertices(const TriangleMeshData &mesh)
+{
+    const size_t n = mesh.vertices.size();
+    Welding welding;
+    welding.vertex.resize(n);
+    welding.position.resize(n);
+    std::unordered_map<PositionKey, unsigned int, PositionHash> ids;
+    ids.reserve(n);
+    // Vertices of each position as a linked list
+    std::vector<unsigned int> head, tail;
+    std::vector<unsigned int> next(n, NO_VERTEX);
+    for (unsigned int v = 0; v < n; ++v)
+    {
+        const auto it = ids.emplace(positionKey(mesh.vertices[v]), unsigned(head.size()));
+        const unsigned int id = it.first->second;
+        welding.position[v] = id;
+        welding.vertex[v] = v;
+        if (it.second)
+        {
+            head.push_back(v);
+            tail.push_back(v);
+            welding.seam.push_back(0);
+            continue;
+        }
+        for (unsigned int u = head[id]; u != NO_VERTEX; u = next[u])
+        {
+            if (welding.vertex[u] == u && sameAttributes(mesh, u, v))
+            {
+                welding.vertex[v] = u;
+                break;
+            }
+        }
+        if (welding.vertex[v] == v)
+        {
+            welding.seam[id] = 1;
+        }
+        next[tail[id]] = v;
+        tail[id] = v;
+    }
+    return welding;
+}
+
+// Simplifies a set of triangles, whose vertices are numbered locally. Each vertex at an unlocked
+// position is the only vertex at that position, so collapsing the position collapses the vertex.
+class ChunkSimplifier
+{
+  public:
+    ChunkSimplifier(std::vector<glm::uvec3> triangles, std::vector<unsigned int> vertex_position,
+                    std::vector<glm::vec3> positions, std::vector<char> locked)
+        : triangles_(std::move(triangles)), vertex_position_(std::move(vertex_position)),
+          positions_(std::move(positions)), locked_(std::move(locked)),
+          quadrics_(positions_.size())
+    {
+        for (const glm::uvec3 &t : triangles_)
+        {
+            const glm::dvec3 p0(position(t[0]));
+            const glm::dvec3 e1 = glm::dvec3(position(t[1])) - p0;
+            const glm::dvec3 e2 = glm::dvec3(position(t[2])) - p0;
+            glm::dvec3 n = glm::cross(e1, e2);
+            const double length = glm::length(n);
+            if (length <= 0)
+            {
+                continue;
+            }
+            n /= length;
+            const double d = -glm::dot(n, p0);
+            for (int k = 0; k < 3; ++k)
+            {
+                quadrics_[vertex_position_[t[k]]].addPlane(n, d, 0.5 * length);
+            }
+        }
+    }
+
+    // Collapses edges in passes until the target or the error bound is reached; returns the
+    // largest squared error of a collapse
+    double run(size_t target, double max_squared_error)
+    {
+        const size_t num_vertices = vertex_position_.size();
+        std::vector<unsigned int> remap(num_vertices);
+        std::vector<char> touched(num_vertices);
+        std::vector<Collapse> collapses;
+        double error = 0;
+        while (triangles_.size() > target)
+        {
+            buildAdjacency();
+            collapses.clear();
+            for (const glm::uvec3 &t : triangles_)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    // Each interior edge is seen from both of its triangles, once per direction
+                    const unsigned int a = t[k];
+                    const unsigned int b = t[(k + 1) % 3];
+                    if (a > b)
+                    {
+                        continue;
+                    }
+                    addCollapse(collapses, a, b);
+                    addCollapse(collapses, b, a);
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(),
+                      [](const Collapse &x, const Collapse &y) { return x.error < y.error; });
+
+            std::iota(remap.begin(), remap.end(), 0u);
+            std::fill(touched.begin(), touched.end(), 0);
+            size_t remaining = triangles_.size();
+            size_t num_collapsed = 0;
+            for (const Collapse &c : collapses)
+            {
+                if (remaining <= target || c.error > max_squared_error)
+                {
+                    break;
+                }
+                // The neighbourhoods of touched vertices changed in this pass
+                if (touched[c.from] || touched[c.to] || !valid(c.from, c.to))
+                {
+                    continue;
+                }
+                remap[c.from] = c.to;
+                quadrics_[vertex_position_[c.to]] += quadrics_[vertex_position_[c.from]];
+                error = std::max(error, c.error);
+                for (unsigned int i = offsets_[c.from]; i < offsets_[c.from + 1]; ++i)
+                {
+                    const glm::uvec3 &t = triangles_[adjacency_[i]];
+                    remaining -= contains(t, vertex_position_[c.to]) ? 1 : 0;
+                    touched[t[0]] = touched[t[1]] = touched[t[2]] = 1;
+                }
+                ++num_collapsed;
+            }
+            if (num_collapsed == 0)
+            {
+                break;
+            }
+            // Remove the triangles that became degenerate
+            size_t count = 0;
+            for (const glm::uvec3 &t : triangles_)
+            {
+                const glm::uvec3 r(remap[t[0]], remap[t[1]], remap[t[2]]);
+                const unsigned int p0 = vertex_position_[r[0]];
+                const unsigned int p1 = vertex_position_[r[1]];
+                const unsigned int p2 = vertex_position_[r[2]];
+                if (p0 != p1 && p1 != p2 && p2 != p0)
+                {
+                    triangles_[count++] = r;
+                }
+            }
+            triangles_.resize(count);
+        }
+        return error;
+    }
+
+    const std::vector<glm::uvec3> &triangles() const
+    {
+        return triangles_;
+    }
+
+  private:
+    struct Collapse
+    {
+        unsigned int from, to;
+        double error;
+    };
+
+    const glm::vec3 &position(unsigned int v) const
+    {
+        return positions_[vertex_position_[v]];
+    }
+
+    bool contains(const glm::uvec3 &t, unsigned int p) const
+    {
+        return vertex_position_[t[0]] == p || vertex_position_[t[1]] == p ||
+               vertex_position_[t[2]] == p;
+    }
+
+    void addCollapse(std::vector<Collapse> &collapses, unsigned int from, unsigned int to) const
+    {
+        const unsigned int pf = vertex_position_[from];
+        const unsigned int pt = vertex_position_[to];
+        if (locked_[pf])
+        {
+            return;
+        }
+        const double error = collapseError(quadrics_[pf], quadrics_[pt], positions_[pt]);
+        collapses.push_back({from, to, error});
+    }
+
+    // Triangles around each vertex
+    void buildAdjacency()
+    {
+        offsets_.assign(vertex_position_.size() + 1, 0);
+        for (const glm::uvec3 &t : triangles_)
+        {
+            ++offsets_[t[0] + 1];
+            ++offsets_[t[1] + 1];
+            ++offsets_[t[2] + 1];
+        }
+        std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+        adjacency_.resize(offsets_.back());
+        std::vector<unsigned int> fill(offsets_.begin(), offsets_.end() - 1);
+        for (unsigned int i = 0; i < triangles_.size(); ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                adjacency_[fill[triangles_[i][k]]++] = i;
+            }
+        }
+    }
+
+    // Positions of the vertices sharing a triangle with a vertex
+    void neighbours(unsigned int v, std::vector<unsigned int> &result) const
+    {
+        result.clear();
+        for (unsigned int i = offsets_[v]; i < offsets_[v + 1]; ++i)
+        {
+            const glm::uvec3 &t = triangles_[adjacency_[i]];
+            for (int k = 0; k < 3; ++k)
+            {
+                if (t[k] != v)
+                {
+                    result.push_back(vertex_position_[t[k]]);
+                }
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+    }
+
+    // Whether collapsing from into to keeps the surface manifold and does not flip triangles
+    bool valid(unsigned int from, unsigned int to)
+    {
+        // Link condition: the edge's endpoints may only share the two vertices opposite to it
+        neighbours(from, ring_from_);
+        neighbours(to, ring_to_);
+        size_t shared = 0;
+        auto i = ring_from_.begin();
+        auto j = ring_to_.begin();
+        while (i != ring_from_.end() && j != ring_to_.end())
+        {
+            if (*i < *j)
+            {
+                ++i;
+            }
+            else if (*j < *i)
+            {
+                ++j;
+            }
+            else
+            {
+                ++shared;
+                ++i;
+                ++j;
+            }
+        }
+        if (shared > 2)
+        {
+            return false;
+        }
+        const unsigned int pt = vertex_position_[to];
+        const glm::vec3 &p = positions_[pt];
+        for (unsigned int k = offsets_[from]; k < offsets_[from + 1]; ++k)
+        {
+            const glm::uvec3 &t = triangles_[adjacency_[k]];
+            if (contains(t, pt))
+            {
+                continue;
+            }
+            glm::vec3 q[3] = {position(t[0]), position(t[1]), position(t[2])};
+            const glm::vec3 before = glm::cross(q[1] - q[0], q[2] - q[0]);
+            for (int c = 0; c < 3; ++c)
+            {
+                if (t[c] == from)
+                {
+                    q[c] = p;
+                }
+            }
+            const glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if (glm::dot(before, after) <= 0.f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<glm::uvec3> triangles_;
+    std::vector<unsigned int> vertex_position_;
+    std::vector<glm::vec3> positions_;
+    std::vector<char> locked_;
+    std::vector<Quadric> quadrics_;
+    std::vector<unsigned int> offsets_;
+    std::vector<unsigned int> adjacency_;
+    std::vector<unsigned int> ring_from_, ring_to_;
+};
+
+// Copies the referenced vertices, in the order of their first use, and renumbers the triangles
+template <typename T>
+static void copyVertices(const std::vector<T> &src, std::vector<T> &dst,
+                         const std::vector<unsigned int> &old_index, size_t num_vertices)
+{
+    if (src.size() != num_vertices)
+    {
+        return;
+    }
+    dst.resize(old_index.size());
+    for (size_t i = 0; i < old_index.size(); ++i)
+    {
+        dst[i] = src[old_index[i]];
+    }
+}
+
+MeshLOD simplifyMesh(const TriangleMeshData &mesh, size_t target_triangles, float max_error,
+                     size_t min_chunk_triangles)
+{
+    const size_t num_vertices = mesh.vertices.size();
+    const Welding welding = weldVertices(mesh);
+    const size_t num_positions = welding.seam.size();
+
+    // Welded, non-degenerate triangles
+    std::vector<glm::uvec3> triangles;
+    const size_t num_input = mesh.indexed ? mesh.indices.size() : num_vertices / 3;
+    triangles.reserve(num_input);
+    for (size_t i = 0; i < num_input; ++i)
+    {
+        const unsigned int first = static_cast<unsigned int>(3 * i);
+        const glm::uvec3 t =
+            mesh.indexed ? mesh.indices[i] : glm::uvec3(first, first + 1, first + 2);
+        const glm::uvec3 w(welding.vertex[t[0]], welding.vertex[t[1]], welding.vertex[t[2]]);
+        const unsigned int p0 = welding.position[w[0]];
+        const unsigned int p1 = welding.position[w[1]];
+        const unsigned int p2 = welding.position[w[2]];
+        if (p0 != p1 && p1 != p2 && p2 != p0)
+        {
+            triangles.push_back(w);
+        }
+    }
+
+    // Positions on seams, boundaries and non-manifold edges are locked
+    std::vector<char> locked(welding.seam);
+    std::vector<uint64_t> edges;
+    edges.reserve(3 * triangles.size());
+    for (const glm::uvec3 &t : triangles)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const uint64_t a = welding.position[t[k]];
+            const uint64_t b = welding.position[t[(k + 1) % 3]];
+            edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();)
+    {
+        size_t j = i + 1;
+        while (j < edges.size() && edges[j] == edges[i])
+        {
+            ++j;
+        }
+        if (j - i != 2)
+        {
+            locked[edges[i] >> 32] = 1;
+            locked[edges[i] & 0xffffffffu] = 1;
+        }
+        i = j;
+    }
+    std::vector<uint64_t>().swap(edges);
+
+    // Chunks of triangles along the longest axis of the bounding box; positions shared by
+    // chunks are locked so that the chunks still fit together
+    glm::vec3 min, max;
+    mesh.boundingBox(min, max);
+    const glm::vec3 extent = max - min;
+    const int axis =
+        extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    const size_t num_chunks = numParallelChunks(triangles.size(), min_chunk_triangles);
+    if (num_chunks > 1)
+    {
+        auto key = [&](const glm::uvec3 &t) {
+            return mesh.vertices[t[0]][axis] + mesh.vertices[t[1]][axis] +
+                   mesh.vertices[t[2]][axis];
+        };
+        std::sort(triangles.begin(), triangles.end(),
+                  [&key](const glm::uvec3 &a, const glm::uvec3 &b) { return key(a) < key(b); });
+    }
+    const size_t chunk_size = (triangles.size() + num_chunks - 1) / num_chunks;
+    if (num_chunks > 1)
+    {
+        std::vector<unsigned int> chunk_of(num_positions, NO_VERTEX);
+        for (size_t i = 0; i < triangles.size(); ++i)
+        {
+            const unsigned int chunk = static_cast<unsigned int>(i / chunk_size);
+            for (int k = 0; k < 3; ++k)
+            {
+                const unsigned int p = welding.position[triangles[i][k]];
+                if (chunk_of[p] == NO_VERTEX)
+                {
+                    chunk_of[p] = chunk;
+                }
+                else if (chunk_of[p] != chunk)
+                {
+                    locked[p] = 1;
+                }
+            }
+        }
+    }
+
+    // Simplify the chunks in parallel, each towards its share of the target
+    std::vector<std::vector<glm::uvec3>> results(num_chunks);
+    std::vector<double> errors(num_chunks, 0.0);
+    const double max_squared_error = double(max_error) * double(max_error);
+    const double ratio = triangles.empty() ? 1.0 : double(target_triangles) / triangles.size();
+    parallelChunks(num_chunks, 1, [&](size_t, size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c)
+        {
+            const size_t first = std::min(c * chunk_size, triangles.size());
+            const size_t last = std::min(first + chunk_size, triangles.size());
+            // Local numbering of the vertices and positions of the chunk
+            std::vector<unsigned int> vertices;
+            vertices.reserve(3 * (last - first));
+            for (size_t i = first; i < last; ++i)
+            {
+                const glm::uvec3 &t = triangles[i];
+                vertices.insert(vertices.end(), {t[0], t[1], t[2]});
+            }
+            std::sort(vertices.begin(), vertices.end());
+            vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+            std::vector<unsigned int> positions(vertices.size());
+            for (size_t v = 0; v < vertices.size(); ++v)
+            {
+                positions[v] = welding.position[vertices[v]];
+            }
+            std::vector<unsigned int> unique_positions(positions);
+            std::sort(unique_positions.begin(), unique_positions.end());
+            unique_positions.erase(std::unique(unique_positions.begin(), unique_positions.end()),
+                                   unique_positions.end());
+            auto local = [](const std::vector<unsigned int> &ids, unsigned int id) {
+                return static_cast<unsigned int>(
+                    std::lower_bound(ids.begin(), ids.end(), id) - ids.begin());
+            };
+            std::vector<unsigned int> vertex_position(vertices.size());
+            for (size_t v = 0; v < vertices.size(); ++v)
+            {
+                vertex_position[v] = local(unique_positions, positions[v]);
+            }
+            std::vector<glm::vec3> points(unique_positions.size());
+            std::vector<char> chunk_locked(unique_positions.size());
+            for (size_t v = 0; v < vertices.size(); ++v)
+            {
+                points[vertex_position[v]] = mesh.vertices[vertices[v]];
+                chunk_locked[vertex_position[v]] = locked[positions[v]];
+            }
+            std::vector<glm::uvec3> chunk_triangles(last - first);
+            for (size_t i = first; i < last; ++i)
+            {
+                const glm::uvec3 &t = triangles[i];
+                chunk_triangles[i - first] = glm::uvec3(
+                    local(vertices, t[0]), local(vertices, t[1]), local(vertices, t[2]));
+            }
+
+            ChunkSimplifier simplifier(std::move(chunk_triangles), std::move(vertex_position),
+                                       std::move(points), std::move(chunk_locked));
+            const size_t target = static_cast<size_t>(std::ceil(ratio * double(last - first)));
+            errors[c] = simplifier.run(target, max_squared_error);
+            results[c].reserve(simplifier.triangles().size());
+            for (const glm::uvec3 &t : simplifier.triangles())
+            {
+                results[c].push_back(glm::uvec3(vertices[t[0]], vertices[t[1]], vertices[t[2]]));
+            }
+        }
+    });
+
+    // Keep the referenced vertices, numbered in the order of their first use
+    MeshLOD lod;
+    lod.error = float(std::sqrt(*std::max_element(errors.begin(), errors.end())));
+    lod.mesh.indexed = true;
+    std::vector<unsigned int> new_index(num_vertices, NO_VERTEX);
+    std::vector<unsigned int> old_index;
+    for (const std::vector<glm::uvec3> &result : results)
+    {
+        for (glm::uvec3 t : result)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                if (new_index[t[k]] == NO_VERTEX)
+                {
+                    new_index[t[k]] = static_cast<unsigned int>(old_index.size());
+                    old_index.push_back(t[k]);
+                }
+                t[k] = new_index[t[k]];
+            }
+            lod.mesh.indices.push_back(t);
+        }
+    }
+    copyVertices(mesh.vertices, lod.mesh.vertices, old_index, num_vertices);
+    copyVertices(mesh.normals, lod.mesh.normals, old_index, num_vertices);
+    copyVertices(mesh.colors, lod.mesh.colors, old_index, num_vertices);
+    copyVertices(mesh.tangents, lod.mesh.tangents, old_index, num_vertices);
+    copyVertices(mesh.texcoords, lod.mesh.texcoords, old_index, num_vertices);
+    return lod;
+}
+
+std::vector<MeshLOD> generateLODChain(const TriangleMeshData &mesh, const LODChainOptions &options)
+{
+    std::vector<MeshLOD> chain;
+    chain.reserve(options.max_levels);
+    size_t num_triangles = mesh.indexed ? mesh.indices.size() : mesh.vertices.size() / 3;
+    float error = 0.f;
+    while (chain.size() < options.max_levels)
+    {
+        const size_t target = static_cast<size_t>(float(num_triangles) * options.reduction);
+        if (target < options.min_triangles)
+        {
+            break;
+        }
+        const TriangleMeshData &source = chain.empty() ? mesh : chain.back().mesh;
+        MeshLOD lod =
+            simplifyMesh(source, target, std::numeric_limits<float>::max(),
+                         options.min_chunk_triangles);
+        // Stalled: less than half of the requested reduction was achieved
+        const size_t achieved = lod.mesh.indices.size();
+        if (2 * achieved > num_triangles + target)
+        {
+            break;
+        }
+        error += lod.error;
+        lod.error = error;
+        num_triangles = achieved;
+        chain.push_back(std::move(lod));
+    }
+    return chain;
+}
+
+} // namespace rcube
@@ -0,0 +1,320 @@
+#include "RCube/Core/Graphics/MeshGen/Meshlets.h"
+#include "RCube/Helpers/ParallelChunks.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace rcube
+{
+
+// Below this many meshlets per thread, culling runs on fewer threads
+constexpr size_t MIN_MESHLETS_PER_THREAD = 4096;
+
+const static uint32_t NO_VERTEX = std::numeric_limits<uint32_t>::max();
+
+// Set of the vertices of the meshlet being built: an open addressing hash table that is
+// cleared in time proportional to the number of vertices it holds
+class MeshletVertexSet
+{
+  public:
+    explicit MeshletVertexSet(size_t capacity)
+    {
+        size_t num_slots = 1;
+        while (num_slots < 2 * capacity)
+        {
+            num_slots *= 2;
+        }
+        slots_.assign(num_slots, NO_VERTEX);
+        used_.reserve(capacity);
+    }
+
+    bool contains(uint32_t v) const
+    {
+        return slots_[find(v)] == v;
+    }
+
+    void insert(uint32_t v)
+    {
+        const size_t slot = find(v);
+        if (slots_[slot] != v)
+        {
+            slots_[slot] = v;
+            used_.push_back(slot);
+        }
+    }
+
+    size_t size() const
+    {
+        return used_.size();
+    }
+
+    void clear()
+    {
+        for (size_t slot : used_)
+        {
+            slots_[slot] = NO_VERTEX;
+        }
+        used_.clear();
+    }
+
+  private:
+    size_t find(uint32_t v) const
+    {
+        const size_t mask = slots_.size() - 1;
+        size_t slot = (size_t(v) * 2654435761u) & mask;
+        while (slots_[slot] != NO_VERTEX && slots_[slot] != v)
+        {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    std::vector<uint32_t> slots_;
+    std::vector<size_t> used_;
+};
+
+static glm::uvec3 triangle(const TriangleMeshData &mesh, size_t i)
+{
+    if (mesh.indexed)
+    {
+        return mesh.indices[i];
+    }
+    const unsigned int first = static_cast<unsigned int>(3 * i);
+    return glm::uvec3(first, first + 1, first + 2);
+}
+
+// Computes the bounding sphere and normal cone of the triangles of a meshlet
+static void computeBounds(const TriangleMeshData &mesh, Meshlet &meshlet)
+{
+    const size_t begin = meshlet.first_triangle;
+    const size_t end = begin + meshlet.num_triangles;
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(-std::numeric_limits<float>::max());
+    glm::vec3 axis(0.f);
+    for (size_t i = begin; i < end; ++i)
+    {
+        const glm::uvec3 t = triangle(mesh, i);
+        const glm::vec3 &p0 = mesh.vertices[t[0]];
+        const glm::vec3 &p1 = mesh.vertices[t[1]];
+        const glm::vec3 &p2 = mesh.vertices[t[2]];
+        min = glm::min(min, glm::min(p0, glm::min(p1, p2)));
+        max = glm::max(max, glm::max(p0, glm::max(p1, p2)));
+        const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        const float length = glm::length(n);
+        if (length > 0.f)
+        {
+            axis += n / length;
+        }
+    }
+    meshlet.center = 0.5f * (min + max);
+    meshlet.radius = 0.f;
+    for (size_t i = begin; i < end; ++i)
+    {
+        const glm::uvec3 t = triangle(mesh, i);
+        for (int k = 0; k < 3; ++k)
+        {
+            meshlet.radius =
+                std::max(meshlet.radius, glm::length(mesh.vertices[t[k]] - meshlet.center));
+        }
+    }
+
+    // The cone's half angle is the largest angle between the axis and a triangle normal
+    const float axis_length = glm::length(axis);
+    if (axis_length <= 0.f)
+    {
+        meshlet.cone_axis = glm::vec3(0.f, 0.f, 1.f);
+        meshlet.cone_cutoff = 1.f;
+        return;
+    }
+    meshlet.cone_axis = axis / axis_length;
+    float min_dot = 1.f;
+    for (size_t i = begin; i < end; ++i)
+    {
+        const glm::uvec3 t = triangle(mesh, i);
+        const glm::vec3 &p0 = mesh.vertices[t[0]];
+        const glm::vec3 n = glm::cross(mesh.vertices[t[1]] - p0, mesh.vertices[t[2]] - p0);
+        const float length = glm::length(n);
+        if (length > 0.f)
+        {
+            min_dot = std::min(min_dot, glm::dot(meshlet.cone_axis, n / length));
+        }
+    }
+    // Cones wider than about 84 degrees can hardly ever be culled
+    meshlet.cone_cutoff = min_dot <= 0.1f ? 1.f : std::sqrt(1.f - min_dot * min_dot);
+}
+
+// Builds the meshlets of a range of triangles by adding triangles in order until a budget is
+// exceeded
+static void buildMeshlets(const TriangleMeshData &mesh, size_t begin, size_t end,
+                          size_t max_vertices, size_t max_triangles, std::vector<Meshlet> &result)
+{
+    MeshletVertexSet vertices(max_vertices);
+    Meshlet meshlet;
+    meshlet.first_triangle = static_cast<uint32_t>(begin);
+    for (size_t i = begin; i < end; ++i)
+    {
+        const glm::uvec3 t = triangle(mesh, i);
+        size_t added = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            const bool repeated = (k > 0 && t[k] == t[0]) || (k > 1 && t[k] == t[1]);
+            added += !repeated && !vertices.contains(t[k]) ? 1 : 0;
+        }
+        if (meshlet.num_triangles == max_triangles || vertices.size() + added > max_vertices)
+        {
+            computeBounds(mesh, meshlet);
+            result.push_back(meshlet);
+            meshlet = Meshlet();
+            meshlet.first_triangle = static_cast<uint32_t>(i);
+            vertices.clear();
+        }
+        vertices.insert(t[0]);
+        vertices.insert(t[1]);
+        vertices.insert(t[2]);
+        ++meshlet.num_triangles;
+    }
+    if (meshlet.num_triangles > 0)
+    {
+        computeBounds(mesh, meshlet);
+        result.push_back(meshlet);
+    }
+}
+
+std::vector<Meshlet> buildMeshlets(const TriangleMeshData &mesh, const MeshletOptions &options)
+{
+    const size_t num_triangles = mesh.indexed ? mesh.indices.size() : mesh.vertices.size() / 3;
+    const size_t max_vertices = std::min<size_t>(std::max<size_t>(options.max_vertices, 3), 255);
+    const size_t max_triangles = std::max<size_t>(options.max_triangles, 1);
+    // Meshlets do not span chunks
+    const size_t num_chunks = numParallelChunks(num_triangles, options.min_chunk_triangles);
+    std::vector<std::vector<Meshlet>> results(num_chunks);
+    parallelChunks(num_triangles, options.min_chunk_triangles,
+                   [&](size_t chunk, size_t begin, size_t end) {
+                       buildMeshlets(mesh, begin, end, max_vertices, max_triangles,
+                                     results[chunk]);
+                   });
+
+    std::vector<Meshlet> meshlets;
+    size_t total = 0;
+    for (const std::vector<Meshlet> &result : results)
+    {
+        total += result.size();
+    }
+    meshlets.reserve(total);
+    for (const std::vector<Meshlet> &result : results)
+    {
+        meshlets.insert(meshlets.end(), result.begin(), result.end());
+    }
+    return meshlets;
+}
+
+// Whether the screen rectangle of a sphere may be in front of the depth pyramid
+static bool inFrontOfDepth(const Meshlet &meshlet, const MeshletCullingView &view)
+{
+    glm::vec3 ndc_min(std::numeric_limits<float>::max());
+    glm::vec3 ndc_max(-std::numeric_limits<float>::max());
+    for (int c = 0; c < 8; ++c)
+    {
+        const glm::vec3 offset((c & 1) ? 1.f : -1.f, (c & 2) ? 1.f : -1.f, (c & 4) ? 1.f : -1.f);
+        const glm::vec4 q =
+            view.object_to_clip * glm::vec4(meshlet.center + meshlet.radius * offset, 1.f);
+        // Spheres reaching behind the camera are kept
+        if (q.w <= 1e-6f)
+        {
+            return true;
+        }
+        ndc_min = glm::min(ndc_min, glm::vec3(q) / q.w);
+        ndc_max = glm::max(ndc_max, glm::vec3(q) / q.w);
+    }
+    const glm::vec2 uv_min = glm::clamp(glm::vec2(ndc_min) * 0.5f + 0.5f, 0.f, 1.f);
+    const glm::vec2 uv_max = glm::clamp(glm::vec2(ndc_max) * 0.5f + 0.5f, 0.f, 1.f);
+    const glm::vec2 viewport(view.viewport);
+    const glm::ivec2 last = view.depth_size - 1;
+    const glm::ivec2 p0 = glm::min(glm::ivec2(uv_min * viewport) >> view.depth_shift, last);
+    const glm::ivec2 p1 = glm::min(glm::ivec2(uv_max * viewport) >> view.depth_shift, last);
+    float farthest = 0.f;
+    for (int y = p0.y; y <= p1.y; ++y)
+    {
+        for (int x = p0.x; x <= p1.x; ++x)
+        {
+            farthest = std::max(farthest, view.depth[size_t(y) * view.depth_size.x + x]);
+        }
+    }
+    return ndc_min.z * 0.5f + 0.5f <= farthest;
+}
+
+void cullMeshlets(const std::vector<Meshlet> &meshlets, const MeshletCullingView &view,
+                  std::vector<uint32_t> &visible)
+{
+    // Frustum planes in object space (Gribb and Hartmann), normalized so that they give
+    // distances
+    const glm::mat4 &m = view.object_to_clip;
+    std::array<glm::vec4, 4> rows;
+    for (int i = 0; i < 4; ++i)
+    {
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    }
+    std::array<glm::vec4, 6> planes = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+                                       rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2]};
+    for (glm::vec4 &plane : planes)
+    {
+        const float length = glm::length(glm::vec3(plane));
+        if (length > 0.f)
+        {
+            plane /= length;
+        }
+    }
+    const glm::vec3 eye(view.eye);
+    const bool orthographic = view.eye.w == 0.f;
+
+    auto is_visible = [&](const Meshlet &meshlet) {
+        for (const glm::vec4 &plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius)
+            {
+                return false;
+            }
+        }
+        if (view.cull_backfacing && meshlet.cone_cutoff < 1.f)
+        {
+            if (orthographic)
+            {
+                if (glm::dot(eye, meshlet.cone_axis) >= meshlet.cone_cutoff)
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                const glm::vec3 d = meshlet.center - eye;
+                if (glm::dot(d, meshlet.cone_axis) >=
+                    meshlet.cone_cutoff * glm::length(d) + meshlet.radius)
+                {
+                    return false;
+                }
+            }
+        }
+        return view.depth == nullptr || inFrontOfDepth(meshlet, view);
+    };
+
+    const size_t num_chunks = numParallelChunks(meshlets.size(), MIN_MESHLETS_PER_THREAD);
+    std::vector<std::vector<uint32_t>> results(num_chunks);
+    parallelChunks(meshlets.size(), MIN_MESHLETS_PER_THREAD,
+                   [&](size_t chunk, size_t begin, size_t end) {
+                       for (size_t i = begin; i < end; ++i)
+                       {
+                           if (is_visible(meshlets[i]))
+                           {
+                               results[chunk].push_back(static_cast<uint32_t>(i));
+                           }
+                       }
+                   });
+    visible.clear();
+    for (const std::vector<uint32_t> &result : results)
+    {
+        visible.insert(visible.end(), result.begin(), result.end());
+    }
+}
+
+} // namespace rcube
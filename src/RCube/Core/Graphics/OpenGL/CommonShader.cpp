@@ -12,17 +12,26 @@ std::shared_ptr<ShaderProgram> skyboxShader()
 
 std::shared_ptr<ShaderProgram> shadowMapShader()
 {
-    return ShaderProgram::create(SHADOWMAP_VERTEX_SHADER, SHADOWMAP_FRAGMENT_SHADER, true);
+    return ShaderProgram::create(
+        std::vector<std::string>{"#version 450\n", INSTANCING_VERTEX_SHADER_CHUNK,
+                                 SHADOWMAP_VERTEX_SHADER},
+        std::vector<std::string>{SHADOWMAP_FRAGMENT_SHADER}, true);
 }
 
 std::shared_ptr<ShaderProgram> uniqueColorShader()
 {
-    return ShaderProgram::create(UNIQUECOLOR_VERTEX_SHADER, UNIQUECOLOR_FRAGMENT_SHADER, true);
+    return ShaderProgram::create(
+        std::vector<std::string>{"#version 450\n", INSTANCING_VERTEX_SHADER_CHUNK,
+                                 UNIQUECOLOR_VERTEX_SHADER},
+        std::vector<std::string>{UNIQUECOLOR_FRAGMENT_SHADER}, true);
 }
 
 std::shared_ptr<ShaderProgram> depthShader()
 {
-    return ShaderProgram::create(DEPTH_VERTEX_SHADER, DEPTH_FRAGMENT_SHADER, true);
+    return ShaderProgram::create(
+        std::vector<std::string>{"#version 450\n", INSTANCING_VERTEX_SHADER_CHUNK,
+                                 DEPTH_VERTEX_SHADER},
+        std::vector<std::string>{DEPTH_FRAGMENT_SHADER}, true);
 }
 
 std::shared_ptr<ShaderProgram> fullScreenQuadShader(const std::string &fragment_shader)
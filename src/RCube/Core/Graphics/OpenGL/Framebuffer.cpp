@@ -189,6 +189,11 @@ bool Framebuffer::hasDepthStencilAttachment() const
     return depth_stencil_ != nullptr;
 }
 
+std::shared_ptr<Texture2D> Framebuffer::depthStencilAttachment()
+{
+    return depth_stencil_;
+}
+
 std::shared_ptr<Texture2D> Framebuffer::colorAttachment(size_t i)
 {
     if (i >= colors_.size() + 1)
@@ -0,0 +1,427 @@
+#include "RCube/Core/Graphics/OpenGL/GeometryArena.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace rcube
+{
+
+// Minimum number of vertices and indices an arena grows to, to avoid many small reallocations
+const static size_t MIN_ARENA_CAPACITY = 65536;
+
+////////////////////////////////////////////////////////////////////////////////
+// RangeAllocator
+
+size_t RangeAllocator::allocate(size_t size)
+{
+    // First fit
+    auto it = std::find_if(free_ranges_.begin(), free_ranges_.end(),
+                           [size](const auto &r) { return r.second >= size; });
+    if (it == free_ranges_.end())
+    {
+        return INVALID;
+    }
+    const size_t offset = it->first;
+    const size_t remaining = it->second - size;
+    free_ranges_.erase(it);
+    if (remaining > 0)
+    {
+        free_ranges_[offset + size] = remaining;
+    }
+    used_ += size;
+    return offset;
+}
+
+void RangeAllocator::free(size_t offset, size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    used_ -= size;
+    auto next = free_ranges_.lower_bound(offset);
+    // Merge with the following free range
+    if (next != free_ranges_.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = free_ranges_.erase(next);
+    }
+    // Merge with the preceding free range
+    if (next != free_ranges_.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            prev->second += size;
+            return;
+        }
+    }
+    free_ranges_[offset] = size;
+}
+
+void RangeAllocator::grow(size_t capacity)
+{
+    if (capacity <= capacity_)
+    {
+        return;
+    }
+    const size_t old_capacity = capacity_;
+    capacity_ = capacity;
+    // The added range is free; free() merges it with a trailing free range
+    used_ += capacity - old_capacity;
+    free(old_capacity, capacity - old_capacity);
+}
+
+void RangeAllocator::reset(size_t capacity, size_t used)
+{
+    free_ranges_.clear();
+    capacity_ = capacity;
+    used_ = used;
+    if (capacity > used)
+    {
+        free_ranges_[used] = capacity - used;
+    }
+}
+
+size_t RangeAllocator::capacity() const
+{
+    return capacity_;
+}
+
+size_t RangeAllocator::used() const
+{
+    return used_;
+}
+
+size_t RangeAllocator::largestFreeRange() const
+{
+    size_t largest = 0;
+    for (const auto &r : free_ranges_)
+    {
+        largest = std::max(largest, r.second);
+    }
+    return largest;
+}
+
+size_t RangeAllocator::numFreeRanges() const
+{
+    return free_ranges_.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// GeometryArena
+
+static std::map<GeometryArena::Layout, std::shared_ptr<GeometryArena>> &arenaRegistry()
+{
+    static std::map<GeometryArena::Layout, std::shared_ptr<GeometryArena>> registry;
+    return registry;
+}
+
+GeometryArena &GeometryArena::forLayout(const Layout &layout)
+{
+    auto &registry = arenaRegistry();
+    auto it = registry.find(layout);
+    if (it == registry.end())
+    {
+        it = registry.emplace(layout, std::shared_ptr<GeometryArena>(new GeometryArena(layout)))
+                 .first;
+    }
+    return *it->second;
+}
+
+std::vector<GeometryArena *> GeometryArena::arenas()
+{
+    std::vector<GeometryArena *> result;
+    for (auto &kv : arenaRegistry())
+    {
+        result.push_back(kv.second.get());
+    }
+    return result;
+}
+
+void GeometryArena::releaseAll()
+{
+    arenaRegistry().clear();
+}
+
+GeometryArena::GeometryArena(const Layout &layout) : layout_(layout)
+{
+    glCreateVertexArrays(1, &vao_);
+    for (const Attribute &attr : layout_)
+    {
+        // Each attribute reads from the binding index equal to its location
+        glVertexArrayAttribFormat(vao_, attr.location, GLint(attr.dim), GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribBinding(vao_, attr.location, attr.location);
+        glEnableVertexArrayAttrib(vao_, attr.location);
+    }
+    vertex_buffers_.resize(layout_.size());
+}
+
+GeometryArena::~GeometryArena()
+{
+    if (vao_ != 0)
+    {
+        glDeleteVertexArrays(1, &vao_);
+    }
+}
+
+void GeometryArena::bindBuffers()
+{
+    for (size_t i = 0; i < layout_.size(); ++i)
+    {
+        if (vertex_buffers_[i] != nullptr)
+        {
+            glVertexArrayVertexBuffer(vao_, layout_[i].location, vertex_buffers_[i]->id(), 0,
+                                      GLsizei(layout_[i].dim * sizeof(float)));
+        }
+    }
+    if (index_buffer_ != nullptr)
+    {
+        glVertexArrayElementBuffer(vao_, index_buffer_->id());
+    }
+}
+
+void GeometryArena::growVertices(size_t min_capacity)
+{
+    size_t capacity = std::max(vertex_ranges_.capacity() * 2, MIN_ARENA_CAPACITY);
+    while (capacity < min_capacity)
+    {
+        capacity *= 2;
+    }
+    for (size_t i = 0; i < layout_.size(); ++i)
+    {
+        const size_t stride = layout_[i].dim * sizeof(float);
+        auto buffer = ArrayBuffer::create(capacity * stride, GL_DYNAMIC_DRAW);
+        if (vertex_buffers_[i] != nullptr && vertex_ranges_.capacity() > 0)
+        {
+            glCopyNamedBufferSubData(vertex_buffers_[i]->id(), buffer->id(), 0, 0,
+                                     vertex_ranges_.capacity() * stride);
+        }
+        vertex_buffers_[i] = buffer;
+    }
+    vertex_ranges_.grow(capacity);
+    bindBuffers();
+}
+
+void GeometryArena::growIndices(size_t min_capacity)
+{
+    size_t capacity = std::max(index_ranges_.capacity() * 2, MIN_ARENA_CAPACITY);
+    while (capacity < min_capacity)
+    {
+        capacity *= 2;
+    }
+    auto buffer = ElementArrayBuffer::create(capacity * sizeof(unsigned int), GL_DYNAMIC_DRAW);
+    if (index_buffer_ != nullptr && index_ranges_.capacity() > 0)
+    {
+        glCopyNamedBufferSubData(index_buffer_->id(), buffer->id(), 0, 0,
+                                 index_ranges_.capacity() * sizeof(unsigned int));
+    }
+    index_buffer_ = buffer;
+    index_ranges_.grow(capacity);
+    bindBuffers();
+}
+
+std::shared_ptr<GeometryArena::Allocation> GeometryArena::allocate(size_t num_vertices,
+                                                                   size_t num_indices)
+{
+    auto *allocation = new Allocation();
+    allocation->num_vertices = num_vertices;
+    allocation->num_indices = num_indices;
+    if (num_vertices > 0)
+    {
+        allocation->first_vertex = vertex_ranges_.allocate(num_vertices);
+        if (allocation->first_vertex == RangeAllocator::INVALID)
+        {
+            // Growing by num_vertices guarantees a free range of that size at the end
+            growVertices(vertex_ranges_.capacity() + num_vertices);
+            allocation->first_vertex = vertex_ranges_.allocate(num_vertices);
+        }
+    }
+    if (num_indices > 0)
+    {
+        allocation->first_index = index_ranges_.allocate(num_indices);
+        if (allocation->first_index == RangeAllocator::INVALID)
+        {
+            growIndices(index_ranges_.capacity() + num_indices);
+            allocation->first_index = index_ranges_.allocate(num_indices);
+        }
+    }
+    allocations_.insert(allocation);
+    // The arena may be destroyed by releaseAll() before the allocation
+    std::weak_ptr<GeometryArena> arena = weak_from_this();
+    return std::shared_ptr<Allocation>(allocation, [arena](Allocation *a) {
+        if (auto owner = arena.lock())
+        {
+            owner->free(a);
+        }
+        else
+        {
+            delete a;
+        }
+    });
+}
+
+void GeometryArena::free(Allocation *allocation)
+{
+    vertex_ranges_.free(allocation->first_vertex, allocation->num_vertices);
+    index_ranges_.free(allocation->first_index, allocation->num_indices);
+    allocations_.erase(allocation);
+    delete allocation;
+}
+
+size_t GeometryArena::attributeIndex(GLuint location) const
+{
+    auto it = std::find_if(layout_.begin(), layout_.end(),
+                           [location](const Attribute &attr) { return attr.location == location; });
+    if (it == layout_.end())
+    {
+        throw std::runtime_error("Attribute location " + std::to_string(location) +
+                                 " is not part of the geometry arena's layout");
+    }
+    return size_t(std::distance(layout_.begin(), it));
+}
+
+void GeometryArena::writeVertices(const Allocation &allocation, GLuint location,
+                                  const float *data, size_t offset, size_t count)
+{
+    const size_t i = attributeIndex(location);
+    const size_t dim = layout_[i].dim;
+    assert(offset + count <= allocation.num_vertices * dim);
+    if (count > 0)
+    {
+        vertex_buffers_[i]->setData(data, count,
+                                    (allocation.first_vertex * dim + offset) * sizeof(float));
+    }
+}
+
+void GeometryArena::readVertices(const Allocation &allocation, GLuint location, float *data,
+                                 size_t offset, size_t count) const
+{
+    const size_t i = attributeIndex(location);
+    const size_t dim = layout_[i].dim;
+    assert(offset + count <= allocation.num_vertices * dim);
+    if (count > 0)
+    {
+        vertex_buffers_[i]->getData(data, count * sizeof(float),
+                                    (allocation.first_vertex * dim + offset) * sizeof(float));
+    }
+}
+
+void GeometryArena::writeIndices(const Allocation &allocation, const unsigned int *data,
+                                 size_t offset, size_t count)
+{
+    assert(offset + count <= allocation.num_indices);
+    if (count > 0)
+    {
+        index_buffer_->setData(data, count * sizeof(unsigned int),
+                               (allocation.first_index + offset) * sizeof(unsigned int));
+    }
+}
+
+void GeometryArena::readIndices(const Allocation &allocation, unsigned int *data, size_t offset,
+                                size_t count) const
+{
+    assert(offset + count <= allocation.num_indices);
+    if (count > 0)
+    {
+        index_buffer_->getData(data, count * sizeof(unsigned int),
+                               (allocation.first_index + offset) * sizeof(unsigned int));
+    }
+}
+
+void GeometryArena::defragment()
+{
+    std::vector<Allocation *> sorted(allocations_.begin(), allocations_.end());
+    // Vertices: copy each allocation to the end of the previous one in new buffers
+    std::sort(sorted.begin(), sorted.end(), [](const Allocation *a, const Allocation *b) {
+        return a->first_vertex < b->first_vertex;
+    });
+    if (vertex_ranges_.capacity() > 0)
+    {
+        for (size_t i = 0; i < layout_.size(); ++i)
+        {
+            const size_t stride = layout_[i].dim * sizeof(float);
+            auto buffer = ArrayBuffer::create(vertex_ranges_.capacity() * stride, GL_DYNAMIC_DRAW);
+            size_t next = 0;
+            for (const Allocation *a : sorted)
+            {
+                if (a->num_vertices > 0)
+                {
+                    glCopyNamedBufferSubData(vertex_buffers_[i]->id(), buffer->id(),
+                                             a->first_vertex * stride, next * stride,
+                                             a->num_vertices * stride);
+                }
+                next += a->num_vertices;
+            }
+            vertex_buffers_[i] = buffer;
+        }
+    }
+    size_t next_vertex = 0;
+    for (Allocation *a : sorted)
+    {
+        a->first_vertex = next_vertex;
+        next_vertex += a->num_vertices;
+    }
+    vertex_ranges_.reset(vertex_ranges_.capacity(), next_vertex);
+
+    // Indices
+    std::sort(sorted.begin(), sorted.end(), [](const Allocation *a, const Allocation *b) {
+        return a->first_index < b->first_index;
+    });
+    size_t next_index = 0;
+    if (index_ranges_.capacity() > 0)
+    {
+        const size_t stride = sizeof(unsigned int);
+        auto buffer = ElementArrayBuffer::create(index_ranges_.capacity() * stride, GL_DYNAMIC_DRAW);
+        for (Allocation *a : sorted)
+        {
+            if (a->num_indices > 0)
+            {
+                glCopyNamedBufferSubData(index_buffer_->id(), buffer->id(), a->first_index * stride,
+                                         next_index * stride, a->num_indices * stride);
+                a->first_index = next_index;
+                next_index += a->num_indices;
+            }
+        }
+        index_buffer_ = buffer;
+    }
+    index_ranges_.reset(index_ranges_.capacity(), next_index);
+    bindBuffers();
+}
+
+GeometryArena::Stats GeometryArena::stats() const
+{
+    Stats s;
+    s.vertex_capacity = vertex_ranges_.capacity();
+    s.vertices_used = vertex_ranges_.used();
+    s.index_capacity = index_ranges_.capacity();
+    s.indices_used = index_ranges_.used();
+    s.num_allocations = allocations_.size();
+    const size_t vertices_free = s.vertex_capacity - s.vertices_used;
+    const size_t indices_free = s.index_capacity - s.indices_used;
+    s.vertex_fragmentation =
+        vertices_free > 0 ? 1.f - float(vertex_ranges_.largestFreeRange()) / float(vertices_free)
+                          : 0.f;
+    s.index_fragmentation =
+        indices_free > 0 ? 1.f - float(index_ranges_.largestFreeRange()) / float(indices_free)
+                         : 0.f;
+    for (const auto &buffer : vertex_buffers_)
+    {
+        s.bytes += buffer != nullptr ? buffer->size() : 0;
+    }
+    s.bytes += index_buffer_ != nullptr ? index_buffer_->size() : 0;
+    return s;
+}
+
+const GeometryArena::Layout &GeometryArena::layout() const
+{
+    return layout_;
+}
+
+GLuint GeometryArena::vao() const
+{
+    return vao_;
+}
+
+} // namespace rcube
@@ -5,7 +5,9 @@
 #include "glm/gtc/type_ptr.hpp"
 #include "imgui.h"
 #include <algorithm>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 
 namespace rcube
@@ -158,17 +160,19 @@ void TriangleMeshData::boundingBox(glm::vec3 &min, glm::vec3 &max) const
 //-----------------------------------------------------------------------------
 
 std::shared_ptr<Mesh> Mesh::create(std::vector<std::shared_ptr<AttributeBuffer>> attributes,
-                                   MeshPrimitive prim, bool indexed)
+                                   MeshPrimitive prim, bool indexed, const VertexLayout &layout)
 {
     auto mesh = std::make_shared<Mesh>();
     glGenVertexArrays(1, &mesh->vao_);
     glBindVertexArray(mesh->vao_);
     for (auto attr : attributes)
     {
-        auto attrbuf = AttributeBuffer::create(attr->name(), attr->location(), attr->dim());
+        auto attrbuf = AttributeBuffer::create(attr->name(), attr->location(), attr->dim(),
+                                               attr->divisor());
         attrbuf->buffer()->use();
         GLuint loc = static_cast<GLuint>(attrbuf->location());
         glVertexAttribPointer(loc, static_cast<GLint>(attr->dim()), GL_FLOAT, GL_FALSE, 0, NULL);
+        glVertexAttribDivisor(loc, attr->divisor());
         glEnableVertexAttribArray(loc);
         mesh->attributes_[attr->name()] = attrbuf;
         mesh->attributes_enabled_[attr->name()] = true;
@@ -180,6 +184,7 @@ std::shared_ptr<Mesh> Mesh::create(std::vector<std::shared_ptr<AttributeBuffer>>
             prim == MeshPrimitive::Points ? 1 : (prim == MeshPrimitive::Lines ? 2 : 3));
         mesh->indices_->buffer()->use();
     }
+    mesh->setupVertexLayout(layout);
     mesh->init_ = true;
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -187,9 +192,9 @@ std::shared_ptr<Mesh> Mesh::create(std::vector<std::shared_ptr<AttributeBuffer>>
     return mesh;
 }
 
-std::shared_ptr<Mesh> Mesh::create(const LineMeshData &linemesh)
+std::shared_ptr<Mesh> Mesh::create(const LineMeshData &linemesh, const VertexLayout &layout)
 {
-    auto mesh = Mesh::createLineMesh(linemesh.indexed);
+    auto mesh = Mesh::createLineMesh(linemesh.indexed, layout);
     mesh->attribute("positions")->setData(linemesh.vertices);
     mesh->attribute("colors")->setData(linemesh.colors);
     if (linemesh.indexed)
@@ -199,9 +204,9 @@ std::shared_ptr<Mesh> Mesh::create(const LineMeshData &linemesh)
     return mesh;
 }
 
-std::shared_ptr<Mesh> Mesh::create(const TriangleMeshData &trimesh)
+std::shared_ptr<Mesh> Mesh::create(const TriangleMeshData &trimesh, const VertexLayout &layout)
 {
-    auto mesh = Mesh::createTriangleMesh(trimesh.indexed);
+    auto mesh = Mesh::createTriangleMesh(trimesh.indexed, false, layout);
     if (!trimesh.vertices.empty())
     {
         mesh->attributes_["positions"]->setData(trimesh.vertices);
@@ -229,17 +234,70 @@ std::shared_ptr<Mesh> Mesh::create(const TriangleMeshData &trimesh)
     return mesh;
 }
 
+std::shared_ptr<Mesh> Mesh::create(TriangleMeshData &&trimesh, const VertexLayout &layout,
+                                   CPUDataPolicy policy)
+{
+    auto mesh = Mesh::createTriangleMesh(trimesh.indexed, false, layout);
+    mesh->cpu_data_policy_ = policy;
+    for (const glm::vec3 &p : trimesh.vertices)
+    {
+        mesh->bounds_.expandBy(p);
+    }
+    const bool release = policy == CPUDataPolicy::ReleaseAfterUpload;
+    // Hands the array over to the attribute and frees it; the CPU data is stored as flat
+    // floats, so vec arrays are copied (or converted directly into the GPU buffer) once
+    auto hand_over = [&](const std::string &name, auto &data, size_t dim) {
+        if (data.empty())
+        {
+            return;
+        }
+        AttributeBuffer &attr = *mesh->attributes_[name];
+        if (release && !mesh->interleaved(name))
+        {
+            attr.uploadWithoutCPUCopy(glm::value_ptr(data[0]), data.size() * dim);
+        }
+        else
+        {
+            attr.setData(glm::value_ptr(data[0]), data.size() * dim);
+        }
+        data.clear();
+        data.shrink_to_fit();
+    };
+    hand_over("positions", trimesh.vertices, 3);
+    hand_over("normals", trimesh.normals, 3);
+    hand_over("colors", trimesh.colors, 3);
+    hand_over("uvs", trimesh.texcoords, 2);
+    hand_over("tangents", trimesh.tangents, 3);
+    mesh->bounds_version_ = mesh->attributes_["positions"]->version();
+    if (trimesh.indexed && !trimesh.indices.empty())
+    {
+        const unsigned int *indices = glm::value_ptr(trimesh.indices[0]);
+        if (release)
+        {
+            mesh->indices_->uploadWithoutCPUCopy(indices, trimesh.indices.size() * 3);
+        }
+        else
+        {
+            mesh->indices_->setData(indices, trimesh.indices.size() * 3);
+        }
+    }
+    trimesh.clear();
+    return mesh;
+}
+
 Mesh::Mesh(std::vector<std::shared_ptr<AttributeBuffer>> attributes, MeshPrimitive prim,
-           bool indexed)
+           bool indexed, const VertexLayout &layout)
 {
     glGenVertexArrays(1, &vao_);
     glBindVertexArray(vao_);
     for (auto attr : attributes)
     {
-        auto attrbuf = AttributeBuffer::create(attr->name(), attr->location(), attr->dim());
+        auto attrbuf = AttributeBuffer::create(attr->name(), attr->location(), attr->dim(),
+                                               attr->divisor());
         attrbuf->buffer()->use();
         GLuint loc = static_cast<GLuint>(attrbuf->location());
         glVertexAttribPointer(loc, static_cast<GLint>(attr->dim()), GL_FLOAT, GL_FALSE, 0, NULL);
+        glVertexAttribDivisor(loc, attr->divisor());
         glEnableVertexAttribArray(loc);
         attributes_[attr->name()] = attrbuf;
         attributes_enabled_[attr->name()] = true;
@@ -251,29 +309,31 @@ Mesh::Mesh(std::vector<std::shared_ptr<AttributeBuffer>> attributes, MeshPrimiti
             prim == MeshPrimitive::Points ? 1 : (prim == MeshPrimitive::Lines ? 2 : 3));
         indices_->buffer()->use();
     }
+    setupVertexLayout(layout);
     init_ = true;
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     checkGLError();
 }
 
-std::shared_ptr<Mesh> Mesh::createPointMesh()
+std::shared_ptr<Mesh> Mesh::createPointMesh(const VertexLayout &layout)
 {
     return Mesh::create(
         {AttributeBuffer::create("positions", GLuint(AttributeLocation::POSITION), 3),
          AttributeBuffer::create("colors", GLuint(AttributeLocation::COLOR), 3)},
-        MeshPrimitive::Points, false);
+        MeshPrimitive::Points, false, layout);
 }
 
-std::shared_ptr<Mesh> Mesh::createLineMesh(bool indexed)
+std::shared_ptr<Mesh> Mesh::createLineMesh(bool indexed, const VertexLayout &layout)
 {
     return Mesh::create(
         {AttributeBuffer::create("positions", GLuint(AttributeLocation::POSITION), 3),
          AttributeBuffer::create("colors", GLuint(AttributeLocation::COLOR), 3)},
-        MeshPrimitive::Lines, indexed);
+        MeshPrimitive::Lines, indexed, layout);
 }
 
-std::shared_ptr<Mesh> Mesh::createTriangleMesh(bool indexed, bool strip)
+std::shared_ptr<Mesh> Mesh::createTriangleMesh(bool indexed, bool strip,
+                                               const VertexLayout &layout)
 {
     return Mesh::create(
         {AttributeBuffer::create("positions", GLuint(AttributeLocation::POSITION), 3),
@@ -282,7 +342,7 @@ std::shared_ptr<Mesh> Mesh::createTriangleMesh(bool indexed, bool strip)
          AttributeBuffer::create("colors", GLuint(AttributeLocation::COLOR), 3),
          AttributeBuffer::create("tangents", GLuint(AttributeLocation::TANGENT), 3),
          AttributeBuffer::create("wireframe", GLuint(AttributeLocation::WIREFRAME), 1)},
-        strip ? MeshPrimitive::TriangleStrip : MeshPrimitive::Triangles, indexed);
+        strip ? MeshPrimitive::TriangleStrip : MeshPrimitive::Triangles, indexed, layout);
 }
 
 void Mesh::release()
@@ -295,6 +355,12 @@ void Mesh::release()
     {
         kv.second->release();
     }
+    arena_allocation_ = nullptr;
+    arena_.reset();
+    if (interleaved_buffer_ != nullptr)
+    {
+        interleaved_buffer_->release();
+    }
     if (vao_ != 0)
     {
         glDeleteVertexArrays(1, &vao_);
@@ -305,7 +371,8 @@ void Mesh::release()
 
 GLuint Mesh::vao() const
 {
-    return vao_;
+    auto arena = arena_.lock();
+    return arena != nullptr ? arena->vao() : vao_;
 }
 
 bool Mesh::valid() const
@@ -315,37 +382,57 @@ bool Mesh::valid() const
 
 void Mesh::enableAttribute(std::string name)
 {
+    attributes_enabled_[name] = true;
+    // Arena meshes share their vertex array; the attribute is added to the layout instead
+    if (use_arena_)
+    {
+        uploadToArena();
+        return;
+    }
     GLuint location = attributes_.at(name)->location();
     use();
     glEnableVertexAttribArray(location);
     done();
-    attributes_enabled_[name] = true;
 }
 
 void Mesh::disableAttribute(std::string name)
 {
     auto &attr = attributes_.at(name);
     checkGLError();
+    attributes_enabled_[name] = false;
+    setDefaultValue(*attr);
+    checkGLError();
+    // Arena meshes share their vertex array; the attribute is dropped from the layout instead
+    if (use_arena_)
+    {
+        uploadToArena();
+        return;
+    }
     use();
-    GLuint id = attr->buffer()->id();
-    GLuint location = attr->location();
-    glDisableVertexAttribArray(location);
+    glDisableVertexAttribArray(attr->location());
+    done();
+}
+
+void Mesh::setDefaultValue(const AttributeBuffer &attr)
+{
+    const GLuint location = attr.location();
     // TODO(pradeep): these default values should be provided in the attribute buffer as a parameter
-    if (attr->dim() == 3)
+    if (attr.dim() == 4)
+    {
+        setDefaultValue(location, glm::vec4(0, 0, 0, 1));
+    }
+    else if (attr.dim() == 3)
     {
         setDefaultValue(location, glm::vec3(1, 1, 1));
     }
-    else if (attr->dim() == 2)
+    else if (attr.dim() == 2)
     {
         setDefaultValue(location, glm::vec2(0, 0));
     }
-    else if (attr->dim() == 1)
+    else if (attr.dim() == 1)
     {
         setDefaultValue(location, 1);
     }
-    checkGLError();
-    done();
-    attributes_enabled_[name] = false;
 }
 
 void Mesh::drawGUI()
@@ -373,6 +460,8 @@ void Mesh::drawGUI()
         ImGui::LabelText("Dimension", std::to_string(attribute(current_attr)->dim()).c_str());
         ImGui::LabelText("Layout location",
                          std::to_string(attribute(current_attr)->location()).c_str());
+        ImGui::LabelText("Format", formatName(attribute(current_attr)->format()).c_str());
+        ImGui::LabelText("Interleaved", interleaved(current_attr) ? "Yes" : "No");
         bool checked = attributeEnabled(current_attr);
         if (ImGui::Checkbox("Active", &checked))
         {
@@ -383,27 +472,68 @@ void Mesh::drawGUI()
     {
         ImGui::LabelText("#Faces", std::to_string(indices()->size() / primitiveDim()).c_str());
     }
+    const MeshMemoryReport report = memoryReport();
+    ImGui::LabelText("GPU memory", "%zu / %zu bytes", report.totalBytes(),
+                     report.totalFloatBytes());
+    ImGui::LabelText("Bytes per vertex", "%zu / %zu", report.bytes_per_vertex,
+                     report.float_bytes_per_vertex);
+    ImGui::LabelText("CPU memory", "%zu bytes", report.cpu_bytes);
 }
 
 AABB Mesh::boundingBox()
 {
     AABB bbox;
-    auto positions = attribute("positions")->ptrVec3();
-    size_t num_vertices = attribute("positions")->count();
+    // Read through a const reference so that the positions are not marked for upload
+    const AttributeBuffer &attr = *attribute("positions");
+    if (attr.version() == bounds_version_ || !attr.resident())
+    {
+        return bounds_;
+    }
+    const glm::vec3 *positions = attr.ptrVec3();
+    size_t num_vertices = attr.count();
     for (size_t i = 0; i < num_vertices; ++i)
     {
         bbox.expandBy(positions[i]);
     }
+    bounds_ = bbox;
+    bounds_version_ = attr.version();
     return bbox;
 }
 
+size_t Mesh::shapeVersion() const
+{
+    // Versions only increase, so their sum changes whenever one of them does
+    size_t version = indices_ != nullptr ? indices_->version() : 0;
+    for (const auto &kv : attributes_)
+    {
+        const GLuint location = kv.second->location();
+        if (location == AttributeLocation::POSITION ||
+            location == AttributeLocation::INSTANCE_OFFSET ||
+            location == AttributeLocation::INSTANCE_DIRECTION)
+        {
+            version += kv.second->version();
+        }
+    }
+    return version;
+}
+
+size_t Mesh::dataVersion() const
+{
+    size_t version = indices_ != nullptr ? indices_->version() : 0;
+    for (const auto &kv : attributes_)
+    {
+        version += kv.second->version();
+    }
+    return version;
+}
+
 void Mesh::use() const
 {
     if (!valid())
     {
         throw std::runtime_error(ERROR_MESH_UNINITIALIZED);
     }
-    glBindVertexArray(vao_);
+    glBindVertexArray(vao());
 }
 
 void Mesh::done() const
@@ -425,6 +555,38 @@ size_t Mesh::numIndexData() const
     return 0;
 }
 
+bool Mesh::instanced() const
+{
+    return std::any_of(attributes_.begin(), attributes_.end(),
+                       [](const auto &kv) { return kv.second->divisor() > 0; });
+}
+
+size_t Mesh::numInstances() const
+{
+    size_t num_instances = 0;
+    for (const auto &kv : attributes_)
+    {
+        if (kv.second->divisor() > 0)
+        {
+            num_instances = std::max(num_instances, kv.second->count() * kv.second->divisor());
+        }
+    }
+    return num_instances;
+}
+
+void Mesh::addChild(std::shared_ptr<Mesh> child)
+{
+    if (std::find(children_.begin(), children_.end(), child) == children_.end())
+    {
+        children_.push_back(child);
+    }
+}
+
+void Mesh::removeChild(std::shared_ptr<Mesh> child)
+{
+    children_.erase(std::remove(children_.begin(), children_.end(), child), children_.end());
+}
+
 bool Mesh::hasAttribute(std::string name) const
 {
     return attributes_.find(name) != attributes_.end();
@@ -443,43 +605,701 @@ std::shared_ptr<AttributeIndexBuffer> Mesh::indices()
 void Mesh::uploadToGPU()
 {
     done();
-    if (indices_ != nullptr)
+    if (use_arena_)
+    {
+        for (auto &kv : attributes_)
+        {
+            const bool enabled = kv.second->count() == attributes_["positions"]->count() &&
+                                 kv.second->count() > 0;
+            attributes_enabled_[kv.first] = enabled;
+            if (!enabled)
+            {
+                setDefaultValue(*kv.second);
+            }
+        }
+        uploadToArena();
+        return;
+    }
+    if (indices_ != nullptr && indices_->dirty())
     {
         indices_->update();
     }
+    // Per-instance attributes are checked against the largest of them, as there is no
+    // attribute that defines the number of instances like "positions" does for vertices
+    const size_t num_instances = numInstances();
     for (auto &kv : attributes_)
     {
-        if (kv.second->data().size() / kv.second->dim() !=
-            attributes_["positions"]->data().size() / attributes_["positions"]->dim())
+        const size_t expected_count = kv.second->divisor() > 0
+                                          ? num_instances / kv.second->divisor()
+                                          : attributes_["positions"]->count();
+        if (kv.second->count() != expected_count || kv.second->count() == 0)
         {
             disableAttribute(kv.first);
         }
         else
         {
             enableAttribute(kv.first);
-            kv.second->update();
+            // Attributes that were not modified since the last upload are skipped; interleaved
+            // ones are written by uploadInterleaved()
+            if (!interleaved(kv.first) && kv.second->dirty())
+            {
+                kv.second->update();
+                if (kv.second->streaming())
+                {
+                    bindAttributeBuffer(*kv.second);
+                }
+            }
         }
     }
+    uploadInterleaved();
+    releaseCPUCopies();
 }
 
 void Mesh::uploadToGPU(const std::string &attribute)
 {
     done();
     auto attr = attributes_.at(attribute);
+    if (use_arena_)
     {
-        if (attr->data().size() / attr->dim() !=
-            attributes_["positions"]->data().size() / attributes_["positions"]->dim())
+        const bool enabled =
+            attr->count() == attributes_["positions"]->count() && attr->count() > 0;
+        attributes_enabled_[attribute] = enabled;
+        if (!enabled)
+        {
+            setDefaultValue(*attr);
+        }
+        uploadToArena();
+        return;
+    }
+    {
+        const size_t expected_count = attr->divisor() > 0 ? numInstances() / attr->divisor()
+                                                          : attributes_["positions"]->count();
+        if (attr->count() != expected_count || attr->count() == 0)
         {
             disableAttribute(attribute);
         }
         else
         {
             enableAttribute(attribute);
-            attr->update();
+            if (interleaved(attribute))
+            {
+                uploadInterleaved();
+            }
+            else if (attr->dirty())
+            {
+                attr->update();
+                if (attr->streaming())
+                {
+                    bindAttributeBuffer(*attr);
+                }
+            }
+        }
+    }
+}
+
+void Mesh::setCPUDataPolicy(CPUDataPolicy policy)
+{
+    cpu_data_policy_ = policy;
+}
+
+void Mesh::releaseCPUCopies()
+{
+    if (cpu_data_policy_ != CPUDataPolicy::ReleaseAfterUpload)
+    {
+        return;
+    }
+    // Keep the bounding box so that culling and camera fitting need no readback
+    if (attributes_.at("positions")->resident())
+    {
+        boundingBox();
+    }
+    if (use_arena_)
+    {
+        // The data only lives in the arena; it is read back from the allocation, whose
+        // offsets may change with defragmentation, as long as the mesh holds on to it
+        std::weak_ptr<GeometryArena> arena = arena_;
+        std::weak_ptr<GeometryArena::Allocation> allocation = arena_allocation_;
+        for (auto &kv : attributes_)
+        {
+            if (!attributes_enabled_[kv.first])
+            {
+                continue;
+            }
+            const GLuint location = kv.second->location();
+            kv.second->releaseCPUData([arena, allocation, location](float *data, size_t count) {
+                auto owner = arena.lock();
+                auto alloc = allocation.lock();
+                if (owner == nullptr || alloc == nullptr)
+                {
+                    throw std::runtime_error("Released vertex data is no longer in its arena");
+                }
+                owner->readVertices(*alloc, location, data, 0, count);
+            });
+        }
+        if (indices_ != nullptr)
+        {
+            indices_->releaseCPUData([arena, allocation](unsigned int *data, size_t count) {
+                auto owner = arena.lock();
+                auto alloc = allocation.lock();
+                if (owner == nullptr || alloc == nullptr)
+                {
+                    throw std::runtime_error("Released indices are no longer in their arena");
+                }
+                owner->readIndices(*alloc, data, 0, count);
+            });
         }
+        return;
+    }
+    for (auto &kv : attributes_)
+    {
+        // Interleaved records are assembled from the CPU copies
+        if (!interleaved(kv.first))
+        {
+            kv.second->releaseCPUData();
+        }
+    }
+    if (indices_ != nullptr)
+    {
+        indices_->releaseCPUData();
     }
 }
 
+void Mesh::setUseGeometryArena(bool use)
+{
+    if (use == use_arena_)
+    {
+        return;
+    }
+    if (use)
+    {
+        if (instanced())
+        {
+            throw std::runtime_error("Instanced meshes cannot be stored in a geometry arena");
+        }
+        if (!interleaved_.empty())
+        {
+            throw std::runtime_error("Meshes with interleaved attributes cannot be stored in a "
+                                     "geometry arena");
+        }
+        for (const auto &kv : attributes_)
+        {
+            if (kv.second->streaming())
+            {
+                throw std::runtime_error("Streamed attribute " + kv.first +
+                                         " cannot be stored in a geometry arena");
+            }
+            if (kv.second->format() != AttributeFormat::Float32)
+            {
+                throw std::runtime_error("Attribute " + kv.first + " in " +
+                                         formatName(kv.second->format()) +
+                                         " format cannot be stored in a geometry arena");
+            }
+        }
+        use_arena_ = true;
+        // Released data is read back from the mesh's own buffers into the arena, after which
+        // they and the vertex array are freed
+        uploadToGPU();
+        for (auto &kv : attributes_)
+        {
+            kv.second->buffer()->reserve(0);
+        }
+        if (indices_ != nullptr)
+        {
+            indices_->buffer()->reserve(0);
+        }
+        glDeleteVertexArrays(1, &vao_);
+        vao_ = 0;
+        return;
+    }
+    // Released data is read back from the arena before the allocation is freed, and the
+    // mesh's own buffers (emptied when moving into the arena) are filled again
+    for (auto &kv : attributes_)
+    {
+        kv.second->markDirty(0, kv.second->count());
+    }
+    if (indices_ != nullptr)
+    {
+        indices_->markDirty(0, indices_->count());
+    }
+    use_arena_ = false;
+    arena_allocation_ = nullptr;
+    arena_.reset();
+    createVertexArray();
+    uploadToGPU();
+}
+
+bool Mesh::usesGeometryArena() const
+{
+    return use_arena_;
+}
+
+bool Mesh::geometryArenaCompatible() const
+{
+    if (instanced() || !interleaved_.empty())
+    {
+        return false;
+    }
+    for (const auto &kv : attributes_)
+    {
+        if (kv.second->streaming() || kv.second->format() != AttributeFormat::Float32)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t Mesh::baseVertex() const
+{
+    return arena_allocation_ != nullptr ? arena_allocation_->first_vertex : 0;
+}
+
+size_t Mesh::firstIndex() const
+{
+    return arena_allocation_ != nullptr ? arena_allocation_->first_index : 0;
+}
+
+void Mesh::uploadToArena()
+{
+    // The layout consists of the enabled per-vertex attributes
+    GeometryArena::Layout layout;
+    std::vector<std::shared_ptr<AttributeBuffer>> layout_attributes;
+    for (const auto &kv : attributes_)
+    {
+        if (attributes_enabled_[kv.first])
+        {
+            GeometryArena::Attribute attr;
+            attr.location = kv.second->location();
+            attr.dim = kv.second->dim();
+            layout.push_back(attr);
+            layout_attributes.push_back(kv.second);
+        }
+    }
+    std::sort(layout.begin(), layout.end());
+    GeometryArena &arena = GeometryArena::forLayout(layout);
+    const size_t num_vertices = numVertexData();
+    const size_t num_indices = numIndexData();
+    // A new allocation is needed if the layout or the size changed; everything is written then
+    const bool reallocate = &arena != arena_.lock().get() || arena_allocation_ == nullptr ||
+                            arena_allocation_->num_vertices != num_vertices ||
+                            arena_allocation_->num_indices != num_indices;
+    if (reallocate)
+    {
+        // Released data (also of attributes leaving the layout) is read back from the old
+        // allocation before it is freed
+        for (const auto &kv : attributes_)
+        {
+            static_cast<const AttributeBuffer &>(*kv.second).data();
+        }
+        if (indices_ != nullptr)
+        {
+            static_cast<const AttributeIndexBuffer &>(*indices_).data();
+        }
+        arena_allocation_ = nullptr;
+        arena_allocation_ = arena.allocate(num_vertices, num_indices);
+        arena_ = arena.weak_from_this();
+    }
+    for (const std::shared_ptr<AttributeBuffer> &attr : layout_attributes)
+    {
+        // Unmodified data stays in the arena and may have been released
+        if (!reallocate && attr->dirtyRanges().empty())
+        {
+            continue;
+        }
+        const std::vector<float> &data = static_cast<const AttributeBuffer &>(*attr).data();
+        if (reallocate)
+        {
+            arena.writeVertices(*arena_allocation_, attr->location(), data.data(), 0,
+                                data.size());
+        }
+        else
+        {
+            for (const std::pair<size_t, size_t> &range : attr->dirtyRanges().ranges())
+            {
+                arena.writeVertices(*arena_allocation_, attr->location(),
+                                    data.data() + range.first, range.first,
+                                    range.second - range.first);
+            }
+        }
+        attr->clearDirty();
+    }
+    if (indices_ != nullptr && (reallocate || !indices_->dirtyRanges().empty()))
+    {
+        const std::vector<unsigned int> &data =
+            static_cast<const AttributeIndexBuffer &>(*indices_).data();
+        if (reallocate)
+        {
+            arena.writeIndices(*arena_allocation_, data.data(), 0, data.size());
+        }
+        else
+        {
+            for (const std::pair<size_t, size_t> &range : indices_->dirtyRanges().ranges())
+            {
+                arena.writeIndices(*arena_allocation_, data.data() + range.first, range.first,
+                                   range.second - range.first);
+            }
+        }
+        indices_->clearDirty();
+    }
+    releaseCPUCopies();
+}
+
+void Mesh::createVertexArray()
+{
+    glCreateVertexArrays(1, &vao_);
+    for (const auto &kv : attributes_)
+    {
+        const AttributeBuffer &attr = *kv.second;
+        // Each attribute reads from the binding index equal to its location
+        glVertexArrayAttribFormat(vao_, attr.location(),
+                                  formatComponents(attr.format(), attr.dim()),
+                                  formatType(attr.format()), formatNormalized(attr.format()), 0);
+        glVertexArrayAttribBinding(vao_, attr.location(), attr.location());
+        glVertexArrayBindingDivisor(vao_, attr.location(), attr.divisor());
+        if (attributes_enabled_[kv.first])
+        {
+            glEnableVertexArrayAttrib(vao_, attr.location());
+        }
+        bindAttributeBuffer(attr);
+    }
+    if (indices_ != nullptr)
+    {
+        glVertexArrayElementBuffer(vao_, indices_->buffer()->id());
+    }
+}
+
+void Mesh::setStreaming(const std::string &attribute, bool streaming)
+{
+    if (streaming && use_arena_)
+    {
+        throw std::runtime_error("Attribute " + attribute +
+                                 " of a mesh in a geometry arena cannot be streamed");
+    }
+    if (streaming && interleaved(attribute))
+    {
+        throw std::runtime_error("Interleaved attribute " + attribute + " cannot be streamed");
+    }
+    auto attr = attributes_.at(attribute);
+    attr->setStreaming(streaming);
+    bindAttributeBuffer(*attr);
+    uploadToGPU(attribute);
+}
+
+void Mesh::setAttributeFormat(const std::string &attribute, AttributeFormat format)
+{
+    if (format != AttributeFormat::Float32 && use_arena_)
+    {
+        throw std::runtime_error("Attribute " + attribute +
+                                 " of a mesh in a geometry arena must be Float32");
+    }
+    auto attr = attributes_.at(attribute);
+    if (attr->format() == format)
+    {
+        return;
+    }
+    attr->setFormat(format);
+    if (interleaved(attribute))
+    {
+        // The offsets of the following fields and the record size change
+        configureInterleaved();
+    }
+    else
+    {
+        glVertexArrayAttribFormat(vao_, attr->location(), formatComponents(format, attr->dim()),
+                                  formatType(format), formatNormalized(format), 0);
+        bindAttributeBuffer(*attr);
+    }
+    uploadToGPU(attribute);
+}
+
+void Mesh::setCompressedVertexFormats(bool compress)
+{
+    for (auto &kv : attributes_)
+    {
+        AttributeFormat format = AttributeFormat::Float32;
+        if (compress && kv.second->divisor() == 0)
+        {
+            switch (kv.second->location())
+            {
+            case AttributeLocation::POSITION:
+                format = AttributeFormat::Snorm16;
+                break;
+            case AttributeLocation::NORMAL:
+            case AttributeLocation::TANGENT:
+                format = AttributeFormat::Oct16;
+                break;
+            case AttributeLocation::UV:
+                format = AttributeFormat::Float16;
+                break;
+            case AttributeLocation::COLOR:
+                format = AttributeFormat::Unorm8;
+                break;
+            default:
+                break;
+            }
+        }
+        setAttributeFormat(kv.first, format);
+    }
+}
+
+GLenum Mesh::indexType() const
+{
+    // Arenas store 32-bit indices
+    if (indices_ == nullptr || use_arena_)
+    {
+        return GL_UNSIGNED_INT;
+    }
+    return indices_->indexType();
+}
+
+glm::vec3 Mesh::positionDecodeOffset() const
+{
+    auto it = attributes_.find("positions");
+    if (it == attributes_.end() || it->second->format() != AttributeFormat::Snorm16)
+    {
+        return glm::vec3(0.f);
+    }
+    return glm::vec3(it->second->decodeOffset());
+}
+
+glm::vec3 Mesh::positionDecodeScale() const
+{
+    auto it = attributes_.find("positions");
+    if (it == attributes_.end() || it->second->format() != AttributeFormat::Snorm16)
+    {
+        return glm::vec3(1.f);
+    }
+    return glm::vec3(it->second->decodeScale());
+}
+
+int Mesh::vertexFormatFlags() const
+{
+    int flags = 0;
+    for (const auto &kv : attributes_)
+    {
+        if (kv.second->format() != AttributeFormat::Oct16 || !attributes_enabled_.at(kv.first))
+        {
+            continue;
+        }
+        if (kv.second->location() == AttributeLocation::NORMAL)
+        {
+            flags |= 1;
+        }
+        else if (kv.second->location() == AttributeLocation::TANGENT)
+        {
+            flags |= 2;
+        }
+    }
+    return flags;
+}
+
+MeshMemoryReport Mesh::memoryReport() const
+{
+    MeshMemoryReport report;
+    for (const auto &kv : attributes_)
+    {
+        const AttributeBuffer &attr = *kv.second;
+        MeshMemoryReport::Attribute entry;
+        entry.name = kv.first;
+        entry.format = attr.format();
+        entry.enabled = attributes_enabled_.at(kv.first);
+        entry.bytes = attr.count() * attr.stride();
+        entry.float_bytes = attr.size() * sizeof(float);
+        report.cpu_bytes += attr.resident() ? attr.size() * sizeof(float) : 0;
+        if (entry.enabled && attr.divisor() == 0)
+        {
+            report.bytes_per_vertex += attr.stride();
+            report.float_bytes_per_vertex += attr.dim() * sizeof(float);
+        }
+        report.attributes.push_back(entry);
+    }
+    if (indices_ != nullptr)
+    {
+        const size_t index_size = indexType() == GL_UNSIGNED_SHORT ? sizeof(uint16_t)
+                                                                   : sizeof(uint32_t);
+        report.index_bytes = indices_->size() * index_size;
+        report.index_uint32_bytes = indices_->size() * sizeof(uint32_t);
+        report.cpu_bytes += indices_->resident() ? indices_->size() * sizeof(unsigned int) : 0;
+    }
+    return report;
+}
+
+size_t MeshMemoryReport::totalBytes() const
+{
+    size_t total = index_bytes;
+    for (const Attribute &attr : attributes)
+    {
+        total += attr.bytes;
+    }
+    return total;
+}
+
+size_t MeshMemoryReport::totalFloatBytes() const
+{
+    size_t total = index_uint32_bytes;
+    for (const Attribute &attr : attributes)
+    {
+        total += attr.float_bytes;
+    }
+    return total;
+}
+
+std::string MeshMemoryReport::toString() const
+{
+    std::ostringstream out;
+    out << std::left << std::setw(16) << "Attribute" << std::setw(10) << "Format"
+        << std::right << std::setw(14) << "Bytes" << std::setw(14) << "Float bytes" << "\n";
+    for (const Attribute &attr : attributes)
+    {
+        out << std::left << std::setw(16) << (attr.name + (attr.enabled ? "" : " (off)"))
+            << std::setw(10) << formatName(attr.format) << std::right << std::setw(14)
+            << attr.bytes << std::setw(14) << attr.float_bytes << "\n";
+    }
+    out << std::left << std::setw(16) << "indices" << std::setw(10)
+        << (index_bytes < index_uint32_bytes ? "Uint16" : "Uint32") << std::right
+        << std::setw(14) << index_bytes << std::setw(14) << index_uint32_bytes << "\n";
+    out << std::left << std::setw(26) << "total" << std::right << std::setw(14) << totalBytes()
+        << std::setw(14) << totalFloatBytes() << "\n";
+    out << std::left << std::setw(26) << "bytes per vertex" << std::right << std::setw(14)
+        << bytes_per_vertex << std::setw(14) << float_bytes_per_vertex << "\n";
+    out << std::left << std::setw(26) << "CPU copies" << std::right << std::setw(14) << cpu_bytes
+        << "\n";
+    return out.str();
+}
+
+bool Mesh::interleaved(const std::string &attribute) const
+{
+    return std::any_of(interleaved_.begin(), interleaved_.end(),
+                       [&attribute](const auto &attr) { return attr->name() == attribute; });
+}
+
+void Mesh::setupVertexLayout(const VertexLayout &layout)
+{
+    for (const auto &kv : attributes_)
+    {
+        if (!layout.interleaves(kv.first))
+        {
+            continue;
+        }
+        if (kv.second->divisor() > 0)
+        {
+            if (layout.interleave_all)
+            {
+                continue;
+            }
+            throw std::runtime_error("Per-instance attribute " + kv.first +
+                                     " cannot be interleaved");
+        }
+        interleaved_.push_back(kv.second);
+    }
+    if (interleaved_.empty())
+    {
+        return;
+    }
+    // Records follow the order of the layout; interleave_all keeps the order of the locations
+    auto order = [&layout](const std::shared_ptr<AttributeBuffer> &attr) {
+        auto it = std::find(layout.interleaved.begin(), layout.interleaved.end(), attr->name());
+        return std::make_pair(it - layout.interleaved.begin(), attr->location());
+    };
+    std::sort(interleaved_.begin(), interleaved_.end(),
+              [&order](const auto &a, const auto &b) { return order(a) < order(b); });
+    interleaved_buffer_ = ArrayBuffer::create(1);
+    configureInterleaved();
+}
+
+void Mesh::configureInterleaved()
+{
+    interleaved_offsets_.clear();
+    interleaved_stride_ = 0;
+    for (const std::shared_ptr<AttributeBuffer> &attr : interleaved_)
+    {
+        // Element sizes of all formats are multiples of 4 bytes, so every field is aligned
+        const GLuint location = attr->location();
+        glVertexArrayAttribFormat(vao_, location, formatComponents(attr->format(), attr->dim()),
+                                  formatType(attr->format()), formatNormalized(attr->format()),
+                                  GLuint(interleaved_stride_));
+        glVertexArrayAttribBinding(vao_, location, VertexLayout::INTERLEAVED_BINDING);
+        interleaved_offsets_.push_back(interleaved_stride_);
+        interleaved_stride_ += attr->stride();
+    }
+    glVertexArrayVertexBuffer(vao_, VertexLayout::INTERLEAVED_BINDING, interleaved_buffer_->id(),
+                              0, GLsizei(interleaved_stride_));
+    interleaved_full_upload_ = true;
+}
+
+void Mesh::uploadInterleaved()
+{
+    if (interleaved_.empty() || use_arena_)
+    {
+        return;
+    }
+    const size_t num_vertices = numVertexData();
+    bool full = interleaved_full_upload_ ||
+                interleaved_buffer_->size() != num_vertices * interleaved_stride_;
+    // Attributes with a mismatching count are disabled and leave their fields untouched
+    std::vector<size_t> fields;
+    DirtyRanges vertices;
+    for (size_t i = 0; i < interleaved_.size(); ++i)
+    {
+        const AttributeBuffer &attr = *interleaved_[i];
+        if (attr.count() != num_vertices)
+        {
+            continue;
+        }
+        fields.push_back(i);
+        full = interleaved_[i]->updateDecodeRange(full) || full;
+        for (const std::pair<size_t, size_t> &range : attr.dirtyRanges().ranges())
+        {
+            vertices.add(range.first / attr.dim(), (range.second + attr.dim() - 1) / attr.dim());
+        }
+    }
+    if (full)
+    {
+        interleaved_buffer_->reserve(num_vertices * interleaved_stride_);
+        vertices.clear();
+        vertices.add(0, num_vertices);
+    }
+    // Modified vertices are written as whole records, taking the unmodified fields from the
+    // CPU data of the other attributes
+    std::vector<char> records;
+    for (const std::pair<size_t, size_t> &range : vertices.ranges())
+    {
+        const size_t count = range.second - range.first;
+        records.assign(count * interleaved_stride_, 0);
+        for (size_t i : fields)
+        {
+            interleaved_[i]->packInto(range.first, count, records.data() + interleaved_offsets_[i],
+                                      interleaved_stride_);
+        }
+        interleaved_buffer_->setData(records.data(), records.size(),
+                                     range.first * interleaved_stride_);
+    }
+    for (size_t i : fields)
+    {
+        interleaved_[i]->clearDirty();
+    }
+    interleaved_full_upload_ = false;
+}
+
+void Mesh::bindAttributeBuffer(const AttributeBuffer &attr)
+{
+    const GLsizei stride = GLsizei(attr.stride());
+    // glVertexAttribPointer used the attribute location as the binding index
+    if (attr.streaming())
+    {
+        glVertexArrayVertexBuffer(vao_, attr.location(), attr.streamingBuffer()->id(),
+                                  GLintptr(attr.streamingBuffer()->offset()), stride);
+    }
+    else
+    {
+        glVertexArrayVertexBuffer(vao_, attr.location(), attr.buffer()->id(), 0, stride);
+    }
+}
+
+void Mesh::setDefaultValue(GLuint id, const glm::vec4 &val)
+{
+    glVertexAttrib4f(id, val[0], val[1], val[2], val[3]);
+}
 void Mesh::setDefaultValue(GLuint id, const glm::vec3 &val)
 {
     glVertexAttrib3f(id, val[0], val[1], val[2]);
@@ -0,0 +1,114 @@
+#include "RCube/Core/Graphics/OpenGL/ReadbackBuffer.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace rcube
+{
+
+std::shared_ptr<ReadbackBuffer> ReadbackBuffer::create(size_t region_size)
+{
+    auto buf = std::shared_ptr<ReadbackBuffer>(new ReadbackBuffer());
+    buf->region_size_ = (std::max(region_size, size_t(1)) + 255) / 256 * 256;
+    const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr total = GLsizeiptr(buf->region_size_ * NUM_REGIONS);
+    glCreateBuffers(1, &buf->id_);
+    glNamedBufferStorage(buf->id_, total, nullptr, flags);
+    buf->mapped_ = static_cast<char *>(glMapNamedBufferRange(buf->id_, 0, total, flags));
+    if (buf->mapped_ == nullptr)
+    {
+        throw std::runtime_error("Unable to map readback buffer of size " +
+                                 std::to_string(total));
+    }
+    return buf;
+}
+
+ReadbackBuffer::~ReadbackBuffer()
+{
+    for (Region &region : regions_)
+    {
+        if (region.fence != nullptr)
+        {
+            glDeleteSync(region.fence);
+        }
+    }
+    if (id_ > 0)
+    {
+        glUnmapNamedBuffer(id_);
+        glDeleteBuffers(1, &id_);
+    }
+}
+
+void ReadbackBuffer::checkFence(Region &region)
+{
+    if (region.fence == nullptr)
+    {
+        return;
+    }
+    // Flushing guarantees that the fence is signaled eventually; a zero timeout never waits
+    const GLenum result = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (result == GL_WAIT_FAILED)
+    {
+        throw std::runtime_error("Polling a readback buffer region failed");
+    }
+    if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+    {
+        glDeleteSync(region.fence);
+        region.fence = nullptr;
+        region.ready = true;
+    }
+}
+
+size_t ReadbackBuffer::copy(GLuint buffer, size_t bytes)
+{
+    if (bytes > region_size_)
+    {
+        throw std::runtime_error("Attempting to read back " + std::to_string(bytes) +
+                                 " bytes into a readback buffer region of size " +
+                                 std::to_string(region_size_));
+    }
+    const size_t index = (current_ + 1) % NUM_REGIONS;
+    Region &region = regions_[index];
+    checkFence(region);
+    if (region.fence != nullptr)
+    {
+        return NO_REGION;
+    }
+    glCopyNamedBufferSubData(buffer, id_, 0, GLintptr(index * region_size_), GLsizeiptr(bytes));
+    region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region.sequence = ++sequence_;
+    region.ready = false;
+    current_ = index;
+    return index;
+}
+
+size_t ReadbackBuffer::poll()
+{
+    size_t latest = NO_REGION;
+    for (size_t i = 0; i < NUM_REGIONS; ++i)
+    {
+        checkFence(regions_[i]);
+        if (regions_[i].ready &&
+            (latest == NO_REGION || regions_[i].sequence > regions_[latest].sequence))
+        {
+            latest = i;
+        }
+    }
+    for (Region &region : regions_)
+    {
+        region.ready = false;
+    }
+    return latest;
+}
+
+const void *ReadbackBuffer::data(size_t region) const
+{
+    return mapped_ + region * region_size_;
+}
+
+size_t ReadbackBuffer::regionSize() const
+{
+    return region_size_;
+}
+
+} // namespace rcube
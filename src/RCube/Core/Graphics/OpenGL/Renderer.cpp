@@ -4,6 +4,7 @@
 #include "RCube/Core/Graphics/OpenGL/CommonShader.h"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtx/string_cast.hpp"
+#include <algorithm>
 
 namespace rcube
 {
@@ -38,6 +39,9 @@ void GLRenderer::initialize()
     skybox_mesh_ = common::skyboxMesh();
     skybox_shader_ = common::skyboxShader();
 
+    // Point splats set their own size
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
     init_ = true;
 }
 
@@ -248,16 +252,7 @@ void GLRenderer::draw(const RenderTarget &render_target, const std::vector<DrawC
             glBindTextureUnit(dccub.unit, dccub.texture);
         }
         // Draw
-        glBindVertexArray(dc.mesh.vao);
-        if (!dc.mesh.indexed)
-        {
-            glDrawArrays(dc.mesh.primitive, 0, dc.mesh.num_data);
-        }
-        else
-        {
-            glDrawElements(dc.mesh.primitive, dc.mesh.num_data, GL_UNSIGNED_INT,
-                           (void *)(0 * sizeof(uint32_t)));
-        }
+        submit(dc);
     }
     glDisable(GL_SCISSOR_TEST);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
@@ -321,19 +316,113 @@ void GLRenderer::draw(const RenderTarget &render_target, const RenderSettings &s
             glBindTextureUnit(dccub.unit, dccub.texture);
         }
         // Draw
+        submit(dc);
+    }
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+void GLRenderer::submit(const DrawCall &dc)
+{
+    // Looked up once when the program was linked
+    const ShaderProgram::MeshUniforms &uniforms = dc.shader->meshUniforms();
+    if (dc.multi_draw.draw_count > 0)
+    {
+        setMeshUniforms(dc.mesh, uniforms);
         glBindVertexArray(dc.mesh.vao);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, dc.multi_draw.indirect_buffer);
         if (!dc.mesh.indexed)
         {
-            glDrawArrays(dc.mesh.primitive, 0, dc.mesh.num_data);
+            glMultiDrawArraysIndirect(dc.mesh.primitive, (void *)dc.multi_draw.offset,
+                                      dc.multi_draw.draw_count, 0);
         }
         else
         {
-            glDrawElements(dc.mesh.primitive, dc.mesh.num_data, GL_UNSIGNED_INT,
-                           (void *)(0 * sizeof(uint32_t)));
+            glMultiDrawElementsIndirect(dc.mesh.primitive, dc.mesh.index_type,
+                                        (void *)dc.multi_draw.offset, dc.multi_draw.draw_count,
+                                        0);
         }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return;
+    }
+    drawMesh(dc.mesh, uniforms);
+}
+
+void GLRenderer::setMeshUniforms(const DrawCall::MeshInfo &mesh,
+                                 const ShaderProgram::MeshUniforms &uniforms)
+{
+    if (uniforms.glyph_params != nullptr)
+    {
+        uniforms.glyph_params->set(mesh.glyph_params);
+    }
+    if (uniforms.colormap_params != nullptr)
+    {
+        uniforms.colormap_params->set(mesh.colormap_params);
+        if (mesh.colormap_lut > 0)
+        {
+            glBindTextureUnit(DrawCall::COLORMAP_TEXTURE_UNIT, mesh.colormap_lut);
+        }
+    }
+    if (uniforms.face_data_flags != nullptr)
+    {
+        uniforms.face_data_flags->set(mesh.face_data_flags);
+        if (mesh.face_data > 0)
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawCall::FACE_DATA_BINDING,
+                             mesh.face_data);
+        }
+    }
+    if (uniforms.position_decode_offset != nullptr)
+    {
+        uniforms.position_decode_offset->set(mesh.position_decode_offset);
+    }
+    if (uniforms.position_decode_scale != nullptr)
+    {
+        uniforms.position_decode_scale->set(mesh.position_decode_scale);
+    }
+    if (uniforms.vertex_format_flags != nullptr)
+    {
+        uniforms.vertex_format_flags->set(mesh.vertex_format_flags);
+    }
+}
+
+void GLRenderer::drawMesh(const DrawCall::MeshInfo &mesh,
+                          const ShaderProgram::MeshUniforms &uniforms)
+{
+    setMeshUniforms(mesh, uniforms);
+    glBindVertexArray(mesh.vao);
+    if (!mesh.indexed)
+    {
+        if (mesh.instanced)
+        {
+            glDrawArraysInstanced(mesh.primitive, mesh.base_vertex, mesh.num_data,
+                                  mesh.num_instances);
+        }
+        else
+        {
+            glDrawArrays(mesh.primitive, mesh.base_vertex, mesh.num_data);
+        }
+    }
+    else
+    {
+        const size_t index_size =
+            mesh.index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        void *first_index = (void *)(size_t(mesh.first_index) * index_size);
+        if (mesh.instanced)
+        {
+            glDrawElementsInstancedBaseVertex(mesh.primitive, mesh.num_data, mesh.index_type,
+                                              first_index, mesh.num_instances, mesh.base_vertex);
+        }
+        else
+        {
+            glDrawElementsBaseVertex(mesh.primitive, mesh.num_data, mesh.index_type, first_index,
+                                     mesh.base_vertex);
+        }
+    }
+    for (const DrawCall::MeshInfo &child : mesh.children)
+    {
+        drawMesh(child, uniforms);
     }
-    glDisable(GL_SCISSOR_TEST);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
 void GLRenderer::drawTexture(const RenderTarget &render_target, std::shared_ptr<Texture2D> texture)
@@ -366,6 +455,37 @@ DrawCall::MeshInfo GLRenderer::getDrawCallMeshInfo(std::shared_ptr<Mesh> mesh)
     mesh_info.num_data = GLsizei(mesh_info.indexed ? mesh->numIndexData() : mesh->numVertexData());
     mesh_info.primitive = static_cast<GLenum>(mesh->primitive());
     mesh_info.vao = mesh->vao();
+    mesh_info.base_vertex = GLint(mesh->baseVertex());
+    mesh_info.first_index = GLuint(mesh->firstIndex());
+    mesh_info.index_type = mesh->indexType();
+    mesh_info.instanced = mesh->instanced();
+    mesh_info.num_instances = GLsizei(mesh->numInstances());
+    const GlyphParameters &glyph = mesh->glyphParameters();
+    mesh_info.glyph_params = glm::vec4(glyph.scale_by_magnitude ? 1.f : 0.f, glyph.max_length,
+                                       1.f / std::max(glyph.max_magnitude, 1e-6f), glyph.size);
+    const ColormapParameters &cmap = mesh->colormapParameters();
+    if (cmap.lut != nullptr && cmap.lut->valid())
+    {
+        mesh_info.colormap_lut = cmap.lut->id();
+        const float range = cmap.vmax - cmap.vmin;
+        mesh_info.colormap_params = glm::vec4(
+            1.f, cmap.vmin, std::abs(range) > 1e-12f ? 1.f / range : 0.f, 0.f);
+    }
+    const FaceDataParameters &face_data = mesh->faceData();
+    if (face_data.buffer != nullptr && face_data.buffer->size() > 0)
+    {
+        mesh_info.face_data = face_data.buffer->id();
+        mesh_info.face_data_flags =
+            (face_data.colors ? 1 : 0) | (face_data.scalars ? 2 : 0) | (face_data.wires ? 4 : 0);
+    }
+    mesh_info.position_decode_offset = mesh->positionDecodeOffset();
+    mesh_info.position_decode_scale = mesh->positionDecodeScale();
+    mesh_info.vertex_format_flags = mesh->vertexFormatFlags();
+    mesh_info.children.reserve(mesh->children().size());
+    for (const std::shared_ptr<Mesh> &child : mesh->children())
+    {
+        mesh_info.children.push_back(getDrawCallMeshInfo(child));
+    }
     return mesh_info;
 }
 
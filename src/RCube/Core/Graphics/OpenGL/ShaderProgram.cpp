@@ -75,6 +75,17 @@ ShaderProgram::create(const std::vector<std::string> &vertex_shader,
     return prog;
 }
 
+std::shared_ptr<ShaderProgram>
+ShaderProgram::createCompute(const std::vector<std::string> &compute_shader, bool debug)
+{
+    auto prog = std::make_shared<ShaderProgram>();
+    prog->addShader(GL_COMPUTE_SHADER, compute_shader, debug);
+    prog->link(debug);
+    prog->generateUniforms();
+
+    return prog;
+}
+
 void ShaderProgram::release()
 {
     if (location_ != 0)
@@ -191,6 +202,10 @@ void ShaderProgram::addShader(GLuint type, const std::vector<std::string> &sourc
             {
                 str_type = "geometry";
             }
+            else if (type == GL_COMPUTE_SHADER)
+            {
+                str_type = "compute";
+            }
             std::cerr << "Compilation error in " << str_type << " shader:\n" << log << std::endl;
         }
         throw std::runtime_error("Unable to compile shader");
@@ -247,6 +262,16 @@ void ShaderProgram::generateUniforms()
         GLDataType gldatatype = getGLDataType(type);
         uniforms_[name] = Uniform(name, gldatatype, id());
     }
+    auto find = [this](const std::string &uniform_name) -> Uniform * {
+        auto it = uniforms_.find(uniform_name);
+        return it != uniforms_.end() ? &it->second : nullptr;
+    };
+    mesh_uniforms_.glyph_params = find("glyph_params");
+    mesh_uniforms_.colormap_params = find("colormap_params");
+    mesh_uniforms_.face_data_flags = find("face_data_flags");
+    mesh_uniforms_.position_decode_offset = find("position_decode_offset");
+    mesh_uniforms_.position_decode_scale = find("position_decode_scale");
+    mesh_uniforms_.vertex_format_flags = find("vertex_format_flags");
 }
 
 const std::unordered_map<std::string, ShaderAttributeDesc> &ShaderProgram::attributes() const
@@ -264,6 +289,10 @@ bool ShaderProgram::hasUniform(std::string name, Uniform &uni)
     uni = it->second;
     return true;
 }
+const ShaderProgram::MeshUniforms &ShaderProgram::meshUniforms() const
+{
+    return mesh_uniforms_;
+}
 const Uniform &ShaderProgram::uniform(std::string name) const
 {
     return uniforms_.at(name);
@@ -0,0 +1,104 @@
+#include "RCube/Core/Graphics/OpenGL/StreamingBuffer.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace rcube
+{
+
+std::shared_ptr<StreamingBuffer> StreamingBuffer::create(size_t region_size)
+{
+    auto buf = std::shared_ptr<StreamingBuffer>(new StreamingBuffer());
+    // Keep every region aligned for any vertex attribute or storage buffer binding
+    buf->region_size_ = (std::max(region_size, size_t(1)) + 255) / 256 * 256;
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr total = GLsizeiptr(buf->region_size_ * NUM_REGIONS);
+    glCreateBuffers(1, &buf->id_);
+    glNamedBufferStorage(buf->id_, total, nullptr, flags);
+    buf->mapped_ = static_cast<char *>(glMapNamedBufferRange(buf->id_, 0, total, flags));
+    if (buf->mapped_ == nullptr)
+    {
+        throw std::runtime_error("Unable to map streaming buffer of size " +
+                                 std::to_string(total));
+    }
+    return buf;
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+    for (GLsync &fence : fences_)
+    {
+        if (fence != nullptr)
+        {
+            glDeleteSync(fence);
+        }
+    }
+    if (id_ > 0)
+    {
+        glUnmapNamedBuffer(id_);
+        // Deletion is deferred by OpenGL until pending draws no longer use the buffer
+        glDeleteBuffers(1, &id_);
+    }
+}
+
+void StreamingBuffer::waitForRegion(size_t region)
+{
+    GLsync &fence = fences_[region];
+    if (fence == nullptr)
+    {
+        return;
+    }
+    // Flush on the first wait so that the fence is guaranteed to be signaled eventually
+    GLbitfield wait_flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true)
+    {
+        GLenum result = glClientWaitSync(fence, wait_flags, 1000000);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+        {
+            break;
+        }
+        if (result == GL_WAIT_FAILED)
+        {
+            throw std::runtime_error("Waiting for a streaming buffer region failed");
+        }
+        wait_flags = 0;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void StreamingBuffer::write(const void *data, size_t bytes)
+{
+    if (bytes > region_size_)
+    {
+        throw std::runtime_error("Attempting to write " + std::to_string(bytes) +
+                                 " bytes into a streaming buffer region of size " +
+                                 std::to_string(region_size_));
+    }
+    // The draws reading the previous region have been issued by now, so fence it
+    if (current_ < NUM_REGIONS)
+    {
+        fences_[current_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    current_ = current_ < NUM_REGIONS ? (current_ + 1) % NUM_REGIONS : 0;
+    waitForRegion(current_);
+    std::memcpy(mapped_ + offset(), data, bytes);
+}
+
+size_t StreamingBuffer::offset() const
+{
+    return current_ < NUM_REGIONS ? current_ * region_size_ : 0;
+}
+
+size_t StreamingBuffer::regionSize() const
+{
+    return region_size_;
+}
+
+GLuint StreamingBuffer::id() const
+{
+    return id_;
+}
+
+} // namespace rcube
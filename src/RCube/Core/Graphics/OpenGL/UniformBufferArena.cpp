@@ -0,0 +1,154 @@
+#include "RCube/Core/Graphics/OpenGL/UniformBufferArena.h"
+#include <algorithm>
+#include <iterator>
+
+namespace rcube
+{
+
+UniformBufferArena &UniformBufferArena::instance()
+{
+    static UniformBufferArena arena;
+    return arena;
+}
+
+size_t UniformBufferArena::align(size_t bytes) const
+{
+    return (bytes + alignment_ - 1) / alignment_ * alignment_;
+}
+
+void UniformBufferArena::grow(size_t min_capacity)
+{
+    size_t new_capacity = std::max(capacity_ * 2, size_t(16384));
+    while (new_capacity < min_capacity)
+    {
+        new_capacity *= 2;
+    }
+    auto new_ubo = UniformBuffer::create(new_capacity, GL_DYNAMIC_DRAW);
+    if (ubo_ != nullptr && capacity_ > 0)
+    {
+        glCopyNamedBufferSubData(ubo_->id(), new_ubo->id(), 0, 0, capacity_);
+    }
+    // The newly added range at the end is free; merge with a trailing free range if any
+    size_t start = capacity_;
+    size_t size = new_capacity - capacity_;
+    if (!free_ranges_.empty())
+    {
+        auto last = std::prev(free_ranges_.end());
+        if (last->first + last->second == capacity_)
+        {
+            start = last->first;
+            size += last->second;
+            free_ranges_.erase(last);
+        }
+    }
+    free_ranges_[start] = size;
+    ubo_ = new_ubo;
+    capacity_ = new_capacity;
+}
+
+UniformBufferArena::Block UniformBufferArena::allocate(size_t bytes)
+{
+    if (alignment_ == 0)
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment_ = static_cast<size_t>(std::max(alignment, 16));
+    }
+    const size_t aligned_size = align(std::max(bytes, size_t(16)));
+    // First fit
+    auto it = std::find_if(free_ranges_.begin(), free_ranges_.end(),
+                           [aligned_size](const auto &r) { return r.second >= aligned_size; });
+    if (it == free_ranges_.end())
+    {
+        grow(capacity_ + aligned_size);
+        it = std::find_if(free_ranges_.begin(), free_ranges_.end(),
+                          [aligned_size](const auto &r) { return r.second >= aligned_size; });
+    }
+    Block block;
+    block.offset = it->first;
+    block.size = aligned_size;
+    block.generation = generation_;
+    const size_t remaining = it->second - aligned_size;
+    free_ranges_.erase(it);
+    if (remaining > 0)
+    {
+        free_ranges_[block.offset + aligned_size] = remaining;
+    }
+    used_ += aligned_size;
+    return block;
+}
+
+void UniformBufferArena::free(Block &block)
+{
+    if (!owns(block))
+    {
+        block = Block();
+        return;
+    }
+    size_t start = block.offset;
+    size_t size = block.size;
+    // Merge with the following free range
+    auto next = free_ranges_.find(start + size);
+    if (next != free_ranges_.end())
+    {
+        size += next->second;
+        free_ranges_.erase(next);
+    }
+    // Merge with the preceding free range
+    auto prev = free_ranges_.lower_bound(start);
+    if (prev != free_ranges_.begin())
+    {
+        --prev;
+        if (prev->first + prev->second == start)
+        {
+            start = prev->first;
+            size += prev->second;
+            free_ranges_.erase(prev);
+        }
+    }
+    free_ranges_[start] = size;
+    used_ -= block.size;
+    block = Block();
+}
+
+bool UniformBufferArena::owns(const Block &block) const
+{
+    return block.valid() && block.generation == generation_;
+}
+
+void UniformBufferArena::release()
+{
+    if (ubo_ != nullptr)
+    {
+        ubo_->release();
+    }
+    ubo_ = nullptr;
+    capacity_ = 0;
+    used_ = 0;
+    free_ranges_.clear();
+    ++generation_;
+}
+
+void UniformBufferArena::write(const Block &block, const void *data, size_t bytes)
+{
+    assert(owns(block) && bytes <= block.size);
+    ubo_->setData(data, bytes, block.offset);
+}
+
+void UniformBufferArena::bind(const Block &block, int index)
+{
+    assert(owns(block));
+    ubo_->bindRange(index, block.offset, block.size);
+}
+
+size_t UniformBufferArena::capacity() const
+{
+    return capacity_;
+}
+
+size_t UniformBufferArena::used() const
+{
+    return used_;
+}
+
+} // namespace rcube
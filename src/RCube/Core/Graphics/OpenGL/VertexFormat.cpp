@@ -0,0 +1,331 @@
+#include "RCube/Core/Graphics/OpenGL/VertexFormat.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace rcube
+{
+
+GLint formatComponents(AttributeFormat format, size_t dim)
+{
+    switch (format)
+    {
+    case AttributeFormat::Float32:
+        return GLint(dim);
+    case AttributeFormat::Float16:
+    case AttributeFormat::Snorm16:
+        return GLint((dim + 1) / 2 * 2);
+    case AttributeFormat::Oct16:
+        return 2;
+    case AttributeFormat::Unorm8:
+        return 4;
+    }
+    return GLint(dim);
+}
+
+GLenum formatType(AttributeFormat format)
+{
+    switch (format)
+    {
+    case AttributeFormat::Float32:
+        return GL_FLOAT;
+    case AttributeFormat::Float16:
+        return GL_HALF_FLOAT;
+    case AttributeFormat::Snorm16:
+    case AttributeFormat::Oct16:
+        return GL_SHORT;
+    case AttributeFormat::Unorm8:
+        return GL_UNSIGNED_BYTE;
+    }
+    return GL_FLOAT;
+}
+
+GLboolean formatNormalized(AttributeFormat format)
+{
+    return format == AttributeFormat::Snorm16 || format == AttributeFormat::Oct16 ||
+                   format == AttributeFormat::Unorm8
+               ? GL_TRUE
+               : GL_FALSE;
+}
+
+size_t formatStride(AttributeFormat format, size_t dim)
+{
+    size_t component_size = 4;
+    if (format == AttributeFormat::Float16 || format == AttributeFormat::Snorm16 ||
+        format == AttributeFormat::Oct16)
+    {
+        component_size = 2;
+    }
+    else if (format == AttributeFormat::Unorm8)
+    {
+        component_size = 1;
+    }
+    return size_t(formatComponents(format, dim)) * component_size;
+}
+
+std::string formatName(AttributeFormat format)
+{
+    switch (format)
+    {
+    case AttributeFormat::Float32:
+        return "Float32";
+    case AttributeFormat::Float16:
+        return "Float16";
+    case AttributeFormat::Snorm16:
+        return "Snorm16";
+    case AttributeFormat::Oct16:
+        return "Oct16";
+    case AttributeFormat::Unorm8:
+        return "Unorm8";
+    }
+    return "";
+}
+
+uint16_t packHalf(float value)
+{
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    const uint32_t sign = (f >> 16) & 0x8000u;
+    const uint32_t abs = f & 0x7fffffffu;
+    // Infinity and NaN
+    if (abs >= 0x7f800000u)
+    {
+        return uint16_t(sign | (abs > 0x7f800000u ? 0x7e00u : 0x7c00u));
+    }
+    // Values that round to more than the largest half overflow to infinity
+    if (abs >= 0x477ff000u)
+    {
+        return uint16_t(sign | 0x7c00u);
+    }
+    // Subnormal halves (below 2^-14); below 2^-25 everything rounds to zero
+    if (abs < 0x38800000u)
+    {
+        if (abs < 0x33000000u)
+        {
+            return uint16_t(sign);
+        }
+        const uint32_t exponent = abs >> 23;
+        const uint32_t mantissa = (abs & 0x7fffffu) | 0x800000u;
+        const uint32_t shift = 126u - exponent;
+        uint32_t h = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1u);
+        const uint32_t halfway = 1u << (shift - 1u);
+        if (rest > halfway || (rest == halfway && (h & 1u)))
+        {
+            ++h;
+        }
+        return uint16_t(sign | h);
+    }
+    // Rebias the exponent from 127 to 15 and drop 13 bits of the mantissa; a carry out of the
+    // mantissa correctly increments the exponent
+    uint32_t h = (abs - 0x38000000u) >> 13;
+    const uint32_t rest = abs & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (h & 1u)))
+    {
+        ++h;
+    }
+    return uint16_t(sign | h);
+}
+
+float unpackHalf(uint16_t value)
+{
+    const uint32_t sign = uint32_t(value & 0x8000u) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1fu;
+    const uint32_t mantissa = value & 0x3ffu;
+    uint32_t f;
+    if (exponent == 0)
+    {
+        const float v = std::ldexp(float(mantissa), -24);
+        return sign != 0 ? -v : v;
+    }
+    else if (exponent == 31)
+    {
+        f = sign | 0x7f800000u | (mantissa << 13);
+    }
+    else
+    {
+        f = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    }
+    float result;
+    std::memcpy(&result, &f, sizeof(f));
+    return result;
+}
+
+static float signNotZero(float v)
+{
+    return v >= 0.f ? 1.f : -1.f;
+}
+
+glm::vec2 octEncode(const glm::vec3 &n)
+{
+    const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 == 0.f)
+    {
+        return glm::vec2(0.f);
+    }
+    glm::vec2 e = glm::vec2(n.x, n.y) / l1;
+    // Fold the lower hemisphere over the diagonals
+    if (n.z < 0.f)
+    {
+        e = glm::vec2((1.f - std::abs(e.y)) * signNotZero(e.x),
+                      (1.f - std::abs(e.x)) * signNotZero(e.y));
+    }
+    return e;
+}
+
+glm::vec3 octDecode(const glm::vec2 &e)
+{
+    glm::vec3 v(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+    const float t = std::max(-v.z, 0.f);
+    v.x += v.x >= 0.f ? -t : t;
+    v.y += v.y >= 0.f ? -t : t;
+    return glm::normalize(v);
+}
+
+static int16_t toSnorm16(float v)
+{
+    return int16_t(std::lround(std::clamp(v, -1.f, 1.f) * 32767.f));
+}
+
+static float fromSnorm16(int16_t v)
+{
+    return std::max(float(v) / 32767.f, -1.f);
+}
+
+void packElements(AttributeFormat format, size_t dim, const float *src, size_t count,
+                  const glm::vec4 &offset, const glm::vec4 &scale, void *dst)
+{
+    const size_t components = size_t(formatComponents(format, dim));
+    switch (format)
+    {
+    case AttributeFormat::Float32:
+        std::memcpy(dst, src, count * dim * sizeof(float));
+        break;
+    case AttributeFormat::Float16:
+    {
+        uint16_t *out = static_cast<uint16_t *>(dst);
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (size_t c = 0; c < components; ++c)
+            {
+                out[i * components + c] = c < dim ? packHalf(src[i * dim + c]) : 0;
+            }
+        }
+        break;
+    }
+    case AttributeFormat::Snorm16:
+    {
+        if (dim > 4)
+        {
+            throw std::runtime_error("Snorm16 format supports at most 4 components");
+        }
+        int16_t *out = static_cast<int16_t *>(dst);
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (size_t c = 0; c < components; ++c)
+            {
+                out[i * components + c] =
+                    c < dim ? toSnorm16((src[i * dim + c] - offset[c]) / scale[c]) : 0;
+            }
+        }
+        break;
+    }
+    case AttributeFormat::Oct16:
+    {
+        if (dim != 3)
+        {
+            throw std::runtime_error("Oct16 format requires 3D data");
+        }
+        int16_t *out = static_cast<int16_t *>(dst);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const glm::vec2 e = octEncode(glm::vec3(src[3 * i], src[3 * i + 1], src[3 * i + 2]));
+            out[2 * i] = toSnorm16(e.x);
+            out[2 * i + 1] = toSnorm16(e.y);
+        }
+        break;
+    }
+    case AttributeFormat::Unorm8:
+    {
+        if (dim > 4)
+        {
+            throw std::runtime_error("Unorm8 format supports at most 4 components");
+        }
+        uint8_t *out = static_cast<uint8_t *>(dst);
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (size_t c = 0; c < 4; ++c)
+            {
+                out[4 * i + c] =
+                    c < dim ? uint8_t(std::lround(std::clamp(src[i * dim + c], 0.f, 1.f) * 255.f))
+                            : 255;
+            }
+        }
+        break;
+    }
+    }
+}
+
+void unpackElements(AttributeFormat format, size_t dim, const void *src, size_t count,
+                    const glm::vec4 &offset, const glm::vec4 &scale, float *dst)
+{
+    const size_t components = size_t(formatComponents(format, dim));
+    switch (format)
+    {
+    case AttributeFormat::Float32:
+        std::memcpy(dst, src, count * dim * sizeof(float));
+        break;
+    case AttributeFormat::Float16:
+    {
+        const uint16_t *in = static_cast<const uint16_t *>(src);
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (size_t c = 0; c < dim; ++c)
+            {
+                dst[i * dim + c] = unpackHalf(in[i * components + c]);
+            }
+        }
+        break;
+    }
+    case AttributeFormat::Snorm16:
+    {
+        const int16_t *in = static_cast<const int16_t *>(src);
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (size_t c = 0; c < dim; ++c)
+            {
+                dst[i * dim + c] = offset[c] + scale[c] * fromSnorm16(in[i * components + c]);
+            }
+        }
+        break;
+    }
+    case AttributeFormat::Oct16:
+    {
+        const int16_t *in = static_cast<const int16_t *>(src);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const glm::vec3 n =
+                octDecode(glm::vec2(fromSnorm16(in[2 * i]), fromSnorm16(in[2 * i + 1])));
+            dst[3 * i] = n.x;
+            dst[3 * i + 1] = n.y;
+            dst[3 * i + 2] = n.z;
+        }
+        break;
+    }
+    case AttributeFormat::Unorm8:
+    {
+        const uint8_t *in = static_cast<const uint8_t *>(src);
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (size_t c = 0; c < dim; ++c)
+            {
+                dst[i * dim + c] = float(in[4 * i + c]) / 255.f;
+            }
+        }
+        break;
+    }
+    }
+}
+
+} // namespace rcube
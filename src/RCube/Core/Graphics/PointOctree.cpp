@@ -0,0 +1,695 @@
+#include "RCube/Core/Graphics/PointOctree.h"
+#include "RCube/Helpers/ParallelChunks.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace rcube
+{
+
+// Below this many points per thread, a batch is binned on fewer threads
+constexpr size_t MIN_BINNING_POINTS_PER_THREAD = 65536;
+
+const static char HIERARCHY_MAGIC[4] = {'R', 'C', 'P', 'O'};
+const static uint32_t HIERARCHY_VERSION = 1;
+
+// A point in the chunk files and in octree.bin: its position relative to the minimum of the
+// root cube and its color
+struct PointRecord
+{
+    float x, y, z;
+    uint8_t r, g, b, a;
+};
+static_assert(sizeof(PointRecord) == 16, "Point records must be 16 bytes");
+
+// Nodes are named after their path from the root: "r" followed by the octant of each level
+static std::string childName(const std::string &name, int octant)
+{
+    return name + char('0' + octant);
+}
+
+// Minimum corner, relative to the root's, and size of the cube of a node
+static void nodeCube(const std::string &name, float root_size, glm::vec3 &min, float &size)
+{
+    min = glm::vec3(0.f);
+    size = root_size;
+    for (size_t i = 1; i < name.size(); ++i)
+    {
+        const int octant = name[i] - '0';
+        size *= 0.5f;
+        min += size * glm::vec3(float(octant & 1), float((octant >> 1) & 1),
+                                float((octant >> 2) & 1));
+    }
+}
+
+static int octantOf(const PointRecord &p, const glm::vec3 &center)
+{
+    return (p.x >= center.x ? 1 : 0) | (p.y >= center.y ? 2 : 0) | (p.z >= center.z ? 4 : 0);
+}
+
+static void appendRecords(const std::filesystem::path &path, const PointRecord *records,
+                          size_t count)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    if (!file.write(reinterpret_cast<const char *>(records), count * sizeof(PointRecord)))
+    {
+        throw std::runtime_error("Unable to write " + path.string());
+    }
+}
+
+// Moves the point closest to the center of each cell of a node's sampling grid from points
+// into the returned vector
+static std::vector<PointRecord> samplePoints(std::vector<PointRecord> &points,
+                                             const glm::vec3 &cube_min, float cube_size,
+                                             size_t grid_size)
+{
+    const float cell_size = cube_size / float(grid_size);
+    const uint64_t last = grid_size - 1;
+    std::vector<uint64_t> keys(points.size());
+    std::vector<float> distances(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        const glm::vec3 p = (glm::vec3(points[i].x, points[i].y, points[i].z) - cube_min) /
+                            cell_size;
+        const uint64_t x = std::min(uint64_t(std::max(p.x, 0.f)), last);
+        const uint64_t y = std::min(uint64_t(std::max(p.y, 0.f)), last);
+        const uint64_t z = std::min(uint64_t(std::max(p.z, 0.f)), last);
+        keys[i] = (z * grid_size + y) * grid_size + x;
+        const glm::vec3 d = p - (glm::vec3(float(x), float(y), float(z)) + 0.5f);
+        distances[i] = glm::dot(d, d);
+    }
+    std::vector<uint32_t> order(points.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return keys[a] < keys[b] || (keys[a] == keys[b] && distances[a] < distances[b]);
+    });
+    std::vector<PointRecord> sampled;
+    std::vector<PointRecord> rest;
+    rest.reserve(points.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const bool first_in_cell = i == 0 || keys[order[i]] != keys[order[i - 1]];
+        (first_in_cell ? sampled : rest).push_back(points[order[i]]);
+    }
+    points.swap(rest);
+    return sampled;
+}
+
+namespace
+{
+
+// Writes the points of the nodes to octree.bin as they are indexed
+class NodeWriter
+{
+  public:
+    explicit NodeWriter(const std::filesystem::path &path)
+        : path_(path), file_(path, std::ios::binary | std::ios::trunc)
+    {
+        if (!file_)
+        {
+            throw std::runtime_error("Unable to write " + path.string());
+        }
+    }
+
+    void write(const std::string &name, const std::vector<PointRecord> &points)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_.write(reinterpret_cast<const char *>(points.data()),
+                         points.size() * sizeof(PointRecord)))
+        {
+            throw std::runtime_error("Unable to write " + path_.string());
+        }
+        nodes_[name] = {num_points_, points.size()};
+        num_points_ += points.size();
+    }
+
+    // Copies the points of a node from a file, batch_points at a time
+    void write(const std::string &name, const std::filesystem::path &path, size_t num_points,
+               size_t batch_points)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<PointRecord> batch(std::min(batch_points, num_points));
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t done = 0; done < num_points;)
+        {
+            const size_t count = std::min(batch.size(), num_points - done);
+            if (!file.read(reinterpret_cast<char *>(batch.data()), count * sizeof(PointRecord)))
+            {
+                throw std::runtime_error("Unable to read " + path.string());
+            }
+            if (!file_.write(reinterpret_cast<const char *>(batch.data()),
+                             count * sizeof(PointRecord)))
+            {
+                throw std::runtime_error("Unable to write " + path_.string());
+            }
+            done += count;
+        }
+        nodes_[name] = {num_points_, num_points};
+        num_points_ += num_points;
+    }
+
+    // First point and number of points of each node
+    const std::map<std::string, std::pair<uint64_t, size_t>> &nodes() const
+    {
+        return nodes_;
+    }
+
+  private:
+    std::filesystem::path path_;
+    std::ofstream file_;
+    std::mutex mutex_;
+    std::map<std::string, std::pair<uint64_t, size_t>> nodes_;
+    uint64_t num_points_ = 0;
+};
+
+struct Chunk
+{
+    std::string name;
+    size_t num_points;
+};
+
+} // namespace
+
+// Indexes the points of a node and its descendants in memory
+static void indexSubtree(const std::string &name, std::vector<PointRecord> &points,
+                         float root_size, const PointOctreeOptions &options, NodeWriter &writer)
+{
+    if (points.size() <= options.max_leaf_points || name.size() > options.max_depth)
+    {
+        writer.write(name, points);
+        return;
+    }
+    glm::vec3 cube_min;
+    float cube_size;
+    nodeCube(name, root_size, cube_min, cube_size);
+    writer.write(name, samplePoints(points, cube_min, cube_size, options.grid_size));
+    const glm::vec3 center = cube_min + 0.5f * cube_size;
+    std::array<std::vector<PointRecord>, 8> children;
+    for (const PointRecord &p : points)
+    {
+        children[octantOf(p, center)].push_back(p);
+    }
+    points.clear();
+    points.shrink_to_fit();
+    for (int octant = 0; octant < 8; ++octant)
+    {
+        if (!children[octant].empty())
+        {
+            indexSubtree(childName(name, octant), children[octant], root_size, options, writer);
+        }
+    }
+}
+
+// Splits a chunk file into files of its octants
+static void splitChunk(const std::filesystem::path &tmp, const Chunk &chunk, float root_size,
+                       size_t batch_points, std::vector<Chunk> &children)
+{
+    const std::filesystem::path path = tmp / (chunk.name + ".bin");
+    glm::vec3 cube_min;
+    float cube_size;
+    nodeCube(chunk.name, root_size, cube_min, cube_size);
+    const glm::vec3 center = cube_min + 0.5f * cube_size;
+    std::array<size_t, 8> counts = {};
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<PointRecord> batch(batch_points);
+        std::array<std::vector<PointRecord>, 8> octants;
+        for (size_t done = 0; done < chunk.num_points;)
+        {
+            const size_t count = std::min(batch_points, chunk.num_points - done);
+            if (!file.read(reinterpret_cast<char *>(batch.data()), count * sizeof(PointRecord)))
+            {
+                throw std::runtime_error("Unable to read " + path.string());
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                octants[octantOf(batch[i], center)].push_back(batch[i]);
+            }
+            for (int octant = 0; octant < 8; ++octant)
+            {
+                if (!octants[octant].empty())
+                {
+                    appendRecords(tmp / (childName(chunk.name, octant) + ".bin"),
+                                  octants[octant].data(), octants[octant].size());
+                    counts[octant] += octants[octant].size();
+                    octants[octant].clear();
+                }
+            }
+            done += count;
+        }
+    }
+    std::filesystem::remove(path);
+    for (int octant = 0; octant < 8; ++octant)
+    {
+        if (counts[octant] > 0)
+        {
+            children.push_back({childName(chunk.name, octant), counts[octant]});
+        }
+    }
+}
+
+PointOctreeStats buildPointOctree(PointSource &source, const std::string &directory,
+                                  const PointOctreeOptions &options)
+{
+    const std::filesystem::path dir(directory);
+    const std::filesystem::path tmp = dir / "chunks";
+    std::filesystem::create_directories(tmp);
+    for (const auto &entry : std::filesystem::directory_iterator(tmp))
+    {
+        std::filesystem::remove(entry.path());
+    }
+    const size_t batch_points = std::max<size_t>(options.batch_points, 1);
+
+    // The root is the cube around the bounding box, slightly enlarged so that the points on
+    // its maximum faces fall inside
+    const AABB box = source.bounds();
+    const glm::vec3 root_min = box.isNull() ? glm::vec3(0.f) : box.min();
+    const glm::vec3 extent = box.isNull() ? glm::vec3(0.f) : box.max() - box.min();
+    float root_size = std::max(extent.x, std::max(extent.y, extent.z)) * 1.0001f;
+    if (!(root_size > 0.f))
+    {
+        root_size = 1.f;
+    }
+
+    // Distribute the points into the chunk files in batches
+    const size_t chunk_depth = std::min<size_t>(options.chunk_depth, 7);
+    const size_t cells = size_t(1) << chunk_depth;
+    std::vector<std::string> chunk_names(cells * cells * cells);
+    for (size_t i = 0; i < chunk_names.size(); ++i)
+    {
+        const size_t x = i % cells, y = (i / cells) % cells, z = i / (cells * cells);
+        std::string name = "r";
+        for (size_t level = 0; level < chunk_depth; ++level)
+        {
+            const size_t bit = chunk_depth - 1 - level;
+            name = childName(name, int(((x >> bit) & 1) | (((y >> bit) & 1) << 1) |
+                                       (((z >> bit) & 1) << 2)));
+        }
+        chunk_names[i] = name;
+    }
+    std::vector<size_t> chunk_counts(chunk_names.size(), 0);
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> colors;
+    std::vector<uint32_t> chunk_of;
+    std::vector<PointRecord> records;
+    std::vector<size_t> offsets;
+    size_t num_points = 0;
+    while (true)
+    {
+        positions.clear();
+        colors.clear();
+        const size_t count = source.read(batch_points, positions, colors);
+        if (count == 0)
+        {
+            break;
+        }
+        const bool has_colors = colors.size() == count;
+        chunk_of.resize(count);
+        parallelChunks(count, MIN_BINNING_POINTS_PER_THREAD,
+                       [&](size_t, size_t begin, size_t end) {
+                           for (size_t i = begin; i < end; ++i)
+                           {
+                               const glm::vec3 p = (positions[i] - root_min) / root_size;
+                               size_t c[3];
+                               for (int k = 0; k < 3; ++k)
+                               {
+                                   c[k] = std::min(size_t(std::max(p[k], 0.f) * cells),
+                                                   cells - 1);
+                               }
+                               chunk_of[i] = uint32_t((c[2] * cells + c[1]) * cells + c[0]);
+                           }
+                       });
+        // Sort the batch by chunk with a counting sort and append each chunk's points
+        offsets.assign(chunk_names.size() + 1, 0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            ++offsets[chunk_of[i] + 1];
+        }
+        for (size_t c = 0; c < chunk_names.size(); ++c)
+        {
+            offsets[c + 1] += offsets[c];
+        }
+        records.resize(count);
+        std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const glm::vec3 p = positions[i] - root_min;
+            const glm::vec3 col =
+                has_colors ? glm::clamp(colors[i], 0.f, 1.f) * 255.f + 0.5f : glm::vec3(255.f);
+            records[next[chunk_of[i]]++] = {p.x, p.y, p.z, uint8_t(col.x), uint8_t(col.y),
+                                            uint8_t(col.z), uint8_t(255)};
+        }
+        for (size_t c = 0; c < chunk_names.size(); ++c)
+        {
+            const size_t n = offsets[c + 1] - offsets[c];
+            if (n > 0)
+            {
+                appendRecords(tmp / (chunk_names[c] + ".bin"), &records[offsets[c]], n);
+                chunk_counts[c] += n;
+            }
+        }
+        num_points += count;
+    }
+    positions = std::vector<glm::vec3>();
+    colors = std::vector<glm::vec3>();
+    records = std::vector<PointRecord>();
+
+    // Split the chunks that do not fit in memory
+    std::vector<Chunk> pending;
+    for (size_t c = 0; c < chunk_names.size(); ++c)
+    {
+        if (chunk_counts[c] > 0)
+        {
+            pending.push_back({chunk_names[c], chunk_counts[c]});
+        }
+    }
+    std::vector<Chunk> chunks;
+    while (!pending.empty())
+    {
+        const Chunk chunk = pending.back();
+        pending.pop_back();
+        if (chunk.num_points > options.max_chunk_points && chunk.name.size() <= options.max_depth)
+        {
+            splitChunk(tmp, chunk, root_size, batch_points, pending);
+        }
+        else
+        {
+            chunks.push_back(chunk);
+        }
+    }
+
+    // Index the chunks in parallel, largest first. A chunk also samples the nodes above it
+    // within its cube; their points are appended to a file per node and copied to octree.bin
+    // once all chunks are done, so that they are never held in memory together.
+    std::sort(chunks.begin(), chunks.end(),
+              [](const Chunk &a, const Chunk &b) { return a.num_points > b.num_points; });
+    NodeWriter writer(dir / "octree.bin");
+    auto upper_path = [&tmp](const std::string &name) { return tmp / ("upper_" + name + ".bin"); };
+    std::mutex upper_mutex;
+    // Number of points in the file of each node above the chunks
+    std::map<std::string, size_t> upper_counts;
+    std::atomic<size_t> next_chunk(0);
+    parallelChunks(numParallelChunks(chunks.size(), 1), 1, [&](size_t, size_t, size_t) {
+        for (size_t c = next_chunk++; c < chunks.size(); c = next_chunk++)
+        {
+            const Chunk &chunk = chunks[c];
+            const std::filesystem::path path = tmp / (chunk.name + ".bin");
+            std::vector<PointRecord> points(chunk.num_points);
+            {
+                std::ifstream file(path, std::ios::binary);
+                if (!file.read(reinterpret_cast<char *>(points.data()),
+                               points.size() * sizeof(PointRecord)))
+                {
+                    throw std::runtime_error("Unable to read " + path.string());
+                }
+            }
+            std::filesystem::remove(path);
+            for (size_t level = 0; level + 1 < chunk.name.size() && !points.empty(); ++level)
+            {
+                const std::string ancestor = chunk.name.substr(0, level + 1);
+                glm::vec3 cube_min;
+                float cube_size;
+                nodeCube(ancestor, root_size, cube_min, cube_size);
+                std::vector<PointRecord> sampled =
+                    samplePoints(points, cube_min, cube_size, options.grid_size);
+                std::lock_guard<std::mutex> lock(upper_mutex);
+                appendRecords(upper_path(ancestor), sampled.data(), sampled.size());
+                upper_counts[ancestor] += sampled.size();
+            }
+            if (!points.empty())
+            {
+                indexSubtree(chunk.name, points, root_size, options, writer);
+            }
+        }
+    });
+    for (const auto &kv : upper_counts)
+    {
+        writer.write(kv.first, upper_path(kv.first), kv.second, batch_points);
+        std::filesystem::remove(upper_path(kv.first));
+    }
+    std::filesystem::remove(tmp);
+
+    // Hierarchy: the nodes sorted by level, each with its name, first point and point count
+    std::vector<std::string> names;
+    names.reserve(writer.nodes().size());
+    for (const auto &kv : writer.nodes())
+    {
+        names.push_back(kv.first);
+    }
+    std::stable_sort(names.begin(), names.end(), [](const std::string &a, const std::string &b) {
+        return a.size() < b.size();
+    });
+    const std::filesystem::path hierarchy_path = dir / "hierarchy.bin";
+    std::ofstream hierarchy(hierarchy_path, std::ios::binary | std::ios::trunc);
+    auto put = [&hierarchy](const auto &value) {
+        hierarchy.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+    hierarchy.write(HIERARCHY_MAGIC, sizeof(HIERARCHY_MAGIC));
+    put(HIERARCHY_VERSION);
+    put(uint32_t(options.grid_size));
+    put(uint32_t(names.size()));
+    put(uint64_t(num_points));
+    put(root_min);
+    put(root_size);
+    PointOctreeStats stats;
+    for (const std::string &name : names)
+    {
+        const std::pair<uint64_t, size_t> &node = writer.nodes().at(name);
+        put(uint8_t(name.size()));
+        hierarchy.write(name.data(), name.size());
+        put(node.first);
+        put(uint32_t(node.second));
+        stats.depth = std::max(stats.depth, name.size());
+    }
+    if (!hierarchy)
+    {
+        throw std::runtime_error("Unable to write " + hierarchy_path.string());
+    }
+    stats.num_points = num_points;
+    stats.num_nodes = names.size();
+    stats.num_chunks = chunks.size();
+    return stats;
+}
+
+MemoryPointSource::MemoryPointSource(const std::vector<glm::vec3> &positions)
+    : positions_(&positions), colors_(nullptr)
+{
+}
+
+MemoryPointSource::MemoryPointSource(const std::vector<glm::vec3> &positions,
+                                     const std::vector<glm::vec3> &colors)
+    : positions_(&positions), colors_(&colors)
+{
+}
+
+AABB MemoryPointSource::bounds()
+{
+    AABB box;
+    for (const glm::vec3 &p : *positions_)
+    {
+        box.expandBy(p);
+    }
+    return box;
+}
+
+size_t MemoryPointSource::read(size_t max_points, std::vector<glm::vec3> &positions,
+                               std::vector<glm::vec3> &colors)
+{
+    const size_t begin = next_;
+    const size_t end = std::min(positions_->size(), begin + max_points);
+    positions.assign(positions_->begin() + begin, positions_->begin() + end);
+    if (colors_ != nullptr && colors_->size() == positions_->size())
+    {
+        colors.assign(colors_->begin() + begin, colors_->begin() + end);
+    }
+    next_ = end;
+    return end - begin;
+}
+
+std::shared_ptr<PointOctree> PointOctree::open(const std::string &directory)
+{
+    const std::filesystem::path dir(directory);
+    const std::filesystem::path hierarchy_path = dir / "hierarchy.bin";
+    std::ifstream hierarchy(hierarchy_path, std::ios::binary);
+    auto get = [&hierarchy](auto &value) {
+        hierarchy.read(reinterpret_cast<char *>(&value), sizeof(value));
+    };
+    char magic[4] = {};
+    uint32_t version = 0, grid_size = 0, num_nodes = 0;
+    uint64_t num_points = 0;
+    glm::vec3 root_min;
+    float root_size = 0.f;
+    hierarchy.read(magic, sizeof(magic));
+    get(version);
+    get(grid_size);
+    get(num_nodes);
+    get(num_points);
+    get(root_min);
+    get(root_size);
+    if (!hierarchy || std::memcmp(magic, HIERARCHY_MAGIC, sizeof(magic)) != 0 ||
+        version != HIERARCHY_VERSION || num_nodes == 0 || grid_size == 0)
+    {
+        throw std::runtime_error("Invalid point octree " + hierarchy_path.string());
+    }
+
+    std::shared_ptr<PointOctree> octree(new PointOctree());
+    octree->points_path_ = (dir / "octree.bin").string();
+    octree->num_points_ = num_points;
+    octree->root_min_ = root_min;
+    octree->nodes_.resize(num_nodes);
+    std::unordered_map<std::string, uint32_t> index;
+    index.reserve(num_nodes);
+    std::string name;
+    for (uint32_t i = 0; i < num_nodes; ++i)
+    {
+        uint8_t length = 0;
+        get(length);
+        name.resize(length);
+        hierarchy.read(&name[0], length);
+        Node &node = octree->nodes_[i];
+        uint32_t count = 0;
+        get(node.first_point);
+        get(count);
+        if (!hierarchy || length == 0 || name[0] != 'r' || (i == 0) != (length == 1))
+        {
+            throw std::runtime_error("Invalid point octree " + hierarchy_path.string());
+        }
+        node.num_points = count;
+        node.level = uint32_t(length - 1);
+        node.children.fill(NO_NODE);
+        glm::vec3 cube_min;
+        float cube_size;
+        nodeCube(name, root_size, cube_min, cube_size);
+        node.bounds = AABB(root_min + cube_min, root_min + cube_min + cube_size);
+        node.spacing = cube_size / float(grid_size);
+        if (i > 0)
+        {
+            // Parents come first, so a missing parent means a corrupt file
+            const auto parent = index.find(name.substr(0, length - 1));
+            if (parent == index.end())
+            {
+                throw std::runtime_error("Invalid point octree " + hierarchy_path.string());
+            }
+            node.parent = parent->second;
+            octree->nodes_[parent->second].children[name.back() - '0'] = i;
+        }
+        index[name] = i;
+    }
+    return octree;
+}
+
+void PointOctree::readNode(uint32_t node, std::vector<glm::vec3> &positions,
+                           std::vector<glm::vec3> &colors) const
+{
+    const Node &n = nodes_.at(node);
+    std::vector<PointRecord> records(n.num_points);
+    std::ifstream file(points_path_, std::ios::binary);
+    file.seekg(std::streamoff(n.first_point * sizeof(PointRecord)));
+    if (!file.read(reinterpret_cast<char *>(records.data()), records.size() * sizeof(PointRecord)))
+    {
+        throw std::runtime_error("Unable to read " + points_path_);
+    }
+    positions.resize(records.size());
+    colors.resize(records.size());
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        const PointRecord &r = records[i];
+        positions[i] = root_min_ + glm::vec3(r.x, r.y, r.z);
+        colors[i] = glm::vec3(r.r, r.g, r.b) / 255.f;
+    }
+}
+
+std::vector<uint32_t> PointOctree::selectNodes(const PointOctreeView &view, size_t point_budget,
+                                               float min_node_pixels) const
+{
+    // Frustum planes in world space (Gribb and Hartmann), normalized so that they give
+    // distances
+    const glm::mat4 &m = view.world_to_clip;
+    std::array<glm::vec4, 4> rows;
+    for (int i = 0; i < 4; ++i)
+    {
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    }
+    std::array<glm::vec4, 6> planes = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+                                       rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2]};
+    for (glm::vec4 &plane : planes)
+    {
+        const float length = glm::length(glm::vec3(plane));
+        if (length > 0.f)
+        {
+            plane /= length;
+        }
+    }
+    const float scale = std::max(glm::length(glm::vec3(view.model[0])),
+                                 std::max(glm::length(glm::vec3(view.model[1])),
+                                          glm::length(glm::vec3(view.model[2]))));
+
+    // Projected diameter of a node in pixels, or a negative value if it is outside the frustum
+    auto projected_size = [&](uint32_t i) {
+        const AABB &box = nodes_[i].bounds;
+        const glm::vec3 center = glm::vec3(view.model * glm::vec4(box.center(), 1.f));
+        const float radius = 0.5f * glm::length(box.max() - box.min()) * scale;
+        for (const glm::vec4 &plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            {
+                return -1.f;
+            }
+        }
+        if (view.orthographic)
+        {
+            return 2.f * radius * view.pixels_per_unit;
+        }
+        const float distance = glm::length(center - view.eye);
+        return distance <= radius ? std::numeric_limits<float>::max()
+                                  : 2.f * radius * view.pixels_per_unit / distance;
+    };
+
+    std::vector<uint32_t> selected;
+    std::priority_queue<std::pair<float, uint32_t>> queue;
+    const float root_size = projected_size(0);
+    if (root_size >= 0.f)
+    {
+        queue.push({root_size, 0});
+    }
+    size_t num_points = 0;
+    while (!queue.empty())
+    {
+        const std::pair<float, uint32_t> top = queue.top();
+        queue.pop();
+        const Node &node = nodes_[top.second];
+        if (!selected.empty() &&
+            (top.first < min_node_pixels || num_points + node.num_points > point_budget))
+        {
+            break;
+        }
+        selected.push_back(top.second);
+        num_points += node.num_points;
+        for (uint32_t child : node.children)
+        {
+            if (child != NO_NODE)
+            {
+                const float size = projected_size(child);
+                if (size >= 0.f)
+                {
+                    queue.push({size, child});
+                }
+            }
+        }
+    }
+    return selected;
+}
+
+} // namespace rcube
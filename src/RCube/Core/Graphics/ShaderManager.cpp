@@ -1,4 +1,5 @@
 #include "RCube/Core/Graphics/ShaderManager.h"
+#include "RCube/Core/Graphics/OpenGL/CommonShader.h"
 #include <iostream>
 
 namespace rcube
@@ -23,9 +24,11 @@ void ForwardRenderSystemShaderManager::create(const std::string &name,
     {
         return;
     }
-    for (int i = 0; i < 2; ++i)
+    for (size_t i = 0; i < defines_.size(); ++i)
     {
         std::vector<std::string> vs = prepareShaderSource(vertex_shader, ForwardRenderPass(i));
+        vs.insert(vs.end() - 1, common::INSTANCING_VERTEX_SHADER_CHUNK);
+        vs.insert(vs.end() - 1, common::COLORMAP_VERTEX_SHADER_CHUNK);
         std::vector<std::string> fs = prepareShaderSource(fragment_shader, ForwardRenderPass(i));
         auto shader = ShaderProgram::create(vs, fs, debug);
         res_[{name, static_cast<ForwardRenderPass>(i)}] = shader;
@@ -42,10 +45,13 @@ void ForwardRenderSystemShaderManager::create(const std::string &name,
     {
         return;
     }
-    for (int i = 0; i < 2; ++i)
+    for (size_t i = 0; i < defines_.size(); ++i)
     {
         std::vector<std::string> vs = prepareShaderSource(vertex_shader, ForwardRenderPass(i));
+        vs.insert(vs.end() - 1, common::INSTANCING_VERTEX_SHADER_CHUNK);
+        vs.insert(vs.end() - 1, common::COLORMAP_VERTEX_SHADER_CHUNK);
         std::vector<std::string> gs = prepareShaderSource(geometry_shader, ForwardRenderPass(i));
+        gs.insert(gs.end() - 1, common::FACE_DATA_GEOMETRY_SHADER_CHUNK);
         std::vector<std::string> fs = prepareShaderSource(fragment_shader, ForwardRenderPass(i));
         auto shader = ShaderProgram::create(vs, gs, fs, debug);
         res_[{name, static_cast<ForwardRenderPass>(i)}] = shader;
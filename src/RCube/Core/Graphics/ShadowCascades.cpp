@@ -0,0 +1,126 @@
+#include "RCube/Core/Graphics/ShadowCascades.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace rcube
+{
+
+std::vector<float> cascadeSplits(float znear, float zfar, unsigned int count, float lambda)
+{
+    std::vector<float> splits(count);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const float f = float(i + 1) / float(count);
+        const float log_split = znear * std::pow(zfar / znear, f);
+        const float uniform_split = znear + (zfar - znear) * f;
+        splits[i] = lambda * log_split + (1.f - lambda) * uniform_split;
+    }
+    if (count > 0)
+    {
+        splits.back() = zfar;
+    }
+    return splits;
+}
+
+std::array<glm::vec3, 8> frustumSlice(const glm::mat4 &inverse_view_projection, float znear,
+                                      float zfar, float slice_near, float slice_far)
+{
+    static const glm::vec2 ndc[4] = {glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1),
+                                     glm::vec2(-1, 1)};
+    std::array<glm::vec3, 8> corners;
+    // The view distance is linear along the segments joining the near and far plane corners
+    const float t_near = (slice_near - znear) / (zfar - znear);
+    const float t_far = (slice_far - znear) / (zfar - znear);
+    for (size_t i = 0; i < 4; ++i)
+    {
+        glm::vec4 n = inverse_view_projection * glm::vec4(ndc[i], -1.f, 1.f);
+        glm::vec4 f = inverse_view_projection * glm::vec4(ndc[i], 1.f, 1.f);
+        const glm::vec3 pn = glm::vec3(n) / n.w;
+        const glm::vec3 pf = glm::vec3(f) / f.w;
+        corners[i] = pn + t_near * (pf - pn);
+        corners[i + 4] = pn + t_far * (pf - pn);
+    }
+    return corners;
+}
+
+ShadowCascade fitShadowCascade(const glm::vec3 &light_direction,
+                               const std::array<glm::vec3, 8> &slice, const AABB &casters,
+                               unsigned int resolution)
+{
+    glm::vec3 center(0.f);
+    for (const glm::vec3 &p : slice)
+    {
+        center += p;
+    }
+    center /= 8.f;
+    float radius = 0.f;
+    for (const glm::vec3 &p : slice)
+    {
+        radius = std::max(radius, glm::length(p - center));
+    }
+    // Rounding up avoids changes of the texel size from floating point noise
+    radius = std::max(std::ceil(radius * 16.f) / 16.f, 1.f / 16.f);
+
+    const glm::vec3 dir = glm::normalize(light_direction);
+    const glm::vec3 up = glm::length(glm::cross(dir, glm::vec3(0, 1, 0))) > 1e-6f
+                             ? glm::vec3(0, 1, 0)
+                             : glm::vec3(1, 0, 0);
+    // The view only depends on the light direction, so that snapping in light space is stable
+    const glm::mat4 light_view = glm::lookAt(glm::vec3(0.f), dir, up);
+    glm::vec3 c = glm::vec3(light_view * glm::vec4(center, 1.f));
+    const float texel = 2.f * radius / float(resolution);
+    c.x = std::floor(c.x / texel) * texel;
+    c.y = std::floor(c.y / texel) * texel;
+
+    // Light space z decreases away from the light; casters between the light and the slice
+    // have larger z than the slice
+    const float zmin = c.z - radius;
+    float zmax = c.z + radius;
+    if (!casters.isNull())
+    {
+        for (const glm::vec3 &p : casters.corners())
+        {
+            zmax = std::max(zmax, (light_view * glm::vec4(p, 1.f)).z);
+        }
+    }
+    const glm::mat4 light_proj =
+        glm::ortho(c.x - radius, c.x + radius, c.y - radius, c.y + radius, -zmax, -zmin);
+
+    ShadowCascade cascade;
+    cascade.view_projection = light_proj * light_view;
+    cascade.texel_size = texel;
+    return cascade;
+}
+
+bool boxInShadowCascade(const glm::mat4 &view_projection, const AABB &box)
+{
+    if (box.isNull())
+    {
+        return false;
+    }
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(-std::numeric_limits<float>::max());
+    for (const glm::vec3 &p : box.corners())
+    {
+        // Orthographic projection: w is 1
+        const glm::vec3 q = glm::vec3(view_projection * glm::vec4(p, 1.f));
+        min = glm::min(min, q);
+        max = glm::max(max, q);
+    }
+    return max.x >= -1.f && min.x <= 1.f && max.y >= -1.f && min.y <= 1.f && min.z <= 1.f;
+}
+
+unsigned int shadowTileResolution(const ShadowSettings &settings, size_t num_tiles)
+{
+    size_t resolution = std::max(settings.resolution, 256u);
+    while (resolution > 256 &&
+           num_tiles * resolution * resolution * sizeof(float) > settings.memory_budget)
+    {
+        resolution /= 2;
+    }
+    return static_cast<unsigned int>(resolution);
+}
+
+} // namespace rcube
@@ -0,0 +1,207 @@
+#include "RCube/Core/Graphics/StaticBatch.h"
+#include <stdexcept>
+
+namespace rcube
+{
+
+// Attributes of a mesh merged into batches: the enabled per-vertex ones
+static bool mergedAttribute(const Mesh &mesh, const std::string &name,
+                            const AttributeBuffer &attr)
+{
+    return attr.divisor() == 0 && mesh.attributeEnabled(name);
+}
+
+// Transforms the 3D vectors of an attribute at the given location to world space in place;
+// positions expand the bounds. Returns false for attributes that are not transformed.
+static bool transformVectors(GLuint location, const glm::mat4 &model, float *values,
+                             size_t count, AABB &bounds)
+{
+    if (location != AttributeLocation::POSITION && location != AttributeLocation::NORMAL &&
+        location != AttributeLocation::TANGENT)
+    {
+        return false;
+    }
+    const glm::mat3 linear(model);
+    const glm::mat3 normal_matrix = glm::transpose(glm::inverse(linear));
+    for (size_t i = 0; i < count * 3; i += 3)
+    {
+        glm::vec3 v(values[i], values[i + 1], values[i + 2]);
+        if (location == AttributeLocation::POSITION)
+        {
+            v = glm::vec3(model * glm::vec4(v, 1.f));
+            bounds.expandBy(v);
+        }
+        else
+        {
+            v = location == AttributeLocation::NORMAL ? normal_matrix * v : linear * v;
+            const float length = glm::length(v);
+            v = length > 0.f ? v / length : v;
+        }
+        values[i] = v.x;
+        values[i + 1] = v.y;
+        values[i + 2] = v.z;
+    }
+    return true;
+}
+
+bool staticBatchable(const Mesh &mesh)
+{
+    if (mesh.primitive() != MeshPrimitive::Triangles || mesh.instanced() ||
+        !mesh.children().empty() || mesh.faceData().buffer != nullptr ||
+        mesh.colormapParameters().lut != nullptr || mesh.attributes().count("positions") == 0)
+    {
+        return false;
+    }
+    const size_t num_vertices = mesh.attributes().at("positions")->count();
+    return num_vertices > 0 && num_vertices <= MAX_STATIC_BATCH_MEMBER_VERTICES;
+}
+
+std::string staticBatchSignature(const Mesh &mesh)
+{
+    std::string signature;
+    for (const auto &kv : mesh.attributes())
+    {
+        const AttributeBuffer &attr = *kv.second;
+        if (mergedAttribute(mesh, kv.first, attr))
+        {
+            signature += kv.first + ':' + std::to_string(attr.location()) + ':' +
+                         std::to_string(attr.dim()) + ':' +
+                         std::to_string(static_cast<int>(attr.format())) + ';';
+        }
+    }
+    return signature;
+}
+
+std::shared_ptr<Mesh> buildStaticBatch(std::vector<StaticBatchMember> &members)
+{
+    if (members.empty())
+    {
+        throw std::runtime_error("A static batch needs at least one member");
+    }
+    const Mesh &first = *members[0].mesh;
+    const std::string signature = staticBatchSignature(first);
+    std::vector<std::shared_ptr<AttributeBuffer>> attributes;
+    std::vector<std::string> names;
+    for (const auto &kv : first.attributes())
+    {
+        if (mergedAttribute(first, kv.first, *kv.second))
+        {
+            names.push_back(kv.first);
+            attributes.push_back(
+                AttributeBuffer::create(kv.first, kv.second->location(), kv.second->dim()));
+        }
+    }
+    attributes.push_back(
+        AttributeBuffer::create("object_ids", GLuint(AttributeLocation::OBJECT_ID), 1));
+
+    std::vector<std::vector<float>> data(names.size());
+    std::vector<float> object_ids;
+    std::vector<unsigned int> indices;
+    for (StaticBatchMember &member : members)
+    {
+        const Mesh &mesh = *member.mesh;
+        if (staticBatchSignature(mesh) != signature)
+        {
+            throw std::runtime_error("Meshes of a static batch must have the same attributes");
+        }
+        // The const accessors read released data back without marking it modified
+        const AttributeBuffer &positions = *mesh.attributes().at("positions");
+        const size_t base = object_ids.size();
+        const size_t num_vertices = positions.count();
+        member.bounds = AABB();
+        member.first_vertex = base;
+        member.num_vertices = num_vertices;
+        for (size_t a = 0; a < names.size(); ++a)
+        {
+            const AttributeBuffer &attr = *mesh.attributes().at(names[a]);
+            const std::vector<float> &src = attr.data();
+            std::vector<float> &dst = data[a];
+            const size_t offset = dst.size();
+            dst.insert(dst.end(), src.begin(), src.begin() + num_vertices * attr.dim());
+            if (attr.dim() == 3)
+            {
+                transformVectors(attr.location(), member.transform, dst.data() + offset,
+                                 num_vertices, member.bounds);
+            }
+        }
+        object_ids.insert(object_ids.end(), num_vertices, static_cast<float>(member.id));
+
+        // Mirroring transforms turn the triangles around
+        const bool flip = glm::determinant(glm::mat3(member.transform)) < 0.f;
+        member.first_index = indices.size();
+        if (mesh.numIndexData() > 0)
+        {
+            const std::vector<unsigned int> &src =
+                static_cast<const AttributeIndexBuffer &>(*member.mesh->indices()).data();
+            for (size_t i = 0; i + 2 < src.size(); i += 3)
+            {
+                indices.push_back(static_cast<unsigned int>(base + src[i]));
+                indices.push_back(static_cast<unsigned int>(base + src[i + (flip ? 2 : 1)]));
+                indices.push_back(static_cast<unsigned int>(base + src[i + (flip ? 1 : 2)]));
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i + 2 < num_vertices; i += 3)
+            {
+                indices.push_back(static_cast<unsigned int>(base + i));
+                indices.push_back(static_cast<unsigned int>(base + i + (flip ? 2 : 1)));
+                indices.push_back(static_cast<unsigned int>(base + i + (flip ? 1 : 2)));
+            }
+        }
+        member.num_indices = indices.size() - member.first_index;
+    }
+
+    std::shared_ptr<Mesh> batch = Mesh::create(attributes, MeshPrimitive::Triangles, true);
+    for (size_t a = 0; a < names.size(); ++a)
+    {
+        batch->setAttributeFormat(names[a], first.attributes().at(names[a])->format());
+        batch->attribute(names[a])->setData(std::move(data[a]));
+    }
+    batch->attribute("object_ids")->setData(std::move(object_ids));
+    batch->indices()->setData(std::move(indices));
+    batch->setCPUDataPolicy(CPUDataPolicy::ReleaseAfterUpload);
+    batch->uploadToGPU();
+    return batch;
+}
+
+bool retransformStaticBatchMember(Mesh &batch, StaticBatchMember &member,
+                                  const glm::mat4 &transform)
+{
+    // The triangles of the member were flipped for the old transform if it was mirroring
+    if ((glm::determinant(glm::mat3(transform)) < 0.f) !=
+        (glm::determinant(glm::mat3(member.transform)) < 0.f))
+    {
+        return false;
+    }
+    const Mesh &mesh = *member.mesh;
+    AABB bounds;
+    std::vector<float> values;
+    for (const auto &kv : mesh.attributes())
+    {
+        const AttributeBuffer &attr = *kv.second;
+        if (!mergedAttribute(mesh, kv.first, attr) || attr.dim() != 3)
+        {
+            continue;
+        }
+        const std::vector<float> &src = attr.data();
+        values.assign(src.begin(), src.begin() + member.num_vertices * 3);
+        if (!transformVectors(attr.location(), transform, values.data(), member.num_vertices,
+                              bounds))
+        {
+            continue;
+        }
+        if (!batch.attribute(kv.first)->writeElements(member.first_vertex, values.data(),
+                                                      member.num_vertices))
+        {
+            return false;
+        }
+    }
+    // Uploads the modified ranges of attributes whose CPU copies were kept
+    batch.uploadToGPU();
+    member.transform = transform;
+    member.bounds = bounds;
+    return true;
+}
+
+} // namespace rcube
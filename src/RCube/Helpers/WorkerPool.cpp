@@ -0,0 +1,110 @@
+#include "RCube/Helpers/WorkerPool.h"
+#include <algorithm>
+
+namespace rcube
+{
+
+WorkerPool::WorkerPool(size_t num_threads)
+{
+    if (num_threads == 0)
+    {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers_.reserve(num_threads - 1);
+    for (size_t i = 1; i < num_threads; ++i)
+    {
+        workers_.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void WorkerPool::parallelChunks(size_t size, size_t min_chunk_size, const Kernel &kernel)
+{
+    const size_t num_chunks =
+        std::max(size_t(1), std::min(numThreads(), size / std::max(min_chunk_size, size_t(1))));
+    if (num_chunks == 1)
+    {
+        kernel(size_t(0), size_t(0), size);
+        return;
+    }
+    std::lock_guard<std::mutex> call_lock(call_mutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    kernel_ = &kernel;
+    size_ = size;
+    chunk_size_ = (size + num_chunks - 1) / num_chunks;
+    num_chunks_ = num_chunks;
+    next_chunk_ = 0;
+    pending_ = num_chunks;
+    error_ = nullptr;
+    wake_.notify_all();
+    while (next_chunk_ < num_chunks_)
+    {
+        runChunk(lock);
+    }
+    done_.wait(lock, [this] { return pending_ == 0; });
+    kernel_ = nullptr;
+    num_chunks_ = 0;
+    next_chunk_ = 0;
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    lock.unlock();
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkerPool::work()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        wake_.wait(lock, [this] { return stop_ || next_chunk_ < num_chunks_; });
+        if (stop_)
+        {
+            return;
+        }
+        runChunk(lock);
+    }
+}
+
+void WorkerPool::runChunk(std::unique_lock<std::mutex> &lock)
+{
+    const size_t index = next_chunk_++;
+    const Kernel &kernel = *kernel_;
+    const size_t begin = std::min(index * chunk_size_, size_);
+    const size_t end = std::min(begin + chunk_size_, size_);
+    lock.unlock();
+    std::exception_ptr error;
+    try
+    {
+        kernel(index, begin, end);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    lock.lock();
+    if (error && !error_)
+    {
+        error_ = error;
+    }
+    if (--pending_ == 0)
+    {
+        done_.notify_all();
+    }
+}
+
+} // namespace rcube
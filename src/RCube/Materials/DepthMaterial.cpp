@@ -7,7 +7,6 @@ namespace rcube
 {
 
 const static std::string DepthVertexShader = R"(
-#version 450
 layout (location = 0) in vec3 position;
 
 layout (std140, binding=0) uniform Camera {
@@ -25,14 +24,13 @@ uniform mat4 model_matrix;
 
 void main()
 {
-    vec4 world_pos = model_matrix * vec4(position, 1.0);
+    vec4 world_pos = model_matrix * vec4(instancePosition(position), 1.0);
     vert_position = world_pos.xyz;
     gl_Position = projection_matrix * view_matrix * world_pos;
 }
 )";
 
 const static std::string DepthFragmentShader = R"(
-#version 450
 in vec3 vert_position;
 out vec4 out_color;
 
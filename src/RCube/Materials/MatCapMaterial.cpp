@@ -34,9 +34,9 @@ uniform mat3 normal_matrix;
 
 void main()
 {
-    vec4 world_pos = model_matrix * vec4(position, 1.0);
-    vert_normal = vec3(view_matrix * vec4(normal_matrix * normal, 0.0));
-    vert_color = color;
+    vec4 world_pos = model_matrix * vec4(instancePosition(position), 1.0);
+    vert_normal = vec3(view_matrix * vec4(normal_matrix * instanceVector(decodeNormal(normal)), 0.0));
+    vert_color = vertexColor(color);
     vert_wire = wire;
     gl_Position = projection_matrix * view_matrix * world_pos;
 }
@@ -84,25 +84,25 @@ void main() {
 
     // Emit vertex 1
     dist = vec3(ha, 0, 0);
-    geom_color = vert_color[0];
+    geom_color = faceColor(vert_color[0], 1.0);
     geom_normal = vert_normal[0];
-    geom_wire = vert_wire[0];
+    geom_wire = faceWire(vert_wire[0]);
     gl_Position = gl_in[0].gl_Position;
     EmitVertex();
 
     // Emit vertex 2
     dist = vec3(0, hb, 0);
-    geom_color = vert_color[1];
+    geom_color = faceColor(vert_color[1], 1.0);
     geom_normal = vert_normal[1];
-    geom_wire = vert_wire[1];
+    geom_wire = faceWire(vert_wire[1]);
     gl_Position = gl_in[1].gl_Position;
     EmitVertex();
 
     // Emit vertex 3
     dist = vec3(0, 0, hc);
-    geom_color = vert_color[2];
+    geom_color = faceColor(vert_color[2], 1.0);
     geom_normal = vert_normal[2];
-    geom_wire = vert_wire[2];
+    geom_wire = faceWire(vert_wire[2]);
     gl_Position = gl_in[2].gl_Position;
     EmitVertex();
     EndPrimitive();
@@ -259,11 +259,15 @@ void main()
 }
 )";
 
-MatCapRGBMaterial::MatCapRGBMaterial() : ShaderMaterial("MatCapRGBMaterial")
+MatCapRGBMaterial::MatCapRGBMaterial() : MatCapRGBMaterial("MatCapRGBMaterial")
 {
     ForwardRenderSystemShaderManager::instance().create("MatCapRGBMaterial", MatCapVertexShader,
                                                         MatCapGeometryShader,
                                                         MatCapRGBFragmentShader, true);
+}
+
+MatCapRGBMaterial::MatCapRGBMaterial(const std::string &name) : ShaderMaterial(name)
+{
     textures_.reserve(4);
     red_ = Texture2D::create(256, 256, 1, TextureInternalFormat::sRGB8);
     red_->setData(Image::fromMemory(red_png_start, red_png_size, 3));
@@ -21,9 +21,9 @@ uniform float thickness;
 void main()
 {
     mat4 mvp = projection_matrix * view_matrix * model_matrix;
-    vec4 clip_position = mvp * vec4(position, 1.0);
+    vec4 clip_position = mvp * vec4(instancePosition(position), 1.0);
     vec4 vp_position = viewport_matrix * clip_position;
-    vec3 vp_normal = vec3(mvp * vec4(normal, 0.0));
+    vec3 vp_normal = vec3(mvp * vec4(instanceVector(decodeNormal(normal)), 0.0));
     vp_position.xy += normalize(vp_normal.xy) * thickness * vp_position.w;
     gl_Position = inverse(viewport_matrix) * vp_position;
 }
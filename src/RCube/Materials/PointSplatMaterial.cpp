@@ -0,0 +1,116 @@
+#include "RCube/Materials/PointSplatMaterial.h"
+#include "RCube/Core/Graphics/ShaderManager.h"
+#include "imgui.h"
+
+namespace rcube
+{
+
+const static std::string PointSplatVertexShader = R"(
+layout (location = 0) in vec3 position;
+layout (location = 3) in vec3 color;
+
+layout (std140, binding=0) uniform Camera {
+    mat4 view_matrix;
+    mat4 projection_matrix;
+    mat4 viewport_matrix;
+    vec3 eye_pos;
+};
+
+out vec3 vert_color;
+
+uniform mat4 model_matrix;
+uniform float point_size;
+uniform bool size_in_world_units;
+uniform float max_point_size;
+
+void main()
+{
+    vec4 view_pos = view_matrix * model_matrix * vec4(instancePosition(position), 1.0);
+    vert_color = pow(vertexColor(color), vec3(2.2));
+    float size = point_size;
+    if (size_in_world_units)
+    {
+        // viewport_matrix[1][1] is half the viewport height in pixels
+        bool ortho = projection_matrix[3][3] == 1.0;
+        size *= viewport_matrix[1][1] * projection_matrix[1][1];
+        size /= ortho ? 1.0 : max(-view_pos.z, 1e-6);
+    }
+    gl_PointSize = clamp(size, 1.0, max_point_size);
+    gl_Position = projection_matrix * view_pos;
+}
+)";
+
+const static std::string PointSplatFragmentShader = R"(
+in vec3 vert_color;
+
+#if RCUBE_RENDERPASS == 0
+out vec4 out_color;
+#elif RCUBE_RENDERPASS == 1
+layout (location = 0) out vec4 accum;
+layout (location = 1) out float reveal;
+#endif
+
+uniform bool round_splats;
+uniform float opacity;
+
+void main() {
+    vec2 d = 2.0 * gl_PointCoord - 1.0;
+    if (round_splats && dot(d, d) > 1.0)
+    {
+        discard;
+    }
+    vec4 final_color = vec4(vert_color, opacity);
+#if RCUBE_RENDERPASS == 0
+    out_color = final_color;
+#elif RCUBE_RENDERPASS == 1
+    // Based on https://learnopengl.com/Guest-Articles/2020/OIT/Weighted-Blended
+    // and http://casual-effects.blogspot.com/2015/03/implemented-weighted-blended-order.html
+    float a = min(1.0, final_color.a) * 8.0 + 0.01;
+    float b = -gl_FragCoord.z * 0.95 + 1.0;
+    float weight = clamp(a * a * a * 1e8 * b * b * b, 1e-2, 3e2);
+    accum = vec4(final_color.rgb * final_color.a, final_color.a) * weight;
+    reveal = final_color.a;
+#endif
+}
+)";
+
+PointSplatMaterial::PointSplatMaterial() : ShaderMaterial("PointSplatMaterial")
+{
+    ForwardRenderSystemShaderManager::instance().create(
+        "PointSplatMaterial", PointSplatVertexShader, PointSplatFragmentShader, true);
+}
+
+void PointSplatMaterial::updateUniforms(std::shared_ptr<ShaderProgram> shader)
+{
+    shader->uniform("point_size").set(point_size);
+    shader->uniform("size_in_world_units").set(size_in_world_units);
+    shader->uniform("max_point_size").set(max_point_size);
+    shader->uniform("round_splats").set(round);
+    ShaderMaterial::updateUniforms(shader);
+}
+
+bool PointSplatMaterial::supportsDepthPrepass() const
+{
+    return false;
+}
+
+void PointSplatMaterial::drawGUI()
+{
+    ImGui::Text("PointSplatMaterial");
+    ImGui::Text("This material renders each vertex as a\nsplat with per-vertex colors");
+    ImGui::Separator();
+    ImGui::Checkbox("Size in world units", &size_in_world_units);
+    if (size_in_world_units)
+    {
+        ImGui::InputFloat("Point size", &point_size);
+    }
+    else
+    {
+        ImGui::SliderFloat("Point size", &point_size, 1.f, 32.f);
+    }
+    ImGui::SliderFloat("Max point size", &max_point_size, 1.f, 256.f);
+    ImGui::Checkbox("Round", &round);
+    ShaderMaterial::drawGUI();
+}
+
+} // namespace rcube
@@ -0,0 +1,146 @@
+#include "RCube/Materials/SphereImpostorMaterial.h"
+#include "RCube/Core/Graphics/ShaderManager.h"
+#include "glm/gtc/type_ptr.hpp"
+#include "imgui.h"
+
+namespace rcube
+{
+
+const static std::string SphereImpostorVertexShader = R"(
+layout (location = 0) in vec3 position;
+layout (location = 3) in vec3 color;
+
+layout (std140, binding=0) uniform Camera {
+    mat4 view_matrix;
+    mat4 projection_matrix;
+    mat4 viewport_matrix;
+    vec3 eye_pos;
+};
+
+out vec3 vert_position;
+out vec3 vert_color;
+flat out vec3 vert_center;
+flat out float vert_radius;
+
+uniform mat4 model_matrix;
+
+void main()
+{
+    // Sphere in view space
+    vec4 center = view_matrix * model_matrix * vec4(instance_offset.xyz, 1.0);
+    float radius = 0.5 * instanceScale() * length(model_matrix[0].xyz);
+    // Quad perpendicular to the ray towards the center and tangent to the front of the sphere,
+    // which covers the silhouette of the sphere
+    bool ortho = projection_matrix[3][3] == 1.0;
+    vec3 w = ortho ? vec3(0.0, 0.0, 1.0) : normalize(-center.xyz);
+    vec3 u = normalize(cross(abs(w.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0), w));
+    vec3 v = cross(w, u);
+    vec3 p = center.xyz + radius * (w + 2.0 * (position.x * u + position.y * v));
+    vert_position = p;
+    vert_color = vertexColor(color);
+    vert_center = center.xyz;
+    vert_radius = radius;
+    gl_Position = projection_matrix * vec4(p, 1.0);
+}
+)";
+
+const static std::string SphereImpostorFragmentShader = R"(
+in vec3 vert_position;
+in vec3 vert_color;
+flat in vec3 vert_center;
+flat in float vert_radius;
+
+#if RCUBE_RENDERPASS == 0
+out vec4 out_color;
+#elif RCUBE_RENDERPASS == 1
+layout (location = 0) out vec4 accum;
+layout (location = 1) out float reveal;
+#endif
+
+layout(binding=0) uniform sampler2D matcap_red;
+layout(binding=1) uniform sampler2D matcap_green;
+layout(binding=2) uniform sampler2D matcap_blue;
+layout(binding=3) uniform sampler2D matcap_black;
+
+layout (std140, binding=0) uniform Camera {
+    mat4 view_matrix;
+    mat4 projection_matrix;
+    mat4 viewport_matrix;
+    vec3 eye_pos;
+};
+
+uniform vec3 color;
+uniform vec3 emissive_color;
+uniform float opacity;
+
+void main()
+{
+    // Intersect the view ray through this fragment with the sphere
+    bool ortho = projection_matrix[3][3] == 1.0;
+    vec3 rd = ortho ? vec3(0.0, 0.0, -1.0) : normalize(vert_position);
+    vec3 oc = vert_position - vert_center;
+    float oc_rd = dot(oc, rd);
+    float h = oc_rd * oc_rd - dot(oc, oc) + vert_radius * vert_radius;
+    if (h < 0.0)
+    {
+        discard;
+    }
+    vec3 hit = vert_position + (-oc_rd - sqrt(h)) * rd;
+    vec3 normal = (hit - vert_center) / vert_radius;
+    vec4 clip = projection_matrix * vec4(hit, 1.0);
+    float ndc_depth = clip.z / clip.w;
+    gl_FragDepth = 0.5 * (gl_DepthRange.diff * ndc_depth + gl_DepthRange.near + gl_DepthRange.far);
+
+    vec3 frag_color = vert_color * color + emissive_color;
+    vec2 uv = 0.498 * normal.xy + vec2(0.5, 0.5);
+    uv.y = 1.0 - uv.y;
+    vec3 red = texture(matcap_red, uv).rgb;
+    vec3 green = texture(matcap_green, uv).rgb;
+    vec3 blue = texture(matcap_blue, uv).rgb;
+    vec3 black = texture(matcap_black, uv).rgb;
+    vec4 final_color = vec4(frag_color.r * red + frag_color.g * green + frag_color.b * blue + (1.0 - frag_color.r - frag_color.g - frag_color.b) * black, opacity);
+
+#if RCUBE_RENDERPASS == 0
+    out_color = final_color;
+#elif RCUBE_RENDERPASS == 1
+    // Based on https://learnopengl.com/Guest-Articles/2020/OIT/Weighted-Blended
+    // and http://casual-effects.blogspot.com/2015/03/implemented-weighted-blended-order.html
+    float a = min(1.0, final_color.a) * 8.0 + 0.01;
+    float b = -gl_FragDepth * 0.95 + 1.0;
+    float weight = clamp(a * a * a * 1e8 * b * b * b, 1e-2, 3e2);
+    accum = vec4(final_color.rgb * final_color.a, final_color.a) * weight;
+    reveal = final_color.a;
+#endif
+}
+)";
+
+SphereImpostorMaterial::SphereImpostorMaterial() : MatCapRGBMaterial("SphereImpostorMaterial")
+{
+    ForwardRenderSystemShaderManager::instance().create(
+        "SphereImpostorMaterial", SphereImpostorVertexShader, SphereImpostorFragmentShader, true);
+}
+
+void SphereImpostorMaterial::updateUniforms(std::shared_ptr<ShaderProgram> shader)
+{
+    shader->uniform("color").set(glm::pow(color, glm::vec3(2.2f)));
+    shader->uniform("emissive_color").set(glm::pow(emissive_color, glm::vec3(2.2f)));
+    ShaderMaterial::updateUniforms(shader);
+}
+
+bool SphereImpostorMaterial::supportsDepthPrepass() const
+{
+    return false;
+}
+
+void SphereImpostorMaterial::drawGUI()
+{
+    ImGui::Text("SphereImpostorMaterial");
+    ImGui::Text("This material renders each instance as a \nray-cast sphere shaded with blended RGB\n"
+                "material capture textures.");
+    ImGui::Separator();
+    ImGui::ColorEdit3("Color", glm::value_ptr(color));
+    ImGui::ColorEdit3("Emissive color", glm::value_ptr(emissive_color));
+    ShaderMaterial::drawGUI();
+}
+
+} // namespace rcube
@@ -1,6 +1,7 @@
 #include "RCube/Materials/StandardMaterial.h"
 #include "RCube/Core/Graphics/ShaderManager.h"
 #include "imgui.h"
+#include <algorithm>
 #include <string>
 
 namespace rcube
@@ -31,21 +32,44 @@ out vec3 vert_normal;
 out mat3 vert_tbn;
 flat out float vert_wire;
 
+#ifdef RCUBE_MULTIDRAW
+layout (location = 6) in uint draw_id;
+// Index of the object's material in the materials of the multi-draw call
+flat out uint vert_material;
+
+struct ObjectData
+{
+    mat4 model_matrix;
+    mat4 normal_matrix;
+    uvec4 ids;
+};
+
+layout (std430, binding=0) readonly buffer Objects {
+    ObjectData objects[];
+};
+#else
 uniform mat4 model_matrix;
 uniform mat3 normal_matrix;
+#endif
 
 void main()
 {
-    vec4 world_pos = model_matrix * vec4(position, 1.0);
+#ifdef RCUBE_MULTIDRAW
+    mat4 model_matrix = objects[draw_id].model_matrix;
+    mat3 normal_matrix = mat3(objects[draw_id].normal_matrix);
+    vert_material = objects[draw_id].ids.y;
+#endif
+    vec4 world_pos = model_matrix * vec4(instancePosition(position), 1.0);
+    vec3 N = instanceVector(decodeNormal(normal));
     vert_position = world_pos.xyz;
     vert_uv = uv;
-    vert_color = pow(color, vec3(2.2));
-    vert_normal = normal_matrix * normal;
+    vert_color = pow(vertexColor(color), vec3(2.2));
+    vert_normal = normal_matrix * N;
     gl_Position = projection_matrix * view_matrix * world_pos;
     // Tangent basis
-    vec3 T = normalize(vec3(model_matrix * vec4(tangent, 0.0)));
-    vec3 B = cross(normal, T);
-    vert_tbn = mat3(T, B, normal);
+    vec3 T = normalize(vec3(model_matrix * vec4(instanceVector(decodeTangent(tangent)), 0.0)));
+    vec3 B = cross(N, T);
+    vert_tbn = mat3(T, B, N);
     vert_wire = wire;
 }
 )";
@@ -77,6 +101,14 @@ out float geom_wire;
 
 noperspective out vec3 dist;
 
+#ifdef RCUBE_MULTIDRAW
+flat in uint vert_material[];
+flat out uint geom_material;
+#define EMIT_MATERIAL(i) geom_material = vert_material[i]
+#else
+#define EMIT_MATERIAL(i)
+#endif
+
 void main() {
     // Transform each vertex into viewport space
     vec3 p0 = vec3(viewport_matrix * (gl_in[0].gl_Position / gl_in[0].gl_Position.w));
@@ -101,9 +133,10 @@ void main() {
     geom_position = vert_position[0];
     geom_normal = vert_normal[0];
     geom_uv = vert_uv[0];
-    geom_color = vert_color[0];
+    geom_color = faceColor(vert_color[0], 2.2);
     geom_tbn = vert_tbn[0];
-    geom_wire = vert_wire[0];
+    geom_wire = faceWire(vert_wire[0]);
+    EMIT_MATERIAL(0);
     gl_Position = gl_in[0].gl_Position;
     EmitVertex();
 
@@ -112,9 +145,10 @@ void main() {
     geom_position = vert_position[1];
     geom_normal = vert_normal[1];
     geom_uv = vert_uv[1];
-    geom_color = vert_color[1];
+    geom_color = faceColor(vert_color[1], 2.2);
     geom_tbn = vert_tbn[1];
-    geom_wire = vert_wire[1];
+    geom_wire = faceWire(vert_wire[1]);
+    EMIT_MATERIAL(1);
     gl_Position = gl_in[1].gl_Position;
     EmitVertex();
 
@@ -123,9 +157,10 @@ void main() {
     geom_position = vert_position[2];
     geom_normal = vert_normal[2];
     geom_uv = vert_uv[2];
-    geom_color = vert_color[2];
+    geom_color = faceColor(vert_color[2], 2.2);
     geom_tbn = vert_tbn[2];
-    geom_wire = vert_wire[2];
+    geom_wire = faceWire(vert_wire[2]);
+    EMIT_MATERIAL(2);
     gl_Position = gl_in[2].gl_Position;
     EmitVertex();
     EndPrimitive();
@@ -143,7 +178,7 @@ in float geom_wire;
 noperspective in vec3 dist;
 
 #define RCUBE_MAX_DIRLIGHTS 5
-#define RCUBE_MAX_POINTLIGHTS 50
+#define RCUBE_MAX_SHADOW_CASCADES 4
 
 #if RCUBE_RENDERPASS == 0
 out vec4 out_color;
@@ -152,14 +187,77 @@ layout (location = 0) out vec4 accum;
 layout (location = 1) out float reveal;
 #endif
 
-uniform vec3 albedo;
-uniform float roughness;
-uniform float metallic;
+// Material parameters; must match the order in StandardMaterial::writeUniformBlock
+#ifdef RCUBE_MULTIDRAW
+// Multi-draw calls read them from the array of the materials drawn together
+struct StandardMaterialParams {
+    vec3 albedo;
+    float roughness;
+    vec3 wireframe_color;
+    float metallic;
+    float wireframe_thickness;
+    float opacity;
+    bool show_wireframe;
+    bool use_albedo_texture;
+    bool use_roughness_texture;
+    bool use_metallic_texture;
+    bool use_normal_texture;
+    bool use_image_based_lighting;
+};
+
+layout (std430, binding=5) readonly buffer StandardMaterials {
+    StandardMaterialParams materials[];
+};
+
+flat in uint geom_material;
+
+vec3 albedo;
+float roughness;
+vec3 wireframe_color;
+float metallic;
+float wireframe_thickness;
+float opacity;
+bool show_wireframe;
+bool use_albedo_texture;
+bool use_roughness_texture;
+bool use_metallic_texture;
+bool use_normal_texture;
+bool use_image_based_lighting;
+
+void loadMaterial() {
+    StandardMaterialParams m = materials[geom_material];
+    albedo = m.albedo;
+    roughness = m.roughness;
+    wireframe_color = m.wireframe_color;
+    metallic = m.metallic;
+    wireframe_thickness = m.wireframe_thickness;
+    opacity = m.opacity;
+    show_wireframe = m.show_wireframe;
+    use_albedo_texture = m.use_albedo_texture;
+    use_roughness_texture = m.use_roughness_texture;
+    use_metallic_texture = m.use_metallic_texture;
+    use_normal_texture = m.use_normal_texture;
+    use_image_based_lighting = m.use_image_based_lighting;
+}
+#else
+layout (std140, binding=3) uniform StandardMaterialParams {
+    vec3 albedo;
+    float roughness;
+    vec3 wireframe_color;
+    float metallic;
+    float wireframe_thickness;
+    float opacity;
+    bool show_wireframe;
+    bool use_albedo_texture;
+    bool use_roughness_texture;
+    bool use_metallic_texture;
+    bool use_normal_texture;
+    bool use_image_based_lighting;
+};
 
-uniform bool use_albedo_texture;
-uniform bool use_roughness_texture;
-uniform bool use_metallic_texture;
-uniform bool use_normal_texture;
+void loadMaterial() {
+}
+#endif
 
 layout(binding=0) uniform sampler2D albedo_tex;
 layout(binding=1) uniform sampler2D roughness_tex;
@@ -168,16 +266,6 @@ layout(binding=3) uniform sampler2D normal_tex;
 layout(binding=4) uniform sampler2D brdf_lut;
 layout(binding=5) uniform samplerCube prefilter_map;
 layout(binding=6) uniform samplerCube irradiance_map;
-uniform bool use_image_based_lighting;
-
-struct Wireframe {
-    bool show;
-    vec3 color;
-    float thickness;
-};
-uniform Wireframe wireframe;
-uniform bool show_wireframe;
-uniform float opacity;
 
 const vec3 PINK = pow(vec3(255.0 / 255.0, 20.0 / 255.0, 147.0 / 255.0), vec3(2.2));
 const vec3 PURPLE = pow(vec3(138.0 / 255.0, 43.0 / 255.0, 226.0 / 255.0), vec3(2.2));
@@ -210,16 +298,43 @@ struct PointLight
     vec3 color;
     float radius;
     float intensity;
+    float range;
     float padding1_;
     float padding2_;
-    float padding3_;
 };
 
-layout (std140, binding=2) uniform PointLights {
-    PointLight pointlights[RCUBE_MAX_POINTLIGHTS];
-    int num_pointlights;
+layout (std430, binding=2) readonly buffer PointLights {
+    PointLight pointlights[];
+};
+
+// Point lights assigned to a grid of view frustum clusters, written by
+// ForwardRenderSystem::setLightClustersSSBO
+layout (std430, binding=3) readonly buffer LightClusters {
+    // Number of clusters along x, y and depth
+    uvec4 cluster_grid;
+    // Depth slice scale and bias (slice = log(depth) * x + y), clusters per pixel along x and y
+    vec4 cluster_params;
+    // Offset into light_indices and number of lights of each cluster
+    uvec2 cluster_lights[];
+};
+
+layout (std430, binding=4) readonly buffer LightIndices {
+    uint light_indices[];
+};
+
+// Cascaded shadow maps of the directional lights, written by ForwardRenderSystem::shadowMapPass
+layout (std140, binding=4) uniform ShadowCascades {
+    // World to atlas texture coordinates and depth, per light and cascade
+    mat4 shadow_matrices[RCUBE_MAX_DIRLIGHTS * RCUBE_MAX_SHADOW_CASCADES];
+    // Atlas tile (uv min, uv max) per light and cascade
+    vec4 shadow_tiles[RCUBE_MAX_DIRLIGHTS * RCUBE_MAX_SHADOW_CASCADES];
+    // Far view distance, texel size, normal offset and depth bias per cascade
+    vec4 shadow_cascades[RCUBE_MAX_SHADOW_CASCADES];
+    int num_shadow_cascades;
 };
 
+layout(binding=10) uniform sampler2D shadow_atlas;
+
 struct PerLightDotProducts
 {
     float LdotN, HdotV, HdotN;
@@ -235,9 +350,19 @@ const mat4 bayerMatrix = mat4(
 );
 
 // Returns the attenuation factor that is multiplied with the light's color
-float falloff(float dist, float radius) {
+float falloff(float dist, float radius, float range) {
     float denom = (dist * dist) / (radius * radius);
-    return 1.0 / denom;
+    // Fade out to zero at the range, so that lights only affect the clusters they overlap
+    float window = clamp(1.0 - pow(dist / range, 4.0), 0.0, 1.0);
+    return window * window / denom;
+}
+
+// Offset and number of lights of the cluster containing a fragment
+uvec2 clusterLights(vec2 frag_coord, float view_depth) {
+    ivec3 cell = ivec3(ivec2(frag_coord * cluster_params.zw),
+                       int(floor(log(max(view_depth, 1e-6)) * cluster_params.x + cluster_params.y)));
+    cell = clamp(cell, ivec3(0), ivec3(cluster_grid.xyz) - 1);
+    return cluster_lights[(cell.z * int(cluster_grid.y) + cell.y) * int(cluster_grid.x) + cell.x];
 }
 
 const float PI = 3.14159265359;
@@ -319,7 +444,48 @@ void computePerLightDotProducts(const vec3 L, const vec3 N, const vec3 V, inout
     dots.HdotN = clamp(dot(H, N), 0, 1);
 }
 
-vec3 dirLightDirectContribution(int index, const vec3 N, const vec3 V, float NdotV, float roughness, float metallic, vec3 albedo, vec3 specular_color)
+// Fraction of the directional light reaching the surface, with 3x3 PCF in the cascade
+// covering the surface's view distance
+float dirLightVisibility(int index, vec3 world_pos, vec3 N)
+{
+    if (dirlights[index].cast_shadow < 0.5 || num_shadow_cascades == 0)
+    {
+        return 1.0;
+    }
+    float view_dist = -(view_matrix * vec4(world_pos, 1.0)).z;
+    int c = 0;
+    while (c < num_shadow_cascades && view_dist > shadow_cascades[c].x)
+    {
+        ++c;
+    }
+    if (c == num_shadow_cascades)
+    {
+        return 1.0;
+    }
+    int slot = index * RCUBE_MAX_SHADOW_CASCADES + c;
+    // Offsetting along the normal by a texel-sized amount avoids shadow acne
+    vec4 p = shadow_matrices[slot] * vec4(world_pos + shadow_cascades[c].z * N, 1.0);
+    vec3 coords = p.xyz / p.w;
+    if (coords.z > 1.0)
+    {
+        return 1.0;
+    }
+    vec2 texel = 1.0 / vec2(textureSize(shadow_atlas, 0));
+    vec4 tile = shadow_tiles[slot];
+    float lit = 0.0;
+    for (int x = -1; x <= 1; ++x)
+    {
+        for (int y = -1; y <= 1; ++y)
+        {
+            // Samples stay within the tile of the cascade
+            vec2 uv = clamp(coords.xy + vec2(x, y) * texel, tile.xy + 0.5 * texel, tile.zw - 0.5 * texel);
+            lit += coords.z - shadow_cascades[c].w > texture(shadow_atlas, uv).r ? 0.0 : 1.0;
+        }
+    }
+    return lit / 9.0;
+}
+
+vec3 dirLightDirectContribution(int index, const vec3 N, const vec3 V, float NdotV, vec3 surface_position, float roughness, float metallic, vec3 albedo, vec3 specular_color)
 {
     vec3 L = -normalize(dirlights[index].direction);
     PerLightDotProducts dots;
@@ -327,6 +493,7 @@ vec3 dirLightDirectContribution(int index, const vec3 N, const vec3 V, float Ndo
 
     // Radiance
     vec3 radiance = dirlights[index].intensity * dots.LdotN * dirlights[index].color;
+    radiance *= dirLightVisibility(index, surface_position, N);
     return radiance * lightDirectContribution(dots, NdotV, roughness, metallic, albedo, specular_color);
 }
 
@@ -339,11 +506,12 @@ vec3 pointLightDirectContribution(int index, const vec3 N, const vec3 V, float N
     computePerLightDotProducts(L, N, V, dots); 
 
     // Radiance
-    vec3 radiance = pointlights[index].intensity * dots.LdotN * pointlights[index].color * falloff(dist, pointlights[index].radius);
+    vec3 radiance = pointlights[index].intensity * dots.LdotN * pointlights[index].color * falloff(dist, pointlights[index].radius, pointlights[index].range);
     return radiance * lightDirectContribution(dots, NdotV, roughness, metallic, albedo, specular_color);
 }
 
 void main() {
+    loadMaterial();
     /*if (bayerMatrix[int(gl_FragCoord.x) % 4][int(gl_FragCoord.y) % 4] > opacity)
     {
         discard;
@@ -364,11 +532,11 @@ void main() {
         // Find the smallest distance
         float d = min(dist.x, dist.y);
         d = min(d, dist.z);
-        float thickness = edge_flag > 1 ? 2.0 * wireframe.thickness : wireframe.thickness;
+        float thickness = edge_flag > 1 ? 2.0 * wireframe_thickness : wireframe_thickness;
         if (d < thickness)
         {
             float mix_val = smoothstep(thickness - 1, thickness + 1, d);
-            vec3 wcolor = edge_flag == 3 ? PINK : (edge_flag == 2 ? PURPLE : (wireframe.show ? wireframe.color : alb));
+            vec3 wcolor = edge_flag == 3 ? PINK : (edge_flag == 2 ? PURPLE : (show_wireframe ? wireframe_color : alb));
             alb = mix(wcolor, alb, mix_val);
         }
     }
@@ -399,12 +567,15 @@ void main() {
     vec3 direct = vec3(0.0);
     for (int i = 0; i < min(num_dirlights, RCUBE_MAX_DIRLIGHTS); ++i)
     {
-        direct += dirLightDirectContribution(i, N, V, NdotV, rou, met, alb, specular_color);
+        direct += dirLightDirectContribution(i, N, V, NdotV, position, rou, met, alb, specular_color);
     }
 
-    for (int i = 0; i < min(num_pointlights, RCUBE_MAX_POINTLIGHTS); ++i)
+    // Only the point lights of the fragment's cluster can reach it
+    uvec2 lights = clusterLights(gl_FragCoord.xy, -(view_matrix * vec4(position, 1.0)).z);
+    for (uint i = 0; i < lights.y; ++i)
     {
-        direct += pointLightDirectContribution(i, N, V, NdotV, position, rou, met, alb, specular_color);
+        int index = int(light_indices[lights.x + i]);
+        direct += pointLightDirectContribution(index, N, V, NdotV, position, rou, met, alb, specular_color);
     }
 
     // Indirect image-based lighting for ambient term
@@ -453,48 +624,62 @@ StandardMaterial::StandardMaterial() : ShaderMaterial("StandardMaterial")
     cubemaps_.reserve(2);
 }
 
+bool StandardMaterial::writeUniformBlock(Std140Writer &writer)
+{
+    writer.add(glm::pow(albedo_, glm::vec3(2.2f)));
+    writer.add(roughness_);
+    writer.add(glm::pow(wireframe_color_, glm::vec3(2.2f)));
+    writer.add(metallic_);
+    writer.add(wireframe_thickness_);
+    writer.add(std::min(1.f, std::max(opacity, 0.f)));
+    writer.add(wireframe_);
+    writer.add(albedo_texture_ != nullptr);
+    writer.add(roughness_texture_ != nullptr);
+    writer.add(metallic_texture_ != nullptr);
+    writer.add(normal_texture_ != nullptr);
+    writer.add(useIBL());
+    return true;
+}
+
 void StandardMaterial::updateUniforms(std::shared_ptr<ShaderProgram> shader)
 {
-    shader->uniform("albedo").set(glm::pow(albedo, glm::vec3(2.2f)));
-    shader->uniform("roughness").set(roughness);
-    shader->uniform("metallic").set(metallic);
-    shader->uniform("use_albedo_texture").set(albedo_texture != nullptr);
-    shader->uniform("use_roughness_texture").set(roughness_texture != nullptr);
-    shader->uniform("use_normal_texture").set(normal_texture != nullptr);
-    shader->uniform("use_metallic_texture").set(metallic_texture != nullptr);
-    shader->uniform("wireframe.show").set(wireframe);
-    shader->uniform("wireframe.color").set(glm::pow(wireframe_color, glm::vec3(2.2f)));
-    shader->uniform("wireframe.thickness").set(wireframe_thickness);
-    shader->uniform("use_image_based_lighting")
-        .set(image_based_lighting && ibl_irradiance != nullptr && ibl_prefilter != nullptr &&
-             ibl_brdfLUT != nullptr);
+    // All parameters live in a uniform block that is re-uploaded only when they change
     ShaderMaterial::updateUniforms(shader);
 }
 
+bool StandardMaterial::supportsMultiDraw() const
+{
+    return true;
+}
+
+bool StandardMaterial::useIBL() const
+{
+    return image_based_lighting_ && ibl_irradiance_ != nullptr && ibl_prefilter_ != nullptr &&
+           ibl_brdfLUT_ != nullptr;
+}
+
 const std::vector<DrawCall::Texture2DInfo> StandardMaterial::textureSlots()
 {
     textures_.clear();
-    if (albedo_texture != nullptr)
+    if (albedo_texture_ != nullptr)
     {
-        textures_.push_back({albedo_texture->id(), 0});
+        textures_.push_back({albedo_texture_->id(), 0});
     }
-    if (roughness_texture != nullptr)
+    if (roughness_texture_ != nullptr)
     {
-        textures_.push_back({roughness_texture->id(), 1});
+        textures_.push_back({roughness_texture_->id(), 1});
     }
-    if (metallic_texture != nullptr)
+    if (metallic_texture_ != nullptr)
     {
-        textures_.push_back({metallic_texture->id(), 2});
+        textures_.push_back({metallic_texture_->id(), 2});
     }
-    if (normal_texture != nullptr)
+    if (normal_texture_ != nullptr)
     {
-        textures_.push_back({normal_texture->id(), 3});
+        textures_.push_back({normal_texture_->id(), 3});
     }
-    const bool use_ibl = image_based_lighting && ibl_irradiance != nullptr &&
-                         ibl_prefilter != nullptr && ibl_brdfLUT != nullptr;
-    if (use_ibl)
+    if (useIBL())
     {
-        textures_.push_back({ibl_brdfLUT->id(), 4});
+        textures_.push_back({ibl_brdfLUT_->id(), 4});
     }
     return textures_;
 }
@@ -502,41 +687,197 @@ const std::vector<DrawCall::Texture2DInfo> StandardMaterial::textureSlots()
 const std::vector<DrawCall::TextureCubemapInfo> StandardMaterial::cubemapSlots()
 {
     cubemaps_.clear();
-    const bool use_ibl = image_based_lighting && ibl_irradiance != nullptr &&
-                         ibl_prefilter != nullptr && ibl_brdfLUT != nullptr;
-    if (use_ibl)
+    if (useIBL())
     {
-        cubemaps_.push_back({ibl_prefilter->id(), 5});
-        cubemaps_.push_back({ibl_irradiance->id(), 6});
+        cubemaps_.push_back({ibl_prefilter_->id(), 5});
+        cubemaps_.push_back({ibl_irradiance_->id(), 6});
     }
     return cubemaps_;
 }
 
+void StandardMaterial::setAlbedo(const glm::vec3 &albedo)
+{
+    albedo_ = albedo;
+    markUniformBlockDirty();
+}
+
+const glm::vec3 &StandardMaterial::albedo() const
+{
+    return albedo_;
+}
+
+void StandardMaterial::setRoughness(float roughness)
+{
+    roughness_ = roughness;
+    markUniformBlockDirty();
+}
+
+float StandardMaterial::roughness() const
+{
+    return roughness_;
+}
+
+void StandardMaterial::setMetallic(float metallic)
+{
+    metallic_ = metallic;
+    markUniformBlockDirty();
+}
+
+float StandardMaterial::metallic() const
+{
+    return metallic_;
+}
+
+void StandardMaterial::setAlbedoTexture(std::shared_ptr<Texture2D> texture)
+{
+    albedo_texture_ = std::move(texture);
+    markUniformBlockDirty();
+}
+
+const std::shared_ptr<Texture2D> &StandardMaterial::albedoTexture() const
+{
+    return albedo_texture_;
+}
+
+void StandardMaterial::setRoughnessTexture(std::shared_ptr<Texture2D> texture)
+{
+    roughness_texture_ = std::move(texture);
+    markUniformBlockDirty();
+}
+
+const std::shared_ptr<Texture2D> &StandardMaterial::roughnessTexture() const
+{
+    return roughness_texture_;
+}
+
+void StandardMaterial::setMetallicTexture(std::shared_ptr<Texture2D> texture)
+{
+    metallic_texture_ = std::move(texture);
+    markUniformBlockDirty();
+}
+
+const std::shared_ptr<Texture2D> &StandardMaterial::metallicTexture() const
+{
+    return metallic_texture_;
+}
+
+void StandardMaterial::setNormalTexture(std::shared_ptr<Texture2D> texture)
+{
+    normal_texture_ = std::move(texture);
+    markUniformBlockDirty();
+}
+
+const std::shared_ptr<Texture2D> &StandardMaterial::normalTexture() const
+{
+    return normal_texture_;
+}
+
+void StandardMaterial::setIBLMaps(std::shared_ptr<TextureCubemap> irradiance,
+                                  std::shared_ptr<TextureCubemap> prefilter,
+                                  std::shared_ptr<Texture2D> brdfLUT)
+{
+    ibl_irradiance_ = std::move(irradiance);
+    ibl_prefilter_ = std::move(prefilter);
+    ibl_brdfLUT_ = std::move(brdfLUT);
+    markUniformBlockDirty();
+}
+
 void StandardMaterial::setIBLFromCamera(Camera *cam)
 {
     if (cam != nullptr)
     {
-        ibl_irradiance = cam->irradiance;
-        ibl_prefilter = cam->prefilter;
-        ibl_brdfLUT = cam->brdfLUT;
+        setIBLMaps(cam->irradiance, cam->prefilter, cam->brdfLUT);
     }
 }
 
+void StandardMaterial::setImageBasedLighting(bool flag)
+{
+    image_based_lighting_ = flag;
+    markUniformBlockDirty();
+}
+
+bool StandardMaterial::imageBasedLighting() const
+{
+    return image_based_lighting_;
+}
+
+void StandardMaterial::setWireframe(bool flag)
+{
+    wireframe_ = flag;
+    markUniformBlockDirty();
+}
+
+bool StandardMaterial::wireframe() const
+{
+    return wireframe_;
+}
+
+void StandardMaterial::setWireframeThickness(float thickness)
+{
+    wireframe_thickness_ = thickness;
+    markUniformBlockDirty();
+}
+
+float StandardMaterial::wireframeThickness() const
+{
+    return wireframe_thickness_;
+}
+
+void StandardMaterial::setWireframeColor(const glm::vec3 &color)
+{
+    wireframe_color_ = color;
+    markUniformBlockDirty();
+}
+
+const glm::vec3 &StandardMaterial::wireframeColor() const
+{
+    return wireframe_color_;
+}
+
 void StandardMaterial::drawGUI()
 {
     ImGui::Text("StandardMaterial");
     ImGui::Text("This material renders the object with a\nphysically-based material based on "
                 "the\nmetallic-roughness model.");
     ImGui::Separator();
-    ImGui::ColorEdit3("Albedo", glm::value_ptr(albedo));
-    ImGui::SliderFloat("Roughness", &roughness, 0.04f, 1.f);
-    ImGui::SliderFloat("Metallic", &metallic, 0.f, 1.f);
+    // Edits go through the setters so that the uniform block is repacked
+    glm::vec3 albedo = albedo_;
+    if (ImGui::ColorEdit3("Albedo", glm::value_ptr(albedo)))
+    {
+        setAlbedo(albedo);
+    }
+    float roughness = roughness_;
+    if (ImGui::SliderFloat("Roughness", &roughness, 0.04f, 1.f))
+    {
+        setRoughness(roughness);
+    }
+    float metallic = metallic_;
+    if (ImGui::SliderFloat("Metallic", &metallic, 0.f, 1.f))
+    {
+        setMetallic(metallic);
+    }
     ShaderMaterial::drawGUI();
     ImGui::Text("Wireframe");
-    ImGui::Checkbox("Show", &wireframe);
-    ImGui::InputFloat("Thickness", &wireframe_thickness);
-    ImGui::ColorEdit3("Color", glm::value_ptr(wireframe_color));
-    ImGui::Checkbox("Image-based lighting", &image_based_lighting);
+    bool wireframe = wireframe_;
+    if (ImGui::Checkbox("Show", &wireframe))
+    {
+        setWireframe(wireframe);
+    }
+    float thickness = wireframe_thickness_;
+    if (ImGui::InputFloat("Thickness", &thickness))
+    {
+        setWireframeThickness(thickness);
+    }
+    glm::vec3 color = wireframe_color_;
+    if (ImGui::ColorEdit3("Color", glm::value_ptr(color)))
+    {
+        setWireframeColor(color);
+    }
+    bool ibl = image_based_lighting_;
+    if (ImGui::Checkbox("Image-based lighting", &ibl))
+    {
+        setImageBasedLighting(ibl);
+    }
 }
 
 } // namespace rcube
\ No newline at end of file
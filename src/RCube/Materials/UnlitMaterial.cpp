@@ -26,9 +26,9 @@ uniform mat4 model_matrix;
 
 void main()
 {
-    vec4 world_pos = model_matrix * vec4(position, 1.0);
+    vec4 world_pos = model_matrix * vec4(instancePosition(position), 1.0);
     vert_position = world_pos.xyz;
-    vert_color = pow(color, vec3(2.2));
+    vert_color = pow(vertexColor(color), vec3(2.2));
     gl_Position = projection_matrix * view_matrix * world_pos;
 }
 )";
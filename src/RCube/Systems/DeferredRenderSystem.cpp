@@ -12,13 +12,13 @@
 #include "RCube/Systems/DeferredRenderSystem.h"
 #include "glm/gtx/string_cast.hpp"
 #include "RCube/Systems/Shaders.h"
+#include <algorithm>
 
 namespace rcube
 {
 
 const std::string GBufferVertexShader =
     R"(
-#version 420
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 uv;
@@ -45,23 +45,23 @@ uniform mat3 normal_matrix;
 
 void main()
 {
-    vec4 world_pos = model_matrix * vec4(position, 1.0);
+    vec4 world_pos = model_matrix * vec4(instancePosition(position), 1.0);
+    vec3 N = instanceVector(decodeNormal(normal));
     vert_position = world_pos.xyz;
     vert_uv = uv;
-    vert_color = pow(color, vec3(2.2));
-    vert_normal = normal_matrix * normal;
+    vert_color = pow(vertexColor(color), vec3(2.2));
+    vert_normal = normal_matrix * N;
     gl_Position = projection_matrix * view_matrix * world_pos;
     // Tangent basis
-    vec3 T = normalize(vec3(model_matrix * vec4(tangent, 0.0)));
-    vec3 B = cross(normal, T);
-    vert_tbn = mat3(T, B, normal);
+    vec3 T = normalize(vec3(model_matrix * vec4(instanceVector(decodeTangent(tangent)), 0.0)));
+    vec3 B = cross(N, T);
+    vert_tbn = mat3(T, B, N);
     vert_wire = wire;
 }
 )";
 
 const static std::string GBufferGeometryShader =
     R"(
-#version 420
 layout (triangles) in;
 layout (triangle_strip, max_vertices=3) out;
 
@@ -111,9 +111,9 @@ void main() {
     geom_position = vert_position[0];
     geom_normal = vert_normal[0];
     geom_uv = vert_uv[0];
-    geom_color = vert_color[0];
+    geom_color = faceColor(vert_color[0], 2.2);
     geom_tbn = vert_tbn[0];
-    geom_wire = vert_wire[0];
+    geom_wire = faceWire(vert_wire[0]);
     gl_Position = gl_in[0].gl_Position;
     EmitVertex();
 
@@ -122,9 +122,9 @@ void main() {
     geom_position = vert_position[1];
     geom_normal = vert_normal[1];
     geom_uv = vert_uv[1];
-    geom_color = vert_color[1];
+    geom_color = faceColor(vert_color[1], 2.2);
     geom_tbn = vert_tbn[1];
-    geom_wire = vert_wire[1];
+    geom_wire = faceWire(vert_wire[1]);
     gl_Position = gl_in[1].gl_Position;
     EmitVertex();
 
@@ -133,9 +133,9 @@ void main() {
     geom_position = vert_position[2];
     geom_normal = vert_normal[2];
     geom_uv = vert_uv[2];
-    geom_color = vert_color[2];
+    geom_color = faceColor(vert_color[2], 2.2);
     geom_tbn = vert_tbn[2];
-    geom_wire = vert_wire[2];
+    geom_wire = faceWire(vert_wire[2]);
     gl_Position = gl_in[2].gl_Position;
     EmitVertex();
     EndPrimitive();
@@ -223,11 +223,143 @@ void main() {
 }
 )";
 
+// Size in pixels of the square screen tiles of the light culling
+const int LIGHT_TILE_SIZE = 16;
+
+const std::string TiledLightCullingComputeShader = R"(
+#version 450
+
+#define RCUBE_TILE_SIZE 16
+#define RCUBE_MAX_LIGHTS_PER_TILE 256
+
+layout (local_size_x = RCUBE_TILE_SIZE, local_size_y = RCUBE_TILE_SIZE) in;
+
+layout(binding=0) uniform sampler2D depth_tex;
+
+layout (std140, binding=0) uniform Camera {
+    mat4 view_matrix;
+    mat4 projection_matrix;
+    mat4 viewport_matrix;
+    vec3 eye_pos;
+};
+
+struct PointLight
+{
+    vec3 position;
+    float cast_shadow;
+    vec3 color;
+    float radius;
+    float intensity;
+    float range;
+    float padding1_;
+    float padding2_;
+};
+
+layout (std430, binding=2) readonly buffer PointLights {
+    PointLight pointlights[];
+};
+
+layout (std430, binding=3) writeonly buffer TileLightCounts {
+    uint tile_light_counts[];
+};
+
+layout (std430, binding=4) writeonly buffer TileLightIndices {
+    uint tile_light_indices[];
+};
+
+uniform mat4 inverse_projection;
+uniform ivec2 resolution;
+uniform int num_pointlights;
+
+// View depth range of the tile as float bits (which order like the floats for positive values)
+shared uint tile_min_depth;
+shared uint tile_max_depth;
+shared uint tile_count;
+shared uint tile_lights[RCUBE_MAX_LIGHTS_PER_TILE];
+
+// View space position of a pixel (in window coordinates) at a depth buffer value
+vec3 viewPosition(vec2 pixel, float depth) {
+    vec4 p = inverse_projection * vec4(2.0 * pixel / vec2(resolution) - 1.0, 2.0 * depth - 1.0, 1.0);
+    return p.xyz / p.w;
+}
+
+// Plane through three points, oriented so that the inside point is in front of it
+vec4 tilePlane(vec3 a, vec3 b, vec3 c, vec3 inside) {
+    vec3 n = normalize(cross(b - a, c - a));
+    vec4 plane = vec4(n, -dot(n, a));
+    return dot(plane, vec4(inside, 1.0)) < 0.0 ? -plane : plane;
+}
+
+void main() {
+    uint local_index = gl_LocalInvocationIndex;
+    if (local_index == 0) {
+        tile_min_depth = 0x7F7FFFFFu;
+        tile_max_depth = 0u;
+        tile_count = 0u;
+    }
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (all(lessThan(pixel, resolution))) {
+        float depth = texelFetch(depth_tex, pixel, 0).r;
+        // Skip the background
+        if (depth < 1.0) {
+            float view_depth = max(-viewPosition(vec2(pixel) + 0.5, depth).z, 0.0);
+            atomicMin(tile_min_depth, floatBitsToUint(view_depth));
+            atomicMax(tile_max_depth, floatBitsToUint(view_depth));
+        }
+    }
+    barrier();
+
+    float min_depth = uintBitsToFloat(tile_min_depth);
+    float max_depth = uintBitsToFloat(tile_max_depth);
+    if (min_depth <= max_depth) {
+        // Side planes of the tile's frustum through the rays of its corners
+        vec2 p0 = vec2(gl_WorkGroupID.xy * RCUBE_TILE_SIZE);
+        vec2 p1 = min(p0 + vec2(RCUBE_TILE_SIZE), vec2(resolution));
+        vec2 corners[4] = vec2[](p0, vec2(p1.x, p0.y), p1, vec2(p0.x, p1.y));
+        vec3 inside = viewPosition(0.5 * (p0 + p1), 0.5);
+        vec4 planes[4];
+        for (int k = 0; k < 4; ++k) {
+            vec2 a = corners[k];
+            vec2 b = corners[(k + 1) % 4];
+            planes[k] = tilePlane(viewPosition(a, 0.0), viewPosition(a, 1.0), viewPosition(b, 0.0), inside);
+        }
+        for (uint i = local_index; i < uint(num_pointlights); i += RCUBE_TILE_SIZE * RCUBE_TILE_SIZE) {
+            vec3 center = (view_matrix * vec4(pointlights[i].position, 1.0)).xyz;
+            float range = pointlights[i].range;
+            bool overlaps = -center.z + range >= min_depth && -center.z - range <= max_depth;
+            for (int k = 0; k < 4 && overlaps; ++k) {
+                overlaps = dot(planes[k], vec4(center, 1.0)) >= -range;
+            }
+            if (overlaps) {
+                uint slot = atomicAdd(tile_count, 1u);
+                if (slot < RCUBE_MAX_LIGHTS_PER_TILE) {
+                    tile_lights[slot] = i;
+                }
+            }
+        }
+    }
+    barrier();
+
+    // The count includes lights beyond the list's capacity, for the heatmap
+    uint tile = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    uint count = min(tile_count, uint(RCUBE_MAX_LIGHTS_PER_TILE));
+    for (uint i = local_index; i < count; i += RCUBE_TILE_SIZE * RCUBE_TILE_SIZE) {
+        tile_light_indices[tile * RCUBE_MAX_LIGHTS_PER_TILE + i] = tile_lights[i];
+    }
+    if (local_index == 0) {
+        tile_light_counts[tile] = tile_count;
+    }
+}
+)";
+
 const std::string PBRLightingPassShader = R"(
-#version 420
+#version 450
 
 #define RCUBE_MAX_DIRLIGHTS 5
-#define RCUBE_MAX_POINTLIGHTS 50
+#define RCUBE_TILE_SIZE 16
+#define RCUBE_MAX_LIGHTS_PER_TILE 256
 
 out vec4 out_color;
 
@@ -284,16 +416,39 @@ struct PointLight
     vec3 color;
     float radius;
     float intensity;
+    float range;
     float padding1_;
     float padding2_;
-    float padding3_;
 };
 
-layout (std140, binding=2) uniform PointLights {
-    PointLight pointlights[RCUBE_MAX_POINTLIGHTS];
-    int num_pointlights;
+layout (std430, binding=2) readonly buffer PointLights {
+    PointLight pointlights[];
 };
 
+// Light lists of the screen tiles, written by the light culling compute shader
+layout (std430, binding=3) readonly buffer TileLightCounts {
+    uint tile_light_counts[];
+};
+
+layout (std430, binding=4) readonly buffer TileLightIndices {
+    uint tile_light_indices[];
+};
+
+uniform int num_pointlights;
+uniform bool tiled_lighting;
+uniform bool show_tile_heatmap;
+uniform int heatmap_max_lights;
+uniform ivec2 num_tiles;
+
+// Blue (no lights) to red (heatmap_max_lights); white past the capacity of the tile's list
+vec3 tileHeatmap(uint count) {
+    if (count > RCUBE_MAX_LIGHTS_PER_TILE) {
+        return vec3(1.0);
+    }
+    float t = clamp(float(count) / float(max(heatmap_max_lights, 1)), 0.0, 1.0);
+    return clamp(vec3(4.0 * t - 2.0, 2.0 - abs(4.0 * t - 2.0), 2.0 - 4.0 * t), 0.0, 1.0);
+}
+
 struct PerLightDotProducts
 {
     float LdotN, HdotV, HdotN;
@@ -302,9 +457,11 @@ struct PerLightDotProducts
 in vec2 v_texcoord;
 
 // Returns the attenuation factor that is multiplied with the light's color
-float falloff(float dist, float radius) {
+float falloff(float dist, float radius, float range) {
     float denom = (dist * dist) / (radius * radius);
-    return 1.0 / denom;
+    // Fade out to zero at the range, so that lights only affect the tiles they overlap
+    float window = clamp(1.0 - pow(dist / range, 4.0), 0.0, 1.0);
+    return window * window / denom;
 }
 
 const float PI = 3.14159265359;
@@ -424,7 +581,7 @@ vec3 pointLightDirectContribution(int index, const vec3 N, const vec3 V, float N
     computePerLightDotProducts(L, N, V, dots); 
 
     // Radiance
-    vec3 radiance = pointlights[index].intensity * dots.LdotN * pointlights[index].color * falloff(dist, pointlights[index].radius);
+    vec3 radiance = pointlights[index].intensity * dots.LdotN * pointlights[index].color * falloff(dist, pointlights[index].radius, pointlights[index].range);
     return radiance * lightDirectContribution(dots, NdotV, roughness, metallic, albedo, specular_color);
 }
 
@@ -453,9 +610,26 @@ void main()
         direct += dirLightDirectContribution(i, N, V, NdotV, roughness, metallic, albedo, specular_color);
     }
 
-    for (int i = 0; i < min(num_pointlights, RCUBE_MAX_POINTLIGHTS); ++i)
+    // With tiled lighting, only the point lights overlapping the pixel's tile can reach it
+    uint tile_count = 0;
+    if (tiled_lighting)
     {
-        direct += pointLightDirectContribution(i, N, V, NdotV, position, roughness, metallic, albedo, specular_color);
+        ivec2 tile_xy = ivec2(gl_FragCoord.xy) / RCUBE_TILE_SIZE;
+        uint tile = uint(tile_xy.y * num_tiles.x + tile_xy.x);
+        tile_count = tile_light_counts[tile];
+        uint count = min(tile_count, uint(RCUBE_MAX_LIGHTS_PER_TILE));
+        for (uint i = 0; i < count; ++i)
+        {
+            int index = int(tile_light_indices[tile * RCUBE_MAX_LIGHTS_PER_TILE + i]);
+            direct += pointLightDirectContribution(index, N, V, NdotV, position, roughness, metallic, albedo, specular_color);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < num_pointlights; ++i)
+        {
+            direct += pointLightDirectContribution(i, N, V, NdotV, position, roughness, metallic, albedo, specular_color);
+        }
     }
 
     // Indirect image-based lighting for ambient term
@@ -479,6 +653,10 @@ void main()
     }
 
     vec3 result = direct + indirect;
+    if (tiled_lighting && show_tile_heatmap)
+    {
+        result = mix(result, tileHeatmap(tile_count), 0.5);
+    }
 
     // Output
     out_color = vec4(result , 1.0);
@@ -537,8 +715,12 @@ void DeferredRenderSystem::initialize()
 {
     // GBuffer
     gbuffer_ = createGBuffer(resolution_.x, resolution_.y);
-    gbuffer_shader_ = ShaderProgram::create(GBufferVertexShader, GBufferGeometryShader,
-                                            GBufferFragmentShader, true);
+    gbuffer_shader_ = ShaderProgram::create(
+        std::vector<std::string>{"#version 450\n", common::INSTANCING_VERTEX_SHADER_CHUNK,
+                                 common::COLORMAP_VERTEX_SHADER_CHUNK, GBufferVertexShader},
+        std::vector<std::string>{"#version 450\n", common::FACE_DATA_GEOMETRY_SHADER_CHUNK,
+                                 GBufferGeometryShader},
+        std::vector<std::string>{GBufferFragmentShader}, true);
 
     // HDR framebuffer
     framebuffer_hdr_ = Framebuffer::create();
@@ -562,8 +744,10 @@ void DeferredRenderSystem::initialize()
     assert(framebuffer_shadow_->isComplete());
     shadow_shader_ = common::shadowMapShader();
 
-    // Lighting shader
+    // Lighting shader and tiled light culling
     lighting_shader_ = common::fullScreenQuadShader(PBRLightingPassShader);
+    culling_shader_ =
+        ShaderProgram::createCompute(std::vector<std::string>{TiledLightCullingComputeShader}, true);
 
     // UBOs
     // Three 4x4 matrices and one 3D vector
@@ -575,11 +759,14 @@ void DeferredRenderSystem::initialize()
         UniformBuffer::create(RCUBE_MAX_DIRECTIONAL_LIGHTS * 8 * sizeof(float) + sizeof(float));
     dirlight_data_.resize(RCUBE_MAX_DIRECTIONAL_LIGHTS * 8);
     // Point lights: Each light has one 3D position, one bool flag for shadow casting, one 3D color,
-    // one float for radius, one float for intensity and 3 empty floats for padding. Finally there
-    // is one int (treated as float) for number of directional lights
-    ubo_pointlights_ =
-        UniformBuffer::create(RCUBE_MAX_POINT_LIGHTS * 12 * sizeof(float) + sizeof(float));
-    pointlight_data_.resize(RCUBE_MAX_POINT_LIGHTS * 12);
+    // one float for radius, one float for intensity, one float for range and 2 empty floats for
+    // padding. The buffer grows with the number of lights.
+    ssbo_pointlights_ = ShaderStorageBuffer::create(64 * 12 * sizeof(float));
+    // A light count and a list of up to RCUBE_MAX_LIGHTS_PER_TILE lights per tile
+    const glm::ivec2 tiles = numTiles();
+    ssbo_tile_counts_ = ShaderStorageBuffer::create(size_t(tiles.x * tiles.y) * sizeof(uint32_t));
+    ssbo_tile_indices_ = ShaderStorageBuffer::create(size_t(tiles.x * tiles.y) *
+                                                     RCUBE_MAX_LIGHTS_PER_TILE * sizeof(uint32_t));
     // Initialize renderer
     renderer_.initialize();
     // Initialize bloom
@@ -630,12 +817,17 @@ void DeferredRenderSystem::setDirectionalLightsUBO()
     ubo_dirlights_->bindBase(1);
 }
 
-void DeferredRenderSystem::setPointLightsUBO()
+void DeferredRenderSystem::setPointLightsSSBO()
 {
     std::vector<Entity> pointlights =
         getFilteredEntities({PointLight::family(), Transform::family()});
+    if (pointlights.size() > tiled_settings_.max_point_lights)
+    {
+        pointlights.erase(pointlights.begin() + tiled_settings_.max_point_lights,
+                          pointlights.end());
+    }
     // Copy lights
-    assert(pointlights.size() < RCUBE_MAX_POINT_LIGHTS);
+    pointlight_data_.resize(std::max(pointlights.size(), size_t(1)) * 12);
     size_t k = 0;
     for (const Entity &l : pointlights)
     {
@@ -654,14 +846,51 @@ void DeferredRenderSystem::setPointLightsUBO()
         pointlight_data_[k++] = col.z;
         pointlight_data_[k++] = radius;
         pointlight_data_[k++] = pl->intensity();
+        pointlight_data_[k++] = pl->range();
         pointlight_data_[k++] = 0.f; // padding
         pointlight_data_[k++] = 0.f;
-        pointlight_data_[k++] = 0.f;
     }
-    const int num_lights = static_cast<int>(pointlights.size());
-    ubo_pointlights_->setData(pointlight_data_.data(), pointlight_data_.size(), 0);
-    ubo_pointlights_->setData(&num_lights, 1, RCUBE_MAX_POINT_LIGHTS * 12 * sizeof(float));
-    ubo_pointlights_->bindBase(2);
+    num_pointlights_ = static_cast<int>(pointlights.size());
+    const size_t bytes = pointlight_data_.size() * sizeof(float);
+    if (ssbo_pointlights_->size() < bytes)
+    {
+        ssbo_pointlights_->reserve(std::max(bytes, 2 * ssbo_pointlights_->size()));
+    }
+    ssbo_pointlights_->setData(pointlight_data_.data(), bytes, 0);
+    ssbo_pointlights_->bindBase(2);
+}
+
+glm::ivec2 DeferredRenderSystem::numTiles() const
+{
+    return (resolution_ + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+}
+
+std::vector<uint32_t> DeferredRenderSystem::tileLightCounts() const
+{
+    if (!tiled_settings_.enabled || ssbo_tile_counts_ == nullptr)
+    {
+        return {};
+    }
+    const glm::ivec2 tiles = numTiles();
+    std::vector<uint32_t> counts(size_t(tiles.x * tiles.y));
+    ssbo_tile_counts_->getData(counts.data(), counts.size() * sizeof(uint32_t), 0);
+    return counts;
+}
+
+void DeferredRenderSystem::lightCullingPass(Camera *cam)
+{
+    const glm::ivec2 tiles = numTiles();
+    culling_shader_->use();
+    culling_shader_->uniform("inverse_projection").set(glm::inverse(cam->view_to_projection));
+    culling_shader_->uniform("resolution").set(resolution_);
+    culling_shader_->uniform("num_pointlights").set(num_pointlights_);
+    glBindTextureUnit(0, gbuffer_->depthStencilAttachment()->id());
+    ssbo_tile_counts_->bindBase(3);
+    ssbo_tile_indices_->bindBase(4);
+    glDispatchCompute(GLuint(tiles.x), GLuint(tiles.y), 1);
+    // The lighting pass reads the light lists
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    culling_shader_->done();
 }
 
 void DeferredRenderSystem::initializePostprocess()
@@ -810,8 +1039,14 @@ void DeferredRenderSystem::lightingPass(Camera *cam)
         dc_light.cubemaps.push_back({cam->prefilter->id(), 5});
         dc_light.cubemaps.push_back({cam->irradiance->id(), 6});
     }
+    const glm::ivec2 tiles = numTiles();
     dc_light.update_uniforms = [&](std::shared_ptr<ShaderProgram> shader) {
         shader->uniform("use_image_based_lighting").set(use_ibl);
+        shader->uniform("num_pointlights").set(num_pointlights_);
+        shader->uniform("tiled_lighting").set(tiled_settings_.enabled);
+        shader->uniform("show_tile_heatmap").set(tiled_settings_.show_heatmap);
+        shader->uniform("heatmap_max_lights").set(int(tiled_settings_.heatmap_max_lights));
+        shader->uniform("num_tiles").set(tiles);
     };
     dc_light.mesh = GLRenderer::getDrawCallMeshInfo(renderer_.fullscreenQuadMesh());
     dcs.push_back(dc_light);
@@ -837,7 +1072,11 @@ void DeferredRenderSystem::lightingPass(Camera *cam)
         dcs.push_back(dc_skybox);
     }
     setDirectionalLightsUBO();
-    setPointLightsUBO();
+    setPointLightsSSBO();
+    if (tiled_settings_.enabled)
+    {
+        lightCullingPass(cam);
+    }
     renderer_.draw(rtl, dcs);
 }
 
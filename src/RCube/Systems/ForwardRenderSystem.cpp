@@ -5,6 +5,7 @@
 #include "RCube/Components/ForwardMaterial.h"
 #include "RCube/Components/PointLight.h"
 #include "RCube/Components/Transform.h"
+#include "RCube/Core/Graphics/MeshGen/Meshlets.h"
 #include "RCube/Core/Graphics/OpenGL/CheckGLError.h"
 #include "RCube/Core/Graphics/OpenGL/CommonMesh.h"
 #include "RCube/Core/Graphics/OpenGL/CommonShader.h"
@@ -12,26 +13,512 @@
 #include "RCube/Core/Graphics/ShaderManager.h"
 #include "RCube/Systems/Shaders.h"
 #include "RCubeViewer/Components/Name.h"
+#include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtx/string_cast.hpp"
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
 #include <string>
+#include <tuple>
 
 namespace rcube
 {
 
-DrawCall makeDrawCall(Drawable *dr, ShaderMaterial *material, Transform *tr, ForwardRenderPass pass)
+// Vertex buffer binding index used for the per-instance draw ID attribute in multi-draw mode
+const GLuint DRAW_ID_BINDING = 15;
+
+// Layout of the ShadowCascades uniform block (std140), in floats: an atlas matrix per light
+// and cascade, the atlas tile (uv min, uv max) of each of them, and the split distance, texel
+// size, normal offset and depth bias of each cascade, followed by the number of cascades
+const size_t SHADOW_SLOTS = RCUBE_MAX_DIRECTIONAL_LIGHTS * RCUBE_MAX_SHADOW_CASCADES;
+const size_t SHADOW_TILES_OFFSET = SHADOW_SLOTS * 16;
+const size_t SHADOW_CASCADES_OFFSET = SHADOW_TILES_OFFSET + SHADOW_SLOTS * 4;
+const size_t SHADOW_DATA_SIZE = SHADOW_CASCADES_OFFSET + RCUBE_MAX_SHADOW_CASCADES * 4;
+
+// Number of floats per point light in the PointLights shader storage block
+const size_t POINT_LIGHT_SIZE = 12;
+
+// Grows a shader storage buffer to at least the given size
+template <BufferType T> static void reserveStorage(Buffer<T> &buffer, size_t bytes)
+{
+    if (buffer.size() < bytes)
+    {
+        buffer.reserve(std::max(bytes, 2 * buffer.size()));
+    }
+}
+
+// Number of triangles drawn for a mesh; 0 for points and lines
+static size_t numTriangles(const Mesh &mesh)
+{
+    const size_t n = mesh.numIndexData() > 0 ? mesh.numIndexData() : mesh.numVertexData();
+    switch (mesh.primitive())
+    {
+    case MeshPrimitive::Triangles:
+        return n / 3;
+    case MeshPrimitive::TriangleStrip:
+        return n > 2 ? n - 2 : 0;
+    default:
+        return 0;
+    }
+}
+
+// Work group size of the occlusion culling compute shaders
+const GLuint HIZ_GROUP_SIZE = 8;
+const GLuint OCCLUSION_GROUP_SIZE = 64;
+const GLuint MESHLET_GROUP_SIZE = 64;
+
+// Reduces a level of the depth pyramid (or the depth buffer) to the next level, keeping the
+// farthest depth. A texel covers 2x2 source texels, and the last row and column also cover the
+// third one left over by odd source sizes, so that every source texel is accounted for.
+const std::string HiZDownsampleComputeShader = R"(
+#version 450
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout(binding=0) uniform sampler2D src;
+layout(binding=0, r32f) uniform writeonly image2D dst;
+
+uniform int src_level;
+
+void main()
+{
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 dst_size = imageSize(dst);
+    if (p.x >= dst_size.x || p.y >= dst_size.y)
+    {
+        return;
+    }
+    ivec2 src_size = textureSize(src, src_level);
+    ivec2 first = 2 * p;
+    ivec2 last = min(first + 1 + ivec2(equal(p, dst_size - 1)) * (src_size & 1), src_size - 1);
+    float depth = 0.0;
+    for (int y = first.y; y <= last.y; ++y)
+    {
+        for (int x = first.x; x <= last.x; ++x)
+        {
+            depth = max(depth, texelFetch(src, ivec2(x, y), src_level).r);
+        }
+    }
+    imageStore(dst, p, vec4(depth));
+}
+)";
+
+// An object tested for occlusion: world space bounds, draw parameters and visibility history
+// slot (std430 layout)
+struct OcclusionObjectData
+{
+    glm::vec4 box_min;
+    glm::vec4 box_max;
+    // x: number of indices (or vertices), y: first index (or vertex), z: base vertex, w: whether
+    // indexed
+    glm::uvec4 draw;
+    // x: history slot, y: whether the slot is new, so that the object counts as visible
+    glm::uvec4 history;
+};
+
+// Declarations shared by the occlusion culling shaders. The draw command of object i is words
+// 5 i, ..., 5 i + 4 of a command buffer, whether indexed or not, and draws it once or not at all.
+const std::string OcclusionObjectsChunk = R"(
+struct OcclusionObject
+{
+    vec4 box_min;
+    vec4 box_max;
+    uvec4 draw;
+    uvec4 history;
+};
+
+layout (std430, binding=0) readonly buffer OcclusionObjects {
+    OcclusionObject objects[];
+};
+
+// Whether the object in each slot was visible in its latest test
+layout (std430, binding=1) buffer OcclusionHistory {
+    uint history[];
+};
+
+uniform uint num_objects;
+
+// count, instanceCount, firstIndex (or first), baseVertex (or baseInstance)
+uvec4 drawCommand(OcclusionObject object, bool draw)
+{
+    return uvec4(object.draw.x, draw ? 1u : 0u, object.draw.y,
+                 object.draw.w != 0u ? object.draw.z : 0u);
+}
+
+bool wasVisible(OcclusionObject object)
+{
+    return object.history.y != 0u || history[object.history.x] != 0u;
+}
+)";
+
+// Writes the commands of the first phase: the objects visible in their previous test
+const std::string OcclusionHistoryComputeShader = R"(
+layout (local_size_x = 64) in;
+
+layout (std430, binding=6) writeonly buffer PrepassCommands {
+    uint commands[];
+};
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= num_objects)
+    {
+        return;
+    }
+    uvec4 command = drawCommand(objects[i], wasVisible(objects[i]));
+    commands[5u * i] = command.x;
+    commands[5u * i + 1u] = command.y;
+    commands[5u * i + 2u] = command.z;
+    commands[5u * i + 3u] = command.w;
+    commands[5u * i + 4u] = 0u;
+}
+)";
+
+// Tests world space bounding boxes against the depth pyramid. The screen rectangle of a box is
+// looked up at the pyramid level where it spans at most 2x2 texels; the box is hidden if its
+// nearest depth is behind the farthest depth of those texels. Writes the commands of the
+// objects that became visible and of all visible objects, and updates the history.
+const std::string OcclusionTestComputeShader = R"(
+layout (local_size_x = 64) in;
+
+layout(binding=0) uniform sampler2D hiz;
+
+layout (std430, binding=6) writeonly buffer RevealCommands {
+    uint reveal_commands[];
+};
+
+layout (std430, binding=7) writeonly buffer VisibleCommands {
+    uint visible_commands[];
+};
+
+layout(binding=0, offset=0) uniform atomic_uint num_hidden;
+
+uniform mat4 view_projection;
+uniform ivec2 resolution;
+
+bool testBox(vec3 box_min, vec3 box_max)
+{
+    vec3 ndc_min = vec3(1e30);
+    vec3 ndc_max = vec3(-1e30);
+    for (int c = 0; c < 8; ++c)
+    {
+        vec3 p = mix(box_min, box_max, vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1));
+        vec4 q = view_projection * vec4(p, 1.0);
+        // Boxes reaching behind the camera are kept
+        if (q.w <= 1e-6)
+        {
+            return true;
+        }
+        ndc_min = min(ndc_min, q.xyz / q.w);
+        ndc_max = max(ndc_max, q.xyz / q.w);
+    }
+    // Outside the view frustum
+    if (any(lessThan(ndc_max, vec3(-1.0))) || any(greaterThan(ndc_min, vec3(1.0))))
+    {
+        return false;
+    }
+    // Texels of the first level covered by the box; each covers 2x2 pixels
+    ivec2 size = textureSize(hiz, 0);
+    vec2 uv_min = clamp(ndc_min.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uv_max = clamp(ndc_max.xy * 0.5 + 0.5, 0.0, 1.0);
+    ivec2 p0 = min(ivec2(uv_min * vec2(resolution)) / 2, size - 1);
+    ivec2 p1 = min(ivec2(uv_max * vec2(resolution)) / 2, size - 1);
+    ivec2 extent = p1 - p0 + 1;
+    // The single texel of the last level covers the whole screen
+    int level = int(ceil(log2(float(max(extent.x, extent.y)))));
+    level = clamp(level, 0, textureQueryLevels(hiz) - 1);
+    size = textureSize(hiz, level);
+    ivec2 t0 = min(p0 >> level, size - 1);
+    ivec2 t1 = min(p1 >> level, size - 1);
+    float depth = max(texelFetch(hiz, t0, level).r, texelFetch(hiz, t1, level).r);
+    depth = max(depth, texelFetch(hiz, ivec2(t1.x, t0.y), level).r);
+    depth = max(depth, texelFetch(hiz, ivec2(t0.x, t1.y), level).r);
+    return ndc_min.z * 0.5 + 0.5 <= depth;
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= num_objects)
+    {
+        return;
+    }
+    OcclusionObject object = objects[i];
+    bool visible = testBox(object.box_min.xyz, object.box_max.xyz);
+    // Objects drawn by the first phase are already in the depth buffer
+    uvec4 reveal = drawCommand(object, visible && !wasVisible(object));
+    uvec4 command = drawCommand(object, visible);
+    history[object.history.x] = visible ? 1u : 0u;
+    if (!visible)
+    {
+        atomicCounterIncrement(num_hidden);
+    }
+    for (uint k = 0u; k < 4u; ++k)
+    {
+        reveal_commands[5u * i + k] = reveal[k];
+        visible_commands[5u * i + k] = command[k];
+    }
+    reveal_commands[5u * i + 4u] = 0u;
+    visible_commands[5u * i + 4u] = 0u;
+}
+)";
+
+// Sets the instance count of the multi-draw commands of tested objects to their visibility;
+// the objects are the per-object data of the multi-draw shaders
+const std::string OcclusionMultiDrawComputeShader = R"(
+#version 450
+
+layout (local_size_x = 64) in;
+
+struct MultiDrawObject
+{
+    mat4 model_matrix;
+    mat4 normal_matrix;
+    uvec4 ids;
+};
+
+layout (std430, binding=0) readonly buffer MultiDrawObjects {
+    MultiDrawObject objects[];
+};
+
+layout (std430, binding=1) readonly buffer OcclusionHistory {
+    uint history[];
+};
+
+layout (std430, binding=6) buffer MultiDrawCommands {
+    uint commands[];
+};
+
+uniform uint num_objects;
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= num_objects || objects[i].ids.z == 0u)
+    {
+        return;
+    }
+    commands[objects[i].ids.w] = history[objects[i].ids.z - 1u];
+}
+)";
+
+// Bounds and triangle range of a meshlet read by the meshlet culling shader (std430 layout)
+struct MeshletData
+{
+    glm::vec4 sphere;     // center, radius
+    glm::vec4 cone;       // axis, cutoff
+    glm::uvec4 triangles; // x: first triangle, y: number of triangles
+};
+
+// An object whose meshlets are culled, in the object space of its mesh (std430 layout)
+struct MeshletObjectData
+{
+    glm::mat4 object_to_clip;
+    glm::vec4 planes[6];
+    glm::vec4 eye;
+    // x: first meshlet, y: number of meshlets, z: first work group, w: first command word
+    glm::uvec4 meshlets;
+    // x: first index (or first vertex if not indexed), y: base vertex, z: whether indexed,
+    // w: whether back-facing meshlets are culled
+    glm::uvec4 draw;
+};
+
+// Culls the meshlets of a list of objects, one invocation per meshlet, and writes one indirect
+// draw command per meshlet; culled meshlets get a command that draws nothing, so the commands
+// of an object can be drawn as they are. The tests match cullMeshlets(), except that the depth
+// pyramid is looked up like in the occlusion test.
+const std::string MeshletCullComputeShader = R"(
+#version 450
+
+layout (local_size_x = 64) in;
+
+layout(binding=0) uniform sampler2D hiz;
+
+struct Meshlet
+{
+    vec4 sphere;
+    vec4 cone;
+    uvec4 triangles;
+};
+
+struct MeshletObject
+{
+    mat4 object_to_clip;
+    vec4 planes[6];
+    vec4 eye;
+    uvec4 meshlets;
+    uvec4 draw;
+};
+
+// Sorted by first work group
+layout (std430, binding=0) readonly buffer MeshletObjects {
+    MeshletObject objects[];
+};
+
+layout (std430, binding=1) writeonly buffer MeshletCommands {
+    uint commands[];
+};
+
+layout (std430, binding=6) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+// Number of meshlets and triangles drawn
+layout (std430, binding=7) buffer MeshletStats {
+    uint stats[];
+};
+
+uniform uint num_objects;
+uniform bool use_depth;
+uniform bool count_stats;
+uniform ivec2 resolution;
+
+// Whether the screen rectangle of a sphere may be in front of the depth pyramid
+bool inFrontOfDepth(mat4 object_to_clip, vec4 sphere)
+{
+    vec3 ndc_min = vec3(1e30);
+    vec3 ndc_max = vec3(-1e30);
+    for (int c = 0; c < 8; ++c)
+    {
+        vec3 offset = vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1) * 2.0 - 1.0;
+        vec4 q = object_to_clip * vec4(sphere.xyz + sphere.w * offset, 1.0);
+        // Spheres reaching behind the camera are kept
+        if (q.w <= 1e-6)
+        {
+            return true;
+        }
+        ndc_min = min(ndc_min, q.xyz / q.w);
+        ndc_max = max(ndc_max, q.xyz / q.w);
+    }
+    ivec2 size = textureSize(hiz, 0);
+    vec2 uv_min = clamp(ndc_min.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uv_max = clamp(ndc_max.xy * 0.5 + 0.5, 0.0, 1.0);
+    ivec2 p0 = min(ivec2(uv_min * vec2(resolution)) / 2, size - 1);
+    ivec2 p1 = min(ivec2(uv_max * vec2(resolution)) / 2, size - 1);
+    ivec2 extent = p1 - p0 + 1;
+    int level = int(ceil(log2(float(max(extent.x, extent.y)))));
+    level = clamp(level, 0, textureQueryLevels(hiz) - 1);
+    size = textureSize(hiz, level);
+    ivec2 t0 = min(p0 >> level, size - 1);
+    ivec2 t1 = min(p1 >> level, size - 1);
+    float depth = max(texelFetch(hiz, t0, level).r, texelFetch(hiz, t1, level).r);
+    depth = max(depth, texelFetch(hiz, ivec2(t1.x, t0.y), level).r);
+    depth = max(depth, texelFetch(hiz, ivec2(t0.x, t1.y), level).r);
+    return ndc_min.z * 0.5 + 0.5 <= depth;
+}
+
+void main()
+{
+    // The object is the last one starting at or before this work group
+    uint group = gl_WorkGroupID.x;
+    uint lo = 0u;
+    uint hi = num_objects - 1u;
+    while (lo < hi)
+    {
+        uint mid = (lo + hi + 1u) / 2u;
+        if (objects[mid].meshlets.z <= group)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1u;
+        }
+    }
+    uvec4 range = objects[lo].meshlets;
+    uvec4 draw = objects[lo].draw;
+    uint i = (group - range.z) * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+    if (i >= range.y)
+    {
+        return;
+    }
+    Meshlet meshlet = meshlets[range.x + i];
+
+    bool visible = true;
+    for (int p = 0; p < 6 && visible; ++p)
+    {
+        vec4 plane = objects[lo].planes[p];
+        visible = dot(plane.xyz, meshlet.sphere.xyz) + plane.w >= -meshlet.sphere.w;
+    }
+    if (visible && draw.w != 0u && meshlet.cone.w < 1.0)
+    {
+        vec4 eye = objects[lo].eye;
+        if (eye.w == 0.0)
+        {
+            visible = dot(eye.xyz, meshlet.cone.xyz) < meshlet.cone.w;
+        }
+        else
+        {
+            vec3 d = meshlet.sphere.xyz - eye.xyz;
+            visible = dot(d, meshlet.cone.xyz) < meshlet.cone.w * length(d) + meshlet.sphere.w;
+        }
+    }
+    if (visible && use_depth)
+    {
+        visible = inFrontOfDepth(objects[lo].object_to_clip, meshlet.sphere);
+    }
+
+    uint count = visible ? 3u * meshlet.triangles.y : 0u;
+    uint first = draw.x + 3u * meshlet.triangles.x;
+    if (draw.z != 0u)
+    {
+        // count, instanceCount, firstIndex, baseVertex, baseInstance
+        uint c = range.w + 5u * i;
+        commands[c] = count;
+        commands[c + 1u] = visible ? 1u : 0u;
+        commands[c + 2u] = first;
+        commands[c + 3u] = draw.y;
+        commands[c + 4u] = 0u;
+    }
+    else
+    {
+        // count, instanceCount, first, baseInstance
+        uint c = range.w + 4u * i;
+        commands[c] = count;
+        commands[c + 1u] = visible ? 1u : 0u;
+        commands[c + 2u] = first;
+        commands[c + 3u] = 0u;
+    }
+    if (count_stats && visible)
+    {
+        atomicAdd(stats[0], 1u);
+        atomicAdd(stats[1], meshlet.triangles.y);
+    }
+}
+)";
+
+// Per-object data read by shaders compiled with RCUBE_MULTIDRAW (std430 layout)
+struct MultiDrawObjectData
+{
+    glm::mat4 model_matrix;
+    glm::mat4 normal_matrix;
+    // x: entity id, y: index of the material in the draw call's materials, z: occlusion
+    // history slot plus one, or 0 if not tested, w: word of the command's instance count
+    glm::uvec4 ids;
+};
+
+// Draw call of a mesh with a material pass; meshes without a transform (static batches) are
+// already in world space
+DrawCall makeDrawCall(const std::shared_ptr<Mesh> &mesh, ShaderMaterial *material, Transform *tr,
+                      ForwardRenderPass pass)
 {
     DrawCall dc;
     // dc.settings = material->state();
-    dc.mesh = GLRenderer::getDrawCallMeshInfo(dr->mesh);
+    dc.mesh = GLRenderer::getDrawCallMeshInfo(mesh);
     dc.textures = material->textureSlots();
     dc.cubemaps = material->cubemapSlots();
     dc.shader = ForwardRenderSystemShaderManager::instance().get(material->name(), pass);
     dc.update_uniforms = [dc, material, tr](std::shared_ptr<ShaderProgram>) {
-        dc.shader->uniform("model_matrix").set(tr->worldTransform());
+        const glm::mat4 model = tr != nullptr ? tr->worldTransform() : glm::mat4(1.f);
+        dc.shader->uniform("model_matrix").set(model);
         Uniform nor_mat;
         if (dc.shader->hasUniform("normal_matrix", nor_mat))
         {
-            nor_mat.set(glm::transpose(glm::inverse(glm::mat3(tr->worldTransform()))));
+            nor_mat.set(glm::transpose(glm::inverse(glm::mat3(model))));
         }
         material->updateUniforms(dc.shader);
     };
@@ -109,24 +596,21 @@ void ForwardRenderSystem::initialize()
         UniformBuffer::create(RCUBE_MAX_DIRECTIONAL_LIGHTS * 24 * sizeof(float) + sizeof(float));
     dirlight_data_.resize(RCUBE_MAX_DIRECTIONAL_LIGHTS * 24);
     // Point lights: Each light has one 3D position, one bool flag for shadow casting, one 3D color,
-    // one float for radius, one float for intensity and 3 empty floats for padding. Finally there
-    // is one int (treated as float) for number of point lights
-    ubo_pointlights_ =
-        UniformBuffer::create(RCUBE_MAX_POINT_LIGHTS * 12 * sizeof(float) + sizeof(float));
-    pointlight_data_.resize(RCUBE_MAX_POINT_LIGHTS * 12);
+    // one float for radius, one float for intensity, one float for range and 2 empty floats for
+    // padding. The buffers grow with the number of lights and cluster light references.
+    ssbo_pointlights_ = ShaderStorageBuffer::create(64 * POINT_LIGHT_SIZE * sizeof(float));
+    ssbo_light_clusters_ = ShaderStorageBuffer::create(0);
+    ssbo_light_indices_ = ShaderStorageBuffer::create(4096 * sizeof(uint32_t));
 
-    // Shadows
+    // Shadows: the atlas is sized in shadowMapPass() for the lights that cast shadows
     framebuffer_shadow_ = Framebuffer::create();
     shader_shadow_ = common::shadowMapShader();
-    shadow_atlas_ = Texture2D::create(8000, 8000, 1, TextureInternalFormat::Depth32F);
-    shadow_atlas_->setFilterMode(TextureFilterMode::Nearest);
-    shadow_atlas_->setWrapMode(TextureWrapMode::ClampToBorder);
-    shadow_atlas_->setBorderColor(glm::vec4(1.0));
     framebuffer_shadow_->setDrawBuffers({});
     framebuffer_shadow_->setReadBuffer(GL_NONE);
-    framebuffer_shadow_->setDepthAttachment(shadow_atlas_);
+    resizeShadowAtlas(1, 1, false);
     glNamedFramebufferReadBuffer(framebuffer_shadow_->id(), GL_NONE);
-    assert(framebuffer_shadow_->isComplete());
+    ubo_shadows_ = UniformBuffer::create(SHADOW_DATA_SIZE * sizeof(float) + sizeof(float));
+    shadow_data_.resize(SHADOW_DATA_SIZE);
 
     // For picking
     framebuffer_pick_ = Framebuffer::create();
@@ -143,6 +627,69 @@ void ForwardRenderSystem::initialize()
     // Transparency
     wboit_.initialize(resolution_, depth_);
 
+    // Multi-draw submission needs shader storage buffers and indirect draws (OpenGL 4.3)
+    multidraw_supported_ = GLAD_GL_VERSION_4_3 != 0;
+    if (multidraw_supported_)
+    {
+        ssbo_objects_ = ShaderStorageBuffer::create(1024 * sizeof(MultiDrawObjectData));
+        ssbo_materials_ = ShaderStorageBuffer::create(64 * 1024);
+        GLint alignment = 0;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        ssbo_offset_alignment_ = static_cast<size_t>(std::max(alignment, 1));
+        indirect_buffer_ = DrawIndirectBuffer::create(1024 * 5 * sizeof(GLuint));
+        draw_id_buffer_ = ArrayBuffer::create(0, GL_STATIC_DRAW);
+    }
+
+    // Occlusion culling runs compute shaders (OpenGL 4.3). The first pyramid level has half
+    // the resolution of the depth buffer.
+    occlusion_culling_supported_ = GLAD_GL_VERSION_4_3 != 0;
+    if (occlusion_culling_supported_)
+    {
+        const glm::ivec2 hiz_size = glm::max(resolution_ / 2, glm::ivec2(1));
+        size_t levels = 1;
+        while ((std::max(hiz_size.x, hiz_size.y) >> levels) > 0)
+        {
+            ++levels;
+        }
+        hiz_ = Texture2D::create(hiz_size.x, hiz_size.y, levels, TextureInternalFormat::R32F);
+        hiz_->setFilterModeMin(TextureFilterMode::Trilinear);
+        hiz_->setFilterModeMag(TextureFilterMode::Nearest);
+        shader_hiz_downsample_ = ShaderProgram::createCompute(
+            std::vector<std::string>{HiZDownsampleComputeShader}, true);
+        shader_occlusion_history_ = ShaderProgram::createCompute(
+            std::vector<std::string>{"#version 450\n", OcclusionObjectsChunk,
+                                     OcclusionHistoryComputeShader},
+            true);
+        shader_occlusion_test_ = ShaderProgram::createCompute(
+            std::vector<std::string>{"#version 450\n", OcclusionObjectsChunk,
+                                     OcclusionTestComputeShader},
+            true);
+        shader_occlusion_multidraw_ = ShaderProgram::createCompute(
+            std::vector<std::string>{OcclusionMultiDrawComputeShader}, true);
+        ssbo_occlusion_objects_ = ShaderStorageBuffer::create(1024 * sizeof(OcclusionObjectData));
+        for (auto &commands : occlusion_commands_)
+        {
+            commands = DrawIndirectBuffer::create(1024 * 5 * sizeof(GLuint));
+        }
+        occlusion_counter_ = AtomicCounterBuffer::create(sizeof(GLuint));
+    }
+
+    // Meshlets are culled by a compute shader writing indirect draws (OpenGL 4.3)
+    if (GLAD_GL_VERSION_4_3 != 0)
+    {
+        shader_meshlet_cull_ = ShaderProgram::createCompute(
+            std::vector<std::string>{MeshletCullComputeShader}, true);
+        ssbo_meshlets_ = ShaderStorageBuffer::create(4096 * sizeof(MeshletData));
+        ssbo_meshlet_objects_ = ShaderStorageBuffer::create(64 * sizeof(MeshletObjectData));
+        for (auto &commands : meshlet_commands_)
+        {
+            commands = DrawIndirectBuffer::create(4096 * 5 * sizeof(GLuint));
+        }
+        ssbo_meshlet_stats_ = ShaderStorageBuffer::create(2 * sizeof(uint32_t));
+        meshlet_stats_readback_ = ReadbackBuffer::create(2 * sizeof(uint32_t));
+        static_batch_commands_ = DrawIndirectBuffer::create(4096 * 5 * sizeof(GLuint));
+    }
+
     // Initialize renderer
     renderer_.initialize();
 
@@ -164,24 +711,21 @@ void ForwardRenderSystem::setCameraUBO(const glm::vec3 &eye_pos, const glm::mat4
 
 void ForwardRenderSystem::setDirectionalLightsUBO()
 {
+    // Lights beyond the maximum are ignored, as in shadowMapPass()
     std::vector<Entity> dirlights = getFilteredEntities({DirectionalLight::family()});
+    if (dirlights.size() > RCUBE_MAX_DIRECTIONAL_LIGHTS)
+    {
+        dirlights.erase(dirlights.begin() + RCUBE_MAX_DIRECTIONAL_LIGHTS, dirlights.end());
+    }
     // Copy lights
-    assert(dirlights.size() < RCUBE_MAX_DIRECTIONAL_LIGHTS);
     size_t k = 0;
-    for (const Entity &l : dirlights)
+    for (size_t index = 0; index < dirlights.size(); ++index)
     {
-        DirectionalLight *dl = world_->getComponent<DirectionalLight>(l);
+        DirectionalLight *dl = world_->getComponent<DirectionalLight>(dirlights[index]);
         const glm::vec3 dir = glm::normalize(dl->direction());
         const glm::vec3 &col = dl->color();
-        // Light's viewproj matrix
-        /*const glm::vec3 opp_dir = -dir;
-        const glm::mat4 light_proj = glm::ortho<float>(-10, 10, -10, 10, -10, 20);
-        const glm::vec3 up = glm::length(glm::cross(opp_dir, glm::vec3(0, 1, 0))) > 1e-6
-                                 ? glm::vec3(0, 1, 0)
-                                 : glm::vec3(1, 0, 0);
-        const glm::mat4 light_view = glm::lookAt(opp_dir, glm::vec3(0, 0, 0), up);
-        const glm::mat4 light_matrix = light_proj * light_view;*/
-        const glm::mat4 light_matrix = dl->viewProjectionMatrix(-1, 1, -1, 1, 0.1f, 3.f);
+        // Atlas matrix of the light's first cascade, written by shadowMapPass()
+        const float *light_matrix = &shadow_data_[index * RCUBE_MAX_SHADOW_CASCADES * 16];
         dirlight_data_[k++] = dir.x;
         dirlight_data_[k++] = dir.y;
         dirlight_data_[k++] = dir.z;
@@ -190,12 +734,9 @@ void ForwardRenderSystem::setDirectionalLightsUBO()
         dirlight_data_[k++] = col.g;
         dirlight_data_[k++] = col.b;
         dirlight_data_[k++] = dl->intensity();
-        for (int i = 0; i < 4; ++i)
+        for (int i = 0; i < 16; ++i)
         {
-            for (int j = 0; j < 4; ++j)
-            {
-                dirlight_data_[k++] = light_matrix[i][j];
-            }
+            dirlight_data_[k++] = light_matrix[i];
         }
     }
     const int num_lights = static_cast<int>(dirlights.size());
@@ -204,21 +745,28 @@ void ForwardRenderSystem::setDirectionalLightsUBO()
     ubo_dirlights_->bindBase(1);
 }
 
-void ForwardRenderSystem::setPointLightsUBO()
+void ForwardRenderSystem::setPointLightsSSBO()
 {
     std::vector<Entity> pointlights =
         getFilteredEntities({PointLight::family(), Transform::family()});
+    if (pointlights.size() > light_cluster_settings_.max_point_lights)
+    {
+        pointlights.erase(pointlights.begin() + light_cluster_settings_.max_point_lights,
+                          pointlights.end());
+    }
     // Copy lights
-    assert(pointlights.size() < RCUBE_MAX_POINT_LIGHTS);
+    pointlight_data_.resize(std::max(pointlights.size(), size_t(1)) * POINT_LIGHT_SIZE);
+    pointlight_bounds_.resize(pointlights.size());
     size_t k = 0;
-    for (const Entity &l : pointlights)
+    for (size_t index = 0; index < pointlights.size(); ++index)
     {
-        PointLight *pl = world_->getComponent<PointLight>(l);
-        Transform *tr = world_->getComponent<Transform>(l);
+        PointLight *pl = world_->getComponent<PointLight>(pointlights[index]);
+        Transform *tr = world_->getComponent<Transform>(pointlights[index]);
         const glm::vec3 &pos = tr->worldPosition();
         float cast_shadow = static_cast<float>(pl->castShadow());
         const glm::vec3 &col = pl->color();
         float radius = pl->radius();
+        const float range = pl->range();
         pointlight_data_[k++] = pos.x;
         pointlight_data_[k++] = pos.y;
         pointlight_data_[k++] = pos.z;
@@ -228,14 +776,58 @@ void ForwardRenderSystem::setPointLightsUBO()
         pointlight_data_[k++] = col.z;
         pointlight_data_[k++] = radius;
         pointlight_data_[k++] = pl->intensity();
+        pointlight_data_[k++] = range;
         pointlight_data_[k++] = 0.f; // padding
         pointlight_data_[k++] = 0.f;
-        pointlight_data_[k++] = 0.f;
+        pointlight_bounds_[index] = glm::vec4(pos, range);
     }
-    const int num_lights = static_cast<int>(pointlights.size());
-    ubo_pointlights_->setData(pointlight_data_.data(), pointlight_data_.size(), 0);
-    ubo_pointlights_->setData(&num_lights, 1, RCUBE_MAX_POINT_LIGHTS * 12 * sizeof(float));
-    ubo_pointlights_->bindBase(2);
+    const size_t bytes = pointlight_data_.size() * sizeof(float);
+    reserveStorage(*ssbo_pointlights_, bytes);
+    ssbo_pointlights_->setData(pointlight_data_.data(), bytes, 0);
+    ssbo_pointlights_->bindBase(2);
+}
+
+void ForwardRenderSystem::setLightClustersSSBO(Camera *cam)
+{
+    std::vector<glm::vec4> view_lights(pointlight_bounds_.size());
+    for (size_t i = 0; i < pointlight_bounds_.size(); ++i)
+    {
+        const glm::vec4 &light = pointlight_bounds_[i];
+        view_lights[i] = glm::vec4(glm::vec3(cam->world_to_view * glm::vec4(glm::vec3(light), 1.f)),
+                                   light.w);
+    }
+    if (light_workers_ == nullptr &&
+        view_lights.size() >= light_cluster_settings_.min_parallel_lights)
+    {
+        light_workers_ = std::make_unique<WorkerPool>();
+    }
+    light_clusters_ =
+        buildLightClusters(cam->view_to_projection, cam->near_plane, cam->far_plane, view_lights,
+                           light_cluster_settings_, light_workers_.get());
+
+    // Header (grid size, depth slice scale and bias, clusters per pixel) followed by the
+    // offset and count of each cluster's lights
+    const glm::uvec3 &grid = light_clusters_.grid;
+    const glm::uvec4 header_grid(grid, 0);
+    const glm::vec4 header_params(light_clusters_.z_scale, light_clusters_.z_bias,
+                                  float(grid.x) / float(resolution_.x),
+                                  float(grid.y) / float(resolution_.y));
+    const size_t header_bytes = sizeof(glm::uvec4) + sizeof(glm::vec4);
+    const size_t ranges_bytes = light_clusters_.ranges.size() * sizeof(glm::uvec2);
+    reserveStorage(*ssbo_light_clusters_, header_bytes + ranges_bytes);
+    ssbo_light_clusters_->setData(glm::value_ptr(header_grid), sizeof(glm::uvec4), 0);
+    ssbo_light_clusters_->setData(glm::value_ptr(header_params), sizeof(glm::vec4),
+                                  sizeof(glm::uvec4));
+    ssbo_light_clusters_->setData(light_clusters_.ranges.data(), ranges_bytes, header_bytes);
+    ssbo_light_clusters_->bindBase(3);
+
+    const size_t indices_bytes = light_clusters_.indices.size() * sizeof(uint32_t);
+    reserveStorage(*ssbo_light_indices_, std::max(indices_bytes, sizeof(uint32_t)));
+    if (indices_bytes > 0)
+    {
+        ssbo_light_indices_->setData(light_clusters_.indices.data(), indices_bytes, 0);
+    }
+    ssbo_light_indices_->bindBase(4);
 }
 
 void ForwardRenderSystem::initializePostprocess()
@@ -271,59 +863,295 @@ void ForwardRenderSystem::initializePostprocess()
     shader_pp_ = common::fullScreenQuadShader(shaders::PostprocessFragmentShader);
 }
 
-void ForwardRenderSystem::shadowMapPass()
+bool ForwardRenderSystem::ShadowCasterState::operator==(const ShadowCasterState &other) const
 {
-    RenderTarget rt;
-    rt.clear_stencil_buffer = false;
-    rt.clear_depth_buffer = true;
-    rt.framebuffer = framebuffer_shadow_->id();
-    rt.viewport_origin = glm::ivec2(0, 0);
-    rt.viewport_size = glm::ivec2(shadow_atlas_->width(), shadow_atlas_->height());
+    return entity == other.entity && mesh == other.mesh && shape_version == other.shape_version &&
+           transform == other.transform && glyph_params == other.glyph_params;
+}
 
+void ForwardRenderSystem::resizeShadowAtlas(int width, int height, bool split)
+{
+    if (shadow_atlas_ != nullptr && int(shadow_atlas_->width()) == width &&
+        int(shadow_atlas_->height()) == height && (shadow_static_atlas_ != nullptr) == split)
+    {
+        return;
+    }
+    auto create_atlas = [width, height](std::shared_ptr<Framebuffer> &fbo) {
+        auto atlas = Texture2D::create(width, height, 1, TextureInternalFormat::Depth32F);
+        atlas->setFilterMode(TextureFilterMode::Nearest);
+        atlas->setWrapMode(TextureWrapMode::ClampToBorder);
+        atlas->setBorderColor(glm::vec4(1.0));
+        fbo->setDepthAttachment(atlas);
+        assert(fbo->isComplete());
+        return atlas;
+    };
+    if (shadow_atlas_ != nullptr)
+    {
+        shadow_atlas_->release();
+    }
+    shadow_atlas_ = create_atlas(framebuffer_shadow_);
+    if (shadow_static_atlas_ != nullptr)
+    {
+        shadow_static_atlas_->release();
+        shadow_static_atlas_ = nullptr;
+    }
+    if (split)
+    {
+        if (framebuffer_shadow_static_ == nullptr)
+        {
+            framebuffer_shadow_static_ = Framebuffer::create();
+            framebuffer_shadow_static_->setDrawBuffers({});
+            framebuffer_shadow_static_->setReadBuffer(GL_NONE);
+        }
+        shadow_static_atlas_ = create_atlas(framebuffer_shadow_static_);
+    }
+    // The contents of the new atlases are undefined
+    shadow_tile_matrices_.assign(SHADOW_SLOTS, glm::mat4(0.f));
+}
+
+void ForwardRenderSystem::drawShadowCasters(const RenderTarget &rt, const glm::mat4 &light_matrix,
+                                            const std::vector<ShadowCaster> &casters)
+{
     RenderSettings state;
     state.depth.test = true;
     state.depth.write = true;
+    state.cull.enabled = false;
+
+    std::vector<DrawCall> dcs;
+    dcs.reserve(casters.size());
+    for (const ShadowCaster &caster : casters)
+    {
+        if (!boxInShadowCascade(light_matrix, caster.bounds))
+        {
+            continue;
+        }
+        Drawable *dr = world_->getComponent<Drawable>(caster.entity);
+        Transform *tr = world_->getComponent<Transform>(caster.entity);
+        DrawCall dc;
+        dc.mesh = GLRenderer::getDrawCallMeshInfo(dr->mesh);
+        dc.shader = shader_shadow_;
+        dc.update_uniforms = [light_matrix, tr](std::shared_ptr<ShaderProgram> sh) {
+            const glm::mat4 &wt = tr->worldTransform();
+            sh->uniform("model_matrix").set(wt);
+            sh->uniform("light_matrix").set(light_matrix);
+        };
+        dcs.push_back(dc);
+    }
+    renderer_.draw(rt, state, dcs);
+}
+
+void ForwardRenderSystem::shadowMapPass(Camera *cam)
+{
+    std::fill(shadow_data_.begin(), shadow_data_.end(), 0.f);
+    int num_cascades = 0;
+    const bool split = shadow_settings_.split_dynamic_casters;
 
     std::vector<Entity> dirlights = getFilteredEntities({DirectionalLight::family()});
+    if (dirlights.size() > RCUBE_MAX_DIRECTIONAL_LIGHTS)
+    {
+        dirlights.erase(dirlights.begin() + RCUBE_MAX_DIRECTIONAL_LIGHTS, dirlights.end());
+    }
+    const int num_casting = static_cast<int>(
+        std::count_if(dirlights.begin(), dirlights.end(), [this](const Entity &l) {
+            return world_->getComponent<DirectionalLight>(l)->castShadow();
+        }));
+
+    // Shadow casters and their world space bounds; with the split, the dynamic casters are
+    // drawn separately every frame
     const auto &drawable_entities =
         getFilteredEntities({Transform::family(), Drawable::family(), ForwardMaterial::family()});
-
-    for (const Entity &l : dirlights)
+    std::vector<ShadowCaster> static_casters;
+    std::vector<ShadowCaster> dynamic_casters;
+    std::vector<ShadowCasterState> static_state;
+    AABB caster_bounds;
+    for (const Entity &drawable_entity : drawable_entities)
     {
-        DirectionalLight *dl = world_->getComponent<DirectionalLight>(l);
-        if (!dl->castShadow())
+        Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
+        if (!dr->visible || !dr->cast_shadow)
         {
             continue;
         }
-        // Light's viewproj matrix
-        const glm::mat4 light_matrix = dl->viewProjectionMatrix(-1, 1, -1, 1, 0.1f, 3.f);
-        std::vector<DrawCall> dcs;
-        dcs.reserve(drawable_entities.size());
-        for (const Entity &drawable_entity : drawable_entities)
+        Transform *tr = world_->getComponent<Transform>(drawable_entity);
+        const AABB box = tr->worldTransform() * dr->mesh->boundingBox();
+        if (box.isNull())
         {
-            Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
-            if (!dr->visible && !dr->cast_shadow)
+            continue;
+        }
+        caster_bounds.expandBy(box);
+        if (split && dr->dynamic)
+        {
+            dynamic_casters.push_back({drawable_entity, box});
+            continue;
+        }
+        static_casters.push_back({drawable_entity, box});
+        static_state.push_back({drawable_entity.id(), dr->mesh.get(), dr->mesh->shapeVersion(),
+                                tr->worldTransform(),
+                                GLRenderer::getDrawCallMeshInfo(dr->mesh).glyph_params});
+    }
+    // Cached tiles of static casters stay valid while the casters and the tile's projection
+    // (which covers the light direction and the cascade fit) are unchanged
+    const bool static_changed =
+        !shadow_settings_.cache || static_state != shadow_static_casters_;
+    shadow_static_casters_ = std::move(static_state);
+    const bool has_dynamic = !dynamic_casters.empty();
+
+    // Shadows are drawn from the near plane up to the farthest caster (or max_distance)
+    const float znear = cam->near_plane;
+    const float zfar = cam->far_plane;
+    float shadow_far = shadow_settings_.max_distance > 0.f
+                           ? std::min(zfar, shadow_settings_.max_distance)
+                           : zfar;
+    if (!caster_bounds.isNull())
+    {
+        float caster_far = znear;
+        for (const glm::vec3 &p : caster_bounds.corners())
+        {
+            caster_far = std::max(caster_far, -(cam->world_to_view * glm::vec4(p, 1.f)).z);
+        }
+        shadow_far = std::min(shadow_far, caster_far);
+    }
+
+    if (num_casting > 0 && !caster_bounds.isNull() &&
+        (shadow_far > znear || shadow_settings_.fit_to_casters))
+    {
+        num_cascades = shadow_settings_.fit_to_casters
+                           ? 1
+                           : static_cast<int>(std::clamp(shadow_settings_.cascades, 1u,
+                                                         unsigned(RCUBE_MAX_SHADOW_CASCADES)));
+        // Atlas with a row of cascades per light, within the budget and the texture size limit
+        const size_t num_tiles = size_t(num_casting * num_cascades) * (split ? 2 : 1);
+        unsigned int resolution = shadowTileResolution(shadow_settings_, num_tiles);
+        GLint max_size = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+        while (resolution > 256 &&
+               int(resolution) * std::max(num_casting, num_cascades) > max_size)
+        {
+            resolution /= 2;
+        }
+        const int res = static_cast<int>(resolution);
+        resizeShadowAtlas(num_cascades * res, num_casting * res, split);
+        const glm::vec2 atlas_size(float(shadow_atlas_->width()), float(shadow_atlas_->height()));
+        const glm::vec2 tile_scale = glm::vec2(float(res)) / atlas_size;
+
+        const glm::mat4 inverse_view_projection =
+            glm::inverse(cam->view_to_projection * cam->world_to_view);
+        // A single cascade fitted to the casters covers every view distance
+        const std::vector<float> splits =
+            shadow_settings_.fit_to_casters
+                ? std::vector<float>(1, std::numeric_limits<float>::max())
+                : cascadeSplits(znear, shadow_far, num_cascades, shadow_settings_.split_lambda);
+
+        RenderTarget rt;
+        rt.clear_color = {};
+        rt.clear_stencil_buffer = false;
+        rt.clear_depth_buffer = true;
+        rt.viewport_size = glm::ivec2(res, res);
+
+        int row = 0;
+        for (size_t index = 0; index < dirlights.size(); ++index)
+        {
+            DirectionalLight *dl = world_->getComponent<DirectionalLight>(dirlights[index]);
+            if (!dl->castShadow())
             {
                 continue;
             }
-            Transform *tr = world_->getComponent<Transform>(drawable_entity);
-            DrawCall dc;
-            dc.mesh = GLRenderer::getDrawCallMeshInfo(dr->mesh);
-            dc.shader = shader_shadow_;
-            dc.update_uniforms = [light_matrix, tr](std::shared_ptr<ShaderProgram> sh) {
-                const glm::mat4 &wt = tr->worldTransform();
-                sh->uniform("model_matrix").set(wt);
-                sh->uniform("light_matrix").set(light_matrix);
-            };
-
-            dcs.push_back(dc);
+            for (int c = 0; c < num_cascades; ++c)
+            {
+                const std::array<glm::vec3, 8> slice =
+                    shadow_settings_.fit_to_casters
+                        ? caster_bounds.corners()
+                        : frustumSlice(inverse_view_projection, znear, zfar,
+                                       c == 0 ? znear : splits[c - 1], splits[c]);
+                const ShadowCascade cascade =
+                    fitShadowCascade(dl->direction(), slice, caster_bounds, resolution);
+                const glm::mat4 light_matrix = cascade.view_projection;
+
+                // Map clip space of the cascade to its tile in atlas texture coordinates
+                rt.viewport_origin = glm::ivec2(c * res, row * res);
+                const glm::vec2 tile_offset = glm::vec2(rt.viewport_origin) / atlas_size;
+                const glm::mat4 to_tile =
+                    glm::translate(glm::mat4(1.f),
+                                   glm::vec3(tile_offset + 0.5f * tile_scale, 0.5f)) *
+                    glm::scale(glm::mat4(1.f), glm::vec3(0.5f * tile_scale, 0.5f));
+                const glm::mat4 atlas_matrix = to_tile * light_matrix;
+                const size_t slot = index * RCUBE_MAX_SHADOW_CASCADES + size_t(c);
+
+                // Each cascade is drawn into its tile; the clear is limited to it by the
+                // scissor. Static casters are only redrawn when the tile is out of date.
+                const bool tile_valid =
+                    !static_changed && shadow_tile_matrices_[slot] == atlas_matrix;
+                if (!split)
+                {
+                    if (!tile_valid)
+                    {
+                        rt.framebuffer = framebuffer_shadow_->id();
+                        rt.clear_depth_buffer = true;
+                        drawShadowCasters(rt, light_matrix, static_casters);
+                    }
+                }
+                else
+                {
+                    if (!tile_valid)
+                    {
+                        rt.framebuffer = framebuffer_shadow_static_->id();
+                        rt.clear_depth_buffer = true;
+                        drawShadowCasters(rt, light_matrix, static_casters);
+                    }
+                    // The dynamic casters are drawn over a copy of the static tile; the copy
+                    // is also needed once after the last dynamic caster is gone
+                    if (!tile_valid || has_dynamic || shadow_had_dynamic_)
+                    {
+                        glCopyImageSubData(shadow_static_atlas_->id(), GL_TEXTURE_2D, 0,
+                                           rt.viewport_origin.x, rt.viewport_origin.y, 0,
+                                           shadow_atlas_->id(), GL_TEXTURE_2D, 0,
+                                           rt.viewport_origin.x, rt.viewport_origin.y, 0, res,
+                                           res, 1);
+                        rt.framebuffer = framebuffer_shadow_->id();
+                        rt.clear_depth_buffer = false;
+                        drawShadowCasters(rt, light_matrix, dynamic_casters);
+                    }
+                }
+                shadow_tile_matrices_[slot] = atlas_matrix;
+
+                std::copy(glm::value_ptr(atlas_matrix), glm::value_ptr(atlas_matrix) + 16,
+                          shadow_data_.begin() + slot * 16);
+                float *tile = &shadow_data_[SHADOW_TILES_OFFSET + slot * 4];
+                tile[0] = tile_offset.x;
+                tile[1] = tile_offset.y;
+                tile[2] = tile_offset.x + tile_scale.x;
+                tile[3] = tile_offset.y + tile_scale.y;
+                // The cascade sizes only depend on the camera, so all lights share them
+                float *params = &shadow_data_[SHADOW_CASCADES_OFFSET + size_t(c) * 4];
+                params[0] = splits[c];
+                params[1] = cascade.texel_size;
+                params[2] = cascade.texel_size * shadow_settings_.normal_offset;
+                params[3] = shadow_settings_.depth_bias;
+            }
+            ++row;
         }
-        renderer_.draw(rt, state, dcs);
     }
+    shadow_had_dynamic_ = has_dynamic;
+    ubo_shadows_->setData(shadow_data_.data(), shadow_data_.size(), 0);
+    ubo_shadows_->setData(&num_cascades, 1, SHADOW_DATA_SIZE * sizeof(float));
+    ubo_shadows_->bindBase(4);
 }
 
 void ForwardRenderSystem::cleanup()
 {
+    for (const auto &batch : static_batches_)
+    {
+        if (batch->mesh != nullptr)
+        {
+            batch->mesh->release();
+        }
+    }
+    static_batches_.clear();
+    static_batch_members_.clear();
+    // The readback buffers stay mapped until deleted
+    occlusion_states_.clear();
+    occlusion_ = nullptr;
+    meshlet_stats_readback_ = nullptr;
+    light_workers_ = nullptr;
     renderer_.cleanup();
 }
 
@@ -337,11 +1165,34 @@ void ForwardRenderSystem::update(bool)
     const auto &camera_entities = registered_entities_[filters_[1]];
 
     // Render all drawable entities
-    setDirectionalLightsUBO();
-    setPointLightsUBO();
-
-    // Shadow pass
-    shadowMapPass();
+    setPointLightsSSBO();
+    classifyDrawables();
+    updateMeshletData();
+    triangles_drawn_ = 0;
+    triangles_full_detail_ = 0;
+    meshlets_tested_ = 0;
+
+    // Meshlet counters of an earlier frame, if they have arrived; the counters are then reset
+    // for the culls of this frame
+    if (meshlet_stats_readback_ != nullptr)
+    {
+        const size_t region = meshlet_stats_readback_->poll();
+        if (region != ReadbackBuffer::NO_REGION)
+        {
+            const auto *stats =
+                static_cast<const uint32_t *>(meshlet_stats_readback_->data(region));
+            meshlets_drawn_ = stats[0];
+            meshlet_triangles_drawn_ = stats[1];
+        }
+        glClearNamedBufferData(ssbo_meshlet_stats_->id(), GL_R32UI, GL_RED_INTEGER,
+                               GL_UNSIGNED_INT, nullptr);
+        triangles_drawn_ += meshlet_triangles_drawn_;
+    }
+    std::unordered_map<uint64_t, size_t> previous_lod_levels;
+    previous_lod_levels.swap(lod_levels_);
+    const bool occlusion_culling = occlusion_culling_ && occlusion_culling_supported_;
+    std::unordered_set<unsigned int> rendered_cameras;
+    occlusion_ = nullptr;
 
     for (const auto &camera_entity : camera_entities)
     {
@@ -351,13 +1202,39 @@ void ForwardRenderSystem::update(bool)
         {
             continue;
         }
+        rendered_cameras.insert(camera_entity.id());
+        occlusion_ = occlusion_culling ? &occlusion_states_[camera_entity.id()] : nullptr;
+        occlusion_tested_.clear();
+        occlusion_indices_.clear();
 
         // Set camera
         setCameraUBO(tr->worldPosition(), cam->world_to_view, cam->view_to_projection,
                      cam->projection_to_viewport);
-
-        // Render passes
+        selectLODs(camera_entity, previous_lod_levels);
+        cullMeshletDraws(cam, false);
+        cullStaticBatches(cam);
+
+        // Shadow cascades are fitted to the camera; the lights carry their matrices
+        shadowMapPass(cam);
+        setDirectionalLightsUBO();
+        setLightClustersSSBO(cam);
+
+        // Render passes; the transparency targets are neither cleared nor composited when
+        // there is nothing transparent to draw
+        if (occlusion_culling)
+        {
+            prepareOcclusionCulling();
+        }
         depthPrepass(cam);
+        if (occlusion_culling)
+        {
+            occlusionCullingPass(cam);
+            // Objects drawn by meshlets are in the depth prepass, so the pyramid covers them
+            if (!meshlet_draws_.empty())
+            {
+                cullMeshletDraws(cam, true);
+            }
+        }
         opaqueGeometryPass(cam);
         // Resolve MSAA framebuffer if needed
         if (msaa_ > 0)
@@ -365,16 +1242,92 @@ void ForwardRenderSystem::update(bool)
             framebuffer_hdr_ms_->blit(framebuffer_hdr_, {0, 0}, resolution_, {0, 0}, resolution_);
         }
         pickFBOPass(cam);
-        transparentGeometryPass(cam);
+        if (!transparent_entities_.empty())
+        {
+            transparentGeometryPass(cam);
+        }
         postprocessPass(cam);
         finalPass(cam);
     }
+
+    if (meshlet_stats_readback_ != nullptr)
+    {
+        meshlet_stats_readback_->copy(ssbo_meshlet_stats_->id(), 2 * sizeof(uint32_t));
+    }
+
+    // Drop the occlusion results of cameras that are gone or no longer rendering
+    for (auto it = occlusion_states_.begin(); it != occlusion_states_.end();)
+    {
+        it = rendered_cameras.count(it->first) > 0 ? std::next(it) : occlusion_states_.erase(it);
+    }
+}
+
+void ForwardRenderSystem::selectLODs(Entity camera_entity,
+                                     const std::unordered_map<uint64_t, size_t> &previous)
+{
+    lod_meshes_.clear();
+    const Camera *cam = world_->getComponent<Camera>(camera_entity);
+    const glm::vec3 eye = world_->getComponent<Transform>(camera_entity)->worldPosition();
+    // Pixels per world unit at unit distance (perspective) or anywhere (orthographic)
+    const float pixels_per_unit = 0.5f * float(resolution_.y) * cam->view_to_projection[1][1];
+    for (const std::vector<Entity> *entities : {&opaque_entities_, &transparent_entities_})
+    {
+        for (Entity drawable_entity : *entities)
+        {
+            Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
+            const Mesh *mesh = dr->mesh.get();
+            // The simplified meshes have neither instances nor face data nor scalars
+            if (dr->lods.empty() || mesh->instanced() || mesh->faceData().buffer != nullptr ||
+                mesh->colormapParameters().lut != nullptr)
+            {
+                continue;
+            }
+            const glm::mat4 &world = world_->getComponent<Transform>(drawable_entity)
+                                         ->worldTransform();
+            const AABB box = world * dr->mesh->boundingBox();
+            if (box.isNull())
+            {
+                continue;
+            }
+            // Errors are in object space; the largest axis scale converts them to world space
+            const float scale = std::max(glm::length(glm::vec3(world[0])),
+                                         std::max(glm::length(glm::vec3(world[1])),
+                                                  glm::length(glm::vec3(world[2]))));
+            float pixels = pixels_per_unit * scale;
+            if (!cam->orthographic)
+            {
+                const glm::vec3 center = 0.5f * (box.min() + box.max());
+                const float radius = 0.5f * glm::length(box.max() - box.min());
+                pixels /= std::max(glm::length(center - eye) - radius, cam->near_plane);
+            }
+            const uint64_t key = uint64_t(camera_entity.id()) << 32 | drawable_entity.id();
+            const auto it = previous.find(key);
+            const size_t level = dr->selectLOD(pixels, it != previous.end() ? it->second : 0);
+            lod_levels_[key] = level;
+            if (level > 0)
+            {
+                lod_meshes_[drawable_entity.id()] = dr->lodMesh(level);
+            }
+        }
+    }
+}
+
+const std::shared_ptr<Mesh> &ForwardRenderSystem::drawnMesh(Entity entity, Drawable *dr) const
+{
+    const auto it = lod_meshes_.find(entity.id());
+    return it != lod_meshes_.end() ? it->second : dr->mesh;
 }
 
 void ForwardRenderSystem::depthPrepass(Camera *cam)
+{
+    drawDepth(opaque_entities_, true, OcclusionPhase::Prepass);
+}
+
+void ForwardRenderSystem::drawDepth(const std::vector<Entity> &entities, bool clear,
+                                    OcclusionPhase phase)
 {
     RenderTarget rt;
-    rt.clear_depth_buffer = true;
+    rt.clear_depth_buffer = clear;
     rt.clear_stencil_buffer = false;
     rt.framebuffer = msaa_ > 0 ? framebuffer_depth_ms_->id() : framebuffer_depth_->id();
     rt.viewport_origin = glm::ivec2(0, 0);
@@ -388,41 +1341,410 @@ void ForwardRenderSystem::depthPrepass(Camera *cam)
     state.stencil.test = false;
     state.cull.enabled = false;
 
-    const auto &drawable_entities =
-        getFilteredEntities({Transform::family(), Drawable::family(), ForwardMaterial::family()});
-
+    // Consider only opaque objects for depth prepass
     std::vector<DrawCall> drawcalls;
-    drawcalls.reserve(drawable_entities.size());
-    for (Entity drawable_entity : drawable_entities)
+    drawcalls.reserve(entities.size());
+    for (Entity drawable_entity : entities)
     {
         Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
-        if (!dr->visible)
-        {
-            continue;
-        }
-        // Consider only opaque objects for depth prepass
         ForwardMaterial *mat = world_->getComponent<ForwardMaterial>(drawable_entity);
-        if (mat->shader == nullptr)
+        // Materials that write their own depth are drawn with depth writes in the opaque pass
+        if (!mat->shader->supportsDepthPrepass())
         {
             continue;
         }
-        if (mat->shader->opacity < 1.f)
+        // Create draw call
+        const DrawCall::MultiDrawInfo *meshlets = meshletDraws(drawable_entity);
+        if (meshlets != nullptr && meshlets->draw_count == 0)
         {
             continue;
         }
-        // Create draw call
         DrawCall dc;
-        DrawCall::MeshInfo mi = GLRenderer::getDrawCallMeshInfo(dr->mesh);
+        DrawCall::MeshInfo mi = GLRenderer::getDrawCallMeshInfo(drawnMesh(drawable_entity, dr));
         dc.mesh = mi;
+        if (meshlets != nullptr)
+        {
+            dc.multi_draw = *meshlets;
+        }
+        else
+        {
+            occlusionDraw(drawable_entity, phase, dc.multi_draw);
+        }
         Transform *tr = world_->getComponent<Transform>(drawable_entity);
         dc.shader = shader_depth_;
-        const int id = static_cast<int>(drawable_entity.id());
-        dc.update_uniforms = [tr, id](std::shared_ptr<ShaderProgram> shader) {
+        dc.update_uniforms = [tr](std::shared_ptr<ShaderProgram> shader) {
             shader->uniform("model_matrix").set(tr->worldTransform());
         };
         drawcalls.push_back(dc);
     }
-    renderer_.draw(rt, state, drawcalls);
+    // Static batches are not occlusion culled, so they are drawn when clearing only
+    for (const auto &batch : static_batches_)
+    {
+        if (!clear || batch->draws.draw_count == 0 || !batch->material->supportsDepthPrepass())
+        {
+            continue;
+        }
+        DrawCall dc;
+        dc.mesh = GLRenderer::getDrawCallMeshInfo(batch->mesh);
+        dc.multi_draw = batch->draws;
+        dc.shader = shader_depth_;
+        dc.update_uniforms = [](std::shared_ptr<ShaderProgram> shader) {
+            shader->uniform("model_matrix").set(glm::mat4(1.f));
+        };
+        drawcalls.push_back(dc);
+    }
+    if (clear || !drawcalls.empty())
+    {
+        renderer_.draw(rt, state, drawcalls);
+    }
+}
+
+void ForwardRenderSystem::prepareOcclusionCulling()
+{
+    OcclusionState &state = *occlusion_;
+    if (state.readback != nullptr)
+    {
+        const size_t region = state.readback->poll();
+        if (region != ReadbackBuffer::NO_REGION)
+        {
+            state.num_occluded = *static_cast<const uint32_t *>(state.readback->data(region));
+        }
+    }
+
+    // World space bounds and draw parameters of the opaque objects that can be culled
+    std::vector<OcclusionObjectData> objects;
+    objects.reserve(opaque_entities_.size());
+    for (Entity drawable_entity : opaque_entities_)
+    {
+        Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
+        const Mesh *mesh = drawnMesh(drawable_entity, dr).get();
+        // The bounds of a mesh cover neither its instances nor its children, and meshlets are
+        // culled one by one
+        if (mesh->instanced() || !mesh->children().empty() ||
+            meshletDraws(drawable_entity) != nullptr)
+        {
+            continue;
+        }
+        Transform *tr = world_->getComponent<Transform>(drawable_entity);
+        const AABB box = tr->worldTransform() * dr->mesh->boundingBox();
+        if (box.isNull())
+        {
+            continue;
+        }
+        OcclusionObjectData object;
+        object.box_min = glm::vec4(box.min(), 1.f);
+        object.box_max = glm::vec4(box.max(), 1.f);
+        const bool indexed = mesh->numIndexData() > 0;
+        const GLuint base_vertex = static_cast<GLuint>(mesh->baseVertex());
+        object.draw = glm::uvec4(
+            static_cast<GLuint>(indexed ? mesh->numIndexData() : mesh->numVertexData()),
+            indexed ? static_cast<GLuint>(mesh->firstIndex()) : base_vertex, base_vertex,
+            indexed ? 1 : 0);
+        // Objects tested for the first time count as visible
+        auto slot = state.slots.find(drawable_entity.id());
+        const bool is_new = slot == state.slots.end();
+        if (is_new)
+        {
+            uint32_t index = static_cast<uint32_t>(state.slots.size() + state.free_slots.size());
+            if (!state.free_slots.empty())
+            {
+                index = state.free_slots.back();
+                state.free_slots.pop_back();
+            }
+            slot = state.slots.insert({drawable_entity.id(), index}).first;
+        }
+        object.history = glm::uvec4(slot->second, is_new ? 1 : 0, 0, 0);
+        occlusion_indices_[drawable_entity.id()] = static_cast<uint32_t>(objects.size());
+        occlusion_tested_.push_back(drawable_entity);
+        objects.push_back(object);
+    }
+    // The history of objects no longer tested is forgotten
+    for (auto it = state.slots.begin(); it != state.slots.end();)
+    {
+        if (occlusion_indices_.count(it->first) == 0)
+        {
+            state.free_slots.push_back(it->second);
+            it = state.slots.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    if (objects.empty())
+    {
+        return;
+    }
+
+    // The history keeps its contents when it grows
+    const size_t history_bytes = (state.slots.size() + state.free_slots.size()) * sizeof(uint32_t);
+    if (state.history == nullptr || state.history->size() < history_bytes)
+    {
+        auto history = ShaderStorageBuffer::create(std::max<size_t>(2 * history_bytes, 4096));
+        if (state.history != nullptr)
+        {
+            glCopyNamedBufferSubData(state.history->id(), history->id(), 0, 0,
+                                     GLsizeiptr(state.history->size()));
+        }
+        state.history = history;
+    }
+    const size_t object_bytes = objects.size() * sizeof(OcclusionObjectData);
+    reserveStorage(*ssbo_occlusion_objects_, object_bytes);
+    ssbo_occlusion_objects_->setData(objects.data(), object_bytes, 0);
+    for (auto &commands : occlusion_commands_)
+    {
+        reserveStorage(*commands, objects.size() * 5 * sizeof(GLuint));
+    }
+
+    // Commands of the first phase
+    shader_occlusion_history_->use();
+    shader_occlusion_history_->uniform("num_objects")
+        .set(static_cast<unsigned int>(objects.size()));
+    ssbo_occlusion_objects_->bindBase(0);
+    state.history->bindBase(1);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6,
+                     occlusion_commands_[size_t(OcclusionPhase::Prepass)]->id());
+    glDispatchCompute(GLuint((objects.size() + OCCLUSION_GROUP_SIZE - 1) / OCCLUSION_GROUP_SIZE),
+                      1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    shader_occlusion_history_->done();
+}
+
+bool ForwardRenderSystem::occlusionDraw(Entity entity, OcclusionPhase phase,
+                                        DrawCall::MultiDrawInfo &info) const
+{
+    const auto it = occlusion_indices_.find(entity.id());
+    if (it == occlusion_indices_.end())
+    {
+        return false;
+    }
+    info.indirect_buffer = occlusion_commands_[size_t(phase)]->id();
+    info.offset = size_t(it->second) * 5 * sizeof(GLuint);
+    info.draw_count = 1;
+    return true;
+}
+
+void ForwardRenderSystem::occlusionCullingPass(Camera *cam)
+{
+    if (occlusion_tested_.empty())
+    {
+        return;
+    }
+
+    // Depth pyramid of the objects drawn by the first phase
+    if (msaa_ > 0)
+    {
+        framebuffer_depth_ms_->blit(framebuffer_depth_, {0, 0}, resolution_, {0, 0}, resolution_,
+                                    false, true, false);
+    }
+    shader_hiz_downsample_->use();
+    for (size_t level = 0; level < hiz_->levels(); ++level)
+    {
+        const GLuint src = level == 0 ? depth_->id() : hiz_->id();
+        const int src_level = level == 0 ? 0 : static_cast<int>(level - 1);
+        const GLuint width = GLuint(std::max<size_t>(hiz_->width() >> level, 1));
+        const GLuint height = GLuint(std::max<size_t>(hiz_->height() >> level, 1));
+        shader_hiz_downsample_->uniform("src_level").set(src_level);
+        glBindTextureUnit(0, src);
+        glBindImageTexture(0, hiz_->id(), GLint(level), GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+                          (height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+        // The next level reads this one
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+    shader_hiz_downsample_->done();
+
+    // Test the bounds of the objects against the pyramid; the test writes the commands of the
+    // other phases and the history, and counts the hidden objects
+    OcclusionState &state = *occlusion_;
+    const GLuint num_objects = static_cast<GLuint>(occlusion_tested_.size());
+    glClearNamedBufferData(occlusion_counter_->id(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                           nullptr);
+    shader_occlusion_test_->use();
+    shader_occlusion_test_->uniform("view_projection")
+        .set(cam->view_to_projection * cam->world_to_view);
+    shader_occlusion_test_->uniform("resolution").set(resolution_);
+    shader_occlusion_test_->uniform("num_objects").set(static_cast<unsigned int>(num_objects));
+    glBindTextureUnit(0, hiz_->id());
+    ssbo_occlusion_objects_->bindBase(0);
+    state.history->bindBase(1);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6,
+                     occlusion_commands_[size_t(OcclusionPhase::Reveal)]->id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7,
+                     occlusion_commands_[size_t(OcclusionPhase::Visible)]->id());
+    occlusion_counter_->bindBase(0);
+    glDispatchCompute((num_objects + OCCLUSION_GROUP_SIZE - 1) / OCCLUSION_GROUP_SIZE, 1, 1);
+    // The commands are read by indirect draws, the history by the multi-draw shader and the
+    // counter by the copy below
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+                    GL_BUFFER_UPDATE_BARRIER_BIT);
+    shader_occlusion_test_->done();
+    if (state.readback == nullptr)
+    {
+        state.readback = ReadbackBuffer::create(sizeof(GLuint));
+    }
+    state.readback->copy(occlusion_counter_->id(), sizeof(GLuint));
+
+    // Objects hidden in their previous test that are visible now are missing from the depth
+    // prepass
+    drawDepth(occlusion_tested_, false, OcclusionPhase::Reveal);
+}
+
+void ForwardRenderSystem::updateMeshletData()
+{
+    if (shader_meshlet_cull_ == nullptr)
+    {
+        return;
+    }
+    std::vector<std::tuple<unsigned int, const Meshlet *, size_t>> sources;
+    for (Entity drawable_entity : opaque_entities_)
+    {
+        const Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
+        const Mesh *mesh = dr->mesh.get();
+        // Meshlets are ranges of the full mesh's triangles; instances, children and face data
+        // are drawn with the whole mesh
+        if (dr->meshlets.empty() || mesh->primitive() != MeshPrimitive::Triangles ||
+            mesh->instanced() || !mesh->children().empty() || mesh->faceData().buffer != nullptr)
+        {
+            continue;
+        }
+        sources.emplace_back(drawable_entity.id(), dr->meshlets.data(), dr->meshlets.size());
+    }
+    if (sources == meshlet_sources_)
+    {
+        return;
+    }
+    meshlet_sources_ = std::move(sources);
+    meshlet_offsets_.clear();
+    std::vector<MeshletData> data;
+    for (const auto &source : meshlet_sources_)
+    {
+        meshlet_offsets_[std::get<0>(source)] = static_cast<uint32_t>(data.size());
+        const Meshlet *meshlets = std::get<1>(source);
+        for (size_t i = 0; i < std::get<2>(source); ++i)
+        {
+            const Meshlet &meshlet = meshlets[i];
+            data.push_back({glm::vec4(meshlet.center, meshlet.radius),
+                            glm::vec4(meshlet.cone_axis, meshlet.cone_cutoff),
+                            glm::uvec4(meshlet.first_triangle, meshlet.num_triangles, 0, 0)});
+        }
+    }
+    if (!data.empty())
+    {
+        const size_t bytes = data.size() * sizeof(MeshletData);
+        reserveStorage(*ssbo_meshlets_, bytes);
+        ssbo_meshlets_->setData(data.data(), bytes, 0);
+    }
+}
+
+void ForwardRenderSystem::cullMeshletDraws(Camera *cam, bool use_depth)
+{
+    meshlet_draws_.clear();
+    if (shader_meshlet_cull_ == nullptr || meshlet_offsets_.empty())
+    {
+        return;
+    }
+
+    const glm::mat4 view_to_world = glm::inverse(cam->world_to_view);
+    const glm::mat4 world_to_clip = cam->view_to_projection * cam->world_to_view;
+    DrawIndirectBuffer &commands = *meshlet_commands_[use_depth ? 1 : 0];
+    std::vector<MeshletObjectData> objects;
+    GLuint num_groups = 0;
+    GLuint num_words = 0;
+    size_t num_meshlets = 0;
+    for (Entity drawable_entity : opaque_entities_)
+    {
+        const auto offset = meshlet_offsets_.find(drawable_entity.id());
+        Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
+        if (offset == meshlet_offsets_.end() || drawnMesh(drawable_entity, dr) != dr->mesh)
+        {
+            continue;
+        }
+        const Mesh *mesh = dr->mesh.get();
+        const glm::mat4 &world = world_->getComponent<Transform>(drawable_entity)
+                                     ->worldTransform();
+        MeshletObjectData object;
+        object.object_to_clip = world_to_clip * world;
+        // Frustum planes in object space (Gribb and Hartmann), normalized so that they give
+        // distances
+        const glm::mat4 &m = object.object_to_clip;
+        std::array<glm::vec4, 4> rows;
+        for (int i = 0; i < 4; ++i)
+        {
+            rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        }
+        const std::array<glm::vec4, 6> planes = {rows[3] + rows[0], rows[3] - rows[0],
+                                                 rows[3] + rows[1], rows[3] - rows[1],
+                                                 rows[3] + rows[2], rows[3] - rows[2]};
+        for (int i = 0; i < 6; ++i)
+        {
+            const float length = glm::length(glm::vec3(planes[i]));
+            object.planes[i] = length > 0.f ? planes[i] / length : planes[i];
+        }
+        const glm::mat4 world_to_object = glm::inverse(world);
+        if (cam->orthographic)
+        {
+            const glm::vec3 dir = glm::mat3(world_to_object) * -glm::vec3(view_to_world[2]);
+            object.eye = glm::vec4(glm::normalize(dir), 0.f);
+        }
+        else
+        {
+            object.eye = world_to_object * glm::vec4(glm::vec3(view_to_world[3]), 1.f);
+        }
+        // Mirroring transforms flip which side of the triangles faces the camera
+        const bool cull_backfacing =
+            dr->meshlet_cone_culling && glm::determinant(glm::mat3(world)) > 0.f;
+        const bool indexed = mesh->numIndexData() > 0;
+        const GLuint base_vertex = static_cast<GLuint>(mesh->baseVertex());
+        const GLuint count = static_cast<GLuint>(dr->meshlets.size());
+        object.meshlets = glm::uvec4(offset->second, count, num_groups, num_words);
+        object.draw = glm::uvec4(indexed ? static_cast<GLuint>(mesh->firstIndex()) : base_vertex,
+                                 base_vertex, indexed ? 1 : 0, cull_backfacing ? 1 : 0);
+        objects.push_back(object);
+
+        DrawCall::MultiDrawInfo info;
+        info.indirect_buffer = commands.id();
+        info.offset = num_words * sizeof(GLuint);
+        info.draw_count = static_cast<GLsizei>(count);
+        meshlet_draws_[drawable_entity.id()] = info;
+        num_groups += (count + MESHLET_GROUP_SIZE - 1) / MESHLET_GROUP_SIZE;
+        num_words += (indexed ? 5 : 4) * count;
+        num_meshlets += count;
+    }
+    if (objects.empty())
+    {
+        return;
+    }
+
+    // The counters cover the culls whose commands the opaque pass draws
+    const bool count_stats = use_depth || occlusion_ == nullptr;
+    if (count_stats)
+    {
+        meshlets_tested_ += num_meshlets;
+    }
+    const size_t object_bytes = objects.size() * sizeof(MeshletObjectData);
+    reserveStorage(*ssbo_meshlet_objects_, object_bytes);
+    ssbo_meshlet_objects_->setData(objects.data(), object_bytes, 0);
+    // Reallocating keeps the buffer name the draw calls refer to
+    reserveStorage(commands, num_words * sizeof(GLuint));
+    shader_meshlet_cull_->use();
+    shader_meshlet_cull_->uniform("num_objects").set(static_cast<unsigned int>(objects.size()));
+    shader_meshlet_cull_->uniform("use_depth").set(use_depth);
+    shader_meshlet_cull_->uniform("count_stats").set(count_stats);
+    shader_meshlet_cull_->uniform("resolution").set(resolution_);
+    if (use_depth)
+    {
+        glBindTextureUnit(0, hiz_->id());
+    }
+    // Bindings the render passes do not rely on at this point
+    ssbo_meshlet_objects_->bindBase(0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commands.id());
+    ssbo_meshlets_->bindBase(6);
+    ssbo_meshlet_stats_->bindBase(7);
+    glDispatchCompute(num_groups, 1, 1);
+    // The commands are read by indirect draws and the counters by the readback copy
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    shader_meshlet_cull_->done();
 }
 
 void ForwardRenderSystem::opaqueGeometryPass(Camera *cam)
@@ -444,38 +1766,107 @@ void ForwardRenderSystem::opaqueGeometryPass(Camera *cam)
     state.stencil.test = false;
 
     std::vector<DrawCall> drawcalls;
-    const auto &drawable_entities =
-        getFilteredEntities({Transform::family(), Drawable::family(), ForwardMaterial::family()});
-    drawcalls.reserve(drawable_entities.size());
-    for (Entity drawable_entity : drawable_entities)
+    std::vector<DrawCall> drawcalls_depth_write;
+    std::vector<MultiDrawItem> multidraw_items;
+    const bool multidraw = multidraw_ && multidraw_supported_;
+    drawcalls.reserve(opaque_entities_.size());
+    for (Entity drawable_entity : opaque_entities_)
     {
         Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
-        if (!dr->visible)
+        const std::shared_ptr<Mesh> &mesh = drawnMesh(drawable_entity, dr);
+        Transform *tr = world_->getComponent<Transform>(drawable_entity);
+        const DrawCall::MultiDrawInfo *meshlets = meshletDraws(drawable_entity);
+        // Objects tested for occlusion are drawn by the commands the test wrote
+        DrawCall::MultiDrawInfo occlusion;
+        const bool tested = occlusionDraw(drawable_entity, OcclusionPhase::Visible, occlusion);
+        // Triangles of meshlets are counted by the culling shader
+        triangles_drawn_ += meshlets != nullptr ? 0 : numTriangles(*mesh);
+        triangles_full_detail_ += numTriangles(*dr->mesh);
+        if (meshlets != nullptr && meshlets->draw_count == 0)
         {
             continue;
         }
-        Mesh *mesh = dr->mesh.get();
-        Transform *tr = world_->getComponent<Transform>(drawable_entity);
         ForwardMaterial *mat = world_->getComponent<ForwardMaterial>(drawable_entity);
-        if (mat->shader == nullptr)
+        // Add other shader passes to the drawcalls if they exist
+        ShaderMaterial *sh = mat->shader.get();
+        const bool prepassed = sh->supportsDepthPrepass();
+        while (sh != nullptr)
         {
-            continue;
+            if (!prepassed)
+            {
+                drawcalls_depth_write.push_back(
+                    makeDrawCall(mesh, sh, tr, ForwardRenderPass::Opaque));
+                drawcalls_depth_write.back().textures.push_back({shadow_atlas_->id(), 10});
+                if (meshlets != nullptr)
+                {
+                    drawcalls_depth_write.back().multi_draw = *meshlets;
+                }
+                else if (tested)
+                {
+                    drawcalls_depth_write.back().multi_draw = occlusion;
+                }
+            }
+            else if (meshlets != nullptr)
+            {
+                // The visible meshlets are drawn by the per-object shader, which does not read
+                // the multi-draw object data
+                drawcalls.push_back(makeDrawCall(mesh, sh, tr, ForwardRenderPass::Opaque));
+                drawcalls.back().textures.push_back({shadow_atlas_->id(), 10});
+                drawcalls.back().multi_draw = *meshlets;
+            }
+            else if (multidraw && mesh->usesGeometryArena() && mesh->children().empty() &&
+                     mesh->colormapParameters().lut == nullptr &&
+                     mesh->faceData().buffer == nullptr && multiDrawSupported(sh))
+            {
+                const uint32_t slot = tested ? occlusion_->slots.at(drawable_entity.id()) + 1 : 0;
+                multidraw_items.push_back(
+                    {sh, mesh, tr, static_cast<unsigned int>(drawable_entity.id()), slot});
+            }
+            else
+            {
+                drawcalls.push_back(makeDrawCall(mesh, sh, tr, ForwardRenderPass::Opaque));
+                drawcalls.back().textures.push_back({shadow_atlas_->id(), 10});
+                if (tested)
+                {
+                    drawcalls.back().multi_draw = occlusion;
+                }
+            }
+            sh = sh->next_pass.get();
         }
-        if (mat->shader->opacity < 1.f)
+    }
+    for (const auto &batch : static_batches_)
+    {
+        triangles_drawn_ += batch->triangles;
+        triangles_full_detail_ += batch->triangles;
+        if (batch->draws.draw_count == 0)
         {
             continue;
         }
-        // Add other shader passes to the drawcalls if they exist
-        ShaderMaterial *sh = mat->shader.get();
+        ShaderMaterial *sh = batch->material.get();
+        std::vector<DrawCall> &batch_drawcalls =
+            sh->supportsDepthPrepass() ? drawcalls : drawcalls_depth_write;
         while (sh != nullptr)
         {
-            drawcalls.push_back(makeDrawCall(dr, sh, tr, ForwardRenderPass::Opaque));
-            drawcalls.back().textures.push_back({shadow_atlas_->id(), 10});
+            batch_drawcalls.push_back(
+                makeDrawCall(batch->mesh, sh, nullptr, ForwardRenderPass::Opaque));
+            batch_drawcalls.back().textures.push_back({shadow_atlas_->id(), 10});
+            batch_drawcalls.back().multi_draw = batch->draws;
             sh = sh->next_pass.get();
         }
     }
+    addMultiDrawCalls(multidraw_items, drawcalls);
     renderer_.draw(rt, state, drawcalls);
 
+    // Objects missing from the depth prepass write and test their own depth
+    if (!drawcalls_depth_write.empty())
+    {
+        RenderTarget rt_depth_write = rt;
+        rt_depth_write.clear_color.clear();
+        state.depth.write = true;
+        state.depth.func = DepthFunc::Less;
+        renderer_.draw(rt_depth_write, state, drawcalls_depth_write);
+    }
+
     // Draw skybox
     if (cam->use_skybox && !cam->orthographic)
     {
@@ -496,96 +1887,521 @@ void ForwardRenderSystem::opaqueGeometryPass(Camera *cam)
     }
 }
 
-void ForwardRenderSystem::transparentGeometryPass(Camera *cam)
+bool ForwardRenderSystem::multiDrawSupported(ShaderMaterial *material)
 {
-    RenderTarget rt;
-    RenderSettings state;
-    rt.clear_color = {glm::vec4(0.f), glm::vec4(1.f)};
-    rt.clear_depth_buffer = false;
-    rt.clear_stencil_buffer = false;
-    rt.framebuffer = wboit_.getFramebuffer()->id();
-    rt.viewport_origin = glm::ivec2(0, 0);
-    rt.viewport_size = resolution_;
+    if (!material->supportsMultiDraw())
+    {
+        return false;
+    }
+    auto it = multidraw_blocks_.find(material->name());
+    if (it == multidraw_blocks_.end())
+    {
+        std::vector<char> block;
+        it = multidraw_blocks_.emplace(material->name(), material->packUniformBlock(block)).first;
+        if (!it->second)
+        {
+            std::cerr << "Material " << material->name()
+                      << " supports multi-draw but has no uniform block; drawing it per object"
+                      << std::endl;
+        }
+    }
+    return it->second;
+}
 
-    state.depth.test = true;
-    state.depth.write = false;
-    state.depth.func = DepthFunc::LessOrEqual;
-    state.stencil.test = false;
-    state.cull.enabled = false;
-    state.blend.enabled = true;
-    state.blend.blend.resize(2);
-    state.blend.blend[0].color_src = BlendFunc::One;
-    state.blend.blend[0].alpha_src = BlendFunc::One;
-    state.blend.blend[0].color_dst = BlendFunc::One;
-    state.blend.blend[0].alpha_dst = BlendFunc::One;
-    state.blend.blend[1].color_src = BlendFunc::Zero;
-    state.blend.blend[1].alpha_src = BlendFunc::Zero;
-    state.blend.blend[1].color_dst = BlendFunc::OneMinusSrcColor;
-    state.blend.blend[1].alpha_dst = BlendFunc::OneMinusSrcColor;
-    state.blend.equation = BlendEq::Add;
+void ForwardRenderSystem::addMultiDrawCalls(std::vector<MultiDrawItem> &items,
+                                            std::vector<DrawCall> &drawcalls)
+{
+    if (items.empty())
+    {
+        return;
+    }
+    // Objects whose materials share a shader and textures and whose meshes share a vertex
+    // array (that of their geometry arena) and a primitive type are drawn together; the
+    // parameters of their materials are read from the materials storage buffer
+    struct Batched
+    {
+        const MultiDrawItem *item;
+        std::tuple<const ShaderProgram *, GLuint, MeshPrimitive, bool, std::vector<GLuint>> key;
+    };
+    std::vector<Batched> batched;
+    batched.reserve(items.size());
+    for (const MultiDrawItem &item : items)
+    {
+        std::vector<GLuint> textures;
+        for (const DrawCall::Texture2DInfo &tex : item.material->textureSlots())
+        {
+            textures.insert(textures.end(), {tex.texture, GLuint(tex.unit)});
+        }
+        // Cubemaps and 2D textures have separate names; a zero separates the lists
+        textures.push_back(0);
+        for (const DrawCall::TextureCubemapInfo &tex : item.material->cubemapSlots())
+        {
+            textures.insert(textures.end(), {tex.texture, GLuint(tex.unit)});
+        }
+        const Mesh *mesh = item.mesh.get();
+        const ShaderProgram *shader =
+            ForwardRenderSystemShaderManager::instance()
+                .get(item.material->name(), ForwardRenderPass::OpaqueMultiDraw)
+                .get();
+        batched.push_back({&item, std::make_tuple(shader, mesh->vao(), mesh->primitive(),
+                                                  mesh->numIndexData() > 0, textures)});
+    }
+    std::sort(batched.begin(), batched.end(),
+              [](const Batched &a, const Batched &b) { return a.key < b.key; });
+    std::vector<MultiDrawObjectData> objects;
+    objects.reserve(items.size());
+    std::vector<GLuint> commands;
+    commands.reserve(items.size() * 5);
+    std::vector<char> materials;
+    std::vector<char> block;
+    std::unordered_map<ShaderMaterial *, unsigned int> material_indices;
+    bool occlusion_tested = false;
+    size_t i = 0;
+    while (i < batched.size())
+    {
+        const MultiDrawItem &first = *batched[i].item;
+        DrawCall dc = makeDrawCall(first.mesh, first.material, first.transform,
+                                   ForwardRenderPass::OpaqueMultiDraw);
+        dc.textures.push_back({shadow_atlas_->id(), 10});
+        dc.multi_draw.indirect_buffer = indirect_buffer_->id();
+        dc.multi_draw.offset = commands.size() * sizeof(GLuint);
+        // The uniform blocks of the call's materials are an array starting at an aligned offset
+        const size_t materials_offset = (materials.size() + ssbo_offset_alignment_ - 1) /
+                                        ssbo_offset_alignment_ * ssbo_offset_alignment_;
+        materials.resize(materials_offset);
+        material_indices.clear();
+        size_t j = i;
+        for (; j < batched.size(); ++j)
+        {
+            if (batched[j].key != batched[i].key)
+            {
+                break;
+            }
+            const MultiDrawItem &item = *batched[j].item;
+            auto it = material_indices.find(item.material);
+            if (it == material_indices.end())
+            {
+                // Materials without a uniform block were drawn per object instead
+                item.material->packUniformBlock(block);
+                block.resize((block.size() + 15) / 16 * 16, 0);
+                const unsigned int index = static_cast<unsigned int>(
+                    (materials.size() - materials_offset) / block.size());
+                it = material_indices.insert({item.material, index}).first;
+                materials.insert(materials.end(), block.begin(), block.end());
+            }
+            // The draw ID attribute fetches element baseInstance of the draw ID buffer, which
+            // is the index of the object in the storage buffer
+            const GLuint base_instance = static_cast<GLuint>(objects.size());
+            MultiDrawObjectData obj;
+            obj.model_matrix = item.transform->worldTransform();
+            obj.normal_matrix =
+                glm::mat4(glm::transpose(glm::inverse(glm::mat3(obj.model_matrix))));
+            // The instance count is the second word of the command
+            obj.ids = glm::uvec4(item.id, it->second, item.occlusion_slot,
+                                 static_cast<GLuint>(commands.size() + 1));
+            occlusion_tested |= item.occlusion_slot > 0;
+            objects.push_back(obj);
+            const Mesh *mesh = item.mesh.get();
+            const GLuint base_vertex = static_cast<GLuint>(mesh->baseVertex());
+            if (dc.mesh.indexed)
+            {
+                const GLuint count = static_cast<GLuint>(mesh->numIndexData());
+                const GLuint first_index = static_cast<GLuint>(mesh->firstIndex());
+                // count, instanceCount, firstIndex, baseVertex, baseInstance
+                commands.insert(commands.end(),
+                                {count, 1, first_index, base_vertex, base_instance});
+            }
+            else
+            {
+                const GLuint count = static_cast<GLuint>(mesh->numVertexData());
+                // count, instanceCount, first, baseInstance
+                commands.insert(commands.end(), {count, 1, base_vertex, base_instance});
+            }
+        }
+        // All parameters come from the materials buffer, so no uniforms are set
+        const size_t materials_bytes = materials.size() - materials_offset;
+        ShaderStorageBuffer *ssbo_materials = ssbo_materials_.get();
+        dc.update_uniforms = [ssbo_materials, materials_offset,
+                              materials_bytes](std::shared_ptr<ShaderProgram>) {
+            ssbo_materials->bindRange(RCUBE_MULTIDRAW_MATERIAL_BINDING, materials_offset,
+                                      materials_bytes);
+        };
+        dc.multi_draw.draw_count = static_cast<GLsizei>(j - i);
+        drawcalls.push_back(dc);
+        i = j;
+    }
 
-    std::vector<DrawCall> drawcalls;
+    // Upload material parameters
+    if (ssbo_materials_->size() < materials.size())
+    {
+        ssbo_materials_->reserve(std::max(materials.size(), 2 * ssbo_materials_->size()));
+    }
+    ssbo_materials_->setData(materials.data(), materials.size(), 0);
+
+    // Upload per-object data and draw commands
+    const size_t object_bytes = objects.size() * sizeof(MultiDrawObjectData);
+    if (ssbo_objects_->size() < object_bytes)
+    {
+        ssbo_objects_->reserve(std::max(object_bytes, 2 * ssbo_objects_->size()));
+    }
+    ssbo_objects_->setData(objects.data(), object_bytes, 0);
+    ssbo_objects_->bindBase(0);
+    const size_t command_bytes = commands.size() * sizeof(GLuint);
+    if (indirect_buffer_->size() < command_bytes)
+    {
+        indirect_buffer_->reserve(std::max(command_bytes, 2 * indirect_buffer_->size()));
+    }
+    indirect_buffer_->setData(commands.data(), command_bytes, 0);
+
+    // Objects tested for occlusion are drawn if the test found them visible
+    if (occlusion_tested)
+    {
+        shader_occlusion_multidraw_->use();
+        shader_occlusion_multidraw_->uniform("num_objects")
+            .set(static_cast<unsigned int>(objects.size()));
+        occlusion_->history->bindBase(1);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, indirect_buffer_->id());
+        glDispatchCompute(
+            GLuint((objects.size() + OCCLUSION_GROUP_SIZE - 1) / OCCLUSION_GROUP_SIZE), 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+        shader_occlusion_multidraw_->done();
+    }
+
+    // Draw IDs are the sequence 0, 1, 2, ... consumed one per instance
+    const size_t draw_id_bytes = objects.size() * sizeof(GLuint);
+    if (draw_id_buffer_->size() < draw_id_bytes)
+    {
+        const size_t num_ids =
+            std::max(objects.size(), 2 * draw_id_buffer_->size() / sizeof(GLuint));
+        std::vector<GLuint> ids(num_ids);
+        for (size_t k = 0; k < ids.size(); ++k)
+        {
+            ids[k] = static_cast<GLuint>(k);
+        }
+        draw_id_buffer_->reserve(ids.size() * sizeof(GLuint), GL_STATIC_DRAW);
+        draw_id_buffer_->setData(ids.data(), ids.size() * sizeof(GLuint), 0);
+    }
+    // Attach the draw ID buffer as an instanced attribute of every vertex array in use. This is
+    // redone each frame since vertex arrays may be recreated by their meshes.
+    for (const DrawCall &dc : drawcalls)
+    {
+        if (dc.multi_draw.draw_count == 0)
+        {
+            continue;
+        }
+        const GLuint vao = dc.mesh.vao;
+        glVertexArrayVertexBuffer(vao, DRAW_ID_BINDING, draw_id_buffer_->id(), 0, sizeof(GLuint));
+        glVertexArrayAttribIFormat(vao, AttributeLocation::DRAW_ID, 1, GL_UNSIGNED_INT, 0);
+        glVertexArrayAttribBinding(vao, AttributeLocation::DRAW_ID, DRAW_ID_BINDING);
+        glVertexArrayBindingDivisor(vao, DRAW_ID_BINDING, 1);
+        glEnableVertexArrayAttrib(vao, AttributeLocation::DRAW_ID);
+    }
+}
+
+void ForwardRenderSystem::classifyDrawables()
+{
+    opaque_entities_.clear();
+    transparent_entities_.clear();
     const auto &drawable_entities =
         getFilteredEntities({Transform::family(), Drawable::family(), ForwardMaterial::family()});
-    drawcalls.reserve(drawable_entities.size());
+    std::vector<Entity> static_entities;
     for (Entity drawable_entity : drawable_entities)
     {
         Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
-        if (!dr->visible)
+        ForwardMaterial *mat = world_->getComponent<ForwardMaterial>(drawable_entity);
+        if (mat->shader == nullptr)
         {
             continue;
         }
-        ForwardMaterial *mat = world_->getComponent<ForwardMaterial>(drawable_entity);
-        if (mat->shader == nullptr)
+        // Hidden members stay in their batch and are skipped by its draw commands, so that
+        // toggling their visibility does not rebuild it
+        if (dr->static_batch && static_batch_commands_ != nullptr && mat->shader->opacity >= 1.f &&
+            dr->lods.empty() && dr->meshlets.empty() && dr->mesh != nullptr &&
+            staticBatchable(*dr->mesh))
         {
+            static_entities.push_back(drawable_entity);
             continue;
         }
-        if (mat->shader->opacity == 1.f)
+        if (!dr->visible)
         {
             continue;
         }
-        Mesh *mesh = dr->mesh.get();
-        Transform *tr = world_->getComponent<Transform>(drawable_entity);
-        ShaderMaterial *sh = mat->shader.get();
-        DrawCall dc = makeDrawCall(dr, sh, tr, ForwardRenderPass::Transparent);
-        drawcalls.push_back(dc);
+        if (mat->shader->opacity < 1.f)
+        {
+            transparent_entities_.push_back(drawable_entity);
+        }
+        else
+        {
+            opaque_entities_.push_back(drawable_entity);
+        }
     }
-    if (drawcalls.empty())
+    updateStaticBatches(static_entities);
+}
+
+void ForwardRenderSystem::updateStaticBatches(const std::vector<Entity> &entities)
+{
+    ++static_batch_frame_;
+    static_batches_rebuilt_ = 0;
+    for (Entity drawable_entity : entities)
     {
-        return;
+        Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
+        const std::shared_ptr<ShaderMaterial> &material =
+            world_->getComponent<ForwardMaterial>(drawable_entity)->shader;
+        const glm::mat4 &world = world_->getComponent<Transform>(drawable_entity)
+                                     ->worldTransform();
+        const size_t version = dr->mesh->dataVersion();
+        const unsigned int id = static_cast<unsigned int>(drawable_entity.id());
+        std::string signature;
+        auto it = static_batch_members_.find(id);
+        if (it != static_batch_members_.end())
+        {
+            StaticBatch *batch = it->second.first;
+            const size_t k = it->second.second;
+            StaticBatchMember &member = batch->members[k];
+            batch->last_seen[k] = static_batch_frame_;
+            if (member.mesh == dr->mesh && batch->data_versions[k] == version &&
+                member.transform == world && batch->material == material)
+            {
+                continue;
+            }
+            // Members that only moved are transformed again within the batch's vertices;
+            // other changes rebuild the batch, with the member elsewhere if it no longer fits
+            if (!batch->dirty && batch->mesh != nullptr && member.mesh == dr->mesh &&
+                batch->data_versions[k] == version && batch->material == material &&
+                retransformStaticBatchMember(*batch->mesh, member, world))
+            {
+                continue;
+            }
+            batch->dirty = true;
+            signature = staticBatchSignature(*dr->mesh);
+            if (batch->material == material && batch->signature == signature)
+            {
+                member.mesh = dr->mesh;
+                member.transform = world;
+                batch->data_versions[k] = version;
+                continue;
+            }
+            member.mesh = nullptr;
+            static_batch_members_.erase(it);
+        }
+        else
+        {
+            signature = staticBatchSignature(*dr->mesh);
+        }
+
+        const size_t num_vertices = dr->mesh->numVertexData();
+        StaticBatch *batch = nullptr;
+        for (const auto &candidate : static_batches_)
+        {
+            if (candidate->material == material &&
+                candidate->num_vertices + num_vertices <= MAX_STATIC_BATCH_VERTICES &&
+                candidate->signature == signature)
+            {
+                batch = candidate.get();
+                break;
+            }
+        }
+        if (batch == nullptr)
+        {
+            static_batches_.push_back(std::make_unique<StaticBatch>());
+            batch = static_batches_.back().get();
+            batch->material = material;
+            batch->signature = signature;
+        }
+        StaticBatchMember member;
+        member.id = id;
+        member.mesh = dr->mesh;
+        member.transform = world;
+        batch->members.push_back(member);
+        batch->entities.push_back(drawable_entity);
+        batch->data_versions.push_back(version);
+        batch->last_seen.push_back(static_batch_frame_);
+        batch->num_vertices += num_vertices;
+        batch->dirty = true;
+        static_batch_members_[id] = {batch, batch->members.size() - 1};
     }
-    renderer_.draw(rt, state, drawcalls);
 
-    // Composite pass
-    rt = RenderTarget();
-    state = RenderSettings();
-    wboit_.prepareCompositePass(framebuffer_hdr_, rt, state);
-    std::shared_ptr<ShaderProgram> composite_shader = wboit_.getCompositeShader();
-    drawcalls.clear();
-    for (Entity drawable_entity : drawable_entities)
+    // Members not seen this frame were deleted, hidden from the batching or changed material
+    for (const auto &batch : static_batches_)
     {
-        Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
-        if (!dr->visible)
+        for (size_t k = 0; k < batch->members.size(); ++k)
         {
-            continue;
+            if (batch->members[k].mesh != nullptr && batch->last_seen[k] != static_batch_frame_)
+            {
+                static_batch_members_.erase(static_cast<unsigned int>(batch->entities[k].id()));
+                batch->members[k].mesh = nullptr;
+                batch->dirty = true;
+            }
         }
-        ForwardMaterial *mat = world_->getComponent<ForwardMaterial>(drawable_entity);
-        if (mat->shader == nullptr)
+    }
+
+    // Rebuild the changed batches without their removed members
+    for (const auto &batch : static_batches_)
+    {
+        if (!batch->dirty)
         {
             continue;
         }
-        if (mat->shader->opacity == 1.f)
+        size_t n = 0;
+        batch->num_vertices = 0;
+        for (size_t k = 0; k < batch->members.size(); ++k)
         {
-            continue;
+            if (batch->members[k].mesh == nullptr)
+            {
+                continue;
+            }
+            batch->members[n] = std::move(batch->members[k]);
+            batch->entities[n] = batch->entities[k];
+            batch->data_versions[n] = batch->data_versions[k];
+            batch->last_seen[n] = batch->last_seen[k];
+            batch->num_vertices += batch->members[n].mesh->numVertexData();
+            static_batch_members_[batch->members[n].id] = {batch.get(), n};
+            ++n;
         }
-        DrawCall dc;
-        dc.mesh = GLRenderer::getDrawCallMeshInfo(renderer_.fullscreenQuadMesh());
-        dc.shader = composite_shader;
-        dc.textures.push_back(DrawCall::Texture2DInfo{wboit_.getAccumTexture()->id(), 0});
-        dc.textures.push_back(DrawCall::Texture2DInfo{wboit_.getRevealageTexture()->id(), 1});
+        batch->members.resize(n);
+        batch->entities.resize(n);
+        batch->data_versions.resize(n);
+        batch->last_seen.resize(n);
+        if (batch->mesh != nullptr)
+        {
+            batch->mesh->release();
+            batch->mesh = nullptr;
+        }
+        if (n > 0)
+        {
+            batch->mesh = buildStaticBatch(batch->members);
+            ++static_batches_rebuilt_;
+        }
+        batch->dirty = false;
+    }
+    static_batches_.erase(std::remove_if(static_batches_.begin(), static_batches_.end(),
+                                         [](const std::unique_ptr<StaticBatch> &batch) {
+                                             return batch->members.empty();
+                                         }),
+                          static_batches_.end());
+}
+
+void ForwardRenderSystem::cullStaticBatches(Camera *cam)
+{
+    if (static_batches_.empty())
+    {
+        return;
+    }
+    // Frustum planes in world space (Gribb and Hartmann)
+    const glm::mat4 m = cam->view_to_projection * cam->world_to_view;
+    std::array<glm::vec4, 4> rows;
+    for (int i = 0; i < 4; ++i)
+    {
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    }
+    const std::array<glm::vec4, 6> planes = {rows[3] + rows[0], rows[3] - rows[0],
+                                             rows[3] + rows[1], rows[3] - rows[1],
+                                             rows[3] + rows[2], rows[3] - rows[2]};
+    // A box is outside if its corner farthest along a plane's normal is behind the plane
+    auto in_frustum = [&planes](const AABB &box) {
+        for (const glm::vec4 &plane : planes)
+        {
+            const glm::vec3 corner(plane.x >= 0.f ? box.max().x : box.min().x,
+                                   plane.y >= 0.f ? box.max().y : box.min().y,
+                                   plane.z >= 0.f ? box.max().z : box.min().z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.f)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<GLuint> commands;
+    std::vector<std::pair<GLuint, GLuint>> runs;
+    for (const auto &batch : static_batches_)
+    {
+        const GLuint first_index = static_cast<GLuint>(batch->mesh->firstIndex());
+        const GLuint base_vertex = static_cast<GLuint>(batch->mesh->baseVertex());
+        batch->triangles = 0;
+        batch->pick_draws.indirect_buffer = static_batch_commands_->id();
+        batch->pick_draws.offset = commands.size() * sizeof(GLuint);
+        runs.clear();
+        for (size_t k = 0; k < batch->members.size(); ++k)
+        {
+            const StaticBatchMember &member = batch->members[k];
+            if (!world_->getComponent<Drawable>(batch->entities[k])->visible ||
+                !in_frustum(member.bounds))
+            {
+                continue;
+            }
+            const GLuint first = first_index + static_cast<GLuint>(member.first_index);
+            const GLuint count = static_cast<GLuint>(member.num_indices);
+            // count, instanceCount, firstIndex, baseVertex, baseInstance
+            commands.insert(commands.end(), {count, 1, first, base_vertex, 0});
+            if (!runs.empty() && runs.back().first + runs.back().second == first)
+            {
+                runs.back().second += count;
+            }
+            else
+            {
+                runs.push_back({first, count});
+            }
+            batch->triangles += member.num_indices / 3;
+        }
+        batch->pick_draws.draw_count = static_cast<GLsizei>(
+            (commands.size() * sizeof(GLuint) - batch->pick_draws.offset) / (5 * sizeof(GLuint)));
+        batch->draws.indirect_buffer = static_batch_commands_->id();
+        batch->draws.offset = commands.size() * sizeof(GLuint);
+        batch->draws.draw_count = static_cast<GLsizei>(runs.size());
+        for (const auto &run : runs)
+        {
+            commands.insert(commands.end(), {run.second, 1, run.first, base_vertex, 0});
+        }
+    }
+    if (commands.empty())
+    {
+        return;
+    }
+    const size_t command_bytes = commands.size() * sizeof(GLuint);
+    if (static_batch_commands_->size() < command_bytes)
+    {
+        static_batch_commands_->reserve(
+            std::max(command_bytes, 2 * static_batch_commands_->size()));
+    }
+    static_batch_commands_->setData(commands.data(), command_bytes, 0);
+}
+
+void ForwardRenderSystem::transparentGeometryPass(Camera *cam)
+{
+    // Accumulate all transparent objects into the WBOIT targets
+    RenderTarget rt;
+    RenderSettings state;
+    wboit_.prepareTransparentPass(rt, state);
+    state.depth.func = DepthFunc::LessOrEqual;
+
+    std::vector<DrawCall> drawcalls;
+    drawcalls.reserve(transparent_entities_.size());
+    for (Entity drawable_entity : transparent_entities_)
+    {
+        Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
+        ForwardMaterial *mat = world_->getComponent<ForwardMaterial>(drawable_entity);
+        Transform *tr = world_->getComponent<Transform>(drawable_entity);
+        ShaderMaterial *sh = mat->shader.get();
+        const std::shared_ptr<Mesh> &mesh = drawnMesh(drawable_entity, dr);
+        triangles_drawn_ += numTriangles(*mesh);
+        triangles_full_detail_ += numTriangles(*dr->mesh);
+        DrawCall dc = makeDrawCall(mesh, sh, tr, ForwardRenderPass::Transparent);
+        dc.textures.push_back({shadow_atlas_->id(), 10});
         drawcalls.push_back(dc);
     }
     renderer_.draw(rt, state, drawcalls);
+
+    // Resolve the accumulated layers over the opaque image with one full-screen pass
+    rt = RenderTarget();
+    state = RenderSettings();
+    wboit_.prepareCompositePass(framebuffer_hdr_, rt, state);
+    DrawCall dc;
+    dc.mesh = GLRenderer::getDrawCallMeshInfo(renderer_.fullscreenQuadMesh());
+    dc.shader = wboit_.getCompositeShader();
+    dc.textures.push_back(DrawCall::Texture2DInfo{wboit_.getAccumTexture()->id(), 0});
+    dc.textures.push_back(DrawCall::Texture2DInfo{wboit_.getRevealageTexture()->id(), 1});
+    renderer_.draw(rt, state, {dc});
 }
 
 void ForwardRenderSystem::pickFBOPass(Camera *cam)
@@ -618,19 +2434,44 @@ void ForwardRenderSystem::pickFBOPass(Camera *cam)
     for (Entity drawable_entity : drawable_entities)
     {
         Drawable *dr = world_->getComponent<Drawable>(drawable_entity);
-        if (!dr->visible)
+        // Static batch members are drawn with their batch below
+        if (!dr->visible ||
+            static_batch_members_.count(static_cast<unsigned int>(drawable_entity.id())) > 0)
         {
             continue;
         }
+        // The full mesh is drawn so that primitive IDs are faces of Drawable::mesh whatever
+        // level of detail is shown
         DrawCall dc;
         DrawCall::MeshInfo mi = GLRenderer::getDrawCallMeshInfo(dr->mesh);
         dc.mesh = mi;
         Transform *tr = world_->getComponent<Transform>(drawable_entity);
         dc.shader = shader_picking_;
         const int id = static_cast<int>(drawable_entity.id());
-        dc.update_uniforms = [tr, id](std::shared_ptr<ShaderProgram> shader) {
+        const bool instanced = mi.instanced;
+        dc.update_uniforms = [tr, id, instanced](std::shared_ptr<ShaderProgram> shader) {
             shader->uniform("model_matrix").set(tr->worldTransform());
             shader->uniform("id").set(id);
+            shader->uniform("instanced").set(instanced);
+            shader->uniform("batched").set(false);
+        };
+        drawcalls.push_back(dc);
+    }
+    // The entity of each fragment of a batch comes from its vertices' object IDs
+    for (const auto &batch : static_batches_)
+    {
+        if (batch->pick_draws.draw_count == 0)
+        {
+            continue;
+        }
+        DrawCall dc;
+        dc.mesh = GLRenderer::getDrawCallMeshInfo(batch->mesh);
+        dc.multi_draw = batch->pick_draws;
+        dc.shader = shader_picking_;
+        dc.update_uniforms = [](std::shared_ptr<ShaderProgram> shader) {
+            shader->uniform("model_matrix").set(glm::mat4(1.f));
+            shader->uniform("instanced").set(false);
+            shader->uniform("batched").set(true);
         };
         drawcalls.push_back(dc);
     }
@@ -757,7 +2598,7 @@ void WeightedBlendedOITManager::initialize(glm::ivec2 resolution,
                                            std::shared_ptr<Texture2D> opaque_depth)
 {
     fbo_ = Framebuffer::create();
-    accum_tex_ = Texture2D::create(resolution[0], resolution[1], 1, TextureInternalFormat::RGBA32F);
+    accum_tex_ = Texture2D::create(resolution[0], resolution[1], 1, accum_format_);
     accum_tex_->setFilterMode(TextureFilterMode::Linear);
     revealage_tex_ = Texture2D::create(resolution[0], resolution[1], 1, TextureInternalFormat::R8);
     revealage_tex_->setFilterMode(TextureFilterMode::Linear);
@@ -771,6 +2612,24 @@ void WeightedBlendedOITManager::initialize(glm::ivec2 resolution,
     composite_shader_ = common::fullScreenQuadShader(WBOITCompositeFragmentShader);
 }
 
+void WeightedBlendedOITManager::setAccumFormat(TextureInternalFormat format)
+{
+    if (format == accum_format_)
+    {
+        return;
+    }
+    accum_format_ = format;
+    if (fbo_ == nullptr)
+    {
+        return;
+    }
+    accum_tex_->release();
+    accum_tex_ = Texture2D::create(resolution_[0], resolution_[1], 1, accum_format_);
+    accum_tex_->setFilterMode(TextureFilterMode::Linear);
+    fbo_->setColorAttachment(0, accum_tex_);
+    assert(fbo_->isComplete());
+}
+
 std::shared_ptr<Framebuffer> WeightedBlendedOITManager::getFramebuffer()
 {
     return fbo_;
@@ -1,13 +1,25 @@
 #include "RCubeViewer/Colormap.h"
+#include "RCube/Helpers/ParallelChunks.h"
+#include "glm/gtc/type_ptr.hpp"
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
 #include <stdexcept>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RCUBE_COLORMAP_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RCUBE_COLORMAP_SSE2
+#endif
 
 namespace rcube
 {
 namespace viewer
 {
 // Taken from https://github.com/libigl/libigl/blob/master/include/igl/colormap.cpp
-static double viridis[256][3] = {
+static const double viridis[256][3] = {
     {0.267004, 0.004874, 0.329415}, {0.268510, 0.009605, 0.335427}, {0.269944, 0.014625, 0.341379},
     {0.271305, 0.019942, 0.347269}, {0.272594, 0.025563, 0.353093}, {0.273809, 0.031497, 0.358853},
     {0.274952, 0.037752, 0.364543}, {0.276022, 0.044167, 0.370164}, {0.277018, 0.050344, 0.375715},
@@ -95,7 +107,7 @@ static double viridis[256][3] = {
     {0.964894, 0.902323, 0.123941}, {0.974417, 0.903590, 0.130215}, {0.983868, 0.904867, 0.136897},
     {0.993248, 0.906157, 0.143936}};
 
-static double magma[256][3] = {
+static const double magma[256][3] = {
     {0.001462, 0.000466, 0.013866}, {0.002258, 0.001295, 0.018331}, {0.003279, 0.002305, 0.023708},
     {0.004512, 0.003490, 0.029965}, {0.005950, 0.004843, 0.037130}, {0.007588, 0.006356, 0.044973},
     {0.009426, 0.008022, 0.052844}, {0.011465, 0.009828, 0.060750}, {0.013708, 0.011771, 0.068667},
@@ -183,78 +195,235 @@ static double magma[256][3] = {
     {0.988033, 0.970012, 0.727077}, {0.987691, 0.977154, 0.734536}, {0.987387, 0.984288, 0.742002},
     {0.987053, 0.991438, 0.749504}};
 
-void colormap(const double palette[256][3], float value, glm::vec3 &rgb)
+namespace
 {
-    const float zero = 0.0;
-    const float one = 1.0;
-    float value_clamped = static_cast<float>(std::max(zero, std::min(one, value)));
+// Number of entries of the float lookup tables resampled from the 256-entry palettes. Values are
+// mapped to the nearest entry, which is within 1/8 of a palette step of linear interpolation.
+constexpr size_t LUT_SIZE = 1024;
 
-    unsigned int least =
-        static_cast<unsigned int>(std::floor(value_clamped * static_cast<float>(255)));
-    unsigned int most =
-        static_cast<unsigned int>(std::ceil(value_clamped * static_cast<float>(255)));
+// Lookup table stored per channel for SIMD gathers, plus packed RGBA8 colors
+struct ColormapLUT
+{
+    alignas(32) float r[LUT_SIZE];
+    alignas(32) float g[LUT_SIZE];
+    alignas(32) float b[LUT_SIZE];
+    alignas(32) uint32_t rgba8[LUT_SIZE];
 
-    const float r_min = static_cast<float>(palette[least][0]);
-    const float r_max = static_cast<float>(palette[most][0]);
-    const float g_min = static_cast<float>(palette[least][1]);
-    const float g_max = static_cast<float>(palette[most][1]);
-    const float b_min = static_cast<float>(palette[least][2]);
-    const float b_max = static_cast<float>(palette[most][2]);
+    explicit ColormapLUT(const double palette[256][3])
+    {
+        for (size_t i = 0; i < LUT_SIZE; ++i)
+        {
+            const double x = double(i) * 255.0 / double(LUT_SIZE - 1);
+            const size_t least = std::min(size_t(x), size_t(254));
+            const double t = x - double(least);
+            double rgb[3];
+            for (size_t c = 0; c < 3; ++c)
+            {
+                rgb[c] = std::clamp((1.0 - t) * palette[least][c] + t * palette[least + 1][c],
+                                    0.0, 1.0);
+            }
+            r[i] = float(rgb[0]);
+            g[i] = float(rgb[1]);
+            b[i] = float(rgb[2]);
+            rgba8[i] = uint32_t(std::lround(rgb[0] * 255.0)) |
+                       (uint32_t(std::lround(rgb[1] * 255.0)) << 8) |
+                       (uint32_t(std::lround(rgb[2] * 255.0)) << 16) | (uint32_t(255) << 24);
+        }
+    }
+};
 
-    float t = std::max(zero, std::min(one, (float)fmod(value_clamped * 256.f, one)));
+// Returns nullptr for Colormap::None, which maps everything to white
+const ColormapLUT *lookupTable(Colormap cm)
+{
+    static const ColormapLUT viridis_lut(viridis);
+    static const ColormapLUT magma_lut(magma);
+    switch (cm)
+    {
+    case Colormap::Viridis:
+        return &viridis_lut;
+    case Colormap::Magma:
+        return &magma_lut;
+    default:
+        return nullptr;
+    }
+}
 
-    rgb.r = std::max(zero, std::min(one, (one - t) * r_min + t * r_max));
-    rgb.g = std::max(zero, std::min(one, (one - t) * g_min + t * g_max));
-    rgb.b = std::max(zero, std::min(one, (one - t) * b_min + t * b_max));
+// Below this many values per thread, spawning threads costs more than it saves
+constexpr size_t MIN_VALUES_PER_THREAD = size_t(1) << 16;
+
+// Index of the lookup table entry of a value; NaNs map to the first entry
+inline size_t lutIndex(float value, float vmin, float scale)
+{
+    const float x = (value - vmin) * scale;
+    return size_t(std::clamp(x > 0.f ? x : 0.f, 0.f, float(LUT_SIZE - 1)) + 0.5f);
 }
 
-void colormap(Colormap cm, float value, float vmin, float vmax, glm::vec3 &rgb)
+void colormapKernel(const ColormapLUT &lut, const float *values, size_t begin, size_t end,
+                    float vmin, float scale, float *rgb)
+{
+    size_t i = begin;
+#if defined(RCUBE_COLORMAP_AVX2)
+    const __m256 vmin8 = _mm256_set1_ps(vmin);
+    const __m256 scale8 = _mm256_set1_ps(scale);
+    const __m256 zero8 = _mm256_setzero_ps();
+    const __m256 max8 = _mm256_set1_ps(float(LUT_SIZE - 1));
+    alignas(32) float r[8], g[8], b[8];
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(values + i), vmin8), scale8);
+        // max returns the second operand for NaNs
+        x = _mm256_min_ps(_mm256_max_ps(x, zero8), max8);
+        const __m256i index = _mm256_cvtps_epi32(x);
+        _mm256_store_ps(r, _mm256_i32gather_ps(lut.r, index, 4));
+        _mm256_store_ps(g, _mm256_i32gather_ps(lut.g, index, 4));
+        _mm256_store_ps(b, _mm256_i32gather_ps(lut.b, index, 4));
+        float *out = rgb + 3 * i;
+        for (size_t k = 0; k < 8; ++k)
+        {
+            out[3 * k] = r[k];
+            out[3 * k + 1] = g[k];
+            out[3 * k + 2] = b[k];
+        }
+    }
+#elif defined(RCUBE_COLORMAP_SSE2)
+    const __m128 vmin4 = _mm_set1_ps(vmin);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    const __m128 zero4 = _mm_setzero_ps();
+    const __m128 max4 = _mm_set1_ps(float(LUT_SIZE - 1));
+    alignas(16) int32_t index[4];
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + i), vmin4), scale4);
+        x = _mm_min_ps(_mm_max_ps(x, zero4), max4);
+        _mm_store_si128(reinterpret_cast<__m128i *>(index), _mm_cvtps_epi32(x));
+        float *out = rgb + 3 * i;
+        for (size_t k = 0; k < 4; ++k)
+        {
+            out[3 * k] = lut.r[index[k]];
+            out[3 * k + 1] = lut.g[index[k]];
+            out[3 * k + 2] = lut.b[index[k]];
+        }
+    }
+#endif
+    for (; i < end; ++i)
+    {
+        const size_t index = lutIndex(values[i], vmin, scale);
+        rgb[3 * i] = lut.r[index];
+        rgb[3 * i + 1] = lut.g[index];
+        rgb[3 * i + 2] = lut.b[index];
+    }
+}
+
+void colormapKernel(const ColormapLUT &lut, const float *values, size_t begin, size_t end,
+                    float vmin, float scale, uint32_t *rgba)
+{
+    size_t i = begin;
+#if defined(RCUBE_COLORMAP_AVX2)
+    const __m256 vmin8 = _mm256_set1_ps(vmin);
+    const __m256 scale8 = _mm256_set1_ps(scale);
+    const __m256 zero8 = _mm256_setzero_ps();
+    const __m256 max8 = _mm256_set1_ps(float(LUT_SIZE - 1));
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(values + i), vmin8), scale8);
+        x = _mm256_min_ps(_mm256_max_ps(x, zero8), max8);
+        const __m256i index = _mm256_cvtps_epi32(x);
+        const __m256i colors =
+            _mm256_i32gather_epi32(reinterpret_cast<const int *>(lut.rgba8), index, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(rgba + i), colors);
+    }
+#elif defined(RCUBE_COLORMAP_SSE2)
+    const __m128 vmin4 = _mm_set1_ps(vmin);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    const __m128 zero4 = _mm_setzero_ps();
+    const __m128 max4 = _mm_set1_ps(float(LUT_SIZE - 1));
+    alignas(16) int32_t index[4];
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + i), vmin4), scale4);
+        x = _mm_min_ps(_mm_max_ps(x, zero4), max4);
+        _mm_store_si128(reinterpret_cast<__m128i *>(index), _mm_cvtps_epi32(x));
+        rgba[i] = lut.rgba8[index[0]];
+        rgba[i + 1] = lut.rgba8[index[1]];
+        rgba[i + 2] = lut.rgba8[index[2]];
+        rgba[i + 3] = lut.rgba8[index[3]];
+    }
+#endif
+    for (; i < end; ++i)
+    {
+        rgba[i] = lut.rgba8[lutIndex(values[i], vmin, scale)];
+    }
+}
+
+// Scale that maps [vmin, vmax] to the lookup table indices
+float lutScale(float vmin, float vmax)
 {
     if (vmax < vmin)
     {
         throw std::invalid_argument("vmax must be greater than vmin");
     }
     const float denom = vmax - vmin;
-    const float norm_value = value - vmin / denom;
-    switch (cm)
+    return denom > 0.f ? float(LUT_SIZE - 1) / denom : 0.f;
+}
+} // namespace
+
+void colormap(Colormap cm, float value, float vmin, float vmax, glm::vec3 &rgb)
+{
+    const float scale = lutScale(vmin, vmax);
+    const ColormapLUT *lut = lookupTable(cm);
+    if (lut == nullptr)
     {
-    case Colormap::Viridis:
-        colormap(viridis, norm_value, rgb);
-        break;
-    case Colormap::Magma:
-        colormap(magma, norm_value, rgb);
-        break;
-    default:
-        break;
+        rgb = glm::vec3(1.f);
+        return;
+    }
+    const size_t index = lutIndex(value, vmin, scale);
+    rgb = glm::vec3(lut->r[index], lut->g[index], lut->b[index]);
+}
+
+void colormap(Colormap cm, const float *values, size_t size, float vmin, float vmax, float *rgb)
+{
+    const float scale = lutScale(vmin, vmax);
+    const ColormapLUT *lut = lookupTable(cm);
+    if (lut == nullptr)
+    {
+        std::fill(rgb, rgb + 3 * size, 1.f);
+        return;
+    }
+    parallelChunks(size, MIN_VALUES_PER_THREAD, [&](size_t, size_t begin, size_t end) {
+        colormapKernel(*lut, values, begin, end, vmin, scale, rgb);
+    });
+}
+
+void colormap(Colormap cm, const float *values, size_t size, float vmin, float vmax,
+              uint32_t *rgba)
+{
+    const float scale = lutScale(vmin, vmax);
+    const ColormapLUT *lut = lookupTable(cm);
+    if (lut == nullptr)
+    {
+        std::fill(rgba, rgba + size, 0xFFFFFFFFu);
+        return;
     }
+    parallelChunks(size, MIN_VALUES_PER_THREAD, [&](size_t, size_t begin, size_t end) {
+        colormapKernel(*lut, values, begin, end, vmin, scale, rgba);
+    });
 }
 
 void colormap(Colormap cm, const float *ptr, size_t size, float vmin, float vmax,
               std::vector<glm::vec3> &colors)
 {
-    colors.reserve(size);
-    colors.clear();
-    glm::vec3 rgb;
-    for (size_t i = 0; i < size; ++i)
+    colors.resize(size);
+    if (size > 0)
     {
-        colormap(cm, ptr[i], vmin, vmax, rgb);
-        colors.push_back(rgb);
+        colormap(cm, ptr, size, vmin, vmax, glm::value_ptr(colors[0]));
     }
 }
 
-void colormap(Colormap cm, const std::vector<float> values, float vmin, float vmax,
+void colormap(Colormap cm, const std::vector<float> &values, float vmin, float vmax,
               std::vector<float> &colors)
 {
-    colors.reserve(values.size());
-    colors.clear();
-    glm::vec3 rgb;
-    for (size_t i = 0; i < values.size(); ++i)
-    {
-        colormap(cm, values[i], vmin, vmax, rgb);
-        colors.push_back(rgb.r);
-        colors.push_back(rgb.g);
-        colors.push_back(rgb.b);
-    }
+    colors.resize(3 * values.size());
+    colormap(cm, values.data(), values.size(), vmin, vmax, colors.data());
 }
 
 void colormap(Colormap cm, const std::vector<float> &value, float vmin, float vmax,
@@ -262,6 +431,47 @@ void colormap(Colormap cm, const std::vector<float> &value, float vmin, float vm
 {
     colormap(cm, value.data(), value.size(), vmin, vmax, colors);
 }
+
+// Lookup table textures shared by all scalar fields; emptied by releaseColormapTextures() so that
+// no texture outlives the OpenGL context it was created in
+static std::array<std::shared_ptr<Texture2D>, 3> colormap_textures;
+
+std::shared_ptr<Texture2D> colormapTexture(Colormap cm)
+{
+    const ColormapLUT *lut = lookupTable(cm);
+    if (lut == nullptr)
+    {
+        return nullptr;
+    }
+    std::shared_ptr<Texture2D> &tex = colormap_textures.at(static_cast<size_t>(cm));
+    if (tex == nullptr || !tex->valid())
+    {
+        std::vector<float> data;
+        data.reserve(LUT_SIZE * 3);
+        for (size_t i = 0; i < LUT_SIZE; ++i)
+        {
+            data.push_back(lut->r[i]);
+            data.push_back(lut->g[i]);
+            data.push_back(lut->b[i]);
+        }
+        tex = Texture2D::create(LUT_SIZE, 1, 1, TextureInternalFormat::RGB32F);
+        tex->setData(data.data(), TextureFormat::RGB);
+    }
+    return tex;
+}
+
+void releaseColormapTextures()
+{
+    for (std::shared_ptr<Texture2D> &tex : colormap_textures)
+    {
+        if (tex != nullptr)
+        {
+            // Meshes may still hold the texture; they are left with a released one
+            tex->release();
+            tex = nullptr;
+        }
+    }
+}
 } // namespace viewer
 
-} // namespace rcube
\ No newline at end of file
+} // namespace rcube
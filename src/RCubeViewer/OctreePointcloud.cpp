@@ -0,0 +1,257 @@
+#include "RCubeViewer/OctreePointcloud.h"
+#include "imgui.h"
+#include <algorithm>
+
+namespace rcube
+{
+namespace viewer
+{
+
+static std::shared_ptr<Mesh> nodeMesh(const std::vector<glm::vec3> &positions,
+                                      const std::vector<glm::vec3> &colors)
+{
+    std::shared_ptr<Mesh> mesh = Mesh::createPointMesh();
+    mesh->setAttributeFormat("colors", AttributeFormat::Unorm8);
+    mesh->setCPUDataPolicy(CPUDataPolicy::ReleaseAfterUpload);
+    mesh->attribute("positions")->setData(positions);
+    mesh->attribute("colors")->setData(colors);
+    mesh->uploadToGPU();
+    return mesh;
+}
+
+OctreePointcloud::OctreePointcloud(std::shared_ptr<PointOctree> octree)
+    : Mesh({AttributeBuffer::create("positions", GLuint(AttributeLocation::POSITION), 3),
+            AttributeBuffer::create("colors", GLuint(AttributeLocation::COLOR), 3)},
+           MeshPrimitive::Points, false),
+      octree_(octree)
+{
+    // The root is always drawn, so it is loaded up front into the mesh itself
+    std::vector<glm::vec3> positions, colors;
+    octree_->readNode(0, positions, colors);
+    setAttributeFormat("colors", AttributeFormat::Unorm8);
+    attributes_["positions"]->setData(positions);
+    attributes_["colors"]->setData(colors);
+    uploadToGPU();
+    resident_points_ = positions.size();
+    points_drawn_ = positions.size();
+    loader_ = std::thread(&OctreePointcloud::loadNodes, this);
+}
+
+std::shared_ptr<OctreePointcloud> OctreePointcloud::create(const std::string &directory)
+{
+    return std::shared_ptr<OctreePointcloud>(new OctreePointcloud(PointOctree::open(directory)));
+}
+
+OctreePointcloud::~OctreePointcloud()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    loader_.join();
+    for (auto &kv : resident_)
+    {
+        kv.second.mesh->release();
+    }
+}
+
+void OctreePointcloud::loadNodes()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        wake_.wait(lock, [this] { return stop_ || !requests_.empty(); });
+        if (stop_)
+        {
+            return;
+        }
+        LoadedNode result;
+        result.node = requests_.front();
+        requests_.pop_front();
+        loading_ = result.node;
+        lock.unlock();
+        bool ok = true;
+        try
+        {
+            octree_->readNode(result.node, result.positions, result.colors);
+        }
+        catch (const std::exception &)
+        {
+            ok = false;
+        }
+        lock.lock();
+        loading_ = PointOctree::NO_NODE;
+        if (ok)
+        {
+            loaded_.push_back(std::move(result));
+        }
+        else
+        {
+            failed_.insert(result.node);
+        }
+    }
+}
+
+void OctreePointcloud::uploadLoadedNodes()
+{
+    // Uploads are limited per frame to avoid stalls when many nodes arrive at once
+    std::vector<LoadedNode> nodes;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t num_points = 0;
+        while (!loaded_.empty() && (nodes.empty() || num_points < max_upload_points_))
+        {
+            num_points += loaded_.front().positions.size();
+            nodes.push_back(std::move(loaded_.front()));
+            loaded_.pop_front();
+        }
+    }
+    for (const LoadedNode &node : nodes)
+    {
+        if (resident_.count(node.node) == 0)
+        {
+            resident_[node.node] = {nodeMesh(node.positions, node.colors), frame_};
+            resident_points_ += node.positions.size();
+        }
+    }
+}
+
+void OctreePointcloud::evictNodes()
+{
+    if (resident_points_ <= point_budget_)
+    {
+        return;
+    }
+    std::vector<std::pair<uint64_t, uint32_t>> candidates;
+    for (const auto &kv : resident_)
+    {
+        if (kv.second.last_drawn != frame_)
+        {
+            candidates.push_back({kv.second.last_drawn, kv.first});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    const std::vector<PointOctree::Node> &nodes = octree_->nodes();
+    for (size_t i = 0; i < candidates.size() && resident_points_ > point_budget_; ++i)
+    {
+        auto it = resident_.find(candidates[i].second);
+        it->second.mesh->release();
+        resident_.erase(it);
+        resident_points_ -= nodes[candidates[i].second].num_points;
+    }
+}
+
+void OctreePointcloud::update(const glm::mat4 &model, const glm::mat4 &world_to_view,
+                              const glm::mat4 &view_to_projection, bool orthographic,
+                              const glm::ivec2 &viewport_size)
+{
+    ++frame_;
+    uploadLoadedNodes();
+
+    PointOctreeView view;
+    view.world_to_clip = view_to_projection * world_to_view;
+    view.model = model;
+    view.eye = glm::vec3(glm::inverse(world_to_view)[3]);
+    view.orthographic = orthographic;
+    view.pixels_per_unit = 0.5f * float(viewport_size.y) * view_to_projection[1][1];
+    const std::vector<uint32_t> selected =
+        octree_->selectNodes(view, point_budget_, min_node_pixels_);
+
+    // Parents are selected before their children, so a node is drawn if it is loaded and its
+    // parent is drawn; otherwise its parent's points stand in for it
+    const std::vector<PointOctree::Node> &nodes = octree_->nodes();
+    std::unordered_set<uint32_t> drawn = {0};
+    std::vector<uint32_t> missing;
+    children_.clear();
+    points_drawn_ = nodes[0].num_points;
+    for (uint32_t node : selected)
+    {
+        if (node == 0)
+        {
+            continue;
+        }
+        auto it = resident_.find(node);
+        if (it == resident_.end())
+        {
+            missing.push_back(node);
+        }
+        else if (drawn.count(nodes[node].parent) > 0)
+        {
+            drawn.insert(node);
+            it->second.last_drawn = frame_;
+            children_.push_back(it->second.mesh);
+            points_drawn_ += nodes[node].num_points;
+        }
+    }
+
+    // The queue is replaced so that nodes which went out of view are not loaded
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unordered_set<uint32_t> pending = {loading_};
+        for (const LoadedNode &node : loaded_)
+        {
+            pending.insert(node.node);
+        }
+        requests_.clear();
+        for (uint32_t node : missing)
+        {
+            if (pending.count(node) == 0 && failed_.count(node) == 0)
+            {
+                requests_.push_back(node);
+            }
+        }
+    }
+    wake_.notify_one();
+    evictNodes();
+}
+
+size_t OctreePointcloud::pointBudget() const
+{
+    return point_budget_;
+}
+
+void OctreePointcloud::setPointBudget(size_t budget)
+{
+    point_budget_ = budget;
+}
+
+float OctreePointcloud::minNodePixels() const
+{
+    return min_node_pixels_;
+}
+
+void OctreePointcloud::setMinNodePixels(float pixels)
+{
+    min_node_pixels_ = pixels;
+}
+
+size_t OctreePointcloud::numPointsDrawn() const
+{
+    return points_drawn_;
+}
+
+size_t OctreePointcloud::numResidentNodes() const
+{
+    return resident_.size() + 1;
+}
+
+void OctreePointcloud::drawGUI()
+{
+    Mesh::drawGUI();
+    ImGui::Separator();
+    ImGui::Text("Octree pointcloud");
+    ImGui::LabelText("#points", std::to_string(octree_->numPoints()).c_str());
+    ImGui::LabelText("#nodes", std::to_string(octree_->nodes().size()).c_str());
+    ImGui::LabelText("#points drawn", std::to_string(points_drawn_).c_str());
+    ImGui::LabelText("#resident nodes", std::to_string(numResidentNodes()).c_str());
+    int budget = static_cast<int>(point_budget_ / 100000);
+    if (ImGui::SliderInt("Point budget (x100k)", &budget, 1, 300))
+    {
+        point_budget_ = size_t(budget) * 100000;
+    }
+    ImGui::SliderFloat("Min node size (px)", &min_node_pixels_, 10.f, 1000.f);
+}
+
+} // namespace viewer
+} // namespace rcube
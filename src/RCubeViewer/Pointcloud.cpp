@@ -1,5 +1,7 @@
 #include "RCubeViewer/Pointcloud.h"
-#include "RCube/Core/Graphics/MeshGen/Points.h"
+#include "RCube/Core/Graphics/MeshGen/Box.h"
+#include "RCube/Core/Graphics/MeshGen/Plane.h"
+#include "RCube/Core/Graphics/MeshGen/Sphere.h"
 #include "RCubeViewer/MessageBox.h"
 #include "glm/gtx/string_cast.hpp"
 #include "imgui.h"
@@ -9,86 +11,56 @@ namespace rcube
 namespace viewer
 {
 
-void Pointcloud::createMesh()
+void Pointcloud::createGlyph()
 {
-    TriangleMeshData points_mesh;
+    // Glyphs have unit size and are scaled by the point size in the vertex shader
+    TriangleMeshData glyph_mesh;
     if (glyph_ == PointcloudGlyph::Sphere)
     {
-        points_mesh = pointsToSpheres(points_, 0.5f * point_size_, num_vertices_per_point_,
-                                      num_triangles_per_point_);
+        glyph_mesh = icoSphere(0.5f, 1);
     }
-    else
-    {
-        points_mesh = pointsToBoxes(points_, std::sqrt(2.f) * 0.5f * point_size_,
-                                    num_vertices_per_point_, num_triangles_per_point_);
-    }
-    size_t num_arrow_vertices, num_arrow_faces;
-    TriangleMeshData dummy_arrow = pointsVectorsToArrowsIndexed(
-        {glm::vec3(0, 0, 0)}, {glm::vec3(0, 1, 0)}, {1.f}, num_arrow_vertices, num_arrow_faces);
-    // Total number of vertices and faces for the vector field
-    num_vector_field_vertices_ = num_arrow_vertices * numPoints();
-    num_vector_field_faces_ = num_arrow_faces * numPoints();
-
-    attributes_["positions"]->data().clear();
-    indices_->data().clear();
-    attributes_["positions"]->data().resize(
-        3 * (numPoints() * verticesPerPoint() + num_vector_field_vertices_), 0.f);
-    attributes_["normals"]->data().resize(
-        3 * (numPoints() * verticesPerPoint() + num_vector_field_vertices_), 0.f);
-    attributes_["colors"]->data().resize(
-        3 * (numPoints() * verticesPerPoint() + num_vector_field_vertices_), 0.f);
-    indices_->data().resize(3 * (numPoints() * trianglesPerPoint() + num_vector_field_faces_), 0);
-
-    glm::vec3 *pos = attributes_["positions"]->ptrVec3();
-    glm::vec3 *nor = attributes_["normals"]->ptrVec3();
-    glm::vec3 *col = attributes_["colors"]->ptrVec3();
-    for (size_t i = 0; i < points_mesh.vertices.size(); ++i)
+    else if (glyph_ == PointcloudGlyph::Box)
     {
-        pos[i] = points_mesh.vertices[i];
-        nor[i] = points_mesh.normals[i];
-        col[i] = color_;
+        const float side = std::sqrt(2.f) * 0.5f;
+        glyph_mesh = box(side, side, side, 1, 1, 1);
     }
-    glm::uvec3 *ind = indices_->ptrUVec3();
-    for (size_t i = 0; i < points_mesh.indices.size(); ++i)
+    else
     {
-        ind[i] = points_mesh.indices[i];
+        glyph_mesh = plane(1.f, 1.f, 1, 1, Orientation::PositiveZ);
     }
-    uploadToGPU();
-
-    //// Make sphere primitives for BVH (this is more efficient than
-    //// the triangle mesh)
-    // std::vector<PrimitivePtr> prims;
-    // prims.reserve(points_.size());
-    // for (size_t i = 0; i < points_.size(); ++i)
-    //{
-    //    prims.push_back(std::shared_ptr<Point>(new Point(i, points_[i], 0.5f * point_size_)));
-    //}
-    // updateBVH(prims);
+    attributes_["positions"]->setData(glyph_mesh.vertices);
+    attributes_["normals"]->setData(glyph_mesh.normals);
+    indices_->setData(glyph_mesh.indices);
+    indices_->update();
+    uploadToGPU("positions");
+    uploadToGPU("normals");
+}
 
-    if (visible_scalar_field_ != "(None)")
-    {
-        scalarField(visible_scalar_field_).dirty_ = true;
-    }
-    if (visible_vector_field_ != "(None)")
-    {
-        vectorField(visible_vector_field_).dirty_ = true;
-        setPointcloudArrowAttributes(vectorField(visible_vector_field_).mesh_);
-    }
-    else
+void Pointcloud::updateInstances()
+{
+    std::vector<glm::vec4> offsets(points_.size());
+    for (size_t i = 0; i < points_.size(); ++i)
     {
-        hideAllVectorFields();
+        offsets[i] = glm::vec4(points_[i], scales_.empty() ? 1.f : scales_[i]);
     }
+    attributes_["offsets"]->setData(offsets);
+    uploadToGPU("offsets");
 }
 
 Pointcloud::Pointcloud(const std::vector<glm::vec3> &points, float point_size,
                        PointcloudGlyph glyph)
     : Mesh({AttributeBuffer::create("positions", GLuint(AttributeLocation::POSITION), 3),
             AttributeBuffer::create("normals", GLuint(AttributeLocation::NORMAL), 3),
-            AttributeBuffer::create("colors", GLuint(AttributeLocation::COLOR), 3)},
+            AttributeBuffer::create("colors", GLuint(AttributeLocation::COLOR), 3, 1),
+            AttributeBuffer::create("offsets", GLuint(AttributeLocation::INSTANCE_OFFSET), 4, 1),
+            AttributeBuffer::create("scalars", GLuint(AttributeLocation::SCALAR), 1, 1)},
            MeshPrimitive::Triangles, true),
       points_(points), point_size_(point_size), glyph_(glyph)
 {
-    createMesh();
+    glyph_params_.size = point_size_;
+    createGlyph();
+    updateInstances();
+    setPointcloudColorAttribute(color_);
 }
 
 std::shared_ptr<Pointcloud> Pointcloud::create(const std::vector<glm::vec3> &points,
@@ -98,11 +70,25 @@ std::shared_ptr<Pointcloud> Pointcloud::create(const std::vector<glm::vec3> &poi
 }
 size_t Pointcloud::verticesPerPoint() const
 {
-    return num_vertices_per_point_;
+    return numVertexData();
 }
 size_t Pointcloud::trianglesPerPoint() const
 {
-    return num_triangles_per_point_;
+    return indices_->count();
+}
+Pointcloud::PointcloudGlyph Pointcloud::glyph() const
+{
+    return glyph_;
+}
+void Pointcloud::setGlyph(PointcloudGlyph glyph)
+{
+    if (glyph == glyph_)
+    {
+        return;
+    }
+    glyph_ = glyph;
+    createGlyph();
+    attachArrows();
 }
 void Pointcloud::addScalarField(std::string name, const ScalarField &sf)
 {
@@ -129,63 +115,51 @@ void Pointcloud::showScalarField(std::string name)
     // the selected one is different from what's being displayed
     if (sf.updateColors() || visible_scalar_field_ != name)
     {
-        setPointcloudColorAttribute(sf.colors_);
+        if (sf.gpuColormapping())
+        {
+            attributes_["scalars"]->setData(sf.data_);
+            uploadToGPU("scalars");
+        }
+        else
+        {
+            setPointcloudColorAttribute(sf.colors_);
+        }
         visible_scalar_field_ = name;
     }
+    // Range and colormap changes only update the uniforms
+    colormap_params_ = sf.colormapParameters();
 }
 void Pointcloud::setPointcloudColorAttribute(const std::vector<glm::vec3> &perPointColors)
 {
     assert(perPointColors.size() == numPoints());
-    glm::vec3 *colors = attributes_["colors"]->ptrVec3();
-    size_t k = 0;
-    for (size_t i = 0; i < numPoints(); ++i)
-    {
-        for (size_t j = 0; j < verticesPerPoint(); ++j)
-        {
-            colors[k++] = perPointColors[i];
-        }
-    }
+    attributes_["colors"]->setData(perPointColors);
     uploadToGPU("colors");
 }
 void Pointcloud::setPointcloudColorAttribute(const glm::vec3 &perPointColor)
 {
-    glm::vec3 *colors = attributes_["colors"]->ptrVec3();
-    size_t k = 0;
-    for (size_t i = 0; i < numPoints(); ++i)
-    {
-        for (size_t j = 0; j < verticesPerPoint(); ++j)
-        {
-            colors[k++] = perPointColor;
-        }
-    }
+    attributes_["colors"]->setData(std::vector<glm::vec3>(numPoints(), perPointColor));
     uploadToGPU("colors");
 }
-void Pointcloud::setPointcloudArrowAttributes(const TriangleMeshData &mesh)
+void Pointcloud::attachArrows()
 {
-    glm::vec3 *positions = attributes_["positions"]->ptrVec3();
-    glm::vec3 *normals = attributes_["normals"]->ptrVec3();
-    glm::vec3 *colors = attributes_["colors"]->ptrVec3();
-    size_t k = numPoints() * num_vertices_per_point_;
-    for (size_t i = 0; i < mesh.vertices.size(); ++i)
+    // Impostor materials cannot draw regular geometry
+    if (arrows_ != nullptr && glyph_ != PointcloudGlyph::SphereImpostor)
     {
-        positions[k + i] = mesh.vertices.at(i);
-        normals[k + i] = mesh.normals.at(i);
-        colors[k + i] = mesh.colors.at(i);
+        addChild(arrows_);
     }
-    glm::uvec3 *indices = indices_->ptrUVec3();
-    k = numPoints() * num_triangles_per_point_;
-    size_t offset = numPoints() * verticesPerPoint();
-    for (size_t i = 0; i < mesh.indices.size(); ++i)
+    else
     {
-        indices[k + i] = glm::uvec3(offset, offset, offset) + mesh.indices[i];
+        removeChild(arrows_);
     }
-    uploadToGPU();
 }
 void Pointcloud::hideAllScalarFields()
 {
     if (visible_scalar_field_ != "(None)")
     {
         setPointcloudColorAttribute(color_);
+        colormap_params_ = ColormapParameters();
+        attributes_["scalars"]->setData(std::vector<float>());
+        uploadToGPU("scalars");
         visible_scalar_field_ = "(None)";
     }
 }
@@ -201,8 +175,8 @@ void Pointcloud::updatePoints(const std::vector<glm::vec3> &points, float point_
         return;
     }
     points_ = points;
-    point_size_ = point_size;
-    createMesh();
+    updateInstances();
+    setPointSize(point_size);
 }
 void Pointcloud::drawGUI()
 {
@@ -210,10 +184,10 @@ void Pointcloud::drawGUI()
     ImGui::Separator();
     ImGui::Text("Pointcloud geometry");
     ImGui::LabelText("#points", std::to_string(numPoints()).c_str());
-    if (ImGui::InputFloat("Point size", &point_size_))
+    float point_size = point_size_;
+    if (ImGui::InputFloat("Point size", &point_size))
     {
-        point_size_ = std::max(0.0001f, point_size_);
-        createMesh();
+        setPointSize(point_size);
     }
     if (ImGui::ColorEdit3("Color", glm::value_ptr(color_)))
     {
@@ -222,14 +196,17 @@ void Pointcloud::drawGUI()
     ImGui::Text("Glyph");
     if (ImGui::RadioButton("Sphere", glyph_ == PointcloudGlyph::Sphere))
     {
-        glyph_ = PointcloudGlyph::Sphere;
-        createMesh();
+        setGlyph(PointcloudGlyph::Sphere);
     }
     ImGui::SameLine();
     if (ImGui::RadioButton("Box", glyph_ == PointcloudGlyph::Box))
     {
-        glyph_ = PointcloudGlyph::Box;
-        createMesh();
+        setGlyph(PointcloudGlyph::Box);
+    }
+    ImGui::SameLine();
+    if (ImGui::RadioButton("Sphere impostor", glyph_ == PointcloudGlyph::SphereImpostor))
+    {
+        setGlyph(PointcloudGlyph::SphereImpostor);
     }
 
     // Scalar fields
@@ -262,20 +239,38 @@ void Pointcloud::drawGUI()
     if (current_sf != nullptr && current_sf != "(None)")
     {
         showScalarField(current_sf);
-        ImGui::PlotHistogram("Histogram", scalarField(current_sf).histogram_.data(),
-                             static_cast<int>(scalarField(current_sf).histogram_.size()), 0,
-                             nullptr, 0.0f, 1.0f, ImVec2(0, 80.0f));
-        if (ImGui::InputFloat("Min. value", &scalarField(current_sf).vmin_))
+        ScalarField &sf = scalarField(current_sf);
+        const std::vector<float> &histogram = sf.histogram();
+        ImGui::PlotHistogram("Histogram", histogram.data(), static_cast<int>(histogram.size()),
+                             0, nullptr, 0.0f, 1.0f, ImVec2(0, 80.0f));
+        int bins = static_cast<int>(sf.histogramBins());
+        if (ImGui::SliderInt("Bins", &bins, 1, 100))
+        {
+            sf.setHistogramBins(static_cast<size_t>(bins));
+        }
+        float vmin = sf.dataMinRange();
+        if (ImGui::InputFloat("Min. value", &vmin))
         {
-            scalarField(current_sf).dirty_ = true;
+            sf.setDataMinRange(vmin);
         }
-        if (ImGui::InputFloat("Max. value", &scalarField(current_sf).vmax_))
+        float vmax = sf.dataMaxRange();
+        if (ImGui::InputFloat("Max. value", &vmax))
         {
-            scalarField(current_sf).dirty_ = true;
+            sf.setDataMaxRange(vmax);
         }
         if (ImGui::Button("Fit data range"))
         {
-            scalarField(current_sf).fitDataRange();
+            sf.fitDataRange();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Fit 1-99%"))
+        {
+            sf.fitDataRange(1.f, 99.f);
+        }
+        bool gpu = sf.gpuColormapping();
+        if (ImGui::Checkbox("GPU colormapping", &gpu))
+        {
+            sf.setGPUColormapping(gpu);
         }
     }
     if (current_sf == "(None)")
@@ -312,14 +307,16 @@ void Pointcloud::drawGUI()
     if (current_vf != nullptr && current_vf != "(None)")
     {
         showVectorField(current_vf);
-        if (ImGui::SliderFloat("Max. length", &vectorField(current_vf).max_length_, 0.f,
-                               10.f * point_size_))
+        VectorField &vf = vectorField(current_vf);
+        float max_length = vf.maxLength();
+        if (ImGui::SliderFloat("Max. length", &max_length, 0.f, 10.f * point_size_))
         {
-            vectorField(current_vf).dirty_ = true;
+            vf.setMaxLength(max_length);
         }
-        if (ImGui::Checkbox("Scale by magnitude", &vectorField(current_vf).scale_by_magnitude_))
+        bool scale_by_magnitude = vf.scaleByMagnitude();
+        if (ImGui::Checkbox("Scale by magnitude", &scale_by_magnitude))
         {
-            vectorField(current_vf).dirty_ = true;
+            vf.setScaleByMagnitude(scale_by_magnitude);
         }
     }
     if (current_vf == "(None)")
@@ -335,6 +332,28 @@ float Pointcloud::pointSize() const
 {
     return point_size_;
 }
+void Pointcloud::setPointSize(float point_size)
+{
+    point_size_ = std::max(0.0001f, point_size);
+    glyph_params_.size = point_size_;
+}
+const std::vector<float> &Pointcloud::pointScales() const
+{
+    return scales_;
+}
+void Pointcloud::setPointScales(const std::vector<float> &scales)
+{
+    bool ok = scales.empty() || (scales.size() == numPoints());
+    if (!ok)
+    {
+        messageBoxError("Error", "Number of scales passed in Pointcloud::setPointScales has to be " +
+                                     std::to_string(numPoints()) + " but got " +
+                                     std::to_string(scales.size()));
+        return;
+    }
+    scales_ = scales;
+    updateInstances();
+}
 glm::vec3 Pointcloud::color() const
 {
     return color_;
@@ -354,8 +373,11 @@ void Pointcloud::addVectorField(std::string name, const VectorField &vf)
 }
 void Pointcloud::removeVectorField(std::string name)
 {
+    if (visible_vector_field_ == name)
+    {
+        hideAllVectorFields();
+    }
     vector_fields_.erase(name);
-    visible_vector_field_ = "(None)";
 }
 const VectorField &Pointcloud::vectorField(std::string name) const
 {
@@ -368,10 +390,12 @@ VectorField &Pointcloud::vectorField(std::string name)
 void Pointcloud::showVectorField(std::string name)
 {
     VectorField &vf = vectorField(name);
-    bool update = vf.updateArrows();
-    if (update || visible_vector_field_ != name)
+    vf.updateArrows();
+    if (visible_vector_field_ != name)
     {
-        setPointcloudArrowAttributes(vf.mesh_);
+        removeChild(arrows_);
+        arrows_ = vf.mesh();
+        attachArrows();
         visible_vector_field_ = name;
     }
 }
@@ -379,18 +403,8 @@ void rcube::viewer::Pointcloud::hideAllVectorFields()
 {
     if (visible_vector_field_ != "(None)")
     {
-        size_t voffset = numPoints() * verticesPerPoint() * 3;
-        std::fill(attributes_["positions"]->data().begin() + voffset,
-                  attributes_["positions"]->data().end(), 0.f);
-        std::fill(attributes_["normals"]->data().begin() + voffset,
-                  attributes_["normals"]->data().end(), 0.f);
-        std::fill(attributes_["colors"]->data().begin() + voffset,
-                  attributes_["colors"]->data().end(), 0.f);
-        std::fill(attributes_["colors"]->data().begin() + voffset,
-                  attributes_["colors"]->data().end(), 0.f);
-        size_t foffset = numPoints() * trianglesPerPoint() * 3;
-        std::fill(indices_->data().begin() + foffset, indices_->data().end(), 0);
-        uploadToGPU();
+        removeChild(arrows_);
+        arrows_ = nullptr;
         visible_vector_field_ = "(None)";
     }
 }
@@ -3,10 +3,15 @@
 #include "RCube/Core/Graphics/ImageBasedLighting/IBLDiffuse.h"
 #include "RCube/Core/Graphics/ImageBasedLighting/IBLSpecularSplitSum.h"
 #include "RCube/Core/Graphics/MeshGen/Plane.h"
+#include "RCube/Core/Graphics/OpenGL/GeometryArena.h"
+#include "RCube/Core/Graphics/OpenGL/UniformBufferArena.h"
 #include "RCube/Core/Graphics/TexGen/CheckerBoard.h"
 #include "RCube/Core/Graphics/TexGen/Gradient.h"
+#include "RCube/Materials/PointSplatMaterial.h"
 #include "RCube/Systems/DeferredRenderSystem.h"
+#include "RCubeViewer/Colormap.h"
 #include "RCubeViewer/Components/Name.h"
+#include "RCubeViewer/OctreePointcloud.h"
 #include "glm/gtx/euler_angles.hpp"
 #include "glm/gtx/string_cast.hpp"
 #include "imgui.h"
@@ -54,7 +59,12 @@ RCubeViewer::RCubeViewer(RCubeViewerProps props)
     }
     else
     {
-        world_.addSystem(std::make_unique<ForwardRenderSystem>(props.resolution, props.MSAA));
+        auto forward = std::make_unique<ForwardRenderSystem>(props.resolution, props.MSAA);
+        if (props.half_float_transparency)
+        {
+            forward->setTransparencyAccumFormat(TextureInternalFormat::RGBA16F);
+        }
+        world_.addSystem(std::move(forward));
     }
 
     // Create a default camera
@@ -133,6 +143,40 @@ EntityHandle RCubeViewer::addMeshEntity(const std::string &name)
     return ent;
 }
 
+EntityHandle RCubeViewer::addOctreePointcloud(const std::string &name,
+                                              const std::string &directory)
+{
+    EntityHandle ent = addMeshEntity(name);
+    ent.get<Drawable>()->mesh = OctreePointcloud::create(directory);
+    // Shadow maps are rendered without point sizes
+    ent.get<Drawable>()->cast_shadow = false;
+    if (ent.has<ForwardMaterial>())
+    {
+        ent.get<ForwardMaterial>()->shader = std::make_shared<PointSplatMaterial>();
+    }
+    return ent;
+}
+
+void RCubeViewer::updateOctreePointclouds()
+{
+    Camera *cam = camera_.get<Camera>();
+    auto it = world_.entities();
+    while (it.hasNext())
+    {
+        EntityHandle ent = it.next();
+        if (!ent.has<Drawable>() || !ent.has<Transform>())
+        {
+            continue;
+        }
+        auto pc = std::dynamic_pointer_cast<OctreePointcloud>(ent.get<Drawable>()->mesh);
+        if (pc != nullptr && ent.get<Drawable>()->visible)
+        {
+            pc->update(ent.get<Transform>()->worldTransform(), cam->worldToView(),
+                       cam->viewToProjection(), cam->orthographic, cam->viewport_size);
+        }
+    }
+}
+
 EntityHandle RCubeViewer::addPointLight(const std::string name, glm::vec3 position, float radius,
                                         glm::vec3 color)
 {
@@ -269,6 +313,7 @@ void RCubeViewer::draw()
         // Create GUI
         drawGUI();
 
+        updateOctreePointclouds();
         world_.update();
         last_time_ = now;
         current_fps_ = 1.0 / delta_time;
@@ -596,6 +641,9 @@ void RCubeViewer::onResize(int w, int h)
 void RCubeViewer::beforeTerminate()
 {
     world_.cleanup();
+    releaseColormapTextures();
+    UniformBufferArena::instance().release();
+    GeometryArena::releaseAll();
     // Destroy ImGui
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -768,8 +816,9 @@ AABB RCubeViewer::worldBoundingBox()
             }
             Transform *tr = ent.get<Transform>();
             const glm::mat4 model2world = tr->worldTransform();
-            auto positions = dr->mesh->attribute("positions")->ptrVec3();
-            size_t num_vertices = dr->mesh->attribute("positions")->count();
+            const AttributeBuffer &attr = *dr->mesh->attribute("positions");
+            const glm::vec3 *positions = attr.ptrVec3();
+            size_t num_vertices = attr.count();
             for (size_t i = 0; i < num_vertices; ++i)
             {
                 glm::vec3 world_pos = glm::vec3(model2world * glm::vec4(positions[i], 1.f));
@@ -1,7 +1,11 @@
 #include "RCubeViewer/ScalarField.h"
-#include "RCube/Core/Graphics/MeshGen/Points.h"
+#include "RCube/Helpers/ParallelChunks.h"
 #include "RCubeViewer/Colormap.h"
 #include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -9,6 +13,9 @@ namespace rcube
 {
 namespace viewer
 {
+// Below this many values per thread, spawning threads costs more than it saves
+constexpr size_t MIN_VALUES_PER_THREAD = size_t(1) << 16;
+
 const std::vector<float> &ScalarField::data() const
 {
     return data_;
@@ -16,14 +23,64 @@ const std::vector<float> &ScalarField::data() const
 std::vector<float> &ScalarField::data()
 {
     dirty_ = true;
+    stats_dirty_ = true;
     return data_;
 }
 void ScalarField::setData(const std::vector<float> &data)
 {
     data_ = data;
-    updateHistogram();
+    updateStatistics();
     dirty_ = true;
 }
+void ScalarField::setData(size_t offset, const std::vector<float> &values)
+{
+    if (offset + values.size() > data_.size())
+    {
+        throw std::out_of_range("Cannot set " + std::to_string(values.size()) +
+                                " values at offset " + std::to_string(offset) +
+                                " of a scalar field with " + std::to_string(data_.size()) +
+                                " values");
+    }
+    dirty_ = true;
+    // The statistics can be updated incrementally as long as the histogram range does not change:
+    // no new value may fall outside it and no replaced value may be an extremum
+    bool incremental = !stats_dirty_ && stats_.count > 0;
+    for (size_t i = 0; i < values.size() && incremental; ++i)
+    {
+        const float old_value = data_[offset + i];
+        const float new_value = values[i];
+        incremental = !(std::isfinite(old_value) &&
+                        (old_value <= stats_.min || old_value >= stats_.max)) &&
+                      !(std::isfinite(new_value) &&
+                        (new_value < stats_.min || new_value > stats_.max));
+    }
+    if (!incremental)
+    {
+        std::copy(values.begin(), values.end(), data_.begin() + offset);
+        updateStatistics();
+        return;
+    }
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        float &value = data_[offset + i];
+        if (std::isfinite(value))
+        {
+            sum_ -= value;
+            sum_sq_ -= double(value) * double(value);
+            --stats_.count;
+            --bin_counts_[bin(value)];
+        }
+        value = values[i];
+        if (std::isfinite(value))
+        {
+            sum_ += value;
+            sum_sq_ += double(value) * double(value);
+            ++stats_.count;
+            ++bin_counts_[bin(value)];
+        }
+    }
+    finalizeStatistics();
+}
 float ScalarField::dataMinRange() const
 {
     return vmin_;
@@ -31,7 +88,7 @@ float ScalarField::dataMinRange() const
 void ScalarField::setDataMinRange(float val)
 {
     vmin_ = val;
-    dirty_ = true;
+    dirty_ = dirty_ || !gpu_colormap_;
 }
 float ScalarField::dataMaxRange() const
 {
@@ -40,14 +97,64 @@ float ScalarField::dataMaxRange() const
 void ScalarField::setDataMaxRange(float val)
 {
     vmax_ = val;
-    dirty_ = true;
+    dirty_ = dirty_ || !gpu_colormap_;
 }
 void ScalarField::fitDataRange()
 {
-    auto minmax = std::minmax_element(std::begin(data_), std::end(data_));
-    vmin_ = *minmax.first;
-    vmax_ = *minmax.second;
-    dirty_ = true;
+    const ScalarFieldStatistics &stats = statistics();
+    vmin_ = stats.min;
+    vmax_ = stats.max;
+    dirty_ = dirty_ || !gpu_colormap_;
+}
+void ScalarField::fitDataRange(float lower_percentile, float upper_percentile)
+{
+    vmin_ = percentile(lower_percentile);
+    vmax_ = std::max(vmin_, percentile(upper_percentile));
+    dirty_ = dirty_ || !gpu_colormap_;
+}
+float ScalarField::percentile(float percentile) const
+{
+    std::vector<float> values;
+    values.reserve(data_.size());
+    std::copy_if(data_.begin(), data_.end(), std::back_inserter(values),
+                 [](float v) { return std::isfinite(v); });
+    if (values.empty())
+    {
+        return 0.f;
+    }
+    const float p = std::clamp(percentile, 0.f, 100.f) / 100.f;
+    const size_t k = static_cast<size_t>(std::round(p * float(values.size() - 1)));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+const ScalarFieldStatistics &ScalarField::statistics()
+{
+    if (stats_dirty_)
+    {
+        updateStatistics();
+    }
+    return stats_;
+}
+const std::vector<float> &ScalarField::histogram()
+{
+    if (stats_dirty_)
+    {
+        updateStatistics();
+    }
+    return histogram_;
+}
+size_t ScalarField::histogramBins() const
+{
+    return bins_;
+}
+void ScalarField::setHistogramBins(size_t bins)
+{
+    bins_ = std::max(size_t(1), bins);
+    if (!stats_dirty_)
+    {
+        computeHistogram();
+        finalizeStatistics();
+    }
 }
 Colormap ScalarField::cmap() const
 {
@@ -56,54 +163,160 @@ Colormap ScalarField::cmap() const
 void ScalarField::setCmap(Colormap cmap)
 {
     cmap_ = cmap;
-    dirty_ = true;
+    dirty_ = dirty_ || !gpu_colormap_;
+}
+bool ScalarField::gpuColormapping() const
+{
+    return gpu_colormap_;
+}
+void ScalarField::setGPUColormapping(bool flag)
+{
+    if (flag != gpu_colormap_)
+    {
+        gpu_colormap_ = flag;
+        dirty_ = true;
+    }
+}
+ColormapParameters ScalarField::colormapParameters() const
+{
+    ColormapParameters params;
+    if (gpu_colormap_)
+    {
+        params.lut = colormapTexture(cmap_);
+        params.vmin = vmin_;
+        params.vmax = vmax_;
+    }
+    return params;
 }
 bool ScalarField::updateColors()
 {
+    if (stats_dirty_)
+    {
+        updateStatistics();
+    }
     if (dirty_)
     {
-        colormap(cmap_, data_, vmin_, vmax_, colors_);
+        // The shader applies the colormap to the uploaded data
+        if (!gpu_colormap_)
+        {
+            colormap(cmap_, data_, vmin_, vmax_, colors_);
+        }
         dirty_ = false;
         return true;
     }
     return false;
 }
 
-void ScalarField::updateHistogram()
+size_t ScalarField::bin(float value) const
 {
-    auto minmax = std::minmax_element(std::begin(data_), std::end(data_));
-    float vmin = *minmax.first;
-    float vmax = *minmax.second;
-    const size_t bins = 10;
-    float step = (vmax - vmin) / float(bins);
-    std::vector<std::pair<float, float>> bin_ranges;
-    for (size_t i = 0; i < bins; ++i)
+    const float range = stats_.max - stats_.min;
+    if (range <= 0.f)
     {
-        bin_ranges.push_back({vmin + step * float(i), vmin + step * float(i + 1)});
+        return 0;
     }
-    histogram_.resize(bins, 0.f);
-    float sum = 0.f;
-    for (float val : data_)
+    const size_t b = static_cast<size_t>((value - stats_.min) / range * float(bins_));
+    return std::min(b, bins_ - 1);
+}
+
+void ScalarField::updateStatistics()
+{
+    // Pass 1: min., max. and sums of the finite values, reduced over chunks of the data
+    struct Partial
     {
-        for (size_t ii = 0; ii < bin_ranges.size(); ++ii)
-        {
-            const auto &bin_range = bin_ranges[ii];
-            if (val >= bin_range.first && val < bin_range.second)
-            {
-                histogram_[ii] += 1.f;
-                sum += 1.f;
-                break;
-            }
-        }
+        float min = std::numeric_limits<float>::max();
+        float max = std::numeric_limits<float>::lowest();
+        double sum = 0.0;
+        double sum_sq = 0.0;
+        size_t count = 0;
+    };
+    std::vector<Partial> partials(numParallelChunks(data_.size(), MIN_VALUES_PER_THREAD));
+    parallelChunks(data_.size(), MIN_VALUES_PER_THREAD,
+                   [&](size_t chunk, size_t begin, size_t end) {
+                       Partial p;
+                       for (size_t i = begin; i < end; ++i)
+                       {
+                           const float v = data_[i];
+                           if (!std::isfinite(v))
+                           {
+                               continue;
+                           }
+                           p.min = std::min(p.min, v);
+                           p.max = std::max(p.max, v);
+                           p.sum += v;
+                           p.sum_sq += double(v) * double(v);
+                           ++p.count;
+                       }
+                       partials[chunk] = p;
+                   });
+    Partial total;
+    for (const Partial &p : partials)
+    {
+        total.min = std::min(total.min, p.min);
+        total.max = std::max(total.max, p.max);
+        total.sum += p.sum;
+        total.sum_sq += p.sum_sq;
+        total.count += p.count;
     }
-    if (sum > 0.f)
+    stats_ = ScalarFieldStatistics();
+    if (total.count > 0)
+    {
+        stats_.min = total.min;
+        stats_.max = total.max;
+    }
+    stats_.count = total.count;
+    sum_ = total.sum;
+    sum_sq_ = total.sum_sq;
+    // Pass 2: histogram over [min, max]
+    computeHistogram();
+    finalizeStatistics();
+    stats_dirty_ = false;
+}
+
+void ScalarField::computeHistogram()
+{
+    // Each chunk counts into its own bins, which are summed afterwards
+    const size_t num_chunks = numParallelChunks(data_.size(), MIN_VALUES_PER_THREAD);
+    std::vector<size_t> counts(num_chunks * bins_, 0);
+    parallelChunks(data_.size(), MIN_VALUES_PER_THREAD,
+                   [&](size_t chunk, size_t begin, size_t end) {
+                       size_t *chunk_counts = counts.data() + chunk * bins_;
+                       for (size_t i = begin; i < end; ++i)
+                       {
+                           if (std::isfinite(data_[i]))
+                           {
+                               ++chunk_counts[bin(data_[i])];
+                           }
+                       }
+                   });
+    bin_counts_.assign(bins_, 0);
+    for (size_t chunk = 0; chunk < num_chunks; ++chunk)
     {
-        for (float &val : histogram_)
+        for (size_t b = 0; b < bins_; ++b)
         {
-            val /= sum;
+            bin_counts_[b] += counts[chunk * bins_ + b];
         }
     }
 }
 
+void ScalarField::finalizeStatistics()
+{
+    if (stats_.count > 0)
+    {
+        const double n = double(stats_.count);
+        stats_.mean = sum_ / n;
+        stats_.variance = std::max(0.0, sum_sq_ / n - stats_.mean * stats_.mean);
+    }
+    else
+    {
+        stats_.mean = 0.0;
+        stats_.variance = 0.0;
+    }
+    histogram_.assign(bins_, 0.f);
+    for (size_t b = 0; b < bins_; ++b)
+    {
+        histogram_[b] = stats_.count > 0 ? float(bin_counts_[b]) / float(stats_.count) : 0.f;
+    }
+}
+
 } // namespace viewer
-} // namespace rcube
\ No newline at end of file
+} // namespace rcube
@@ -1,5 +1,4 @@
 #include "RCubeViewer/SurfaceMesh.h"
-#include "RCube/Core/Graphics/MeshGen/Points.h"
 #include "imgui.h"
 
 namespace rcube
@@ -16,62 +15,21 @@ void SurfaceMesh::createMesh(const TriangleMeshData &data)
     {
         face_centers_.push_back((vertices_[f[0]] + vertices_[f[1]] + vertices_[f[2]]) / 3.f);
     }
-    // These are the vertices actually used for displaying the mesh
-    // Each vertex in a face is duplicated to support per-face scalar
-    // fields.
-    vertices_display_.clear();
-    vertices_display_.reserve(data.indices.size() * 3);
-    for (const glm::uvec3 &f : data.indices)
-    {
-        vertices_display_.push_back(vertices_[f[0]]);
-        vertices_display_.push_back(vertices_[f[1]]);
-        vertices_display_.push_back(vertices_[f[2]]);
-    }
-    // The mesh attributes are setup such that the vertices of the surface come first,
-    // followed by the vertices of the vertex vector field, followed by the vertices
-    // of the face vector field
-    // First, find the number of vertices needed for the arrow meshes
-    size_t num_arrow_vertices;
-    TriangleMeshData dummy_arrow = pointsVectorsToArrows({glm::vec3(0, 0, 0)}, {glm::vec3(0, 1, 0)},
-                                                         {1.f}, num_arrow_vertices);
-    // Total number of vertices for the vertex vector field is num_arrow_vertices multiplied
-    // by number of vertices
-    num_vertex_vector_field_vertices_ = num_arrow_vertices * numVertices();
-    // Similarly, number of vertices for face vector field is num_arrow_vertices multiplied
-    // by number of faces
-    num_face_vector_field_vertices_ = num_arrow_vertices * numFaces();
-
-    attributes_["positions"]->data().resize(3 * (numVerticesDisplay() +
-                                                 num_vertex_vector_field_vertices_ +
-                                                 num_face_vector_field_vertices_),
-                                            0.f);
-    attributes_["normals"]->data().resize(3 * (numVerticesDisplay() +
-                                               num_vertex_vector_field_vertices_ +
-                                               num_face_vector_field_vertices_),
-                                          0.f);
-    attributes_["colors"]->data().resize(3 * (numVerticesDisplay() +
-                                              num_vertex_vector_field_vertices_ +
-                                              num_face_vector_field_vertices_),
-                                         0.f);
-    attributes_["wires"]->data().resize(numVerticesDisplay() + num_vertex_vector_field_vertices_ +
-                                            num_face_vector_field_vertices_,
-                                        0.f);
-    std::fill(attributes_["wires"]->data().begin(),
-              attributes_["wires"]->data().begin() + numVerticesDisplay(), 1.f);
-    glm::vec3 *pos = attributes_["positions"]->ptrVec3();
-    glm::vec3 *nor = attributes_["normals"]->ptrVec3();
-    glm::vec3 *col = attributes_["colors"]->ptrVec3();
-    size_t k = 0;
-    for (const glm::uvec3 &ind : data.indices)
+    // Each vertex is stored once; per-face colors, scalars and wireframe flags are read by the
+    // geometry shader from the face data buffer using the primitive ID. Vector fields are drawn
+    // as separate instanced child meshes.
+    attributes_["positions"]->setData(data.vertices);
+    attributes_["normals"]->setData(data.normals);
+    attributes_["colors"]->setData(std::vector<glm::vec3>(numVertices(), color_));
+    indices_->setData(data.indices);
+    face_values_.assign(2 * numFaces(), glm::vec4(0.f));
+    for (size_t i = 0; i < numFaces(); ++i)
     {
-        for (auto j = 0; j < 3; ++j)
-        {
-            pos[k] = data.vertices.at(static_cast<size_t>(ind[j]));
-            nor[k] = data.normals.at(static_cast<size_t>(ind[j]));
-            col[k] = color_;
-            ++k;
-        }
+        face_values_[2 * i] = glm::vec4(color_, 0.f);
+        face_values_[2 * i + 1].x = 1.f;
     }
+    face_data_.wires = true;
+    uploadFaceData();
     /*std::vector<PrimitivePtr> prims;
     prims.reserve(data.indices.size());
     for (size_t i = 0; i < data.indices.size(); ++i)
@@ -88,8 +46,8 @@ SurfaceMesh::SurfaceMesh(const TriangleMeshData &data)
     : Mesh({AttributeBuffer::create("positions", GLuint(AttributeLocation::POSITION), 3),
             AttributeBuffer::create("normals", GLuint(AttributeLocation::NORMAL), 3),
             AttributeBuffer::create("colors", GLuint(AttributeLocation::COLOR), 3),
-            AttributeBuffer::create("wires", GLuint(5), 1)},
-           MeshPrimitive::Triangles, false)
+            AttributeBuffer::create("scalars", GLuint(AttributeLocation::SCALAR), 1)},
+           MeshPrimitive::Triangles, true)
 {
     createMesh(data);
 }
@@ -99,45 +57,51 @@ std::shared_ptr<SurfaceMesh> SurfaceMesh::create(const TriangleMeshData &data)
     return std::shared_ptr<SurfaceMesh>(new SurfaceMesh(data));
 }
 
-void SurfaceMesh::setVertexColorAttribute(const std::vector<glm::vec3> &vertex_colors)
+void SurfaceMesh::uploadFaceData()
 {
-    assert(vertex_colors.size() == numVertices());
-    glm::vec3 *colors = attributes_["colors"]->ptrVec3();
-    size_t k = 0;
-    for (const glm::uvec3 &ind : faces_)
+    const size_t bytes = face_values_.size() * sizeof(glm::vec4);
+    if (face_data_.buffer == nullptr || face_data_.buffer->size() != bytes)
+    {
+        face_data_.buffer = ShaderStorageBuffer::create(bytes);
+    }
+    if (bytes > 0)
     {
-        colors[k++] = vertex_colors[ind[0]];
-        colors[k++] = vertex_colors[ind[1]];
-        colors[k++] = vertex_colors[ind[2]];
+        face_data_.buffer->setData(face_values_.data(), bytes, 0);
     }
+}
+
+void SurfaceMesh::setFaceWireFlag(size_t index, float flag)
+{
+    glm::vec4 &wire = face_values_[2 * index + 1];
+    wire.x = flag;
+    // Only the changed face is uploaded
+    face_data_.buffer->setData(&wire, sizeof(glm::vec4), (2 * index + 1) * sizeof(glm::vec4));
+}
+
+void SurfaceMesh::setVertexColorAttribute(const std::vector<glm::vec3> &vertex_colors)
+{
+    assert(vertex_colors.size() == numVertices());
+    attributes_["colors"]->setData(vertex_colors);
     uploadToGPU("colors");
+    face_data_.colors = false;
+    face_data_.scalars = false;
 }
 
 void SurfaceMesh::setVertexColorAttribute(const glm::vec3 &vertex_color)
 {
-    glm::vec3 *colors = attributes_["colors"]->ptrVec3();
-    size_t k = 0;
-    for (size_t i = 0; i < faces_.size(); ++i)
-    {
-        colors[k++] = vertex_color;
-        colors[k++] = vertex_color;
-        colors[k++] = vertex_color;
-    }
-    uploadToGPU("colors");
+    setVertexColorAttribute(std::vector<glm::vec3>(numVertices(), vertex_color));
 }
 
 void SurfaceMesh::setFaceColorAttribute(const std::vector<glm::vec3> &per_face_colors)
 {
     assert(per_face_colors.size() == numFaces());
-    glm::vec3 *colors = attributes_["colors"]->ptrVec3();
-    size_t k = 0;
-    for (const glm::vec3 &face_color : per_face_colors)
+    for (size_t i = 0; i < per_face_colors.size(); ++i)
     {
-        colors[k++] = face_color;
-        colors[k++] = face_color;
-        colors[k++] = face_color;
+        face_values_[2 * i] = glm::vec4(per_face_colors[i], face_values_[2 * i].w);
     }
-    uploadToGPU("colors");
+    uploadFaceData();
+    face_data_.colors = true;
+    face_data_.scalars = false;
 }
 
 void SurfaceMesh::setFaceColorAttribute(const glm::vec3 &face_color)
@@ -145,6 +109,27 @@ void SurfaceMesh::setFaceColorAttribute(const glm::vec3 &face_color)
     setVertexColorAttribute(face_color);
 }
 
+void SurfaceMesh::setVertexScalarAttribute(const std::vector<float> &vertex_scalars)
+{
+    assert(vertex_scalars.size() == numVertices());
+    attributes_["scalars"]->setData(vertex_scalars);
+    uploadToGPU("scalars");
+    face_data_.colors = false;
+    face_data_.scalars = false;
+}
+
+void SurfaceMesh::setFaceScalarAttribute(const std::vector<float> &face_scalars)
+{
+    assert(face_scalars.size() == numFaces());
+    for (size_t i = 0; i < face_scalars.size(); ++i)
+    {
+        face_values_[2 * i].w = face_scalars[i];
+    }
+    uploadFaceData();
+    face_data_.colors = false;
+    face_data_.scalars = true;
+}
+
 size_t SurfaceMesh::numVertices() const
 {
     return vertices_.size();
@@ -163,12 +148,8 @@ size_t SurfaceMesh::highlightedPrimitive() const
 void SurfaceMesh::selectFace(size_t index)
 {
     selected_faces_.insert(index);
-    float *wires_highlight = attributes_["wires"]->ptr();
     // Select the current face
-    wires_highlight[index * 3 + 0] = 3.f;
-    wires_highlight[index * 3 + 1] = 3.f;
-    wires_highlight[index * 3 + 2] = 3.f;
-    uploadToGPU("wires");
+    setFaceWireFlag(index, 3.f);
 }
 
 void SurfaceMesh::unselect()
@@ -179,15 +160,12 @@ void SurfaceMesh::unselect()
         return;
     }
     // Clear all selections
-    float *wires_highlight = attributes_["wires"]->ptr();
     for (size_t index : selected_faces_)
     {
-        wires_highlight[index * 3 + 0] = 1.f;
-        wires_highlight[index * 3 + 1] = 1.f;
-        wires_highlight[index * 3 + 2] = 1.f;
+        face_values_[2 * index + 1].x = 1.f;
     }
     selected_faces_.clear();
-    uploadToGPU("wires");
+    uploadFaceData();
 }
 
 const std::unordered_set<size_t> &SurfaceMesh::selectedFaces() const
@@ -212,7 +190,6 @@ void SurfaceMesh::highlightFace(size_t index)
     {
         return;
     }
-    float *wires_highlight = attributes_["wires"]->ptr();
     // Unhighlight the previously highlighted primitive
     if (highlighted_)
     {
@@ -223,18 +200,13 @@ void SurfaceMesh::highlightFace(size_t index)
         {
             value = 3.f;
         }
-        wires_highlight[highlighted_primitive_ * 3 + 0] = value;
-        wires_highlight[highlighted_primitive_ * 3 + 1] = value;
-        wires_highlight[highlighted_primitive_ * 3 + 2] = value;
+        setFaceWireFlag(highlighted_primitive_, value);
     }
     // Highlight the current face
-    wires_highlight[index * 3 + 0] = 2.f;
-    wires_highlight[index * 3 + 1] = 2.f;
-    wires_highlight[index * 3 + 2] = 2.f;
+    setFaceWireFlag(index, 2.f);
     highlighted_ = true;
     highlighted_primitive_ = index;
     highlighted_primitive_is_face_ = true;
-    uploadToGPU("wires");
 }
 
 void SurfaceMesh::unhighlight()
@@ -248,11 +220,7 @@ void SurfaceMesh::unhighlight()
     if (highlighted_primitive_is_face_ &&
         selected_faces_.find(highlighted_primitive_) == selected_faces_.end())
     {
-        float *wires_highlight = attributes_["wires"]->ptr();
-        wires_highlight[highlighted_primitive_ * 3 + 0] = 1.f;
-        wires_highlight[highlighted_primitive_ * 3 + 1] = 1.f;
-        wires_highlight[highlighted_primitive_ * 3 + 2] = 1.f;
-        uploadToGPU("wires");
+        setFaceWireFlag(highlighted_primitive_, 1.f);
     }
     highlighted_ = false;
 }
@@ -308,10 +276,19 @@ void SurfaceMesh::showFaceScalarField(std::string name)
     // the selected one is different from what's being displayed
     if (sf.updateColors() || visible_face_scalar_field_ != name)
     {
-        setFaceColorAttribute(sf.colors_);
+        if (sf.gpuColormapping())
+        {
+            setFaceScalarAttribute(sf.data_);
+        }
+        else
+        {
+            setFaceColorAttribute(sf.colors_);
+        }
         visible_face_scalar_field_ = name;
         visible_vertex_scalar_field_ = "(None)";
     }
+    // Range and colormap changes only update the uniforms
+    colormap_params_ = sf.colormapParameters();
 }
 
 bool SurfaceMesh::hasFaceScalarField(std::string name)
@@ -341,10 +318,19 @@ void SurfaceMesh::showVertexScalarField(std::string name)
     // the selected one is different from what's being displayed
     if (sf.updateColors() || visible_vertex_scalar_field_ != name)
     {
-        setVertexColorAttribute(sf.colors_);
+        if (sf.gpuColormapping())
+        {
+            setVertexScalarAttribute(sf.data_);
+        }
+        else
+        {
+            setVertexColorAttribute(sf.colors_);
+        }
         visible_vertex_scalar_field_ = name;
         visible_face_scalar_field_ = "(None)";
     }
+    // Range and colormap changes only update the uniforms
+    colormap_params_ = sf.colormapParameters();
 }
 
 bool SurfaceMesh::hasVertexScalarField(std::string name) const
@@ -359,6 +345,9 @@ void SurfaceMesh::hideAllScalarFields()
         return;
     }
     setVertexColorAttribute(color_);
+    colormap_params_ = ColormapParameters();
+    attributes_["scalars"]->setData(std::vector<float>());
+    uploadToGPU("scalars");
     visible_vertex_scalar_field_ = "(None)";
     visible_face_scalar_field_ = "(None)";
 }
@@ -378,6 +367,10 @@ void SurfaceMesh::addVertexVectorField(std::string name)
 
 void SurfaceMesh::removeVertexVectorField(std::string name)
 {
+    if (visible_vertex_vector_field_ == name)
+    {
+        hideAllVertexVectorFields();
+    }
     vertex_vector_fields_.erase(name);
 }
 
@@ -396,6 +389,10 @@ void SurfaceMesh::addFaceVectorField(std::string name)
 
 void SurfaceMesh::removeFaceVectorField(std::string name)
 {
+    if (visible_face_vector_field_ == name)
+    {
+        hideAllFaceVectorFields();
+    }
     face_vector_fields_.erase(name);
 }
 
@@ -419,51 +416,16 @@ VectorField &SurfaceMesh::faceVectorField(std::string name)
     return face_vector_fields_.at(name);
 }
 
-void SurfaceMesh::setFaceArrowMesh(const TriangleMeshData &mesh)
-{
-    size_t voffset = numVerticesDisplay() + num_vertex_vector_field_vertices_;
-    glm::vec3 *pos = attributes_["positions"]->ptrVec3();
-    glm::vec3 *nor = attributes_["normals"]->ptrVec3();
-    glm::vec3 *col = attributes_["colors"]->ptrVec3();
-    for (size_t i = 0; i < mesh.vertices.size(); ++i)
-    {
-        const size_t k = voffset + i;
-        pos[k] = mesh.vertices.at(i);
-        nor[k] = mesh.normals.at(i);
-        col[k] = mesh.colors.at(i);
-    }
-    uploadToGPU();
-}
-
-size_t SurfaceMesh::numVerticesDisplay() const
-{
-    return faces_.size() * 3;
-}
-
-void SurfaceMesh::setVertexArrowMesh(const TriangleMeshData &mesh)
-{
-    size_t voffset = numVerticesDisplay();
-    glm::vec3 *pos = attributes_["positions"]->ptrVec3();
-    glm::vec3 *nor = attributes_["normals"]->ptrVec3();
-    glm::vec3 *col = attributes_["colors"]->ptrVec3();
-    for (size_t i = 0; i < mesh.vertices.size(); ++i)
-    {
-        const size_t k = voffset + i;
-        pos[k] = mesh.vertices.at(i);
-        nor[k] = mesh.normals.at(i);
-        col[k] = mesh.colors.at(i);
-    }
-    uploadToGPU();
-}
-
 void SurfaceMesh::showVertexVectorField(std::string name)
 {
     try
     {
         VectorField &vf = vertexVectorField(name);
-        if (vf.updateArrows() || visible_vertex_vector_field_ != name)
+        vf.updateArrows();
+        if (visible_vertex_vector_field_ != name)
         {
-            setVertexArrowMesh(vf.mesh_);
+            hideAllVertexVectorFields();
+            addChild(vf.mesh());
             visible_vertex_vector_field_ = name;
         }
     }
@@ -481,9 +443,11 @@ bool SurfaceMesh::hasVertexVectorField(std::string name) const
 void SurfaceMesh::showFaceVectorField(std::string name)
 {
     VectorField &vf = faceVectorField(name);
-    if (vf.updateArrows() || visible_face_vector_field_ != name)
+    vf.updateArrows();
+    if (visible_face_vector_field_ != name)
     {
-        setFaceArrowMesh(vf.mesh_);
+        hideAllFaceVectorFields();
+        addChild(vf.mesh());
         visible_face_vector_field_ = name;
     }
 }
@@ -497,20 +461,7 @@ void SurfaceMesh::hideAllVertexVectorFields()
 {
     if (visible_vertex_vector_field_ != "(None)")
     {
-        size_t voffset = numVerticesDisplay() * 3;
-        std::fill(attributes_["positions"]->data().begin() + voffset,
-                  attributes_["positions"]->data().begin() + voffset +
-                      num_vertex_vector_field_vertices_ * 3,
-                  0.f);
-        std::fill(attributes_["normals"]->data().begin() + voffset,
-                  attributes_["normals"]->data().begin() + voffset +
-                      num_vertex_vector_field_vertices_ * 3,
-                  0.f);
-        std::fill(attributes_["colors"]->data().begin() + voffset,
-                  attributes_["colors"]->data().begin() + voffset +
-                      num_vertex_vector_field_vertices_ * 3,
-                  0.f);
-        uploadToGPU();
+        removeChild(vertexVectorField(visible_vertex_vector_field_).mesh());
         visible_vertex_vector_field_ = "(None)";
     }
 }
@@ -519,14 +470,7 @@ void SurfaceMesh::hideAllFaceVectorFields()
 {
     if (visible_face_vector_field_ != "(None)")
     {
-        size_t voffset = (numVerticesDisplay() + num_vertex_vector_field_vertices_) * 3;
-        std::fill(attributes_["positions"]->data().begin() + voffset,
-                  attributes_["positions"]->data().end(), 0.f);
-        std::fill(attributes_["normals"]->data().begin() + voffset,
-                  attributes_["normals"]->data().end(), 0.f);
-        std::fill(attributes_["colors"]->data().begin() + voffset,
-                  attributes_["colors"]->data().end(), 0.f);
-        uploadToGPU();
+        removeChild(faceVectorField(visible_face_vector_field_).mesh());
         visible_face_vector_field_ = "(None)";
     }
 }
@@ -605,41 +549,77 @@ void SurfaceMesh::drawGUI()
             if (is_vertex_based)
             {
                 showVertexScalarField(current_sf);
-                ImGui::PlotHistogram(
-                    "Histogram", vertexScalarField(current_sf).histogram_.data(),
-                    static_cast<int>(vertexScalarField(current_sf).histogram_.size()), 0, nullptr,
-                    0.0f, 1.0f, ImVec2(0, 80.0f));
-                if (ImGui::InputFloat("Min. value###sf1", &vertexScalarField(current_sf).vmin_))
+                ScalarField &sf = vertexScalarField(current_sf);
+                const std::vector<float> &histogram = sf.histogram();
+                ImGui::PlotHistogram("Histogram", histogram.data(),
+                                     static_cast<int>(histogram.size()), 0, nullptr, 0.0f, 1.0f,
+                                     ImVec2(0, 80.0f));
+                int bins = static_cast<int>(sf.histogramBins());
+                if (ImGui::SliderInt("Bins###sf9", &bins, 1, 100))
                 {
-                    vertexScalarField(current_sf).dirty_ = true;
+                    sf.setHistogramBins(static_cast<size_t>(bins));
                 }
-                if (ImGui::InputFloat("Max. value###sf2", &vertexScalarField(current_sf).vmax_))
+                float vmin = sf.dataMinRange();
+                if (ImGui::InputFloat("Min. value###sf1", &vmin))
                 {
-                    vertexScalarField(current_sf).dirty_ = true;
+                    sf.setDataMinRange(vmin);
+                }
+                float vmax = sf.dataMaxRange();
+                if (ImGui::InputFloat("Max. value###sf2", &vmax))
+                {
+                    sf.setDataMaxRange(vmax);
                 }
                 if (ImGui::Button("Fit data range###sf3"))
                 {
-                    vertexScalarField(current_sf).fitDataRange();
+                    sf.fitDataRange();
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Fit 1-99%###sf11"))
+                {
+                    sf.fitDataRange(1.f, 99.f);
+                }
+                bool gpu = sf.gpuColormapping();
+                if (ImGui::Checkbox("GPU colormapping###sf7", &gpu))
+                {
+                    sf.setGPUColormapping(gpu);
                 }
             }
             else
             {
                 showFaceScalarField(current_sf);
-                ImGui::PlotHistogram(
-                    "Histogram", faceScalarField(current_sf).histogram_.data(),
-                    static_cast<int>(faceScalarField(current_sf).histogram_.size()), 0, nullptr,
-                    0.0f, 1.0f, ImVec2(0, 80.0f));
-                if (ImGui::InputFloat("Min. value###sf4", &faceScalarField(current_sf).vmin_))
+                ScalarField &sf = faceScalarField(current_sf);
+                const std::vector<float> &histogram = sf.histogram();
+                ImGui::PlotHistogram("Histogram", histogram.data(),
+                                     static_cast<int>(histogram.size()), 0, nullptr, 0.0f, 1.0f,
+                                     ImVec2(0, 80.0f));
+                int bins = static_cast<int>(sf.histogramBins());
+                if (ImGui::SliderInt("Bins###sf10", &bins, 1, 100))
+                {
+                    sf.setHistogramBins(static_cast<size_t>(bins));
+                }
+                float vmin = sf.dataMinRange();
+                if (ImGui::InputFloat("Min. value###sf4", &vmin))
                 {
-                    faceScalarField(current_sf).dirty_ = true;
+                    sf.setDataMinRange(vmin);
                 }
-                if (ImGui::InputFloat("Max. value###sf5", &faceScalarField(current_sf).vmax_))
+                float vmax = sf.dataMaxRange();
+                if (ImGui::InputFloat("Max. value###sf5", &vmax))
                 {
-                    faceScalarField(current_sf).dirty_ = true;
+                    sf.setDataMaxRange(vmax);
                 }
                 if (ImGui::Button("Fit data range###sf6"))
                 {
-                    faceScalarField(current_sf).fitDataRange();
+                    sf.fitDataRange();
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Fit 1-99%###sf12"))
+                {
+                    sf.fitDataRange(1.f, 99.f);
+                }
+                bool gpu = sf.gpuColormapping();
+                if (ImGui::Checkbox("GPU colormapping###sf8", &gpu))
+                {
+                    sf.setGPUColormapping(gpu);
                 }
             }
         }
@@ -678,15 +658,16 @@ void SurfaceMesh::drawGUI()
             showVertexVectorField(current_vf);
             try
             {
-                if (ImGui::SliderFloat("Max. length###vvf1",
-                                       &vertexVectorField(current_vf).max_length_, 0.f, 1.f))
+                VectorField &vf = vertexVectorField(current_vf);
+                float max_length = vf.maxLength();
+                if (ImGui::SliderFloat("Max. length###vvf1", &max_length, 0.f, 1.f))
                 {
-                    vertexVectorField(current_vf).dirty_ = true;
+                    vf.setMaxLength(max_length);
                 }
-                if (ImGui::Checkbox("Scale by magnitude###vvf2",
-                                    &vertexVectorField(current_vf).scale_by_magnitude_))
+                bool scale_by_magnitude = vf.scaleByMagnitude();
+                if (ImGui::Checkbox("Scale by magnitude###vvf2", &scale_by_magnitude))
                 {
-                    vertexVectorField(current_vf).dirty_ = true;
+                    vf.setScaleByMagnitude(scale_by_magnitude);
                 }
             }
             catch (std::exception &)
@@ -724,15 +705,16 @@ void SurfaceMesh::drawGUI()
         if (current_fvf != nullptr && current_fvf != "(None)")
         {
             showFaceVectorField(current_fvf);
-            if (ImGui::SliderFloat("Max. length###fvf1", &faceVectorField(current_fvf).max_length_,
-                                   0.f, 1.f))
+            VectorField &fvf = faceVectorField(current_fvf);
+            float max_length = fvf.maxLength();
+            if (ImGui::SliderFloat("Max. length###fvf1", &max_length, 0.f, 1.f))
             {
-                faceVectorField(current_fvf).dirty_ = true;
+                fvf.setMaxLength(max_length);
             }
-            if (ImGui::Checkbox("Scale by magnitude###fvf2",
-                                &faceVectorField(current_fvf).scale_by_magnitude_))
+            bool scale_by_magnitude = fvf.scaleByMagnitude();
+            if (ImGui::Checkbox("Scale by magnitude###fvf2", &scale_by_magnitude))
             {
-                faceVectorField(current_fvf).dirty_ = true;
+                fvf.setScaleByMagnitude(scale_by_magnitude);
             }
         }
         if (current_fvf == "(None)")
@@ -1,8 +1,6 @@
 #include "RCubeViewer/VectorField.h"
 #include "RCube/Core/Graphics/MeshGen/Cone.h"
-#include "RCube/Core/Graphics/MeshGen/Points.h"
 #include "RCubeViewer/Colormap.h"
-#include "glm/gtx/quaternion.hpp"
 #include <algorithm>
 #include <string>
 #include <vector>
@@ -14,7 +12,28 @@ namespace viewer
 VectorField::VectorField()
 {
     glyph_ = cone(0.1f * 1, 1, 8, 0, glm::pi<float>() * 2.f, false);
-    glyph_.colors.resize(glyph_.vertices.size(), glm::vec3(1, 1, 1));
+}
+VectorField::VectorField(const VectorField &other)
+    : glyph_(other.glyph_), vectors_(other.vectors_), points_(other.points_),
+      max_length_(other.max_length_), scale_by_magnitude_(other.scale_by_magnitude_),
+      cmap_(other.cmap_)
+{
+}
+VectorField &VectorField::operator=(const VectorField &other)
+{
+    if (this != &other)
+    {
+        mesh_ = nullptr;
+        glyph_ = other.glyph_;
+        vectors_ = other.vectors_;
+        points_ = other.points_;
+        max_length_ = other.max_length_;
+        scale_by_magnitude_ = other.scale_by_magnitude_;
+        cmap_ = other.cmap_;
+        dirty_ = true;
+        dirty_glyph_ = true;
+    }
+    return *this;
 }
 const std::vector<glm::vec3> &VectorField::vectors() const
 {
@@ -51,7 +70,22 @@ float VectorField::maxLength() const
 void VectorField::setMaxLength(float val)
 {
     max_length_ = val;
-    dirty_ = true;
+    if (mesh_ != nullptr)
+    {
+        mesh_->glyphParameters().max_length = max_length_;
+    }
+}
+bool VectorField::scaleByMagnitude() const
+{
+    return scale_by_magnitude_;
+}
+void VectorField::setScaleByMagnitude(bool flag)
+{
+    scale_by_magnitude_ = flag;
+    if (mesh_ != nullptr)
+    {
+        mesh_->glyphParameters().scale_by_magnitude = scale_by_magnitude_;
+    }
 }
 Colormap VectorField::cmap() const
 {
@@ -64,108 +98,89 @@ void VectorField::setCmap(Colormap cmap)
 }
 bool VectorField::updateArrows()
 {
-    // Don't recompute the arrows if nothing has changed
-    if (dirty_)
+    if (mesh_ == nullptr)
     {
-        assert(points_.size() == vectors_.size());
-        mesh_.clear();
-        if (points_.empty())
+        mesh_ = Mesh::create(
+            {AttributeBuffer::create("positions", GLuint(AttributeLocation::POSITION), 3),
+             AttributeBuffer::create("normals", GLuint(AttributeLocation::NORMAL), 3),
+             AttributeBuffer::create("colors", GLuint(AttributeLocation::COLOR), 3, 1),
+             AttributeBuffer::create("offsets", GLuint(AttributeLocation::INSTANCE_OFFSET), 4, 1),
+             AttributeBuffer::create("directions", GLuint(AttributeLocation::INSTANCE_DIRECTION),
+                                     4, 1)},
+            MeshPrimitive::Triangles, true);
+        dirty_ = true;
+        dirty_glyph_ = true;
+    }
+    bool updated = false;
+    if (dirty_glyph_)
+    {
+        // Scale the glyph to unit length and move its tail to the origin so that the vertex
+        // shader only has to scale, rotate and translate it
+        glm::vec3 mn, mx;
+        glyph_.boundingBox(mn, mx);
+        const float glyph_length = std::max(std::abs(mx[1] - mn[1]), 1e-6f);
+        std::vector<glm::vec3> vertices = glyph_.vertices;
+        for (glm::vec3 &vertex : vertices)
         {
-            dirty_ = false;
-            return true;
+            vertex /= glyph_length;
+            vertex[1] -= mn.y / glyph_length;
         }
+        mesh_->attribute("positions")->setData(vertices);
+        mesh_->attribute("normals")->setData(glyph_.normals);
+        mesh_->indices()->setData(glyph_.indexed ? glyph_.indices : std::vector<glm::uvec3>());
+        mesh_->uploadToGPU();
+        dirty_glyph_ = false;
+        updated = true;
+    }
+    // Don't update the instances if nothing has changed
+    if (dirty_)
+    {
+        assert(points_.size() == vectors_.size());
         std::vector<float> lengths;
         lengths.reserve(vectors_.size());
-        for (const glm::vec3 &vec : vectors_)
+        std::vector<glm::vec4> offsets;
+        offsets.reserve(vectors_.size());
+        std::vector<glm::vec4> directions;
+        directions.reserve(vectors_.size());
+        for (size_t i = 0; i < vectors_.size(); ++i)
         {
-            const float length = glm::length(vec);
+            const float length = glm::length(vectors_[i]);
             lengths.push_back(length);
+            // Zero vectors are hidden by a zero scale
+            const bool valid = length > 1e-8f;
+            offsets.push_back(glm::vec4(points_[i], valid ? 1.f : 0.f));
+            directions.push_back(
+                glm::vec4(valid ? vectors_[i] / length : glm::vec3(0, 1, 0), length));
         }
         // Compute colors for arrows
         std::vector<glm::vec3> colors;
-        if (cmap_ != Colormap::None)
+        if (cmap_ != Colormap::None && !lengths.empty())
         {
             auto minmax_length = std::minmax_element(lengths.begin(), lengths.end());
             colormap(cmap_, lengths, *minmax_length.first, *minmax_length.second, colors);
         }
-
-        // If scale_by_magnitude_ is true...
-        if (!scale_by_magnitude_)
-        {
-            // ...then, set all vectors' length to max_length_
-            std::fill(lengths.begin(), lengths.end(), max_length_);
-        }
-        else
-        {
-            // ...else, scale the vector lengths such that the longest is max_length_ long.
-            // Find the longest vector's length
-            float longest_length = *std::max_element(lengths.begin(), lengths.end());
-            for (float &len : lengths)
-            {
-                len *= max_length_;
-                // Make sure not to divide by 0
-                if (longest_length > 1e-6)
-                {
-                    len = len / longest_length;
-                }
-            }
-        }
-        // Create the arrows mesh
-        size_t vertices_per_arrow = glyph_.vertices.size();
-        glm::vec3 mn, mx;
-        glyph_.boundingBox(mn, mx);
-        mesh_.indexed = glyph_.indexed;
-        float glyph_length = std::abs(mx[1] - mn[1]);
-        for (size_t i = 0; i < points_.size(); ++i)
-        {
-            TriangleMeshData curr_glyph = glyph_;
-            // Create an arrow with glyph
-            float h = lengths[i];
-            float scale = h / glyph_length;
-            for (glm::vec3 &vertex : curr_glyph.vertices)
-            {
-                vertex *= scale;
-            }
-            for (glm::vec3 &vertex : curr_glyph.vertices)
-            {
-                vertex[1] -= mn.y * scale;
-            }
-            glm::quat q = glm::rotation(glm::vec3(0.f, 1.f, 0.f), glm::normalize(vectors_[i]));
-            for (glm::vec3 &vertex : curr_glyph.vertices)
-            {
-                vertex = glm::rotate(q, vertex);
-            }
-            // Shift the arrow such that the vector's tail coincides with points[i]
-            for (glm::vec3 &vertex : curr_glyph.vertices)
-            {
-                vertex += points_[i];
-            }
-            mesh_.append(curr_glyph);
-        }
-        // Set colors for arrows based on colormap
-        // The color must be set for each of the vertices in the arrow's mesh
-        if (!colors.empty())
-        {
-            mesh_.colors.clear();
-            for (size_t i = 0; i < colors.size(); ++i)
-            {
-                for (size_t j = 0; j < vertices_per_arrow; ++j)
-                {
-                    mesh_.colors.push_back(colors[i]);
-                }
-            }
-        }
+        // Without colors the attribute is disabled and the arrows are white
+        mesh_->attribute("colors")->setData(colors);
+        mesh_->attribute("offsets")->setData(offsets);
+        mesh_->attribute("directions")->setData(directions);
+        mesh_->uploadToGPU();
+        // The longest vector is drawn with max_length_ when scaling by magnitude
+        const float longest_length =
+            lengths.empty() ? 1.f : *std::max_element(lengths.begin(), lengths.end());
+        mesh_->glyphParameters().max_magnitude = longest_length > 1e-6f ? longest_length : 1.f;
         dirty_ = false;
-        return true;
+        updated = true;
     }
-    return false;
+    mesh_->glyphParameters().max_length = max_length_;
+    mesh_->glyphParameters().scale_by_magnitude = scale_by_magnitude_;
+    return updated;
 }
 void VectorField::setGlyph(const TriangleMeshData &glyph)
 {
     glyph_ = glyph;
-    dirty_ = true;
+    dirty_glyph_ = true;
 }
-const TriangleMeshData &VectorField::mesh() const
+std::shared_ptr<Mesh> VectorField::mesh() const
 {
     return mesh_;
 }